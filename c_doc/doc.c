@@ -44,9 +44,10 @@ static doc *dummy_doc_internal_ptr = (doc*)&dummy_doc_internal;
 // ilegal ascii characters on names
 static const char *illegal_chars_doc_name = "\a\b\t\n\v\f\r\"\'()*+,.\\";
 
-// internal error vars, the char * one holds information about the name of instance to be acted on
-static errno_doc_code_t errno_doc_code_internal = 0;
-static char *errno_msg_doc_internal = NULL;
+// internal error vars, the char * one holds information about the name of instance to be acted on.
+// One per thread, so docs can be built and deleted by several threads at once
+static _Thread_local errno_doc_code_t errno_doc_code_internal = 0;
+static _Thread_local char *errno_msg_doc_internal = NULL;
 
 // array to get the value and name of defined errors 
 static const errno_doc_t errno_doc_msg_code_array[] = {
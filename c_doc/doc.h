@@ -288,7 +288,7 @@ typedef struct{
     size_t len;                                 /**< length of the binary data */                                                   
 }doc_bindata;
 
-#pragma (pop)
+#pragma pack(pop)
 
 /* ----------------------------------------- Prototypes ------------------------------------- */
 
@@ -0,0 +1,741 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "doc_cbor.h"
+#include "parse_utils.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define CBOR_WRITER_BUFFER_SIZE     (64 * 1024)                                     // chunk size passed to the write functions
+#define CBOR_MAX_DEPTH              (1024)                                          // maximum nesting accepted by the parser
+
+#define CBOR_MAJOR_UINT             (0)
+#define CBOR_MAJOR_NEGINT           (1)
+#define CBOR_MAJOR_BYTES            (2)
+#define CBOR_MAJOR_TEXT             (3)
+#define CBOR_MAJOR_ARRAY            (4)
+#define CBOR_MAJOR_MAP              (5)
+#define CBOR_MAJOR_TAG              (6)
+#define CBOR_MAJOR_SIMPLE           (7)
+
+#define CBOR_INFO_INDEFINITE        (31)
+#define CBOR_BREAK                  (0xFF)
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// streaming writer
+struct doc_cbor_writer{
+    wbuffer_t buffer;
+    fsink_t *sink;                                                                  // only set when opened by doc_cbor_writer_open()
+    doc_cbor_serialize_opt_t options;
+};
+
+// parser cursor
+typedef struct{
+    uint8_t *cursor;
+    uint8_t *end;
+    doc_cbor_parse_opt_t options;
+}cbor_reader_t;
+
+// member of a object being sorted for the deterministic encoding
+typedef struct{
+    doc *member;
+    size_t len;
+}cbor_sort_entry_t;
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+// encode the initial byte and argument with the shortest form, returns the length written to head
+static size_t encode_head(uint8_t major, uint64_t value, uint8_t head[9]){
+    size_t bytes;
+
+    if(value < 24){
+        head[0] = (major << 5) | (uint8_t)value;
+        return 1;
+    }
+    else if(value <= UINT8_MAX){
+        head[0] = (major << 5) | 24;
+        bytes = 1;
+    }
+    else if(value <= UINT16_MAX){
+        head[0] = (major << 5) | 25;
+        bytes = 2;
+    }
+    else if(value <= UINT32_MAX){
+        head[0] = (major << 5) | 26;
+        bytes = 4;
+    }
+    else{
+        head[0] = (major << 5) | 27;
+        bytes = 8;
+    }
+
+    for(size_t i = 0; i < bytes; i++)
+        head[bytes - i] = (uint8_t)(value >> (8 * i));
+
+    return bytes + 1;
+}
+
+// write the initial byte and argument
+static void write_head(doc_cbor_writer *writer, uint8_t major, uint64_t value){
+    uint8_t head[9];
+    wbuffer_write(&writer->buffer, head, encode_head(major, value, head));
+}
+
+// write a simple value byte followed by a big endian value of 'bytes' length
+static void write_simple(doc_cbor_writer *writer, uint8_t info, uint64_t bits, size_t bytes){
+    uint8_t data[9];
+
+    data[0] = (CBOR_MAJOR_SIMPLE << 5) | info;
+    for(size_t i = 0; i < bytes; i++)
+        data[bytes - i] = (uint8_t)(bits >> (8 * i));
+
+    wbuffer_write(&writer->buffer, data, bytes + 1);
+}
+
+// convert a float to a half float, only if it can be done without losing precision
+static bool float_to_half(float value, uint16_t *half){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF);
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if(exponent == 0xFF){                                                           // inf and nan, nan is canonical
+        *half = mantissa ? 0x7E00 : (sign | 0x7C00);
+        return true;
+    }
+
+    if(exponent == 0 && mantissa == 0){                                             // zero
+        *half = sign;
+        return true;
+    }
+
+    if(exponent == 0) return false;                                                 // float subnormals are too small for halfs
+
+    exponent -= 127;
+
+    if(exponent >= -14 && exponent <= 15){                                          // half normals
+        if(mantissa & 0x1FFF) return false;
+
+        *half = sign | (uint16_t)((exponent + 15) << 10) | (uint16_t)(mantissa >> 13);
+        return true;
+    }
+
+    if(exponent >= -24 && exponent < -14){                                          // half subnormals, value = m * 2^-24
+        uint32_t full = mantissa | 0x800000;
+        uint32_t shift = (uint32_t)(-exponent - 1);
+
+        if(full & ((1u << shift) - 1)) return false;
+
+        *half = sign | (uint16_t)(full >> shift);
+        return true;
+    }
+
+    return false;
+}
+
+// convert a half float to float
+static float half_to_float(uint16_t half){
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    float value;
+
+    if(exponent == 0)
+        value = ldexpf((float)mantissa, -24);
+    else if(exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+
+    return (half & 0x8000) ? -value : value;
+}
+
+// byte length of a string, some strings count the null terminator on len
+static size_t string_length(doc *variable){
+    return strnlen(((doc_string*)variable)->string, ((doc_string*)variable)->len);
+}
+
+// compare two keys by their deterministic encoding, bytewise
+static int compare_sort_entries(const void *a, const void *b){
+    const cbor_sort_entry_t *entry_a = (const cbor_sort_entry_t*)a;
+    const cbor_sort_entry_t *entry_b = (const cbor_sort_entry_t*)b;
+    uint8_t head_a[9], head_b[9];
+
+    size_t head_a_len = encode_head(CBOR_MAJOR_TEXT, entry_a->len, head_a);
+    size_t head_b_len = encode_head(CBOR_MAJOR_TEXT, entry_b->len, head_b);
+
+    int result = memcmp(head_a, head_b, head_a_len < head_b_len ? head_a_len : head_b_len);
+    if(result != 0) return result;
+    if(head_a_len != head_b_len) return head_a_len < head_b_len ? -1 : 1;
+
+    return memcmp(entry_a->member->name, entry_b->member->name, entry_a->len);      // same head, same length
+}
+
+// check if there are at least len bytes left
+static bool reader_has(cbor_reader_t *reader, size_t len){
+    return (size_t)(reader->end - reader->cursor) >= len;
+}
+
+// read the initial byte and its argument, indefinite is set for info 31
+static bool read_head(cbor_reader_t *reader, uint8_t *major, uint64_t *value, bool *indefinite){
+    if(!reader_has(reader, 1)) return false;
+
+    uint8_t initial = *(reader->cursor++);
+    uint8_t info = initial & 0x1F;
+    size_t bytes;
+
+    *major = initial >> 5;
+    *indefinite = false;
+    *value = 0;
+
+    if(info < 24){
+        *value = info;
+        return true;
+    }
+
+    switch(info){
+        case 24: bytes = 1; break;
+        case 25: bytes = 2; break;
+        case 26: bytes = 4; break;
+        case 27: bytes = 8; break;
+
+        case CBOR_INFO_INDEFINITE:
+            *indefinite = true;
+            return true;
+
+        default:                                                                    // 28 to 30 are reserved
+            return false;
+    }
+
+    if(!reader_has(reader, bytes)) return false;
+
+    for(size_t i = 0; i < bytes; i++)
+        *value = (*value << 8) | reader->cursor[i];
+
+    reader->cursor += bytes;
+    return true;
+}
+
+// allocate a value doc
+static doc *new_value(doc_type_t type, size_t size){
+    doc *variable = calloc(1, size);
+    variable->type = type;
+    return variable;
+}
+
+// read a text or byte string, indefinite strings are concatenated and always copied
+static doc *parse_string(cbor_reader_t *reader, uint8_t major, uint64_t len, bool indefinite){
+    doc_type_t type = (major == CBOR_MAJOR_TEXT) ? dt_string : dt_bindata;
+    uint8_t *data;
+
+    if(!indefinite){
+        if(!reader_has(reader, len)) return NULL;
+
+        doc *variable = new_value(type, sizeof(doc_bindata));
+
+        if(reader->options & cbor_parse_zero_copy){
+            variable->type = (major == CBOR_MAJOR_TEXT) ? dt_const_string : dt_const_bindata;
+            data = reader->cursor;
+        }
+        else{
+            data = malloc(len + 1);
+            memcpy(data, reader->cursor, len);
+            data[len] = '\0';
+        }
+
+        ((doc_bindata*)variable)->data = data;
+        ((doc_bindata*)variable)->len = len;
+        reader->cursor += len;
+
+        return variable;
+    }
+
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, 64, NULL, NULL);
+
+    while(1){
+        if(!reader_has(reader, 1)){
+            wbuffer_free(&buffer);
+            return NULL;
+        }
+
+        if(*reader->cursor == CBOR_BREAK){
+            reader->cursor++;
+            break;
+        }
+
+        uint8_t chunk_major;
+        uint64_t chunk_len;
+        bool chunk_indefinite;
+
+        if( !read_head(reader, &chunk_major, &chunk_len, &chunk_indefinite) ||
+            chunk_major != major || chunk_indefinite || !reader_has(reader, chunk_len)
+        ){                                                                          // chunks must be definite strings of the same type
+            wbuffer_free(&buffer);
+            return NULL;
+        }
+
+        wbuffer_write(&buffer, reader->cursor, chunk_len);
+        reader->cursor += chunk_len;
+    }
+
+    doc *variable = new_value(type, sizeof(doc_bindata));
+    ((doc_bindata*)variable)->data = (uint8_t*)wbuffer_release(&buffer, &((doc_bindata*)variable)->len);
+
+    return variable;
+}
+
+static doc *parse_value(cbor_reader_t *reader, size_t depth);
+
+// check for the break of a indefinite container, consuming it
+static bool reader_break(cbor_reader_t *reader){
+    if(reader_has(reader, 1) && *reader->cursor == CBOR_BREAK){
+        reader->cursor++;
+        return true;
+    }
+
+    return false;
+}
+
+// read a map key as a allocated name
+static char *parse_key(cbor_reader_t *reader, size_t depth){
+    doc *key = parse_value(reader, depth);
+    if(key == NULL) return NULL;
+
+    char *name = NULL;
+    wbuffer_t buffer;
+
+    switch(key->type){
+        case dt_string:
+        case dt_const_string:
+            name = malloc(((doc_string*)key)->len + 1);
+            memcpy(name, ((doc_string*)key)->string, ((doc_string*)key)->len);
+            name[((doc_string*)key)->len] = '\0';
+        break;
+
+        case dt_uint64:
+        case integer_dt_type_parse_utils:
+            wbuffer_init(&buffer, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 2, NULL, NULL);
+
+            if(key->type == dt_uint64)
+                wbuffer_write_uint(&buffer, ((doc_uint64_t*)key)->value);
+            else
+                wbuffer_write_int(&buffer, ((integer_doc_type_parse_utils*)key)->value);
+
+            name = wbuffer_release(&buffer, NULL);
+        break;
+
+        default:
+        break;
+    }
+
+    doc_delete(key, ".");
+    return name;
+}
+
+// parse a array or map, size is ignored for indefinite containers
+static doc *parse_container(cbor_reader_t *reader, doc_type_t type, uint64_t size, bool indefinite, size_t depth){
+    doc *variable = new_value(type, sizeof(doc));
+    doc *last_member = NULL;
+
+    for(uint64_t i = 0; indefinite || i < size; i++){
+        if(indefinite && reader_break(reader))
+            break;
+
+        char *name = NULL;
+
+        if(type == dt_obj){
+            name = parse_key(reader, depth + 1);
+
+            if(name == NULL){
+                doc_delete(variable, ".");
+                return NULL;
+            }
+        }
+
+        doc *member = parse_value(reader, depth + 1);
+
+        if(member == NULL){
+            free(name);
+            doc_delete(variable, ".");
+            return NULL;
+        }
+
+        if(name == NULL){
+            name = malloc(1);
+            *name = '\0';
+        }
+
+        member->name = name;
+        member->parent = variable;
+
+        if(last_member == NULL){
+            variable->child = member;
+        }
+        else{
+            last_member->next = member;
+            member->prev = last_member;
+        }
+
+        last_member = member;
+        variable->childs++;
+    }
+
+    return variable;
+}
+
+// parse any cbor value, recursive
+static doc *parse_value(cbor_reader_t *reader, size_t depth){
+    if(depth > CBOR_MAX_DEPTH) return NULL;
+
+    uint8_t info = reader_has(reader, 1) ? (*reader->cursor & 0x1F) : 0;
+    uint8_t major;
+    uint64_t value;
+    bool indefinite;
+    doc *variable;
+
+    if(!read_head(reader, &major, &value, &indefinite)) return NULL;
+
+    switch(major){
+        case CBOR_MAJOR_UINT:
+            if(indefinite) return NULL;
+
+            if(value > INT64_MAX){
+                variable = new_value(dt_uint64, sizeof(doc_uint64_t));
+                ((doc_uint64_t*)variable)->value = value;
+            }
+            else{
+                variable = new_value(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils));
+                ((integer_doc_type_parse_utils*)variable)->value = (integer_type_parse_utils)value;
+            }
+        return variable;
+
+        case CBOR_MAJOR_NEGINT:
+            if(indefinite) return NULL;
+
+            if(value > INT64_MAX){                                                  // below INT64_MIN, only a double can hold it
+                variable = new_value(dt_double, sizeof(doc_double));
+                ((doc_double*)variable)->value = -1.0 - (double)value;
+            }
+            else{
+                variable = new_value(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils));
+                ((integer_doc_type_parse_utils*)variable)->value = (integer_type_parse_utils)(-1 - (int64_t)value);
+            }
+        return variable;
+
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            return parse_string(reader, major, value, indefinite);
+
+        case CBOR_MAJOR_ARRAY:
+            return parse_container(reader, dt_array, value, indefinite, depth);
+
+        case CBOR_MAJOR_MAP:
+            return parse_container(reader, dt_obj, value, indefinite, depth);
+
+        case CBOR_MAJOR_TAG:                                                        // tags are skipped
+            if(indefinite) return NULL;
+            return parse_value(reader, depth + 1);
+
+        case CBOR_MAJOR_SIMPLE:
+        default:
+            if(indefinite) return NULL;                                             // a break outside of a indefinite item
+
+            switch(info){
+                case 20:                                                            // false
+                case 21:                                                            // true
+                    variable = new_value(dt_bool, sizeof(doc_bool));
+                    ((doc_bool*)variable)->value = (info == 21);
+                return variable;
+
+                case 25:                                                            // half float
+                    variable = new_value(dt_float, sizeof(doc_float));
+                    ((doc_float*)variable)->value = half_to_float((uint16_t)value);
+                return variable;
+
+                case 26:                                                            // single float
+                    {
+                        uint32_t bits = (uint32_t)value;
+                        variable = new_value(dt_float, sizeof(doc_float));
+                        memcpy(&((doc_float*)variable)->value, &bits, sizeof(bits));
+                    }
+                return variable;
+
+                case 27:                                                            // double float
+                    variable = new_value(dt_double, sizeof(doc_double));
+                    memcpy(&((doc_double*)variable)->value, &value, sizeof(value));
+                return variable;
+
+                default:                                                            // null, undefined and unassigned simple values
+                return new_value(dt_null, sizeof(doc));
+            }
+    }
+}
+
+/* ----------------------------------------- Writer ----------------------------------------- */
+
+// new streaming writer
+doc_cbor_writer *doc_cbor_writer_new(doc_cbor_write_function_t write_function, void *context, doc_cbor_serialize_opt_t options){
+    doc_cbor_writer *writer = malloc(sizeof(*writer));
+
+    wbuffer_init(&writer->buffer, CBOR_WRITER_BUFFER_SIZE, write_function, context);
+    writer->sink = NULL;
+    writer->options = options > cbor_serialize_opt_max ? cbor_serialize_normal_mode : options;
+
+    return writer;
+}
+
+// new streaming writer to a file
+doc_cbor_writer *doc_cbor_writer_open(char *filename, doc_cbor_serialize_opt_t options){
+    if(filename == NULL) return NULL;
+
+    fsink_t *sink = fsink_open(filename);
+    if(sink == NULL) return NULL;
+
+    doc_cbor_writer *writer = doc_cbor_writer_new(fsink_write, sink, options);
+    writer->sink = sink;
+
+    return writer;
+}
+
+// flush and free a writer
+void doc_cbor_writer_close(doc_cbor_writer *writer){
+    if(writer == NULL) return;
+
+    wbuffer_flush(&writer->buffer);
+    wbuffer_free(&writer->buffer);
+
+    if(writer->sink != NULL)
+        fsink_close(writer->sink);
+
+    free(writer);
+}
+
+// array header
+void doc_cbor_write_array(doc_cbor_writer *writer, uint64_t size){
+    if(size == DOC_CBOR_INDEFINITE)
+        wbuffer_putc(&writer->buffer, (char)((CBOR_MAJOR_ARRAY << 5) | CBOR_INFO_INDEFINITE));
+    else
+        write_head(writer, CBOR_MAJOR_ARRAY, size);
+}
+
+// map header
+void doc_cbor_write_map(doc_cbor_writer *writer, uint64_t size){
+    if(size == DOC_CBOR_INDEFINITE)
+        wbuffer_putc(&writer->buffer, (char)((CBOR_MAJOR_MAP << 5) | CBOR_INFO_INDEFINITE));
+    else
+        write_head(writer, CBOR_MAJOR_MAP, size);
+}
+
+// end of a indefinite item
+void doc_cbor_write_break(doc_cbor_writer *writer){
+    wbuffer_putc(&writer->buffer, (char)CBOR_BREAK);
+}
+
+// text string
+void doc_cbor_write_text(doc_cbor_writer *writer, const char *string, size_t len){
+    write_head(writer, CBOR_MAJOR_TEXT, len);
+    wbuffer_write(&writer->buffer, string, len);
+}
+
+// byte string
+void doc_cbor_write_bytes(doc_cbor_writer *writer, const void *data, size_t len){
+    write_head(writer, CBOR_MAJOR_BYTES, len);
+    wbuffer_write(&writer->buffer, data, len);
+}
+
+// unsigned integer
+void doc_cbor_write_uint(doc_cbor_writer *writer, uint64_t value){
+    write_head(writer, CBOR_MAJOR_UINT, value);
+}
+
+// signed integer, negatives are encoded as -1 - n
+void doc_cbor_write_int(doc_cbor_writer *writer, int64_t value){
+    if(value >= 0)
+        write_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    else
+        write_head(writer, CBOR_MAJOR_NEGINT, (uint64_t)(-1 - value));
+}
+
+// float, shortest exact form on deterministic mode
+void doc_cbor_write_float(doc_cbor_writer *writer, float value){
+    uint16_t half;
+    uint32_t bits;
+
+    if((writer->options & cbor_serialize_deterministic) && float_to_half(value, &half)){
+        write_simple(writer, 25, half, 2);
+        return;
+    }
+
+    if(isnan(value) && (writer->options & cbor_serialize_deterministic)){           // canonical nan
+        write_simple(writer, 25, 0x7E00, 2);
+        return;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    write_simple(writer, 26, bits, 4);
+}
+
+// double, shortest exact form on deterministic mode. Finite values out of the float range are
+// checked before the cast, converting them to float is undefined
+void doc_cbor_write_double(doc_cbor_writer *writer, double value){
+    uint64_t bits;
+    bool fits_float = !isfinite(value) || (fabs(value) <= FLT_MAX && (double)(float)value == value);
+
+    if((writer->options & cbor_serialize_deterministic) && fits_float){
+        doc_cbor_write_float(writer, (float)value);
+        return;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    write_simple(writer, 27, bits, 8);
+}
+
+// bool
+void doc_cbor_write_bool(doc_cbor_writer *writer, bool value){
+    wbuffer_putc(&writer->buffer, (char)((CBOR_MAJOR_SIMPLE << 5) | (value ? 21 : 20)));
+}
+
+// null
+void doc_cbor_write_null(doc_cbor_writer *writer){
+    wbuffer_putc(&writer->buffer, (char)((CBOR_MAJOR_SIMPLE << 5) | 22));
+}
+
+// whole doc structure, recursive
+void doc_cbor_write_doc(doc_cbor_writer *writer, doc *variable){
+    if(writer == NULL || variable == NULL) return;
+
+    bool deterministic = writer->options & cbor_serialize_deterministic;
+    bool indefinite = !deterministic && (writer->options & cbor_serialize_indefinite_length);
+
+    switch(variable->type){
+        case dt_obj:
+            doc_cbor_write_map(writer, indefinite ? DOC_CBOR_INDEFINITE : variable->childs);
+
+            if(deterministic && variable->childs > 1){                             // members sorted by the encoding of their keys
+                cbor_sort_entry_t *entries = malloc(sizeof(*entries) * variable->childs);
+                doc_size_t i = 0;
+
+                for(doc_loop(member, variable)){
+                    entries[i].member = member;
+                    entries[i].len = strlen(member->name);
+                    i++;
+                }
+
+                qsort(entries, i, sizeof(*entries), compare_sort_entries);
+
+                for(doc_size_t j = 0; j < i; j++){
+                    doc_cbor_write_text(writer, entries[j].member->name, entries[j].len);
+                    doc_cbor_write_doc(writer, entries[j].member);
+                }
+
+                free(entries);
+            }
+            else{
+                for(doc_loop(member, variable)){
+                    doc_cbor_write_text(writer, member->name, strlen(member->name));
+                    doc_cbor_write_doc(writer, member);
+                }
+            }
+
+            if(indefinite) doc_cbor_write_break(writer);
+        break;
+
+        case dt_array:
+            doc_cbor_write_array(writer, indefinite ? DOC_CBOR_INDEFINITE : variable->childs);
+
+            for(doc_loop(member, variable))
+                doc_cbor_write_doc(writer, member);
+
+            if(indefinite) doc_cbor_write_break(writer);
+        break;
+
+        case dt_null:       doc_cbor_write_null(writer);                                            break;
+        case dt_bool:       doc_cbor_write_bool(writer, ((doc_bool*)variable)->value);              break;
+        case dt_double:     doc_cbor_write_double(writer, ((doc_double*)variable)->value);          break;
+        case dt_float:      doc_cbor_write_float(writer, ((doc_float*)variable)->value);            break;
+        case dt_uint:       doc_cbor_write_uint(writer, ((doc_uint_t*)variable)->value);            break;
+        case dt_uint64:     doc_cbor_write_uint(writer, ((doc_uint64_t*)variable)->value);          break;
+        case dt_uint32:     doc_cbor_write_uint(writer, ((doc_uint32_t*)variable)->value);          break;
+        case dt_uint16:     doc_cbor_write_uint(writer, ((doc_uint16_t*)variable)->value);          break;
+        case dt_uint8:      doc_cbor_write_uint(writer, ((doc_uint8_t*)variable)->value);           break;
+        case dt_int:        doc_cbor_write_int(writer, ((doc_int*)variable)->value);                break;
+        case dt_int64:      doc_cbor_write_int(writer, ((doc_int64_t*)variable)->value);            break;
+        case dt_int32:      doc_cbor_write_int(writer, ((doc_int32_t*)variable)->value);            break;
+        case dt_int16:      doc_cbor_write_int(writer, ((doc_int16_t*)variable)->value);            break;
+        case dt_int8:       doc_cbor_write_int(writer, ((doc_int8_t*)variable)->value);             break;
+
+        case dt_string:
+        case dt_const_string:
+            doc_cbor_write_text(writer, ((doc_string*)variable)->string, string_length(variable));
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:
+            doc_cbor_write_bytes(writer, ((doc_bindata*)variable)->data, ((doc_bindata*)variable)->len);
+        break;
+    }
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// opens and parse a cbor file to a doc structure
+doc *doc_cbor_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    size_t size;
+    uint8_t *stream = fload(filename, &size);
+    if(stream == NULL) return NULL;
+
+    doc *cbor = doc_cbor_parse(stream, size, cbor_parse_normal_mode);               // the stream is freed, so copy
+
+    free(stream);
+
+    return cbor;
+}
+
+// save doc as a cbor file
+void doc_cbor_save(doc *cbor_doc, char *filename, doc_cbor_serialize_opt_t options){
+    if(cbor_doc == NULL) return;
+
+    doc_cbor_writer *writer = doc_cbor_writer_open(filename, options);
+    if(writer == NULL) return;
+
+    doc_cbor_write_doc(writer, cbor_doc);
+    doc_cbor_writer_close(writer);
+}
+
+// parse cbor
+doc *doc_cbor_parse(uint8_t *stream, size_t len, doc_cbor_parse_opt_t options){
+    if(stream == NULL) return NULL;
+    if(options > cbor_parse_opt_max) options = cbor_parse_normal_mode;
+
+    cbor_reader_t reader = { .cursor = stream, .end = stream + len, .options = options };
+
+    doc *cbor = parse_value(&reader, 0);
+    if(cbor == NULL) return NULL;
+
+    const char *name = "cbor";
+    cbor->name = malloc(strlen(name) + 1);
+    strcpy(cbor->name, name);
+
+    return cbor;
+}
+
+// serialize a doc to cbor
+uint8_t *doc_cbor_serialize(doc *cbor_doc, size_t *len, doc_cbor_serialize_opt_t options){
+    if(cbor_doc == NULL) return NULL;
+
+    doc_cbor_writer writer = { .sink = NULL, .options = options > cbor_serialize_opt_max ? cbor_serialize_normal_mode : options };
+    wbuffer_init(&writer.buffer, CBOR_WRITER_BUFFER_SIZE, NULL, NULL);
+
+    doc_cbor_write_doc(&writer, cbor_doc);
+
+    return (uint8_t*)wbuffer_release(&writer.buffer, len);
+}
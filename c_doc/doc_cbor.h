@@ -0,0 +1,179 @@
+#ifndef _DOC_CBOR_HEADER_
+#define _DOC_CBOR_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "doc.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_CBOR_INDEFINITE         (UINT64_MAX)                                    // size to start indefinite length arrays and maps on the writer
+
+/* ----------------------------------------- Enumerators ------------------------------------ */
+
+/**
+ * @brief options that can be passed to the cbor parse calls, can be combined with the bitwise OR operator
+ */
+typedef enum{
+    cbor_parse_normal_mode                          = 0,                            /**< Strings and byte strings are copied */
+    cbor_parse_zero_copy                            = 0x01,                         /**< Strings and byte strings become dt_const_string and dt_const_bindata pointing inside the input, that must outlive the doc. Strings are NOT null terminated, use the len */
+    cbor_parse_opt_max                              = 0x01                          /**< Maximum number of bitwised arguments */
+}doc_cbor_parse_opt_t;
+
+/**
+ * @brief options that can be passed to the cbor serialize calls, can be combined with the bitwise OR operator
+ */
+typedef enum{
+    cbor_serialize_normal_mode                      = 0,                            /**< Definite lengths, members in the doc order, floats as their own type */
+    cbor_serialize_deterministic                    = 0x01,                         /**< RFC 8949 4.2.1 core deterministic encoding: map keys sorted bytewise by their encoding, floats in their shortest exact form, no indefinite lengths */
+    cbor_serialize_indefinite_length                = 0x02,                         /**< Arrays and maps are written with indefinite length, ignored on deterministic mode */
+    cbor_serialize_opt_max                          = 0x03                          /**< Maximum number of bitwised arguments */
+}doc_cbor_serialize_opt_t;
+
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief opaque type for a streaming cbor writer
+ */
+typedef struct doc_cbor_writer doc_cbor_writer;
+
+/**
+ * @brief type for a function that receives the output of a cbor writer
+ */
+typedef void (*doc_cbor_write_function_t)(void *context, const void *data, size_t len);
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+/**
+ * @brief opens and parses a cbor file to a doc structure, strings are always copied
+ * @param filename: the path to file
+ * @return a doc data struture
+ */
+doc *doc_cbor_open(char *filename);
+
+/**
+ * @brief serializes a doc structure and save it to a cbor file
+ * @param cbor_doc: doc data structure
+ * @param filename: path to the file
+ * @param options: doc_cbor_serialize_opt_t options
+ */
+void doc_cbor_save(doc *cbor_doc, char *filename, doc_cbor_serialize_opt_t options);
+
+/**
+ * @brief parse a cbor stream to a 'doc' structure
+ * @note maps become dt_obj and arrays dt_array, integers become int64, or uint64 when they don't fit,
+ * half and single floats become dt_float and double floats dt_double, text strings become dt_string,
+ * byte strings dt_bindata, undefined becomes dt_null. Tags are skipped and its value is parsed.
+ * Map keys must be text strings or integers, integer keys are converted to decimal names.
+ * Indefinite length items are accepted. The root value will be named "cbor".
+ * @param stream: cbor encoded data
+ * @param len: length of the data
+ * @param options: doc_cbor_parse_opt_t options
+ * @return pointer to 'doc' structure, NULL if the stream is malformed or truncated
+ */
+doc *doc_cbor_parse(uint8_t *stream, size_t len, doc_cbor_parse_opt_t options);
+
+/**
+ * @brief serializes a 'doc' structure to cbor. The name of the root is not written
+ * and members of arrays are written without their names
+ * @param cbor_doc: pointer to 'doc' structure, of any type
+ * @param len: pointer where the length of the output will be written
+ * @param options: doc_cbor_serialize_opt_t options
+ * @return cbor data, must be freed by the caller. NULL if cbor_doc is NULL
+ */
+uint8_t *doc_cbor_serialize(doc *cbor_doc, size_t *len, doc_cbor_serialize_opt_t options);
+
+/**
+ * @brief creates a streaming writer, output is buffered and passed to write_function in chunks
+ * @param write_function: function that receives the output
+ * @param context: opaque pointer passed to write_function
+ * @param options: doc_cbor_serialize_opt_t options, used by doc_cbor_write_doc() and the float calls
+ * @return a new writer, close it with doc_cbor_writer_close()
+ */
+doc_cbor_writer *doc_cbor_writer_new(doc_cbor_write_function_t write_function, void *context, doc_cbor_serialize_opt_t options);
+
+/**
+ * @brief creates a streaming writer that writes to a file
+ * @param filename: path to the file
+ * @param options: doc_cbor_serialize_opt_t options
+ * @return a new writer, NULL if the file could not be opened
+ */
+doc_cbor_writer *doc_cbor_writer_open(char *filename, doc_cbor_serialize_opt_t options);
+
+/**
+ * @brief flushes and frees a writer, closing the file if opened by doc_cbor_writer_open()
+ * @param writer: the writer
+ */
+void doc_cbor_writer_close(doc_cbor_writer *writer);
+
+/**
+ * @brief writes a array header, followed by 'size' values. With DOC_CBOR_INDEFINITE the array
+ * goes on until doc_cbor_write_break() is called
+ */
+void doc_cbor_write_array(doc_cbor_writer *writer, uint64_t size);
+
+/**
+ * @brief writes a map header, followed by 'size' pairs of key and value. With DOC_CBOR_INDEFINITE the map
+ * goes on until doc_cbor_write_break() is called
+ */
+void doc_cbor_write_map(doc_cbor_writer *writer, uint64_t size);
+
+/**
+ * @brief ends a indefinite length array or map
+ */
+void doc_cbor_write_break(doc_cbor_writer *writer);
+
+/**
+ * @brief writes a text string, may be used as a map key
+ */
+void doc_cbor_write_text(doc_cbor_writer *writer, const char *string, size_t len);
+
+/**
+ * @brief writes a byte string
+ */
+void doc_cbor_write_bytes(doc_cbor_writer *writer, const void *data, size_t len);
+
+/**
+ * @brief writes a signed integer
+ */
+void doc_cbor_write_int(doc_cbor_writer *writer, int64_t value);
+
+/**
+ * @brief writes a unsigned integer
+ */
+void doc_cbor_write_uint(doc_cbor_writer *writer, uint64_t value);
+
+/**
+ * @brief writes a float, on deterministic mode as a half float when exact
+ */
+void doc_cbor_write_float(doc_cbor_writer *writer, float value);
+
+/**
+ * @brief writes a double, on deterministic mode as a half or single float when exact
+ */
+void doc_cbor_write_double(doc_cbor_writer *writer, double value);
+
+/**
+ * @brief writes a bool
+ */
+void doc_cbor_write_bool(doc_cbor_writer *writer, bool value);
+
+/**
+ * @brief writes a null
+ */
+void doc_cbor_write_null(doc_cbor_writer *writer);
+
+/**
+ * @brief writes a whole doc structure, same encoding as doc_cbor_serialize()
+ */
+void doc_cbor_write_doc(doc_cbor_writer *writer, doc *variable);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
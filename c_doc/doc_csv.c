@@ -2,410 +2,2315 @@
 #include "parse_utils.h"
 #include "doc_print.h"
 #include "base64.h"
+#include "scan_utils.h"
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define CSV_MIN_CHUNK_SIZE      (1 << 16)                                           // smallest range given to a parser thread
+#define CSV_TYPE_SAMPLE_ROWS    (100)                                               // rows used to infer the column types
+#define CSV_READER_BUFFER_SIZE  (1 << 16)                                           // initial read buffer of a row reader
+#define CSV_WRITER_BUFFER_SIZE  (1 << 16)                                           // output flushed to the file in chunks of this size
+#define CSV_INDEX_MAGIC         "DOCCSX"                                            // magic number at the start of a index sidecar
+#define CSV_INDEX_VERSION       (1)                                                 // version of the sidecar layout
+#define CSV_INDEX_ENDIANNESS    (0x01020304)                                        // written in host order, to detect byte order mismatch
 
 /* ----------------------------------------- Private Globals -------------------------------- */
 
 // standard separators to be used when parsing
-static char *csv_parser_separators_default = ",;";
+static const char *csv_parser_separators_default = ",;";
 
 // standard separator to be used when stringifying
-static char csv_stringify_separator_default = ',';
+static const char csv_stringify_separator_default = ',';
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// parser state over a stream, fields are delimited by the separators and line breaks found outside quotes
+typedef struct{
+    const char *cursor;                                                             // start of the next field
+    const char *end;
+    const char *block;                                                              // next block to scan
+    const char *mask_base;                                                          // start of the block of the mask
+    uint64_t delimiters;                                                            // delimiters left in the block
+    uint64_t in_quotes;                                                             // all ones when the last block ended inside quotes
+    scan_set_t sets[2];                                                             // quotes, separators and line breaks
+}csv_parser_t;
+
+// a field of the stream, quotes excluded
+typedef struct{
+    const char *start;
+    size_t len;
+    bool quoted;
+    bool escaped;                                                                   // has escaped quotes ("")
+}csv_field_t;
+
+// value types of fields, a column takes the largest kind of its cells, integers and decimals merge to decimals
+typedef enum{
+    csv_cell_empty,
+    csv_cell_bool,
+    csv_cell_integer,
+    csv_cell_decimal,
+    csv_cell_string
+}csv_cell_kind_t;
+
+// how the cells of a line are built, by column. csv_cell_empty lets a column be typed per cell
+typedef struct{
+    const csv_cell_kind_t *kinds;
+    size_t count;
+    char **names;                                                                   // column names from the first line, cells get a copy
+    size_t name_count;
+    csv_cell_kind_t rest;                                                           // kind of the columns past count
+    bool line_names;                                                                // the first field names the line
+    const bool *selected;                                                           // columns to parse, NULL for all
+    size_t selected_count;                                                          // columns past it are skipped
+}csv_columns_t;
+
+// columns and rows asked by csv_parse_select_columns, csv_parse_select_named_columns and csv_parse_row_range
+typedef struct{
+    const int *indexes;
+    size_t index_count;
+    const char **names;
+    size_t name_count;
+    size_t skip;                                                                    // rows skipped after the names
+    size_t limit;                                                                   // rows parsed after the skipped ones, 0 for all
+}csv_projection_t;
+
+// options and extra arguments of a call. Each call keeps its own on the stack, nothing is shared between calls
+// so they can run at the same time from different threads
+typedef struct{
+    unsigned options;                                                               // doc_csv_parse_opt_t or doc_csv_stringify_opt_t
+    char separators[3];                                                             // parse separators, null terminated
+    char separator;                                                                 // stringify separator
+    unsigned threads;
+    const doc_csv_column_type_t *column_types;
+    size_t column_type_count;
+    csv_projection_t projection;
+}csv_ctx_t;
+
+// what a column of a columnar parse holds, found on a first pass
+typedef struct{
+    csv_cell_kind_t kind;
+    size_t string_bytes;                                                            // upper bound of its strings, terminators included
+    char *name;
+}csv_column_info_t;
+
+// range of the stream handled by one thread, rows are chained but not linked to the parent
+typedef struct{
+    const char *start;
+    const char *end;
+    const char *separators;
+    const csv_columns_t *columns;
+    doc *parent;
+    doc *first;                                                                     // rows found
+    doc *last;
+    doc_size_t count;
+    size_t quotes;                                                                  // quotes in the range, to split the stream
+}csv_chunk_t;
+
+// output of a stringify, fields are quoted only when they would not read back the same
+typedef struct{
+    wbuffer_t buffer;
+    char separator;
+    bool special[256];                                                              // chars that force quotes
+}csv_writer_t;
+
+// header of a index sidecar, followed by rows + 1 offsets, the last one is the end of the indexed rows, and by
+// key_count csv_index_key_t sorted by hash
+typedef struct{
+    char magic[6];
+    uint16_t version;
+    uint32_t endianness;
+    uint32_t options;                                                               // csv_parse_first_line_as_names and csv_parse_first_column_as_names
+    char separators[4];
+    int32_t key_column;                                                             // -1 without keys
+    uint64_t data_start;                                                            // offset of the first row, after the names
+    uint64_t rows;
+    uint64_t key_count;
+    uint64_t size;                                                                  // size of the whole sidecar
+}csv_index_header_t;
+
+// hash of the key field of a row
+typedef struct{
+    uint64_t hash;
+    uint64_t row;
+}csv_index_key_t;
+
+// row offsets and keys found by a scan
+typedef struct{
+    uint64_t *offsets;
+    size_t rows;
+    size_t offset_size;
+    csv_index_key_t *keys;
+    size_t key_count;
+    size_t key_size;
+}csv_index_scan_t;
+
+// opened row index, over a sidecar read or mapped into memory
+struct doc_csv_index{
+    uint8_t *base;
+    size_t size;
+    bool mapped;
+    const csv_index_header_t *header;
+    const uint64_t *offsets;
+    const csv_index_key_t *keys;
+    char *filename;                                                                 // the csv file, to compare keys
+};
 
-// separator to be used when parsing
-static char *csv_parser_separators = NULL;
+/* ----------------------------------------- Private Functions ------------------------------ */
 
-// separator to use when stringifying
-static char csv_stringify_separator = ',';
+// allocate a cell or line with a copy of name, empty unless columns are named
+static doc *new_node(doc_type_t type, size_t size, const char *name){
+    doc *variable = calloc(1, size);
+    size_t len = strlen(name);
 
-/* ----------------------------------------- Private Functions ------------------------------ */
+    variable->type = type;
+    variable->name = malloc(len + 1);
+    memcpy(variable->name, name, len + 1);
 
-// tokenize a string by delimiters
-static char *strtok_csv(char *string, char *delimiters){
-    static char *last_string = NULL;
-    static char *last_token = NULL;
-    char *buf;
+    return variable;
+}
 
-    if(string != last_string){
-        last_string = string;
-        last_token = string;
+// link a member at the end of a obj, tail is the last member
+static void link_member(doc *parent, doc **tail, doc *member){
+    member->parent = parent;
+
+    if(*tail == NULL){
+        parent->child = member;
     }
-    if(last_token == NULL){
-        return NULL;
+    else{
+        (*tail)->next = member;
+        member->prev = *tail;
     }
-    if(*last_token == '\0'){
-        buf = last_token;
-        last_token = NULL;
-        return buf;
+
+    *tail = member;
+    parent->childs++;
+}
+
+// string cell, len counts the null terminator like create_doc_from_string()
+static doc *new_string_cell(const char *string, size_t len, const char *name){
+    doc *cell = new_node(dt_string, sizeof(doc_string), name);
+    char *copy = malloc(len + 1);
+
+    memcpy(copy, string, len);
+    copy[len] = '\0';
+
+    ((doc_string*)cell)->string = copy;
+    ((doc_string*)cell)->len = len + 1;
+
+    return cell;
+}
+
+// decimal value, strtod needs a null terminated copy
+static double parse_decimal(const char *field, size_t len){
+    char buffer[64];
+    char *number = len < sizeof(buffer) ? buffer : malloc(len + 1);
+
+    memcpy(number, field, len);
+    number[len] = '\0';
+
+    double value = strto_rational_parse_utils(number, NULL);
+
+    if(number != buffer) free(number);
+
+    return value;
+}
+
+// sign and digits at the start of a unquoted field, accumulated as a int64 with overflow checks.
+// Returns the end of the digits, *integer is only valid if digits were found and none overflowed
+static const char *scan_integer(const char *cursor, const char *end, integer_type_parse_utils *integer, size_t *digits, bool *overflow){
+    bool negative = false;
+    uint64_t value = 0;
+    uint64_t limit;
+
+    if(cursor < end && (*cursor == '-' || *cursor == '+')){
+        negative = (*cursor == '-');
+        cursor++;
     }
 
-    for(size_t i = 0; i < strlen(last_token); i++){
-        for(size_t j = 0; j < strlen(delimiters); j++){
-            if(last_token[i] == delimiters[j]){
-                last_token[i] = '\0';
-                buf = last_token;
-                last_token += (i + 1);
-                return buf;                
-            }
-        }
+    limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    *digits = 0;
+    *overflow = false;
 
-        if(i == (strlen(last_token) - 1)){
-            buf = last_token;
-            last_token = NULL;
-            return buf;
-        }
+    for(; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, (*digits)++){
+        uint64_t digit = (uint64_t)(*cursor - '0');
+
+        if(*overflow || value > (limit - digit) / 10)
+            *overflow = true;
+        else
+            value = value * 10 + digit;
     }
 
-    return NULL;
+    if(value == 0) *integer = 0;
+    else *integer = negative ? -(integer_type_parse_utils)(value - 1) - 1 : (integer_type_parse_utils)value;
+
+    return cursor;
 }
 
-// parse a csv line
-static doc *parse_line(char **stream){
-    char *end_l = strpbrk(*stream, "\r\n");
-    bool end_l_null_terminated = false;
+// kind of a unquoted field, found in one pass over it. Integers are written to *integer
+static csv_cell_kind_t classify_cell(const char *field, size_t len, integer_type_parse_utils *integer){
+    const char *end = field + len;
+    const char *cursor;
+    size_t digits;
+    bool overflow;
 
-    if(end_l == NULL && **stream == '\0'){
-        return NULL;
+    if(len == 0) return csv_cell_empty;
+    if((len == 4 && !memcmp(field, "true", 4)) || (len == 5 && !memcmp(field, "false", 5))) return csv_cell_bool;
+
+    cursor = scan_integer(field, end, integer, &digits, &overflow);
+
+    if(cursor == end && digits > 0 && !overflow)                                    // integers that overflow a int64 are decimals
+        return csv_cell_integer;
+
+    if(cursor < end && *cursor == '.'){                                             // fraction
+        for(cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+            digits++;
     }
-    else if(end_l == NULL && **stream != '\0'){
-        end_l_null_terminated = true;
+
+    if(digits > 0 && cursor < end && (*cursor == 'e' || *cursor == 'E')){           // exponent
+        size_t exponent_digits = 0;
+
+        cursor++;
+        if(cursor < end && (*cursor == '-' || *cursor == '+')) cursor++;
+
+        for(; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+            exponent_digits++;
+
+        if(exponent_digits == 0) return csv_cell_string;
     }
-    else if(**stream == '\0'){
-        return NULL;
+
+    return (cursor == end && digits > 0) ? csv_cell_decimal : csv_cell_string;
+}
+
+// column kind after adding a cell
+static csv_cell_kind_t merge_kind(csv_cell_kind_t column, csv_cell_kind_t cell){
+    if(column == csv_cell_empty || column == cell) return cell;
+    if(cell == csv_cell_empty) return column;
+
+    if((column == csv_cell_integer || column == csv_cell_decimal) && (cell == csv_cell_integer || cell == csv_cell_decimal))
+        return csv_cell_decimal;
+
+    return csv_cell_string;
+}
+
+// unquoted cell, typed as bool, integer, decimal or string
+static doc *parse_cell(const char *field, size_t len, const char *name){
+    integer_type_parse_utils integer = 0;
+    doc *cell;
+
+    switch(classify_cell(field, len, &integer)){
+        case csv_cell_bool:
+            cell = new_node(dt_bool, sizeof(doc_bool), name);
+            ((doc_bool*)cell)->value = (*field == 't');
+        return cell;
+
+        case csv_cell_integer:
+            cell = new_node(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils), name);
+            ((integer_doc_type_parse_utils*)cell)->value = integer;
+        return cell;
+
+        case csv_cell_decimal:
+            cell = new_node(decimal_dt_type_parse_utils, sizeof(decimal_doc_type_parse_utils), name);
+            ((decimal_doc_type_parse_utils*)cell)->value = parse_decimal(field, len);
+        return cell;
+
+        default:
+        return new_string_cell(field, len, name);
     }
-    else{
-        *end_l = '\0';
+}
 
-        if(end_l[1] == '\n'){
-            end_l[1] = '\0';
-            end_l++;
-        }
+// copies a quoted field collapsing escaped quotes, returns the copied length
+static size_t copy_quoted(char *destination, const char *field, size_t len){
+    size_t copied = 0;
+
+    for(size_t i = 0; i < len; i++){
+        destination[copied++] = field[i];
+        if(field[i] == '"') i++;                                                    // skip the second quote of the pair
     }
 
-    doc *line = doc_new("", dt_obj, ";");
-    doc *cell;
+    return copied;
+}
+
+// quoted cell, always a string. Escaped quotes ("") are collapsed
+static doc *parse_quoted_cell(const char *field, size_t len, bool escaped, const char *name){
+    if(!escaped) return new_string_cell(field, len, name);
+
+    doc *cell = new_node(dt_string, sizeof(doc_string), name);
+    char *string = malloc(len + 1);
+    size_t string_len = copy_quoted(string, field, len);
+
+    string[string_len] = '\0';
+
+    ((doc_string*)cell)->string = string;
+    ((doc_string*)cell)->len = string_len + 1;
+
+    return cell;
+}
+
+// prepares a parser over a stream
+static void csv_parser_init(csv_parser_t *parser, const char *stream, size_t len, const char *separators){
+    scan_set_init(&parser->sets[0], "\"");
+    scan_set_init(&parser->sets[1], separators);
+    scan_set_add(&parser->sets[1], '\r');
+    scan_set_add(&parser->sets[1], '\n');
+
+    parser->cursor = stream;
+    parser->end = stream + len;
+    parser->block = stream;
+    parser->mask_base = stream;
+    parser->delimiters = 0;
+    parser->in_quotes = 0;
+}
+
+// next separator or line break outside quotes, end if there are no more
+static const char *next_delimiter(csv_parser_t *parser){
+    while(parser->delimiters == 0){
+        size_t left = parser->end - parser->block;
+        uint64_t masks[2];
+
+        if(left == 0) return parser->end;
+
+        if(left >= SCAN_BLOCK_SIZE)
+            scan_masks(parser->sets, 2, (const uint8_t*)parser->block, masks);
+        else
+            scan_masks_tail(parser->sets, 2, (const uint8_t*)parser->block, left, masks);
 
-    for(char *token = strtok_csv(*stream, csv_parser_separators); token != NULL; token = strtok_csv(*stream, csv_parser_separators)){
-        cell = create_doc_from_string("", token);
-        doc_append(line, ".", cell);
+        uint64_t quoted = scan_prefix_xor(masks[0]) ^ parser->in_quotes;           // escaped quotes toggle twice
+        parser->in_quotes = (uint64_t)((int64_t)quoted >> 63);
+
+        parser->delimiters = masks[1] & ~quoted;
+        parser->mask_base = parser->block;
+        parser->block += left >= SCAN_BLOCK_SIZE ? SCAN_BLOCK_SIZE : left;
     }
 
-    if(end_l_null_terminated)
-        *stream = strrchr(*stream, '\0');
-    else
-        *stream = end_l + 1;
+    const char *delimiter = parser->mask_base + scan_first_bit(parser->delimiters);
+    parser->delimiters &= parser->delimiters - 1;
 
-    return line;
+    return delimiter;
 }
 
-// parse a csv file
-static doc *csv_parse(char *stream, doc_csv_parse_opt_t options, va_list args){
-    if(stream == NULL || options > csv_parse_opt_max) return NULL;
-    
-    if(options > csv_parse_opt_max) options = csv_parse_normal_mode;
-    if(options & csv_parse_use_custom_separator){
-        char separator = va_arg(args, int);
-        if(ispunct(separator) || isblank(separator)){
-            char separator_str[2];
-            separator_str[0] = separator;
-            separator_str[1] = '\0';
-            csv_parser_separators = separator_str;
-        }
-        else{
-            csv_parser_separators = csv_parser_separators_default;
+// field between start and end, without its quotes
+static csv_field_t read_field(const char *start, const char *end){
+    csv_field_t field = { .start = start, .len = end - start, .quoted = false, .escaped = false };
+
+    if(start == end || *start != '"') return field;
+
+    const char *close = end - 1;                                                    // closing quote, garbage after it is ignored
+    while(close > start && *close != '"')
+        close--;
+
+    if(close == start) close = end;                                                 // unterminated, take the rest
+
+    start++;
+
+    field.start = start;
+    field.len = close - start;
+    field.quoted = true;
+    field.escaped = memchr(start, '"', field.len) != NULL;
+
+    return field;
+}
+
+// moves the cursor past the delimiter of a field, returns true when it ends the line
+static bool end_field(csv_parser_t *parser, const char *delimiter){
+    if(delimiter == parser->end){
+        parser->cursor = parser->end;
+        return true;
+    }
+
+    parser->cursor = delimiter + 1;
+
+    if(*delimiter == '\r' || *delimiter == '\n'){                                   // \n, \r or \r\n end the line
+        if(*delimiter == '\r' && parser->cursor < parser->end && *parser->cursor == '\n'){
+            next_delimiter(parser);                                                 // the \n is the next delimiter
+            parser->cursor++;
         }
+
+        return true;
     }
-    else{
-        csv_parser_separators = csv_parser_separators_default;
+
+    return false;
+}
+
+// reads the next field of the current line, returns true when it is the last one of the line.
+// The cursor must be before the end of the stream
+static bool next_field(csv_parser_t *parser, csv_field_t *field){
+    const char *delimiter = next_delimiter(parser);
+
+    *field = read_field(parser->cursor, delimiter);
+
+    return end_field(parser, delimiter);
+}
+
+// skips the next field of the current line without reading it, like next_field()
+static bool skip_field(csv_parser_t *parser){
+    return end_field(parser, next_delimiter(parser));
+}
+
+// skips up to count lines, returns how many were skipped
+static size_t skip_lines(csv_parser_t *parser, size_t count){
+    size_t skipped = 0;
+
+    for(; skipped < count && parser->cursor < parser->end; skipped++){
+        while(!skip_field(parser));
     }
 
-    doc *csv = doc_new("", dt_obj, ";");
+    return skipped;
+}
 
-    for(doc *line = parse_line(&stream); line != NULL; line = parse_line(&stream)){
-        doc_append(csv, ".", line);
-    }
-
-    switch(options){
-        case csv_parse_first_line_as_names:
-            {
-                doc *name_columns = doc_copy(csv, ".[0]");
-                doc_delete(csv, ".[0]");
-
-                for(doc_loop(line, csv)){
-                    doc_size_t i = 0;
-                    for(doc_loop(cell, line)){
-                        // [%u]\0
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(line);
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(cell);
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(name_columns);
-                        
-
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        char name_pos[UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 3];
-                        snprintf(name_pos, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 3, "[%u]", i);
-                        char *column_name = doc_get(name_columns, name_pos, char*);
-
-
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(line);
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(cell);
-                        printf("[%s.%i] [DEBUG]  \n", __FILE__, __LINE__);
-                        doc_print(name_columns);
-
-                        doc_rename(cell, ".", column_name);
-
-                        i++;
-                    }
-                }
+// cell of a field
+static doc *parse_field(const csv_field_t *field, const char *name){
+    if(field->quoted) return parse_quoted_cell(field->start, field->len, field->escaped, name);
+    return parse_cell(field->start, field->len, name);
+}
+
+// integer of a unquoted field, false if it isn't one or it overflows a int64
+static bool convert_integer(const char *field, size_t len, integer_type_parse_utils *integer){
+    const char *end = field + len;
+    size_t digits;
+    bool overflow;
+
+    return scan_integer(field, end, integer, &digits, &overflow) == end && digits > 0 && !overflow;
+}
+
+// cell of a field in a column of a known kind. Empty cells of bool and number columns are null,
+// fields that don't fit the kind are typed on their own
+static doc *parse_typed_field(const csv_field_t *field, csv_cell_kind_t kind, const char *name){
+    integer_type_parse_utils integer;
+    doc *cell;
+
+    if(kind == csv_cell_string) return parse_quoted_cell(field->start, field->len, field->escaped, name);
+    if(kind == csv_cell_empty || field->quoted) return parse_field(field, name);
+
+    if(field->len == 0) return new_node(dt_null, sizeof(doc), name);
+
+    switch(kind){
+        case csv_cell_bool:
+            if((field->len == 4 && !memcmp(field->start, "true", 4)) || (field->len == 5 && !memcmp(field->start, "false", 5))){
+                cell = new_node(dt_bool, sizeof(doc_bool), name);
+                ((doc_bool*)cell)->value = (*field->start == 't');
+                return cell;
             }
         break;
 
-        case csv_parse_first_column_as_names:
-            for(doc_loop(line, csv)){
-                doc_rename(line, ".", doc_get(line, "[0]", char*));
-                doc_delete(line, "[0]");                
+        case csv_cell_integer:
+            if(convert_integer(field->start, field->len, &integer)){
+                cell = new_node(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils), name);
+                ((integer_doc_type_parse_utils*)cell)->value = integer;
+                return cell;
             }
         break;
 
-        case (csv_parse_first_line_as_names | csv_parse_first_column_as_names):
-            {
-                doc *name_columns = doc_copy(csv, "[0]");
-                doc_delete(csv, "[0]");
-
-                for(doc_loop(line, csv)){
-                    doc_rename(line, ".", doc_get(line, "[0]", char*));
-                    doc_delete(line, "[0]");                
+        case csv_cell_decimal:
+            switch(classify_cell(field->start, field->len, &integer)){
+                case csv_cell_integer:
+                    cell = new_node(decimal_dt_type_parse_utils, sizeof(decimal_doc_type_parse_utils), name);
+                    ((decimal_doc_type_parse_utils*)cell)->value = (decimal_type_parse_utils)integer;
+                return cell;
 
-                    doc_type_t i = 0;
-                    for(doc_loop(cell, line)){
-                        char name_pos[UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 3] = {0};
-                        snprintf(name_pos, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 3, "[%u]", i + 1);
+                case csv_cell_decimal:
+                    cell = new_node(decimal_dt_type_parse_utils, sizeof(decimal_doc_type_parse_utils), name);
+                    ((decimal_doc_type_parse_utils*)cell)->value = parse_decimal(field->start, field->len);
+                return cell;
 
-                        doc_rename(cell, ".", doc_get(name_columns, name_pos, char*));
-
-                        i++;
-                    }
-                }
+                default:
+                break;
             }
         break;
+
+        default:
+        break;
     }
 
-    return csv;
+    return parse_field(field, name);
 }
 
-// print to output stream, reallocating it accordingly
-static void printf_stringify(char **string_start_address, size_t *length, size_t buffer_size, char *format, ...){
-    va_list args;
-    va_start(args, format);
-    
-    size_t token_size = buffer_size + strlen(format);
-    char *token = calloc(token_size, sizeof(*token));
-    vsnprintf(token, token_size, format, args);
+// null terminated copy of a field, escaped quotes collapsed
+static char *field_string(const csv_field_t *field){
+    char *string = malloc(field->len + 1);
+    size_t len = field->escaped ? copy_quoted(string, field->start, field->len) : field->len;
 
-    *length += strlen(token);
-    *string_start_address = realloc(*string_start_address, *length);
-    strcat(*string_start_address, token);
+    if(!field->escaped) memcpy(string, field->start, len);
+    string[len] = '\0';
 
-    free(token);
-    va_end(args);
+    return string;
 }
 
-// print a value
-static void print_value(doc *variable, char **stream, size_t *length){
-    char *buffer;
-    size_t buffer_size;
-    
-    switch(variable->type){
-        case dt_double:
-            printf_stringify(stream, length, FLOAT_MAX_DECIMAL_CHARS_PARSE_UTILS, decimal_print_format_parse_utils, FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_double*)variable)->value);
-        break;
-        case dt_float:
-            printf_stringify(stream, length, FLOAT_MAX_DECIMAL_CHARS_PARSE_UTILS, decimal_print_format_parse_utils, FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_float*)variable)->value);
-        break;
-        
-        case dt_uint:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint_t*)variable)->value);
-        break;
-        case dt_uint64:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint64_t*)variable)->value);
-        break;
-        case dt_uint32:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint32_t*)variable)->value);
-        break;
-        case dt_uint16:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint16_t*)variable)->value);
-        break;
-        case dt_uint8:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint8_t*)variable)->value);
-        break;
-        
-        case dt_int:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int*)variable)->value);
-        break;
-        case dt_int64:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int64_t*)variable)->value);
-        break;
-        case dt_int32:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int32_t*)variable)->value);
-        break;
-        case dt_int16:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int16_t*)variable)->value);
-        break;
-        case dt_int8:
-            printf_stringify(stream, length, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int8_t*)variable)->value);
-        break;
+// reads the fields of a line as names, returns how many
+static size_t read_names(csv_parser_t *parser, char ***names){
+    csv_field_t field;
+    size_t count = 0;
+    bool line_end;
 
-        case dt_null:
-        break;
+    *names = NULL;
 
-        case dt_bool:
-            printf_stringify(stream, length, 5, "%s", (((doc_bool*)variable)->value ? "true" : "false"));
-        break;
-        
-        case dt_string:
-        case dt_const_string:
-            printf_stringify(stream, length, ((doc_string*)variable)->len, "%s", ((doc_string*)variable)->string);
-        break;
+    if(parser->cursor >= parser->end) return 0;
 
-        case dt_bindata:
-        case dt_const_bindata:
-            buffer = base64_encode(((doc_bindata*)variable)->data, ((doc_bindata*)variable)->len); 
-            buffer_size = strlen(buffer);
-            
-            printf_stringify(stream, length, buffer_size + 1, "%s", buffer);
+    do{
+        line_end = next_field(parser, &field);
 
-            free(buffer);
-        break;
-    }
+        *names = realloc(*names, (count + 1) * sizeof(**names));
+        (*names)[count++] = field_string(&field);
+    }while(!line_end);
+
+    return count;
 }
 
-// stringify csv
-static char *stringify(doc *csv_doc, va_list args){
+// checks if a column is parsed
+static bool column_selected(const csv_columns_t *columns, size_t column){
+    return columns->selected == NULL || (column < columns->selected_count && columns->selected[column]);
+}
 
-    if(csv_doc == NULL) return NULL;
-    if(csv_doc->type != dt_obj && csv_doc->type != dt_array) return NULL;
+// columns picked by a projection, by index or by one of the names, *count receives the size of the array.
+// Returns NULL when the projection has no column selection
+static bool *select_columns(const csv_projection_t *projection, char **names, size_t name_count, size_t *count){
+    bool *selected;
 
-    for(doc_loop(line, csv_doc)){
-        for(doc_loop(cell, line)){
-            if(cell->type == dt_obj || cell->type == dt_array)  return NULL;        // check if cell values are not objects or arrays
-        }
+    *count = 0;
+
+    if(projection->indexes == NULL && projection->names == NULL) return NULL;
+
+    for(size_t i = 0; i < projection->index_count; i++){
+        if(projection->indexes[i] >= 0 && (size_t)projection->indexes[i] + 1 > *count) *count = (size_t)projection->indexes[i] + 1;
     }
 
-    doc_csv_stringify_opt_t options = va_arg(args, doc_csv_stringify_opt_t);
-    if(options > csv_stringify_opt_max) options = csv_stringify_normal_mode;
-    if(options & csv_stringify_use_custom_separator){
-        char separator = va_arg(args, int);
-        if(ispunct(separator) || isblank(separator)){
-            csv_stringify_separator = separator;
-        }
-        else{
-            csv_stringify_separator = csv_stringify_separator_default;
-        }
+    if(projection->names != NULL && name_count > *count) *count = name_count;
+
+    selected = calloc(*count + 1, sizeof(*selected));                               // a selection that matches nothing parses no cell
+
+    for(size_t i = 0; i < projection->index_count; i++){
+        if(projection->indexes[i] >= 0) selected[projection->indexes[i]] = true;
     }
-    else{
-        csv_stringify_separator = csv_stringify_separator_default;
+
+    for(size_t i = 0; i < projection->name_count; i++){
+        for(size_t column = 0; projection->names[i] != NULL && column < name_count; column++){
+            if(strcmp(projection->names[i], names[column]) == 0) selected[column] = true;
+        }
     }
 
-    char *stream = (char*)calloc(1, sizeof(char));
-    size_t length = 1;
+    return selected;
+}
 
-    if(options & csv_stringify_put_columns_names_in_first_line){
-        if(options & csv_stringify_put_line_name_in_first_column){
-            printf_stringify(&stream, &length, 1, "%c", csv_stringify_separator);    
+// parse a csv line, NULL at the end of the stream. Without columns every cell is typed on its own and unnamed
+static doc *parse_line(csv_parser_t *parser, const csv_columns_t *columns){
+    if(parser->cursor >= parser->end) return NULL;
+
+    doc *line = new_node(dt_obj, sizeof(doc), "");
+    doc *last_cell = NULL;
+    csv_field_t field;
+    bool line_end;
+    size_t column = 0;
+
+    do{
+        if(columns != NULL && !column_selected(columns, column) && !(column == 0 && columns->line_names)){
+            line_end = skip_field(parser);                                          // no conversion nor node
+            column++;
+            continue;
         }
-        
-        for(doc_loop(column, csv_doc->child)){
-            printf_stringify(&stream, &length, strlen(column->name) + 1, "%s", column->name);    
 
-            if(column->next != NULL)
-                printf_stringify(&stream, &length, 1, "%c", csv_stringify_separator);    
+        line_end = next_field(parser, &field);
+
+        if(columns == NULL){
+            link_member(line, &last_cell, parse_field(&field, ""));
+        }
+        else if(column == 0 && columns->line_names){
+            free(line->name);
+            line->name = field_string(&field);
+        }
+        else{
+            csv_cell_kind_t kind = column < columns->count ? columns->kinds[column] : columns->rest;
+            link_member(line, &last_cell, parse_typed_field(&field, kind, column < columns->name_count ? columns->names[column] : ""));
         }
 
-        if(csv_doc->child->next != NULL)
-            printf_stringify(&stream, &length, 1, "\n");    
-    }
+        column++;
+    }while(!line_end);
 
-    for(doc_loop(line, csv_doc)){
-        if(options & csv_stringify_put_line_name_in_first_column){
-            printf_stringify(&stream, &length, strlen(line->name) + 1, "%s,", line->name);    
-        }
+    return line;
+}
 
-        for(doc_loop(cell,line)){
+// kinds of the columns merged over the first rows of a stream, *count receives the number of columns
+static csv_cell_kind_t *sample_kinds(const char *stream, size_t len, const char *separators, size_t rows, size_t *count){
+    csv_parser_t parser;
+    csv_field_t field;
+    csv_cell_kind_t *kinds = NULL;
+    bool line_end;
 
-            print_value(cell, &stream, &length);
+    *count = 0;
+    csv_parser_init(&parser, stream, len, separators);
 
-            if(cell->next != NULL)
-                printf_stringify(&stream, &length, 1, "%c", csv_stringify_separator);    
-        }
+    for(size_t row = 0; row < rows && parser.cursor < parser.end; row++){
+        size_t column = 0;
+
+        do{
+            line_end = next_field(&parser, &field);
 
-        if(line->next != NULL)
-            printf_stringify(&stream, &length, 1, "\n");    
+            if(column == *count){
+                kinds = realloc(kinds, (*count + 1) * sizeof(*kinds));
+                kinds[(*count)++] = csv_cell_empty;
+            }
+
+            integer_type_parse_utils integer;
+            kinds[column] = merge_kind(kinds[column], field.quoted ? csv_cell_string : classify_cell(field.start, field.len, &integer));
+            column++;
+        }while(!line_end);
     }
 
-    return stream;
+    return kinds;
 }
 
-/* ----------------------------------------- Functions -------------------------------------- */
+// named binary data member, owns data
+static doc *new_bindata_member(const char *name, void *data, size_t len){
+    doc *member = new_node(dt_bindata, sizeof(doc_bindata), name);
+    ((doc_bindata*)member)->data = data;
+    ((doc_bindata*)member)->len = len;
+    return member;
+}
 
-// save doc csv to file
-void doc_csv_save(doc *csv_doc, char *filename, ...){
-    va_list args;
-    va_start(args, filename);
+// kind of a field, quoted fields are strings
+static csv_cell_kind_t field_kind(const csv_field_t *field, integer_type_parse_utils *integer){
+    if(field->quoted) return csv_cell_string;
+    return classify_cell(field->start, field->len, integer);
+}
+
+// column type of a kind
+static doc_csv_column_type_t column_type_of(csv_cell_kind_t kind){
+    switch(kind){
+        case csv_cell_bool:     return csv_column_bool;
+        case csv_cell_integer:  return csv_column_int64;
+        case csv_cell_decimal:  return csv_column_double;
+        default:                return csv_column_string;
+    }
+}
+
+// kind of a column type
+static csv_cell_kind_t kind_of_column_type(doc_csv_column_type_t type){
+    switch(type){
+        case csv_column_bool:   return csv_cell_bool;
+        case csv_column_int64:  return csv_cell_integer;
+        case csv_column_double: return csv_cell_decimal;
+        default:                return csv_cell_string;
+    }
+}
 
-    char *csv = stringify(csv_doc, args);
+// member of a column by name
+static doc *column_member(doc *column, const char *name){
+    if(column == NULL || column->type != dt_obj) return NULL;
 
-    if(csv == NULL) return;
+    for(doc_loop(member, column)){
+        if(!strcmp(member->name, name)) return member;
+    }
 
-    FILE *out = fopen(filename, "w+");
-    fprintf(out, csv);
-    fclose(out);
-    free(csv);
-    va_end(args);
+    return NULL;
 }
 
-// makes a csv stream out of a doc data structure 
-char *doc_csv_stringify(doc *csv_doc, ...){
-    va_list args;
-    va_start(args, csv_doc);
+// names of the column types, as stored in the "type" member
+static const char *column_type_names[] = { "int64", "double", "bool", "string" };
+
+// typed buffers of a column being filled
+typedef struct{
+    doc_csv_column_type_t type;
+    uint8_t *validity;
+    void *values;
+    char *strings;
+    size_t strings_len;
+}csv_column_buffers_t;
+
+// writes a field in row of a column
+static void fill_cell(csv_column_buffers_t *column, size_t row, const csv_field_t *field){
+    integer_type_parse_utils integer = 0;
+    csv_cell_kind_t kind = field_kind(field, &integer);
+    bool valid = false;                                                             // cells that don't fit a explicit type are null
+
+    switch(column->type){
+        case csv_column_int64:
+            valid = kind == csv_cell_integer;
+            if(valid) ((int64_t*)column->values)[row] = integer;
+        break;
 
-    char *csv = stringify(csv_doc, args);
+        case csv_column_double:
+            valid = kind == csv_cell_integer || kind == csv_cell_decimal;
+            if(valid) ((double*)column->values)[row] = kind == csv_cell_integer ? (double)integer : parse_decimal(field->start, field->len);
+        break;
 
-    va_end(args);
+        case csv_column_bool:
+            valid = kind == csv_cell_bool;
+            if(valid) ((uint8_t*)column->values)[row] = (*field->start == 't');
+        break;
 
-    return csv;
+        case csv_column_string:
+            valid = kind != csv_cell_empty;
+            if(valid){
+                char *string = column->strings + column->strings_len;
+                size_t len = field->escaped ? copy_quoted(string, field->start, field->len) : field->len;
+
+                if(!field->escaped) memcpy(string, field->start, len);
+                string[len] = '\0';
+                column->strings_len += len + 1;
+            }
+
+            ((uint64_t*)column->values)[row + 1] = column->strings_len;
+        break;
+    }
+
+    if(valid) column->validity[row / 8] |= (uint8_t)(1 << (row % 8));
 }
 
-// open and parse a csv file by filename
-doc *doc_csv_open(char *filename, doc_csv_parse_opt_t options, ...){
-    if(filename == NULL) return NULL;
+// column obj out of its buffers
+static doc *new_column(const char *name, csv_column_buffers_t *buffers, size_t rows){
+    doc *column = new_node(dt_obj, sizeof(doc), name);
+    doc *tail = NULL;
 
-    va_list args;
-    va_start(args, options);
+    doc *type = new_node(dt_string, sizeof(doc_string), "type");
+    size_t type_len = strlen(column_type_names[buffers->type]);
+    ((doc_string*)type)->string = malloc(type_len + 1);
+    memcpy(((doc_string*)type)->string, column_type_names[buffers->type], type_len + 1);
+    ((doc_string*)type)->len = type_len + 1;
+    link_member(column, &tail, type);
 
-    char *file = fstream(filename);
-    if(file == NULL) return NULL;
-    
-    doc *variable = csv_parse(file, options, args);
+    doc *count = new_node(dt_uint64, sizeof(doc_uint64_t), "rows");
+    ((doc_uint64_t*)count)->value = rows;
+    link_member(column, &tail, count);
 
-    free(file);
-    va_end(args);
-    
-    return variable;
+    link_member(column, &tail, new_bindata_member("validity", buffers->validity, (rows + 7) / 8));
+
+    switch(buffers->type){
+        case csv_column_int64:
+        case csv_column_double:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, rows * sizeof(int64_t)));
+        break;
+
+        case csv_column_bool:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, rows));
+        break;
+
+        case csv_column_string:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, (rows + 1) * sizeof(uint64_t)));
+            link_member(column, &tail, new_bindata_member("strings", buffers->strings, buffers->strings_len));
+        break;
+    }
+
+    return column;
 }
 
-// parse a csv file to a doc structure
-doc *doc_csv_parse(char *stream, doc_csv_parse_opt_t options, ...){
-    va_list args;
-    va_start(args, options);
+// parse a csv stream into typed columns. A first pass finds the number of rows and columns and the type of
+// every column, a second one converts the fields straight into the column buffers
+static doc *parse_columnar(doc *csv, const char *stream, size_t len, const csv_ctx_t *ctx){
+    const char *separators = ctx->separators;
+    const csv_projection_t *projection = &ctx->projection;
+    doc_csv_parse_opt_t options = ctx->options;
+    csv_parser_t parser;
+    csv_field_t field;
+    csv_column_info_t *columns = NULL;
+    size_t column_count = 0, rows = 0;
+    bool line_end;
+    char **names = NULL;
+
+    csv_parser_init(&parser, stream, len, separators);
+
+    if(options & csv_parse_first_line_as_names){
+        column_count = read_names(&parser, &names);
+        columns = calloc(column_count, sizeof(*columns));
+
+        for(size_t i = 0; i < column_count; i++)
+            columns[i].name = names[i];
+    }
 
-    doc *csv = csv_parse(stream, options, args);
+    csv_columns_t selection = { 0 };
+    bool *selected = select_columns(projection, names, column_count, &selection.selected_count);
+    selection.selected = selected;
+    free(names);
 
-    va_end(args);
+    skip_lines(&parser, projection->skip);
 
-    return csv;
-}
\ No newline at end of file
+    const char *data = parser.cursor;
+    size_t limit = projection->limit > 0 ? projection->limit : SIZE_MAX;
+
+    for(; rows < limit && parser.cursor < parser.end; rows++){
+        size_t column = 0;
+
+        do{
+            if(!column_selected(&selection, column)){
+                line_end = skip_field(&parser);
+                column++;
+                continue;
+            }
+
+            line_end = next_field(&parser, &field);
+
+            if(column >= column_count){
+                columns = realloc(columns, (column + 1) * sizeof(*columns));
+                for(; column_count <= column; column_count++)
+                    columns[column_count] = (csv_column_info_t){ .kind = csv_cell_empty, .string_bytes = 0, .name = NULL };
+            }
+
+            integer_type_parse_utils integer;
+            columns[column].kind = merge_kind(columns[column].kind, field_kind(&field, &integer));
+            columns[column].string_bytes += field.len + 1;
+            column++;
+        }while(!line_end);
+    }
+
+    for(size_t i = 0; i < ctx->column_type_count && i < column_count; i++)
+        columns[i].kind = kind_of_column_type(ctx->column_types[i]);
+
+    if((options & csv_parse_first_column_as_names) && column_count > 0)
+        columns[0].kind = csv_cell_string;                                          // names are strings
+
+    csv_column_buffers_t *buffers = calloc(column_count, sizeof(*buffers));
+
+    for(size_t i = 0; i < column_count; i++){
+        if(!column_selected(&selection, i)) continue;
+
+        buffers[i].type = column_type_of(columns[i].kind);
+        buffers[i].validity = calloc((rows + 7) / 8 + 1, 1);
+
+        switch(buffers[i].type){
+            case csv_column_int64:
+            case csv_column_double:
+                buffers[i].values = calloc(rows + 1, sizeof(int64_t));
+            break;
+
+            case csv_column_bool:
+                buffers[i].values = calloc(rows + 1, 1);
+            break;
+
+            case csv_column_string:
+                buffers[i].values = calloc(rows + 1, sizeof(uint64_t));
+                buffers[i].strings = malloc(columns[i].string_bytes + 1);
+            break;
+        }
+    }
+
+    csv_parser_init(&parser, data, stream + len - data, separators);                // a line start is outside quotes
+
+    for(size_t row = 0; row < rows; row++){
+        size_t column = 0;
+
+        do{
+            if(!column_selected(&selection, column)){
+                line_end = skip_field(&parser);
+            }
+            else{
+                line_end = next_field(&parser, &field);
+                fill_cell(&buffers[column], row, &field);
+            }
+
+            column++;
+        }while(!line_end);
+
+        for(; column < column_count; column++){                                     // missing cells are null
+            if(column_selected(&selection, column) && buffers[column].type == csv_column_string)
+                ((uint64_t*)buffers[column].values)[row + 1] = buffers[column].strings_len;
+        }
+    }
+
+    doc *last_column = NULL;
+
+    for(size_t i = 0; i < column_count; i++){
+        if(column_selected(&selection, i))
+            link_member(csv, &last_column, new_column(columns[i].name != NULL ? columns[i].name : "", &buffers[i], rows));
+
+        free(columns[i].name);
+    }
+
+    free(selected);
+    free(buffers);
+    free(columns);
+
+    return csv;
+}
+
+// count the quotes of a chunk
+static void *count_chunk_quotes(void *argument){
+    csv_chunk_t *chunk = argument;
+    scan_set_t quote;
+    uint64_t mask;
+
+    scan_set_init(&quote, "\"");
+    chunk->quotes = 0;
+
+    const char *cursor = chunk->start;
+    for(; chunk->end - cursor >= SCAN_BLOCK_SIZE; cursor += SCAN_BLOCK_SIZE){
+        scan_masks(&quote, 1, (const uint8_t*)cursor, &mask);
+        chunk->quotes += __builtin_popcountll(mask);
+    }
+
+    if(cursor < chunk->end){
+        scan_masks_tail(&quote, 1, (const uint8_t*)cursor, chunk->end - cursor, &mask);
+        chunk->quotes += __builtin_popcountll(mask);
+    }
+
+    return NULL;
+}
+
+// parse the rows of a chunk into a chain
+static void *parse_chunk(void *argument){
+    csv_chunk_t *chunk = argument;
+    csv_parser_t parser;
+
+    csv_parser_init(&parser, chunk->start, chunk->end - chunk->start, chunk->separators);
+
+    for(doc *line = parse_line(&parser, chunk->columns); line != NULL; line = parse_line(&parser, chunk->columns)){
+        line->parent = chunk->parent;
+
+        if(chunk->last == NULL){
+            chunk->first = line;
+        }
+        else{
+            chunk->last->next = line;
+            line->prev = chunk->last;
+        }
+
+        chunk->last = line;
+        chunk->count++;
+    }
+
+    return NULL;
+}
+
+// run a function over every chunk, one thread each. Chunks whose thread can't be created run in this one
+static void run_chunks(csv_chunk_t *chunks, size_t count, void *(*function)(void*)){
+    pthread_t *threads = malloc(count * sizeof(*threads));
+    bool *started = calloc(count, sizeof(*started));
+
+    for(size_t i = 1; i < count; i++)
+        started[i] = threads != NULL && pthread_create(&threads[i], NULL, function, &chunks[i]) == 0;
+
+    function(&chunks[0]);
+
+    for(size_t i = 1; i < count; i++){
+        if(started[i])
+            pthread_join(threads[i], NULL);
+        else
+            function(&chunks[i]);
+    }
+
+    free(started);
+    free(threads);
+}
+
+// start of the first row at or after cursor, in_quotes tells if cursor is inside a quoted field
+static const char *next_row_start(const char *cursor, const char *end, bool in_quotes, const char *separators){
+    csv_parser_t parser;
+
+    csv_parser_init(&parser, cursor, end - cursor, separators);
+    parser.in_quotes = in_quotes ? ~0ull : 0;
+
+    for(const char *delimiter = next_delimiter(&parser); delimiter != end; delimiter = next_delimiter(&parser)){
+        if(*delimiter == '\n') return delimiter + 1;
+        if(*delimiter == '\r') return (delimiter + 1 < end && delimiter[1] == '\n') ? delimiter + 2 : delimiter + 1;
+    }
+
+    return end;
+}
+
+// parse the rows of a stream in parallel. The stream is cut in even ranges and the quotes of each are counted,
+// the quote parity at a cut tells if it falls inside a quoted field, so every range is moved to the next row
+// outside quotes. The rows of each range are parsed by its own thread and chained in order
+static void parse_rows_threaded(doc *csv, doc **last_line, const char *stream, size_t len, const char *separators, const csv_columns_t *columns, unsigned threads){
+    size_t count = threads;
+
+    if(count > len / CSV_MIN_CHUNK_SIZE) count = len / CSV_MIN_CHUNK_SIZE;
+    if(count < 1) count = 1;
+
+    csv_chunk_t *chunks = calloc(count, sizeof(*chunks));
+    const char *end = stream + len;
+    size_t step = len / count;
+
+    for(size_t i = 0; i < count; i++){
+        chunks[i].start = stream + i * step;
+        chunks[i].end = (i + 1 == count) ? end : stream + (i + 1) * step;
+        chunks[i].separators = separators;
+        chunks[i].columns = columns;
+        chunks[i].parent = csv;
+    }
+
+    if(count > 1) run_chunks(chunks, count, count_chunk_quotes);
+
+    size_t quotes = 0;
+    for(size_t i = 1; i < count; i++){
+        quotes += chunks[i - 1].quotes;
+
+        const char *start = next_row_start(chunks[i].start, end, quotes & 1, separators);
+        if(start < chunks[i - 1].start) start = chunks[i - 1].start;                 // the previous row ran past this range
+
+        chunks[i - 1].end = start;
+        chunks[i].start = start;
+    }
+
+    run_chunks(chunks, count, parse_chunk);
+
+    for(size_t i = 0; i < count; i++){
+        if(chunks[i].first == NULL) continue;
+
+        if(*last_line == NULL){
+            csv->child = chunks[i].first;
+        }
+        else{
+            (*last_line)->next = chunks[i].first;
+            chunks[i].first->prev = *last_line;
+        }
+
+        *last_line = chunks[i].last;
+        csv->childs += chunks[i].count;
+    }
+
+    free(chunks);
+}
+
+// reads the parse options and their extra arguments, false if the options are invalid
+static bool parse_ctx_init(csv_ctx_t *ctx, doc_csv_parse_opt_t options, va_list args){
+    memset(ctx, 0, sizeof(*ctx));
+
+    if(options > csv_parse_opt_max) return false;
+
+    ctx->options = options;
+    ctx->threads = 1;
+    strcpy(ctx->separators, csv_parser_separators_default);
+
+    if(options & csv_parse_use_custom_separator){
+        char separator = va_arg(args, int);
+        if(ispunct(separator) || isblank(separator)){
+            ctx->separators[0] = separator;
+            ctx->separators[1] = '\0';
+        }
+    }
+
+    if(options & csv_parse_multithreaded){
+        int requested = va_arg(args, int);
+        ctx->threads = requested > 0 ? (unsigned)requested : cpu_count();
+    }
+
+    if(options & csv_parse_column_types){
+        int count = va_arg(args, int);
+        ctx->column_types = va_arg(args, const doc_csv_column_type_t*);
+        ctx->column_type_count = (count > 0 && ctx->column_types != NULL) ? (size_t)count : 0;
+    }
+
+    if(options & csv_parse_select_columns){
+        int count = va_arg(args, int);
+        ctx->projection.indexes = va_arg(args, const int*);
+        ctx->projection.index_count = (count > 0 && ctx->projection.indexes != NULL) ? (size_t)count : 0;
+    }
+
+    if(options & csv_parse_select_named_columns){
+        int count = va_arg(args, int);
+        ctx->projection.names = va_arg(args, const char**);
+        ctx->projection.name_count = (count > 0 && ctx->projection.names != NULL) ? (size_t)count : 0;
+    }
+
+    if(options & csv_parse_row_range){
+        ctx->projection.skip = va_arg(args, size_t);
+        ctx->projection.limit = va_arg(args, size_t);
+    }
+
+    return true;
+}
+
+// parse a csv file
+static doc *csv_parse(const csv_ctx_t *ctx, const char *stream, size_t len){
+    if(stream == NULL) return NULL;
+
+    doc_csv_parse_opt_t options = ctx->options;
+    const csv_projection_t *projection = &ctx->projection;
+    unsigned threads = ctx->threads;
+
+    doc *csv = doc_new("", dt_obj, ";");
+
+    if(options & csv_parse_columnar)
+        return parse_columnar(csv, stream, len, ctx);
+
+    csv_parser_t parser;
+    csv_parser_init(&parser, stream, len, ctx->separators);
+
+    csv_columns_t columns = { .rest = csv_cell_empty, .line_names = (options & csv_parse_first_column_as_names) != 0 };
+
+    if(options & csv_parse_first_line_as_names)                                     // bound once, cells copy their name when created, doc_delete() frees it
+        columns.name_count = read_names(&parser, &columns.names);
+
+    bool *selected = select_columns(projection, columns.names, columns.name_count, &columns.selected_count);
+    columns.selected = selected;
+
+    skip_lines(&parser, projection->skip);
+    if(projection->limit > 0) threads = 1;                                           // the rows past the limit are not parsed
+
+    const char *rows = parser.cursor;
+    size_t rows_len = stream + len - rows;
+
+    csv_cell_kind_t *kinds = NULL;
+    size_t kind_count = 0;
+    if(options & csv_parse_infer_column_types)
+        kinds = sample_kinds(rows, rows_len, ctx->separators, CSV_TYPE_SAMPLE_ROWS, &kind_count);
+
+    if(ctx->column_type_count > kind_count){
+        kinds = realloc(kinds, ctx->column_type_count * sizeof(*kinds));
+        for(; kind_count < ctx->column_type_count; kind_count++)
+            kinds[kind_count] = csv_cell_empty;
+    }
+
+    for(size_t i = 0; i < ctx->column_type_count; i++)
+        kinds[i] = kind_of_column_type(ctx->column_types[i]);
+
+    columns.kinds = kinds;
+    columns.count = kind_count;
+
+    bool plain = kind_count == 0 && columns.name_count == 0 && !columns.line_names && selected == NULL;
+    const csv_columns_t *line_columns = plain ? NULL : &columns;
+    doc *last_line = NULL;
+
+    if(threads > 1){
+        parse_rows_threaded(csv, &last_line, rows, rows_len, ctx->separators, line_columns, threads);
+    }
+    else{
+        size_t limit = projection->limit > 0 ? projection->limit : SIZE_MAX;
+
+        for(size_t row = 0; row < limit; row++){
+            doc *line = parse_line(&parser, line_columns);
+            if(line == NULL) break;
+
+            link_member(csv, &last_line, line);
+        }
+    }
+
+    for(size_t i = 0; i < columns.name_count; i++)
+        free(columns.names[i]);
+
+    free(columns.names);
+    free(selected);
+    free(kinds);
+
+    return csv;
+}
+
+// prepares a writer. Fields with the separator, quotes or line breaks are quoted, and so are the ones with
+// the default separators, so that the output reads back the same with the default options
+static void csv_writer_init(csv_writer_t *writer, char separator, wbuffer_flush_function_t flush, void *context){
+    memset(writer->special, 0, sizeof(writer->special));
+
+    for(const char *chr = csv_parser_separators_default; *chr != '\0'; chr++)
+        writer->special[(uint8_t)*chr] = true;
+
+    writer->special[(uint8_t)separator] = true;
+    writer->special['"'] = true;
+    writer->special['\r'] = true;
+    writer->special['\n'] = true;
+    writer->separator = separator;
+
+    wbuffer_init(&writer->buffer, CSV_WRITER_BUFFER_SIZE, flush, context);
+}
+
+// checks if a field has chars that must be quoted
+static bool has_special_chars(const csv_writer_t *writer, const char *string, size_t len){
+    for(size_t i = 0; i < len; i++){
+        if(writer->special[(uint8_t)string[i]]) return true;
+    }
+
+    return false;
+}
+
+// writes a field between quotes, doubling its quotes. The runs between quotes are copied at once
+static void write_quoted(csv_writer_t *writer, const char *string, size_t len){
+    const char *end = string + len;
+
+    wbuffer_putc(&writer->buffer, '"');
+
+    for(const char *quote; (quote = memchr(string, '"', end - string)) != NULL; string = quote + 1){
+        wbuffer_write(&writer->buffer, string, quote + 1 - string);
+        wbuffer_putc(&writer->buffer, '"');
+    }
+
+    wbuffer_write(&writer->buffer, string, end - string);
+    wbuffer_putc(&writer->buffer, '"');
+}
+
+// writes a line or column name, quoted only if it has special chars
+static void write_name(csv_writer_t *writer, const char *name){
+    if(name == NULL) return;
+
+    size_t len = strlen(name);
+
+    if(has_special_chars(writer, name, len))
+        write_quoted(writer, name, len);
+    else
+        wbuffer_write(&writer->buffer, name, len);
+}
+
+// writes a string cell, also quoted when it would be read back as other type, like "12", "true" or a empty string
+static void write_string(csv_writer_t *writer, const char *string, size_t len){
+    integer_type_parse_utils integer;
+
+    if(has_special_chars(writer, string, len) || classify_cell(string, len, &integer) != csv_cell_string)
+        write_quoted(writer, string, len);
+    else
+        wbuffer_write(&writer->buffer, string, len);
+}
+
+// writes the value of a cell, null cells are left empty
+static void write_value(csv_writer_t *writer, doc *variable){
+    wbuffer_t *buffer = &writer->buffer;
+    char *encoded;
+
+    switch(variable->type){
+        case dt_double:     wbuffer_write_double(buffer, ((doc_double*)variable)->value);       break;
+        case dt_float:      wbuffer_write_double(buffer, ((doc_float*)variable)->value);        break;
+
+        case dt_uint:       wbuffer_write_uint(buffer, ((doc_uint_t*)variable)->value);         break;
+        case dt_uint64:     wbuffer_write_uint(buffer, ((doc_uint64_t*)variable)->value);       break;
+        case dt_uint32:     wbuffer_write_uint(buffer, ((doc_uint32_t*)variable)->value);       break;
+        case dt_uint16:     wbuffer_write_uint(buffer, ((doc_uint16_t*)variable)->value);       break;
+        case dt_uint8:      wbuffer_write_uint(buffer, ((doc_uint8_t*)variable)->value);        break;
+
+        case dt_int:        wbuffer_write_int(buffer, ((doc_int*)variable)->value);             break;
+        case dt_int64:      wbuffer_write_int(buffer, ((doc_int64_t*)variable)->value);         break;
+        case dt_int32:      wbuffer_write_int(buffer, ((doc_int32_t*)variable)->value);         break;
+        case dt_int16:      wbuffer_write_int(buffer, ((doc_int16_t*)variable)->value);         break;
+        case dt_int8:       wbuffer_write_int(buffer, ((doc_int8_t*)variable)->value);          break;
+
+        case dt_bool:       wbuffer_puts(buffer, ((doc_bool*)variable)->value ? "true" : "false");  break;
+
+        case dt_string:
+        case dt_const_string:
+            write_string(writer, ((doc_string*)variable)->string, strlen(((doc_string*)variable)->string));
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:                                                      // base64 has no special chars
+            encoded = base64_encode(((doc_bindata*)variable)->data, ((doc_bindata*)variable)->len);
+            wbuffer_puts(buffer, encoded);
+            free(encoded);
+        break;
+
+        default:
+        break;
+    }
+}
+
+// writes a columnar csv row by row
+static void write_columnar(csv_writer_t *writer, doc *csv_doc, doc_csv_stringify_opt_t options){
+    size_t rows = 0;
+
+    for(doc_loop(column, csv_doc)){
+        if(doc_csv_column_rows(column) > rows) rows = doc_csv_column_rows(column);
+    }
+
+    if(options & csv_stringify_put_columns_names_in_first_line){
+        for(doc_loop(column, csv_doc)){
+            write_name(writer, column->name);
+            if(column->next != NULL) wbuffer_putc(&writer->buffer, writer->separator);
+        }
+
+        if(rows > 0) wbuffer_putc(&writer->buffer, '\n');
+    }
+
+    for(size_t row = 0; row < rows; row++){
+        for(doc_loop(column, csv_doc)){
+            if(row < doc_csv_column_rows(column) && doc_csv_column_valid(column, row)){
+                const char *string;
+                size_t len;
+
+                switch(doc_csv_column_type(column)){
+                    case csv_column_int64:
+                        wbuffer_write_int(&writer->buffer, doc_csv_column_int64(column)[row]);
+                    break;
+
+                    case csv_column_double:
+                        wbuffer_write_double(&writer->buffer, doc_csv_column_double(column)[row]);
+                    break;
+
+                    case csv_column_bool:
+                        wbuffer_puts(&writer->buffer, doc_csv_column_bool(column)[row] ? "true" : "false");
+                    break;
+
+                    case csv_column_string:
+                        string = doc_csv_column_string(column, row, &len);
+                        write_string(writer, string, len);
+                    break;
+                }
+            }
+
+            if(column->next != NULL) wbuffer_putc(&writer->buffer, writer->separator);
+        }
+
+        if(row + 1 < rows) wbuffer_putc(&writer->buffer, '\n');
+    }
+}
+
+// writes a table of lines with cells
+static void write_table(csv_writer_t *writer, doc *csv_doc, doc_csv_stringify_opt_t options){
+    if(csv_doc->child == NULL) return;
+
+    if(options & csv_stringify_put_columns_names_in_first_line){
+        if(options & csv_stringify_put_line_name_in_first_column)
+            wbuffer_putc(&writer->buffer, writer->separator);
+
+        for(doc_loop(column, csv_doc->child)){
+            write_name(writer, column->name);
+            if(column->next != NULL) wbuffer_putc(&writer->buffer, writer->separator);
+        }
+
+        wbuffer_putc(&writer->buffer, '\n');
+    }
+
+    for(doc_loop(line, csv_doc)){
+        if(options & csv_stringify_put_line_name_in_first_column){
+            write_name(writer, line->name);
+            wbuffer_putc(&writer->buffer, writer->separator);
+        }
+
+        for(doc_loop(cell, line)){
+            write_value(writer, cell);
+            if(cell->next != NULL) wbuffer_putc(&writer->buffer, writer->separator);
+        }
+
+        if(line->next != NULL) wbuffer_putc(&writer->buffer, '\n');
+    }
+}
+
+// writes a csv doc through a writer
+static void write_csv(csv_writer_t *writer, doc *csv_doc, doc_csv_stringify_opt_t options){
+    if(doc_csv_is_columnar(csv_doc))
+        write_columnar(writer, csv_doc, options);
+    else
+        write_table(writer, csv_doc, options);
+}
+
+// reads the stringify options and checks that the doc is a table, returns false if it can't be written
+static bool stringify_ctx_init(csv_ctx_t *ctx, doc *csv_doc, va_list args){
+    memset(ctx, 0, sizeof(*ctx));
+
+    if(csv_doc == NULL) return false;
+    if(csv_doc->type != dt_obj && csv_doc->type != dt_array) return false;
+
+    doc_csv_stringify_opt_t options = va_arg(args, doc_csv_stringify_opt_t);
+    if(options > csv_stringify_opt_max) options = csv_stringify_normal_mode;
+
+    ctx->options = options;
+    ctx->separator = csv_stringify_separator_default;
+
+    if(options & csv_stringify_use_custom_separator){
+        char separator = va_arg(args, int);
+        if(ispunct(separator) || isblank(separator)) ctx->separator = separator;
+    }
+
+    if(doc_csv_is_columnar(csv_doc)) return true;
+
+    for(doc_loop(line, csv_doc)){
+        for(doc_loop(cell, line)){
+            if(cell->type == dt_obj || cell->type == dt_array)  return false;       // check if cell values are not objects or arrays
+        }
+    }
+
+    return true;
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// save doc csv to file, written in chunks as it is stringified
+void doc_csv_save(doc *csv_doc, char *filename, ...){
+    csv_writer_t writer;
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, filename);
+
+    bool valid = stringify_ctx_init(&ctx, csv_doc, args);
+    va_end(args);
+
+    if(!valid) return;
+
+    fsink_t *sink = fsink_open(filename);
+    if(sink == NULL) return;
+
+    csv_writer_init(&writer, ctx.separator, fsink_write, sink);
+    write_csv(&writer, csv_doc, ctx.options);
+
+    wbuffer_flush(&writer.buffer);
+    wbuffer_free(&writer.buffer);
+    fsink_close(sink);
+}
+
+// makes a csv stream out of a doc data structure 
+char *doc_csv_stringify(doc *csv_doc, ...){
+    csv_writer_t writer;
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, csv_doc);
+
+    bool valid = stringify_ctx_init(&ctx, csv_doc, args);
+    va_end(args);
+
+    if(!valid) return NULL;
+
+    csv_writer_init(&writer, ctx.separator, NULL, NULL);
+    write_csv(&writer, csv_doc, ctx.options);
+
+    return wbuffer_release(&writer.buffer, NULL);
+}
+
+// open and parse a csv file by filename
+doc *doc_csv_open(char *filename, doc_csv_parse_opt_t options, ...){
+    if(filename == NULL) return NULL;
+
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, options);
+
+    bool valid = parse_ctx_init(&ctx, options, args);
+    va_end(args);
+
+    if(!valid) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *file = fview(filename, &size, &mapped);
+    if(file == NULL) return NULL;
+    
+    doc *variable = csv_parse(&ctx, file, size);
+
+    fview_release(file, size, mapped);
+    
+    return variable;
+}
+
+// parse a csv file to a doc structure
+doc *doc_csv_parse(char *stream, doc_csv_parse_opt_t options, ...){
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, options);
+
+    bool valid = parse_ctx_init(&ctx, options, args);
+    va_end(args);
+
+    return (valid && stream != NULL) ? csv_parse(&ctx, stream, strlen(stream)) : NULL;
+}
+
+// checks if a csv was parsed into columns
+bool doc_csv_is_columnar(doc *csv_doc){
+    if(csv_doc == NULL || csv_doc->type != dt_obj || csv_doc->child == NULL) return false;
+
+    for(doc_loop(column, csv_doc)){
+        doc *type = column_member(column, "type");
+        doc *rows = column_member(column, "rows");
+        doc *validity = column_member(column, "validity");
+        doc *values = column_member(column, "values");
+
+        if(type == NULL || type->type != dt_string || rows == NULL || rows->type != dt_uint64) return false;
+        if(validity == NULL || validity->type != dt_bindata || values == NULL || values->type != dt_bindata) return false;
+    }
+
+    return true;
+}
+
+// type of a column
+doc_csv_column_type_t doc_csv_column_type(doc *column){
+    doc *type = column_member(column, "type");
+
+    if(type != NULL && type->type == dt_string){
+        for(size_t i = 0; i < sizeof(column_type_names) / sizeof(*column_type_names); i++){
+            if(!strcmp(((doc_string*)type)->string, column_type_names[i])) return (doc_csv_column_type_t)i;
+        }
+    }
+
+    return csv_column_string;
+}
+
+// rows of a column
+size_t doc_csv_column_rows(doc *column){
+    doc *rows = column_member(column, "rows");
+    return (rows != NULL && rows->type == dt_uint64) ? ((doc_uint64_t*)rows)->value : 0;
+}
+
+// checks the validity bit of a cell
+bool doc_csv_column_valid(doc *column, size_t row){
+    doc *validity = column_member(column, "validity");
+    if(validity == NULL || validity->type != dt_bindata || row / 8 >= ((doc_bindata*)validity)->len) return false;
+
+    return (((doc_bindata*)validity)->data[row / 8] >> (row % 8)) & 1;
+}
+
+// values of a column of the given type
+static const void *column_values(doc *column, doc_csv_column_type_t type){
+    doc *values = column_member(column, "values");
+    if(values == NULL || values->type != dt_bindata || doc_csv_column_type(column) != type) return NULL;
+
+    return ((doc_bindata*)values)->data;
+}
+
+// int64 values of a column
+const int64_t *doc_csv_column_int64(doc *column){
+    return column_values(column, csv_column_int64);
+}
+
+// double values of a column
+const double *doc_csv_column_double(doc *column){
+    return column_values(column, csv_column_double);
+}
+
+// bool values of a column
+const uint8_t *doc_csv_column_bool(doc *column){
+    return column_values(column, csv_column_bool);
+}
+
+// string of a cell
+const char *doc_csv_column_string(doc *column, size_t row, size_t *len){
+    const uint64_t *offsets = column_values(column, csv_column_string);
+    doc *strings = column_member(column, "strings");
+
+    if(offsets == NULL || strings == NULL || strings->type != dt_bindata) return NULL;
+    if(row >= doc_csv_column_rows(column) || !doc_csv_column_valid(column, row)) return NULL;
+
+    if(len != NULL) *len = offsets[row + 1] - offsets[row] - 1;
+
+    return (const char*)((doc_bindata*)strings)->data + offsets[row];
+}
+
+/* ----------------------------------------- Row Reader ------------------------------------- */
+
+// storage of any cell, so a cell node can change type when reused
+typedef union{
+    doc header;
+    doc_string string;
+    doc_bool boolean;
+    integer_doc_type_parse_utils integer;
+    decimal_doc_type_parse_utils decimal;
+}csv_reader_cell_t;
+
+// row reader, rows are parsed in place in the read buffer
+struct doc_csv_reader{
+    freader_t *file;
+    char *buffer;                                                                   // one spare byte for the terminator of the last field
+    size_t size;
+    size_t len;
+    bool eof;
+    bool error;
+    char separators[3];
+    doc_csv_parse_opt_t options;
+    csv_parser_t parser;
+    csv_field_t *fields;                                                            // fields of the current row
+    size_t field_count;
+    size_t field_size;
+    doc *row;
+    size_t row_name_size;
+    doc **cells;                                                                    // cell nodes, reused for every row
+    size_t cell_count;
+    char **names;                                                                   // column names from the first line
+    size_t name_count;
+    csv_cell_kind_t *kinds;                                                         // explicit column types
+    size_t kind_count;
+};
+
+// fields of the next row, false when the row doesn't end inside the buffer
+static bool reader_scan_row(doc_csv_reader *reader){
+    csv_parser_t *parser = &reader->parser;
+
+    reader->field_count = 0;
+
+    while(1){
+        const char *delimiter = next_delimiter(parser);
+
+        if(!reader->eof && (delimiter == parser->end || (*delimiter == '\r' && delimiter + 1 == parser->end)))
+            return false;                                                           // a \r could be followed by a \n
+
+        if(reader->field_count == reader->field_size){
+            reader->field_size = reader->field_size ? reader->field_size * 2 : 16;
+            reader->fields = realloc(reader->fields, reader->field_size * sizeof(*reader->fields));
+        }
+
+        reader->fields[reader->field_count++] = read_field(parser->cursor, delimiter);
+
+        if(delimiter == parser->end){
+            parser->cursor = parser->end;
+            return true;
+        }
+
+        parser->cursor = delimiter + 1;
+
+        if(*delimiter == '\r' || *delimiter == '\n'){
+            if(*delimiter == '\r' && parser->cursor < parser->end && *parser->cursor == '\n'){
+                next_delimiter(parser);
+                parser->cursor++;
+            }
+
+            return true;
+        }
+    }
+}
+
+// keeps the unfinished row at the start of the buffer and reads after it, the buffer only grows for rows longer than it
+static bool reader_fill(doc_csv_reader *reader, const char *row){
+    size_t keep = reader->buffer + reader->len - row;
+
+    memmove(reader->buffer, row, keep);
+    reader->len = keep;
+
+    if(reader->len == reader->size){
+        reader->size *= 2;
+        reader->buffer = realloc(reader->buffer, reader->size + 1);
+    }
+
+    size_t read = freader_read(reader->file, reader->buffer + reader->len, reader->size - reader->len);
+    if(freader_error(reader->file)){
+        reader->error = true;
+        return false;
+    }
+
+    reader->len += read;
+    reader->eof = (read == 0);
+
+    csv_parser_init(&reader->parser, reader->buffer, reader->len, reader->separators);   // the row starts outside quotes
+
+    return true;
+}
+
+// scans the next row, reading as needed. False at the end of the file or on errors
+static bool reader_next_row(doc_csv_reader *reader){
+    while(1){
+        const char *row = reader->parser.cursor;
+
+        if(reader->eof && row >= reader->parser.end) return false;
+        if(reader_scan_row(reader)) return true;
+        if(!reader_fill(reader, row)) return false;
+    }
+}
+
+// terminates a field in place, escaped quotes are collapsed. Returns its length
+static size_t reader_terminate(csv_field_t *field){
+    char *start = (char*)field->start;
+    size_t len = field->escaped ? copy_quoted(start, start, field->len) : field->len;
+
+    start[len] = '\0';                                                              // over the delimiter or the closing quote
+    return len;
+}
+
+// sets a reused cell to a field, strings point into the read buffer
+static void reader_set_cell(doc *cell, csv_field_t *field, csv_cell_kind_t kind){
+    integer_type_parse_utils integer = 0;
+    csv_cell_kind_t found = (field->quoted || kind == csv_cell_string) ? csv_cell_string : classify_cell(field->start, field->len, &integer);
+
+    if(found == csv_cell_empty)
+        found = (kind == csv_cell_bool || kind == csv_cell_integer || kind == csv_cell_decimal) ? csv_cell_empty : csv_cell_string;
+
+    if(found == csv_cell_integer && kind == csv_cell_decimal)
+        found = csv_cell_decimal;
+
+    switch(found){
+        case csv_cell_empty:
+            cell->type = dt_null;
+        break;
+
+        case csv_cell_bool:
+            cell->type = dt_bool;
+            ((doc_bool*)cell)->value = (*field->start == 't');
+        break;
+
+        case csv_cell_integer:
+            cell->type = integer_dt_type_parse_utils;
+            ((integer_doc_type_parse_utils*)cell)->value = integer;
+        break;
+
+        case csv_cell_decimal:
+            cell->type = decimal_dt_type_parse_utils;
+            ((decimal_doc_type_parse_utils*)cell)->value = parse_decimal(field->start, field->len);
+        break;
+
+        case csv_cell_string:
+            cell->type = dt_const_string;
+            ((doc_string*)cell)->len = reader_terminate(field) + 1;
+            ((doc_string*)cell)->string = (char*)field->start;
+        break;
+    }
+}
+
+// name of a column, empty without names
+static const char *reader_column_name(doc_csv_reader *reader, size_t column){
+    return column < reader->name_count ? reader->names[column] : "";
+}
+
+// turns the scanned fields into the row, allocating only cells never used before
+static doc *reader_build_row(doc_csv_reader *reader){
+    doc *row = reader->row;
+    size_t first = 0;
+
+    if((reader->options & csv_parse_first_column_as_names) && reader->field_count > 0){
+        size_t len = reader_terminate(&reader->fields[0]);
+
+        if(len + 1 > reader->row_name_size){
+            reader->row_name_size = len + 1;
+            row->name = realloc(row->name, reader->row_name_size);
+        }
+
+        memcpy(row->name, reader->fields[0].start, len + 1);
+        first = 1;
+    }
+
+    size_t count = reader->field_count - first;
+
+    if(count > reader->cell_count){
+        reader->cells = realloc(reader->cells, count * sizeof(*reader->cells));
+
+        for(; reader->cell_count < count; reader->cell_count++){
+            const char *name = reader_column_name(reader, reader->cell_count + first);
+            size_t name_len = strlen(name);
+
+            doc *cell = calloc(1, sizeof(csv_reader_cell_t));
+            cell->name = malloc(name_len + 1);
+            memcpy(cell->name, name, name_len + 1);
+            cell->parent = row;
+
+            reader->cells[reader->cell_count] = cell;
+        }
+    }
+
+    row->child = count > 0 ? reader->cells[0] : NULL;
+    row->childs = count;
+
+    for(size_t i = 0; i < count; i++){
+        size_t column = i + first;
+        doc *cell = reader->cells[i];
+
+        cell->prev = i > 0 ? reader->cells[i - 1] : NULL;
+        cell->next = i + 1 < count ? reader->cells[i + 1] : NULL;
+
+        reader_set_cell(cell, &reader->fields[column], column < reader->kind_count ? reader->kinds[column] : csv_cell_empty);
+    }
+
+    return row;
+}
+
+// open a row reader
+doc_csv_reader *doc_csv_reader_open(char *filename, doc_csv_parse_opt_t options, ...){
+    if(filename == NULL) return NULL;
+
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, options);
+
+    bool valid = parse_ctx_init(&ctx, options, args);                               // rows are read one at a time, the thread count is ignored
+    va_end(args);
+
+    if(!valid) return NULL;
+
+    freader_t *file = freader_open(filename);
+    if(file == NULL) return NULL;
+
+    doc_csv_reader *reader = calloc(1, sizeof(*reader));
+    reader->file = file;
+    reader->options = options;
+    reader->size = CSV_READER_BUFFER_SIZE;
+    reader->buffer = malloc(reader->size + 1);
+
+    strcpy(reader->separators, ctx.separators);
+
+    if(ctx.column_type_count > 0){
+        reader->kinds = malloc(ctx.column_type_count * sizeof(*reader->kinds));
+        for(reader->kind_count = 0; reader->kind_count < ctx.column_type_count; reader->kind_count++)
+            reader->kinds[reader->kind_count] = kind_of_column_type(ctx.column_types[reader->kind_count]);
+    }
+
+    if((options & csv_parse_first_column_as_names) && reader->kind_count > 0)
+        reader->kinds[0] = csv_cell_string;
+
+    csv_parser_init(&reader->parser, reader->buffer, 0, reader->separators);
+
+    reader->row = new_node(dt_obj, sizeof(doc), "");
+    reader->row_name_size = 1;
+
+    if((options & csv_parse_first_line_as_names) && reader_next_row(reader)){
+        reader->names = malloc(reader->field_count * sizeof(*reader->names));
+
+        for(; reader->name_count < reader->field_count; reader->name_count++){
+            csv_field_t *field = &reader->fields[reader->name_count];
+            size_t len = reader_terminate(field);
+
+            reader->names[reader->name_count] = malloc(len + 1);
+            memcpy(reader->names[reader->name_count], field->start, len + 1);
+        }
+    }
+
+    if(reader->error){
+        doc_csv_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+// next row of a reader
+doc *doc_csv_reader_next(doc_csv_reader *reader){
+    if(reader == NULL || reader->error) return NULL;
+    if(!reader_next_row(reader)) return NULL;
+
+    return reader_build_row(reader);
+}
+
+// checks if a reader failed
+bool doc_csv_reader_error(doc_csv_reader *reader){
+    return reader == NULL || reader->error;
+}
+
+// close a reader
+void doc_csv_reader_close(doc_csv_reader *reader){
+    if(reader == NULL) return;
+
+    for(size_t i = 0; i < reader->cell_count; i++){                                 // strings are const, they live in the buffer
+        free(reader->cells[i]->name);
+        free(reader->cells[i]);
+    }
+
+    for(size_t i = 0; i < reader->name_count; i++)
+        free(reader->names[i]);
+
+    free(reader->row->name);
+    free(reader->row);
+    free(reader->cells);
+    free(reader->names);
+    free(reader->kinds);
+    free(reader->fields);
+    free(reader->buffer);
+    freader_close(reader->file);
+    free(reader);
+}
+
+/* ----------------------------------------- Row Index -------------------------------------- */
+
+// FNV-1a hash of a key field, escaped quotes count once
+static uint64_t field_hash(const csv_field_t *field){
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for(size_t i = 0; i < field->len; i++){
+        hash = (hash ^ (uint8_t)field->start[i]) * 0x100000001B3ull;
+        if(field->escaped && field->start[i] == '"') i++;                          // skip the second quote of the pair
+    }
+
+    return hash;
+}
+
+// checks if a field holds a key
+static bool field_equals(const csv_field_t *field, const char *key){
+    size_t key_len = strlen(key);
+    size_t pos = 0;
+
+    for(size_t i = 0; i < field->len; i++, pos++){
+        if(pos >= key_len || field->start[i] != key[pos]) return false;
+        if(field->escaped && field->start[i] == '"') i++;
+    }
+
+    return pos == key_len;
+}
+
+// order of the keys, by hash then row
+static int compare_index_keys(const void *a, const void *b){
+    const csv_index_key_t *key_a = a;
+    const csv_index_key_t *key_b = b;
+
+    if(key_a->hash != key_b->hash) return key_a->hash < key_b->hash ? -1 : 1;
+    if(key_a->row != key_b->row) return key_a->row < key_b->row ? -1 : 1;
+    return 0;
+}
+
+// path of the sidecar of a csv file
+static char *index_filename(const char *filename){
+    size_t len = strlen(filename);
+    char *path = malloc(len + sizeof(DOC_CSV_INDEX_EXTENSION));
+
+    memcpy(path, filename, len);
+    memcpy(path + len, DOC_CSV_INDEX_EXTENSION, sizeof(DOC_CSV_INDEX_EXTENSION));
+
+    return path;
+}
+
+// size of a file on disk, false if it can't be opened
+static bool file_size(const char *filename, uint64_t *size){
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) return false;
+
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long end = ok ? ftell(file) : -1;
+
+    fclose(file);
+
+    if(end < 0) return false;
+
+    *size = (uint64_t)end;
+    return true;
+}
+
+// checks every field and table of a sidecar image against itself and the size of the csv file, so the
+// row reads and key lookups can use them without checks
+static bool index_image_valid(const uint8_t *base, size_t size, uint64_t csv_size){
+    const csv_index_header_t *header = (const csv_index_header_t*)base;
+
+    if( size < sizeof(*header)                                                      ||
+        memcmp(header->magic, CSV_INDEX_MAGIC, sizeof(header->magic))               ||
+        header->version != CSV_INDEX_VERSION                                        ||
+        header->endianness != CSV_INDEX_ENDIANNESS                                  ||
+        header->size != size                                                        ||
+        header->rows > size / sizeof(uint64_t)                                      ||
+        header->key_count > size / sizeof(csv_index_key_t)                          ||
+        sizeof(*header) + (header->rows + 1) * sizeof(uint64_t) + header->key_count * sizeof(csv_index_key_t) != size
+    )
+        return false;
+
+    if( (header->options & ~(uint32_t)(csv_parse_first_line_as_names | csv_parse_first_column_as_names)) != 0 ||
+        memchr(header->separators, '\0', sizeof(header->separators)) == NULL      ||
+        header->key_column < -1                                                     ||
+        (header->key_column < 0 && header->key_count > 0)                           ||
+        header->data_start > csv_size
+    )
+        return false;
+
+    const uint64_t *offsets = (const uint64_t*)(base + sizeof(*header));
+    const csv_index_key_t *keys = (const csv_index_key_t*)(offsets + header->rows + 1);
+
+    if(offsets[0] < header->data_start || offsets[header->rows] > csv_size) return false;
+
+    for(uint64_t i = 0; i < header->rows; i++){                                     // rows go forward, so end - start never wraps
+        if(offsets[i + 1] < offsets[i]) return false;
+    }
+
+    for(uint64_t i = 0; i < header->key_count; i++){                                // rows in range, sorted by hash for the binary search
+        if(keys[i].row >= header->rows) return false;
+        if(i > 0 && keys[i].hash < keys[i - 1].hash) return false;
+    }
+
+    return true;
+}
+
+// index over a sidecar image, NULL if the image is not a valid index of a csv file of csv_size bytes
+static doc_csv_index *index_from_image(const char *filename, uint8_t *base, size_t size, bool mapped, uint64_t csv_size){
+    const csv_index_header_t *header = (const csv_index_header_t*)base;
+
+    if(base == NULL || !index_image_valid(base, size, csv_size)){
+        if(base != NULL) fview_release(base, size, mapped);
+        return NULL;
+    }
+
+    doc_csv_index *index = malloc(sizeof(*index));
+    size_t len = strlen(filename);
+
+    index->base = base;
+    index->size = size;
+    index->mapped = mapped;
+    index->header = header;
+    index->offsets = (const uint64_t*)(base + sizeof(*header));
+    index->keys = (const csv_index_key_t*)(index->offsets + header->rows + 1);
+    index->filename = malloc(len + 1);
+    memcpy(index->filename, filename, len + 1);
+
+    return index;
+}
+
+// records the rows of a range of the file, the offsets are relative to base
+static void index_scan_rows(csv_index_scan_t *scan, const char *base, size_t start, size_t end, const csv_ctx_t *ctx, int key_column){
+    csv_parser_t parser;
+    csv_field_t field;
+
+    csv_parser_init(&parser, base + start, end - start, ctx->separators);
+
+    while(parser.cursor < parser.end){
+        uint64_t row_start = parser.cursor - base;
+        size_t column = 0;
+        bool line_end;
+
+        if(scan->rows + 1 >= scan->offset_size){
+            scan->offset_size = scan->offset_size * 2 + 1024;
+            scan->offsets = realloc(scan->offsets, scan->offset_size * sizeof(*scan->offsets));
+        }
+
+        scan->offsets[scan->rows] = row_start;
+
+        do{
+            if(column != (size_t)key_column){
+                line_end = skip_field(&parser);
+            }
+            else{
+                line_end = next_field(&parser, &field);
+
+                if(scan->key_count == scan->key_size){
+                    scan->key_size = scan->key_size * 2 + 1024;
+                    scan->keys = realloc(scan->keys, scan->key_size * sizeof(*scan->keys));
+                }
+
+                scan->keys[scan->key_count++] = (csv_index_key_t){ .hash = field_hash(&field), .row = scan->rows };
+            }
+
+            column++;
+        }while(!line_end);
+
+        scan->rows++;
+    }
+}
+
+// writes a sidecar through a temporary file, so readers never see a partial one
+static bool index_write(const char *path, const void *data, size_t len){
+    size_t path_len = strlen(path);
+    char *temporary = malloc(path_len + 5);
+
+    memcpy(temporary, path, path_len);
+    memcpy(temporary + path_len, ".tmp", 5);
+
+    bool ok = fsave(temporary, data, len);
+
+    if(ok) remove(path);                                                            // rename() can't replace files on windows
+    if(ok) ok = rename(temporary, path) == 0;
+    if(!ok) remove(temporary);
+
+    free(temporary);
+    return ok;
+}
+
+/* ----------------------------------------- Row Index Functions ---------------------------- */
+
+// build or extend the index of a csv file
+doc_csv_index *doc_csv_index_build(char *filename, int key_column, doc_csv_parse_opt_t options, ...){
+    if(filename == NULL) return NULL;
+
+    csv_ctx_t ctx;
+    va_list args;
+    va_start(args, options);
+
+    bool valid = parse_ctx_init(&ctx, options, args);
+    va_end(args);
+
+    if(!valid) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *file = fview(filename, &size, &mapped);
+    if(file == NULL) return NULL;
+
+    if(!mapped && size > 0){                                                        // compressed, offsets would not match the file
+        fview_release(file, size, mapped);
+        return NULL;
+    }
+
+    uint32_t index_options = options & (csv_parse_first_line_as_names | csv_parse_first_column_as_names);
+    if(key_column < 0) key_column = -1;
+
+    csv_index_header_t header = {0};
+    memcpy(header.magic, CSV_INDEX_MAGIC, sizeof(header.magic));
+    header.version = CSV_INDEX_VERSION;
+    header.endianness = CSV_INDEX_ENDIANNESS;
+    header.options = index_options;
+    header.key_column = key_column;
+    memcpy(header.separators, ctx.separators, sizeof(ctx.separators));
+
+    csv_index_scan_t scan = {0};
+    size_t resume = 0;
+    char *path = index_filename(filename);
+    doc_csv_index *old = doc_csv_index_open(filename);
+
+    if( old != NULL                                                                 &&
+        old->header->options == index_options                                       &&
+        old->header->key_column == key_column                                       &&
+        !memcmp(old->header->separators, header.separators, sizeof(header.separators))  &&
+        old->offsets[old->header->rows] <= size
+    ){                                                                              // appended rows are scanned from the end of the old ones
+        scan.rows = old->header->rows;
+        resume = old->offsets[scan.rows];
+        header.data_start = old->header->data_start;
+
+        if(scan.rows > 0 && (resume == 0 || file[resume - 1] != '\n')){            // the last row was still being written
+            scan.rows--;
+            resume = old->offsets[scan.rows];
+        }
+
+        scan.offset_size = scan.rows + 1024;
+        scan.offsets = malloc(scan.offset_size * sizeof(*scan.offsets));
+        memcpy(scan.offsets, old->offsets, scan.rows * sizeof(*scan.offsets));
+
+        for(size_t i = 0; i < old->header->key_count; i++){
+            if(old->keys[i].row >= scan.rows) continue;
+
+            if(scan.key_count == scan.key_size){
+                scan.key_size = scan.key_size * 2 + 1024;
+                scan.keys = realloc(scan.keys, scan.key_size * sizeof(*scan.keys));
+            }
+
+            scan.keys[scan.key_count++] = old->keys[i];
+        }
+    }
+    else if(options & csv_parse_first_line_as_names){
+        csv_parser_t parser;
+
+        csv_parser_init(&parser, file, size, ctx.separators);
+        skip_lines(&parser, 1);
+        resume = header.data_start = parser.cursor - file;
+    }
+
+    doc_csv_index_close(old);
+
+    size_t old_keys = scan.key_count;
+    index_scan_rows(&scan, file, resume, size, &ctx, key_column);
+
+    if(scan.offsets == NULL) scan.offsets = malloc(sizeof(*scan.offsets));
+    scan.offsets[scan.rows] = size;                                                 // the scan runs to the end of the file
+
+    if(scan.key_count > old_keys)
+        qsort(scan.keys + old_keys, scan.key_count - old_keys, sizeof(*scan.keys), compare_index_keys);
+
+    header.rows = scan.rows;
+    header.key_count = scan.key_count;
+    header.size = sizeof(header) + (scan.rows + 1) * sizeof(uint64_t) + scan.key_count * sizeof(csv_index_key_t);
+
+    uint8_t *image = malloc(header.size);
+    uint8_t *cursor = image;
+
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, scan.offsets, (scan.rows + 1) * sizeof(uint64_t));
+    cursor += (scan.rows + 1) * sizeof(uint64_t);
+
+    csv_index_key_t *keys = (csv_index_key_t*)cursor;                              // the old and new keys are both sorted, merged here
+    size_t a = 0, b = old_keys, k = 0;
+
+    while(a < old_keys || b < scan.key_count){
+        if(b == scan.key_count || (a < old_keys && compare_index_keys(&scan.keys[a], &scan.keys[b]) <= 0))
+            keys[k++] = scan.keys[a++];
+        else
+            keys[k++] = scan.keys[b++];
+    }
+
+    bool written = index_write(path, image, header.size);
+
+    free(scan.offsets);
+    free(scan.keys);
+    free(path);
+    fview_release(file, size, mapped);
+
+    if(!written){
+        free(image);
+        return NULL;
+    }
+
+    return index_from_image(filename, image, header.size, false, size);
+}
+
+// open the index of a csv file
+doc_csv_index *doc_csv_index_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    uint64_t csv_size;
+    if(!file_size(filename, &csv_size)) return NULL;
+
+    char *path = index_filename(filename);
+    size_t size;
+    uint8_t *base = fmap(path, &size);
+
+    free(path);
+
+    return index_from_image(filename, base, size, true, csv_size);
+}
+
+// number of rows of a index
+size_t doc_csv_index_rows(doc_csv_index *index){
+    return index != NULL ? index->header->rows : 0;
+}
+
+// row of a key
+bool doc_csv_index_find(doc_csv_index *index, const char *key, size_t *row){
+    if(index == NULL || key == NULL || index->header->key_column < 0) return false;
+
+    csv_field_t key_field = { .start = key, .len = strlen(key), .quoted = false, .escaped = false };
+    uint64_t hash = field_hash(&key_field);
+    size_t low = 0, high = index->header->key_count;
+
+    while(low < high){                                                              // first key with the hash
+        size_t middle = low + (high - low) / 2;
+
+        if(index->keys[middle].hash < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if(low == index->header->key_count || index->keys[low].hash != hash) return false;
+
+    size_t size;
+    const char *file = fmap(index->filename, &size);
+    if(file == NULL) return false;
+
+    bool found = false;
+
+    for(; !found && low < index->header->key_count && index->keys[low].hash == hash; low++){   // hashes can collide, the field is compared
+        size_t candidate = index->keys[low].row;
+        uint64_t start = index->offsets[candidate];
+        uint64_t end = index->offsets[candidate + 1];
+
+        if(end > size) break;
+
+        csv_parser_t parser;
+        csv_field_t field;
+        bool line_end = false;
+
+        csv_parser_init(&parser, file + start, end - start, index->header->separators);
+
+        for(size_t column = 0; column < (size_t)index->header->key_column && !line_end; column++)
+            line_end = skip_field(&parser);
+
+        if(!line_end){
+            next_field(&parser, &field);
+            found = field_equals(&field, key);
+        }
+
+        if(found && row != NULL) *row = candidate;
+    }
+
+    funmap((void*)file, size);
+
+    return found;
+}
+
+// parse some rows of a indexed csv file
+doc *doc_csv_read_rows(char *filename, doc_csv_index *index, size_t first, size_t count){
+    if(filename == NULL || index == NULL || first >= index->header->rows) return NULL;
+
+    if(count > index->header->rows - first) count = index->header->rows - first;
+
+    size_t size;
+    const char *file = fmap(filename, &size);
+    if(file == NULL) return NULL;
+
+    const char *separators = index->header->separators;
+    uint64_t start = index->offsets[first];
+    uint64_t end = index->offsets[first + count];
+
+    if(end > size){                                                                 // the file is shorter than when indexed
+        funmap((void*)file, size);
+        return NULL;
+    }
+
+    csv_parser_t parser;
+    csv_columns_t columns = { .rest = csv_cell_empty, .line_names = (index->header->options & csv_parse_first_column_as_names) != 0 };
+
+    if(index->header->options & csv_parse_first_line_as_names){
+        csv_parser_init(&parser, file, index->header->data_start, separators);
+        columns.name_count = read_names(&parser, &columns.names);
+    }
+
+    const csv_columns_t *line_columns = (columns.name_count == 0 && !columns.line_names) ? NULL : &columns;
+    doc *csv = doc_new("", dt_obj, ";");
+    doc *last_line = NULL;
+
+    csv_parser_init(&parser, file + start, end - start, separators);
+
+    for(doc *line = parse_line(&parser, line_columns); line != NULL; line = parse_line(&parser, line_columns))
+        link_member(csv, &last_line, line);
+
+    for(size_t i = 0; i < columns.name_count; i++)
+        free(columns.names[i]);
+
+    free(columns.names);
+    funmap((void*)file, size);
+
+    return csv;
+}
+
+// close a index
+void doc_csv_index_close(doc_csv_index *index){
+    if(index == NULL) return;
+
+    fview_release(index->base, index->size, index->mapped);
+    free(index->filename);
+    free(index);
+}
@@ -11,6 +11,10 @@ extern "C" {
 #include <stdarg.h>
 #include "doc.h"
 
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_CSV_INDEX_EXTENSION     ".idx"                                          // appended to the csv filename to name its row index
+
 /* ----------------------------------------- Enumerators ------------------------------------ */
 
 /**
@@ -24,9 +28,26 @@ typedef enum{
     csv_parse_first_line_as_names                   = 0x01,                         /**< Parse first line as the name for the columns */
     csv_parse_first_column_as_names                 = 0x02,                         /**< Parse first column, first cell in the line, as the name of that line */
     csv_parse_use_custom_separator                  = 0x04,                         /**< Tells the csv parse calls to accept a extra argument with the char to be used as separator */
-    csv_parse_opt_max                               = 0x07                          /**< Maximum number of bitwised arguments */
+    csv_parse_multithreaded                         = 0x08,                         /**< Tells the csv parse calls to accept a extra int argument with the number of threads, 0 for one per cpu */
+    csv_parse_columnar                              = 0x10,                         /**< Parse into one object per column holding typed arrays, see doc_csv_column_* calls */
+    csv_parse_infer_column_types                    = 0x20,                         /**< Type every column after its first 100 rows instead of typing each cell */
+    csv_parse_column_types                          = 0x40,                         /**< Tells the csv parse calls to accept two extra arguments, a int count and a array of doc_csv_column_type_t with the column types */
+    csv_parse_select_columns                        = 0x80,                         /**< Tells the csv parse calls to accept two extra arguments, a int count and a array of int with the indexes of the columns to parse */
+    csv_parse_select_named_columns                  = 0x100,                        /**< Tells the csv parse calls to accept two extra arguments, a int count and a array of strings with the names of the columns to parse, needs csv_parse_first_line_as_names */
+    csv_parse_row_range                             = 0x200,                        /**< Tells the csv parse calls to accept two extra size_t arguments, the number of rows to skip and the maximum number of rows to parse, 0 for all */
+    csv_parse_opt_max                               = 0x3FF                         /**< Maximum number of bitwised arguments */
 }doc_csv_parse_opt_t;
 
+/**
+ * @brief type of the values of a column parsed with csv_parse_columnar
+ */
+typedef enum{
+    csv_column_int64,                                                               /**< int64_t array */
+    csv_column_double,                                                              /**< double array */
+    csv_column_bool,                                                                /**< uint8_t array of 0 or 1 */
+    csv_column_string                                                               /**< uint64_t offsets into a blob of null terminated strings */
+}doc_csv_column_type_t;
+
 /**
  * @brief enumerator with stringify options that can be passed to doc_csv calls.
  * @note you can pass more than one options using the bitwise OR operator, since the
@@ -41,12 +62,24 @@ typedef enum{
     csv_stringify_opt_max                           = 0x07                          /**< Maximum number of bitwised arguments */
 }doc_csv_stringify_opt_t;
 
+/* ----------------------------------------- Typedef's ---------------------------------------- */
+
+/**
+ * @brief reads a csv file one row at a time, see doc_csv_reader_open
+ */
+typedef struct doc_csv_reader doc_csv_reader;
+
+/**
+ * @brief row offsets of a csv file, see doc_csv_index_build
+ */
+typedef struct doc_csv_index doc_csv_index;
+
 /* ----------------------------------------- Functions -------------------------------------- */
 
 /**
  * @brief open a csv file designated by the filename and parse it into
  * a doc data structure.
- * @note see doc_csv_parse call.
+ * @note see doc_csv_parse call. Plain files are memory mapped instead of read, gzip and doc_lz files are decoded into memory.
  * @param filename: path to the file
  * @param ...: optional parameter of type doc_csv_parse_opt_t
  * @return a doc data structure
@@ -55,7 +88,7 @@ doc *doc_csv_open(char *filename, doc_csv_parse_opt_t options, ...);
 
 /**
  * @brief stringify a doc structure and save it to a file 
- * @note see doc_csv_stringify call.
+ * @note see doc_csv_stringify call. The text is written to the file in chunks of 64KiB as it is made.
  * @param csv_doc: csv doc data structure
  * @param filename: path to the file
  * @param ...: optional parameter of type doc_csv_stringify_opt_t
@@ -69,6 +102,25 @@ void doc_csv_save(doc *csv_doc, char *filename, ...);
  * since a csv table is represented by a object with objects with cells, these first objects 
  * are anonymous, acessing them is easy trought the syntax 'csv[0][0]' for example, by using names
  * they more accessible.
+ * Fields follow RFC 4180, quoted fields may contain separators, line breaks and escaped quotes ("").
+ * Unquoted cells are typed as bool, integer, decimal or string, quoted cells are always strings.
+ * The stream is not modified.
+ * With csv_parse_first_line_as_names the names line is read once, but every cell still gets its own copy of its
+ * column name, since doc_delete() frees the name of each node, so named columns cost a small allocation and copy
+ * per cell over unnamed ones.
+ * Extra arguments follow the order of the option bits: separator char, thread count, column types, column indexes,
+ * column names, then the row range.
+ * With csv_parse_infer_column_types and/or csv_parse_column_types every cell of a column gets the column type,
+ * explicit types win over inferred ones. Empty cells of bool and number columns are null, and cells that don't fit
+ * the type of their column, unseen by the sample, are typed on their own. With csv_parse_columnar, the explicit types
+ * replace the inferred ones and cells that don't fit are null.
+ * With csv_parse_multithreaded the stream is split at row boundaries outside quotes and the parts are parsed
+ * in parallel, the result is the same as a single threaded parse. Streams smaller than 64KiB per thread use less threads.
+ * With csv_parse_select_columns and/or csv_parse_select_named_columns only the picked columns are parsed, in the
+ * order of the file, the other fields are skipped without being converted or allocated. Indexes count the fields of
+ * a line, the line name of csv_parse_first_column_as_names included, which is always read. With csv_parse_row_range
+ * the rows after the names are skipped the same way, and parsing stops after the row limit, so a limit parses in one
+ * thread. Both also apply to csv_parse_columnar.
  * @param stream: a csv file stream
  * @param ...: optional parameter, of type doc_csv_parse_opt_t
  * @return a doc data structure
@@ -79,12 +131,176 @@ doc *doc_csv_parse(char *stream, doc_csv_parse_opt_t options, ...);
  * @brief stringify a doc data structure to a csv file stream.
  * @note doc data structure must have a high level obj/array with one or more obj/array inside of it
  * representing the lines that contains cell data, each line should have the same number of cells
+ * A columnar doc, see csv_parse_columnar, is written back as rows, null cells are left empty.
+ * Fields are quoted as in RFC 4180 only when needed: when they hold a separator, a quote or a line break, or
+ * when a string would be parsed back as other type. Decimals are written as the shortest text that parses back
+ * to the same value.
  * @param csv_doc: doc structure of the csv file
  * @return ASCII stream of the csv file  
  */
 char *doc_csv_stringify(doc *csv_doc, ...);
 
+/**
+ * @brief checks if a doc structure was parsed with csv_parse_columnar.
+ * @note a columnar csv is a object with one object per column, named after the first line when
+ * csv_parse_first_line_as_names is used. Each column has the members "type", "rows", "validity" with one
+ * bit per row set for non null cells, "values" with one value per row and, for strings, "strings" with the
+ * null terminated strings, "values" holding rows + 1 offsets into it. Empty unquoted cells are null.
+ * The type of a column is the smallest one that fits all its cells: bool, int64, double or string.
+ * @param csv_doc: doc structure of the csv file
+ * @return true if it is columnar
+ */
+bool doc_csv_is_columnar(doc *csv_doc);
+
+/**
+ * @brief type of a column of a columnar csv
+ * @param column: column obj, ex: doc_get_ptr(csv, "price")
+ * @return the type, csv_column_string if it is not a column
+ */
+doc_csv_column_type_t doc_csv_column_type(doc *column);
+
+/**
+ * @brief number of rows of a column of a columnar csv
+ * @param column: column obj
+ * @return the number of rows, 0 if it is not a column
+ */
+size_t doc_csv_column_rows(doc *column);
+
+/**
+ * @brief checks if a cell of a column is not null
+ * @param column: column obj
+ * @param row: row index
+ * @return true if the cell has a value
+ */
+bool doc_csv_column_valid(doc *column, size_t row);
+
+/**
+ * @brief values of a int64 column, null cells are 0
+ * @param column: column obj
+ * @return the array, NULL if the column is of other type
+ */
+const int64_t *doc_csv_column_int64(doc *column);
+
+/**
+ * @brief values of a double column, null cells are 0
+ * @param column: column obj
+ * @return the array, NULL if the column is of other type
+ */
+const double *doc_csv_column_double(doc *column);
+
+/**
+ * @brief values of a bool column, 0 or 1, null cells are 0
+ * @param column: column obj
+ * @return the array, NULL if the column is of other type
+ */
+const uint8_t *doc_csv_column_bool(doc *column);
+
+/**
+ * @brief a string of a string column
+ * @param column: column obj
+ * @param row: row index
+ * @param len: if not NULL receives the string length
+ * @return the null terminated string, NULL for null cells or if the column is of other type
+ */
+const char *doc_csv_column_string(doc *column, size_t row, size_t *len);
+
+/**
+ * @brief opens a csv file to be read one row at a time, gzip and doc_lz files are decoded on the fly
+ * @note the file is read through a buffer of 64KiB that only grows for rows longer than it. Each row
+ * is parsed in place in the buffer, and the row and its cells are reused for the next one, so reading
+ * does not allocate once the widest row was seen. Supports csv_parse_use_custom_separator,
+ * csv_parse_first_line_as_names, csv_parse_first_column_as_names and csv_parse_column_types, the extra
+ * arguments are the same as in doc_csv_parse, other options are ignored.
+ * @param filename: path to the file
+ * @param ...: optional parameter of type doc_csv_parse_opt_t
+ * @return the reader, NULL on error
+ */
+doc_csv_reader *doc_csv_reader_open(char *filename, doc_csv_parse_opt_t options, ...);
+
+/**
+ * @brief next row of a reader, like a line of doc_csv_parse
+ * @note the row belongs to the reader and is only valid until the next call, its strings are
+ * const and point into the read buffer. Use doc_copy to keep it, don't delete it.
+ * @param reader: csv reader
+ * @return the row, NULL at the end of the file or on errors
+ */
+doc *doc_csv_reader_next(doc_csv_reader *reader);
+
+/**
+ * @brief checks if the file of a reader could not be read or decoded
+ * @param reader: csv reader
+ * @return true on errors
+ */
+bool doc_csv_reader_error(doc_csv_reader *reader);
+
+/**
+ * @brief closes a reader and frees its memory, including the last row
+ * @param reader: csv reader
+ */
+void doc_csv_reader_close(doc_csv_reader *reader);
+
+/**
+ * @brief builds the row index of a csv file and writes it next to it, as the filename with DOC_CSV_INDEX_EXTENSION
+ * @note the index holds the byte offset of every row, 8 bytes per row, so rows can be read without parsing the
+ * rows before them, see doc_csv_read_rows. With a key column it also holds a 64 bit hash of that field for every
+ * row, sorted, for doc_csv_index_find. When the file already has a index built with the same options, only the
+ * rows appended since are scanned, a last row that didn't end with a line break is scanned again. A file that
+ * shrank is indexed again from the start. Only plain files can be indexed, compressed files give NULL.
+ * Supports csv_parse_use_custom_separator, csv_parse_first_line_as_names and csv_parse_first_column_as_names,
+ * which are kept in the index for doc_csv_read_rows, other options are ignored.
+ * @param filename: path to the csv file
+ * @param key_column: index of the field to look rows up by, counting the line name field, -1 for none
+ * @param ...: optional parameter of type doc_csv_parse_opt_t
+ * @return the index, NULL on error or if the sidecar can't be written
+ */
+doc_csv_index *doc_csv_index_build(char *filename, int key_column, doc_csv_parse_opt_t options, ...);
+
+/**
+ * @brief opens the index of a csv file written by doc_csv_index_build, without reading the csv file
+ * @note every offset and key of the index is checked once here, against the index and the size of the csv file.
+ * A stale or corrupted index gives NULL, and doc_csv_index_build indexes the file again from the start.
+ * @param filename: path to the csv file, not to the index
+ * @return the index, NULL if there is no valid index
+ */
+doc_csv_index *doc_csv_index_open(char *filename);
+
+/**
+ * @brief number of rows of a index, the names line excluded
+ * @param index: csv index
+ * @return the number of rows
+ */
+size_t doc_csv_index_rows(doc_csv_index *index);
+
+/**
+ * @brief finds the first row whose key field is equal to key
+ * @note the row is mapped and its key field compared, so hash collisions don't give wrong rows
+ * @param index: csv index built with a key column
+ * @param key: unquoted value of the field
+ * @param row: if not NULL receives the row number
+ * @return true if found
+ */
+bool doc_csv_index_find(doc_csv_index *index, const char *key, size_t *row);
+
+/**
+ * @brief parses count rows of a indexed csv file starting at row first, like doc_csv_parse with the options
+ * the index was built with
+ * @note the file is memory mapped and only the requested rows are parsed, the names line too if the
+ * index uses it. Rows appended after the index was built are not seen until it is built again.
+ * @param filename: path to the csv file
+ * @param index: index of the file
+ * @param first: first row, from 0
+ * @param count: number of rows, less are parsed at the end of the index
+ * @return a doc data structure with the rows, NULL if first is past the last row or on error
+ */
+doc *doc_csv_read_rows(char *filename, doc_csv_index *index, size_t first, size_t count);
+
+/**
+ * @brief closes a index and frees its memory
+ * @param index: csv index
+ */
+void doc_csv_index_close(doc_csv_index *index);
+
 #ifdef __cplusplus 
 }
 #endif
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,531 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "doc_image.h"
+#include "parse_utils.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_IMAGE_ENDIANNESS        (0x01020304)                                    // written in host order, to detect byte order mismatch
+#define DOC_IMAGE_ALIGNMENT         (8)                                             // every node and table is aligned to this
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// header at the start of every image file
+typedef struct{
+    char magic[6];
+    uint16_t version;
+    uint32_t endianness;
+    uint32_t reserved;
+    uint64_t root;                                                                  // offset of the root node
+    uint64_t size;                                                                  // size of the whole file
+}doc_image_header_t;
+
+// opened image
+struct doc_image{
+    uint8_t *base;
+    size_t size;
+    doc_image_node *root;
+};
+
+// state of the image writer
+typedef struct{
+    FILE *file;
+    uint64_t offset;
+    bool error;
+}image_writer_t;
+
+// member name used to sort the members of a object
+typedef struct{
+    const char *name;
+    size_t len;
+    uint32_t index;
+}image_sort_entry_t;
+
+/* ----------------------------------------- Private Globals -------------------------------- */
+
+// dummy node to receive macros operations, to not generate segfault
+static doc_image_node dummy_node_internal = { .type = dt_null, .name_len = 0, .name = 0, .bits = 0xFFFFFFFFFFFFFFFF, .data = 0 };
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+// compare a name against a sized name, same order used to sort the members when writing
+static int compare_names(const char *a, size_t a_len, const char *b, size_t b_len){
+    int result = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+    if(result != 0) return result;
+    if(a_len == b_len) return 0;
+    return a_len < b_len ? -1 : 1;
+}
+
+// qsort callback for object members
+static int compare_sort_entries(const void *a, const void *b){
+    const image_sort_entry_t *entry_a = (const image_sort_entry_t*)a;
+    const image_sort_entry_t *entry_b = (const image_sort_entry_t*)b;
+
+    return compare_names(entry_a->name, entry_a->len, entry_b->name, entry_b->len);
+}
+
+// write bytes to the image, returning the offset where they were written
+static uint64_t write_bytes(image_writer_t *writer, const void *data, size_t len){
+    uint64_t offset = writer->offset;
+
+    if(len > 0 && fwrite(data, 1, len, writer->file) != len)
+        writer->error = true;
+
+    writer->offset += len;
+    return offset;
+}
+
+// pad the image to the alignment
+static void write_align(image_writer_t *writer){
+    static const uint8_t zeros[DOC_IMAGE_ALIGNMENT] = {0};
+    size_t pad = (DOC_IMAGE_ALIGNMENT - (writer->offset % DOC_IMAGE_ALIGNMENT)) % DOC_IMAGE_ALIGNMENT;
+
+    write_bytes(writer, zeros, pad);
+}
+
+// write a node and its members recursively, members are written before the parent, returns the node offset
+static uint64_t write_node(image_writer_t *writer, doc *variable){
+    doc_image_node node = {0};
+    uint64_t *offsets = NULL;
+    image_sort_entry_t *entries = NULL;
+    const char *name = variable->name != NULL ? variable->name : "";
+
+    node.type = variable->type;
+    node.name_len = strlen(name);
+    node.name = write_bytes(writer, name, node.name_len + 1);
+
+    switch(variable->type){
+        case dt_obj:
+        case dt_array:
+            node.childs = variable->childs;
+
+            if(node.childs > 0){
+                offsets = malloc(sizeof(*offsets) * node.childs);
+                if(variable->type == dt_obj) entries = malloc(sizeof(*entries) * node.childs);
+
+                uint32_t i = 0;
+                for(doc_loop(member, variable)){
+                    offsets[i] = write_node(writer, member);
+
+                    if(entries != NULL){
+                        entries[i].name = member->name != NULL ? member->name : "";
+                        entries[i].len = strlen(entries[i].name);
+                        entries[i].index = i;
+                    }
+
+                    i++;
+                }
+
+                write_align(writer);
+                node.data = write_bytes(writer, offsets, sizeof(*offsets) * node.childs);
+
+                if(entries != NULL){                                                // sorted index table right after the offsets
+                    qsort(entries, node.childs, sizeof(*entries), compare_sort_entries);
+
+                    for(uint32_t j = 0; j < node.childs; j++)
+                        write_bytes(writer, &(entries[j].index), sizeof(entries[j].index));
+                }
+
+                free(offsets);
+                free(entries);
+            }
+        break;
+
+        case dt_string:
+        case dt_const_string:
+            node.len = ((doc_string*)variable)->len;
+            node.data = write_bytes(writer, ((doc_string*)variable)->string, node.len);
+            write_bytes(writer, "", 1);                                             // strings are always null terminated on the image
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:
+            node.len = ((doc_bindata*)variable)->len;
+            node.data = write_bytes(writer, ((doc_bindata*)variable)->data, node.len);
+        break;
+
+        case dt_double:  memcpy(&node.bits, &((doc_double*)variable)->value,   sizeof(double));        break;
+        case dt_float:   memcpy(&node.bits, &((doc_float*)variable)->value,    sizeof(float));         break;
+        case dt_uint:    memcpy(&node.bits, &((doc_uint_t*)variable)->value,   sizeof(unsigned int));  break;
+        case dt_uint64:  memcpy(&node.bits, &((doc_uint64_t*)variable)->value, sizeof(uint64_t));      break;
+        case dt_uint32:  memcpy(&node.bits, &((doc_uint32_t*)variable)->value, sizeof(uint32_t));      break;
+        case dt_uint16:  memcpy(&node.bits, &((doc_uint16_t*)variable)->value, sizeof(uint16_t));      break;
+        case dt_uint8:   memcpy(&node.bits, &((doc_uint8_t*)variable)->value,  sizeof(uint8_t));       break;
+        case dt_int:     memcpy(&node.bits, &((doc_int*)variable)->value,      sizeof(int));           break;
+        case dt_int64:   memcpy(&node.bits, &((doc_int64_t*)variable)->value,  sizeof(int64_t));       break;
+        case dt_int32:   memcpy(&node.bits, &((doc_int32_t*)variable)->value,  sizeof(int32_t));       break;
+        case dt_int16:   memcpy(&node.bits, &((doc_int16_t*)variable)->value,  sizeof(int16_t));       break;
+        case dt_int8:    memcpy(&node.bits, &((doc_int8_t*)variable)->value,   sizeof(int8_t));        break;
+        case dt_bool:    memcpy(&node.bits, &((doc_bool*)variable)->value,     sizeof(bool));          break;
+
+        case dt_null:
+        default:
+        break;
+    }
+
+    write_align(writer);
+    return write_bytes(writer, &node, sizeof(node));
+}
+
+// check that a range of bytes lies inside the mapping
+static bool range_in_image(doc_image *image, uint64_t offset, uint64_t len){
+    return offset <= image->size && len <= image->size - offset;
+}
+
+// offset of a node inside the mapping
+static uint64_t node_offset(doc_image *image, doc_image_node *node){
+    return (uint64_t)((uint8_t*)node - image->base);
+}
+
+// get a node by its offset, checking the node and every range it refers to against the mapping,
+// members are always written before their parent, so a member offset must be below the parent offset
+static doc_image_node *node_at_offset(doc_image *image, uint64_t offset, uint64_t limit){
+    if(offset >= limit || !range_in_image(image, offset, sizeof(doc_image_node)) || (offset % DOC_IMAGE_ALIGNMENT) != 0)
+        return NULL;
+
+    doc_image_node *node = (doc_image_node*)(image->base + offset);
+
+    if(!IS_DOC_TYPE(node->type)) return NULL;
+    if(!range_in_image(image, node->name, (uint64_t)node->name_len + 1) || image->base[node->name + node->name_len] != '\0')
+        return NULL;
+
+    switch(node->type){
+        case dt_obj:
+        case dt_array:{
+            uint64_t entry_size = sizeof(uint64_t) + (node->type == dt_obj ? sizeof(uint32_t) : 0);
+
+            if(node->childs == 0) break;
+            if(node->childs > image->size / entry_size || (node->data % DOC_IMAGE_ALIGNMENT) != 0) return NULL;
+            if(!range_in_image(image, node->data, node->childs * entry_size)) return NULL;
+        }
+        break;
+
+        case dt_string:
+        case dt_const_string:
+            if(!range_in_image(image, node->data, node->len) || node->len == image->size - node->data) return NULL;
+            if(image->base[node->data + node->len] != '\0') return NULL;
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:
+            if(!range_in_image(image, node->data, node->len)) return NULL;
+        break;
+
+        default:
+        break;
+    }
+
+    return node;
+}
+
+// get a member of a object or array by its position on the table of members
+static doc_image_node *member_at(doc_image *image, doc_image_node *node, uint64_t index){
+    uint64_t offset;
+
+    memcpy(&offset, image->base + node->data + index * sizeof(offset), sizeof(offset));
+    return node_at_offset(image, offset, node_offset(image, node));
+}
+
+// find a member by name, binary search on objects, linear on arrays since their members are usually anonymous
+static doc_image_node *find_member(doc_image *image, doc_image_node *node, const char *name, size_t len){
+    if(node->type != dt_obj && node->type != dt_array) return NULL;
+    if(node->childs == 0) return NULL;
+
+    if(node->type == dt_array){
+        for(uint64_t i = 0; i < node->childs; i++){
+            doc_image_node *member = member_at(image, node, i);
+
+            if(member != NULL && !compare_names(name, len, (char*)(image->base + member->name), member->name_len))
+                return member;
+        }
+
+        return NULL;
+    }
+
+    uint32_t *sorted = (uint32_t*)(image->base + node->data + node->childs * sizeof(uint64_t));
+    uint64_t low = 0;
+    uint64_t high = node->childs;
+
+    while(low < high){
+        uint64_t middle = low + (high - low) / 2;
+        if(sorted[middle] >= node->childs) return NULL;
+
+        doc_image_node *member = member_at(image, node, sorted[middle]);
+        if(member == NULL) return NULL;
+
+        int result = compare_names(name, len, (char*)(image->base + member->name), member->name_len);
+
+        if(result == 0)
+            return member;
+        else if(result < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    return NULL;
+}
+
+// size in bytes of a doc value struct by type
+static size_t doc_struct_size(doc_type_t type){
+    switch(type){
+        case dt_double:         return sizeof(doc_double);
+        case dt_float:          return sizeof(doc_float);
+        case dt_uint:           return sizeof(doc_uint_t);
+        case dt_uint64:         return sizeof(doc_uint64_t);
+        case dt_uint32:         return sizeof(doc_uint32_t);
+        case dt_uint16:         return sizeof(doc_uint16_t);
+        case dt_uint8:          return sizeof(doc_uint8_t);
+        case dt_int:            return sizeof(doc_int);
+        case dt_int64:          return sizeof(doc_int64_t);
+        case dt_int32:          return sizeof(doc_int32_t);
+        case dt_int16:          return sizeof(doc_int16_t);
+        case dt_int8:           return sizeof(doc_int8_t);
+        case dt_bool:           return sizeof(doc_bool);
+        case dt_string:
+        case dt_const_string:   return sizeof(doc_string);
+        case dt_bindata:
+        case dt_const_bindata:  return sizeof(doc_bindata);
+        default:                return sizeof(doc);
+    }
+}
+
+// build a doc structure out of a node, recursive
+static doc *node_to_doc(doc_image *image, doc_image_node *node){
+    doc *variable = calloc(1, doc_struct_size(node->type));
+    doc *last_member = NULL;
+
+    variable->type = node->type;
+    variable->name = malloc(node->name_len + 1);
+    memcpy(variable->name, image->base + node->name, node->name_len + 1);
+
+    switch(node->type){
+        case dt_obj:
+        case dt_array:
+            for(uint64_t i = 0; i < node->childs; i++){
+                doc_image_node *member_node = doc_image_node_at(image, node, i);
+                if(member_node == NULL) break;
+
+                doc *member = node_to_doc(image, member_node);
+                member->parent = variable;
+
+                if(last_member == NULL){
+                    variable->child = member;
+                }
+                else{
+                    last_member->next = member;
+                    member->prev = last_member;
+                }
+
+                last_member = member;
+                variable->childs++;
+            }
+        break;
+
+        case dt_string:
+        case dt_const_string:
+            variable->type = dt_const_string;                                       // points inside the mapping
+            ((doc_string*)variable)->string = (char*)(image->base + node->data);
+            ((doc_string*)variable)->len = node->len;
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:
+            variable->type = dt_const_bindata;
+            ((doc_bindata*)variable)->data = image->base + node->data;
+            ((doc_bindata*)variable)->len = node->len;
+        break;
+
+        case dt_null:
+        break;
+
+        default:                                                                    // numeric values are right after the header
+            memcpy((uint8_t*)variable + sizeof(doc), &node->bits, doc_struct_size(node->type) - sizeof(doc));
+        break;
+    }
+
+    return variable;
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// check node for the value macros
+doc_image_node *__doc_image_check_node(doc_image_node *node){
+    return node != NULL ? node : &dummy_node_internal;
+}
+
+// write a doc structure as a image
+bool doc_image_write(doc *variable, char *filename){
+    if(variable == NULL || filename == NULL) return false;
+
+    FILE *file = fopen(filename, "wb");
+    if(file == NULL) return false;
+
+    image_writer_t writer = { .file = file, .offset = 0, .error = false };
+    doc_image_header_t header = {0};
+
+    write_bytes(&writer, &header, sizeof(header));                                  // placeholder, written again at the end
+    header.root = write_node(&writer, variable);
+    header.size = writer.offset;
+
+    memcpy(header.magic, DOC_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = DOC_IMAGE_VERSION;
+    header.endianness = DOC_IMAGE_ENDIANNESS;
+
+    if(fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)
+        writer.error = true;
+
+    if(fclose(file) != 0)
+        writer.error = true;
+
+    if(writer.error){
+        remove(filename);
+        return false;
+    }
+
+    return true;
+}
+
+// map a image
+doc_image *doc_image_open(char *filename){
+    size_t size;
+    uint8_t *base = fmap(filename, &size);
+    if(base == NULL) return NULL;
+
+    doc_image_header_t *header = (doc_image_header_t*)base;
+
+    if( size < sizeof(*header) + sizeof(doc_image_node)                             ||
+        memcmp(header->magic, DOC_IMAGE_MAGIC, sizeof(header->magic))              ||
+        header->version != DOC_IMAGE_VERSION                                        ||
+        header->endianness != DOC_IMAGE_ENDIANNESS                                  ||
+        header->size != size
+    ){
+        funmap(base, size);
+        return NULL;
+    }
+
+    doc_image *image = malloc(sizeof(*image));
+    image->base = base;
+    image->size = size;
+    image->root = node_at_offset(image, header->root, size);
+
+    if(image->root == NULL){
+        doc_image_close(image);
+        return NULL;
+    }
+
+    return image;
+}
+
+// unmap a image
+void doc_image_close(doc_image *image){
+    if(image == NULL) return;
+
+    funmap(image->base, image->size);
+    free(image);
+}
+
+// get a node from the root
+doc_image_node *doc_image_get_ptr(doc_image *image, char *name){
+    if(image == NULL) return NULL;
+
+    return doc_image_node_get_ptr(image, image->root, name);
+}
+
+// get a node relative to another
+doc_image_node *doc_image_node_get_ptr(doc_image *image, doc_image_node *node, char *name){
+    if(image == NULL || node == NULL || name == NULL) return NULL;
+
+    const char *cursor = name;
+
+    while(*cursor != '\0' && node != NULL){
+        if(*cursor == '.'){
+            cursor++;
+        }
+        else if(*cursor == '['){                                                    // by index
+            char *end;
+            uint64_t index = strtoull(cursor + 1, &end, 10);
+
+            if(end == cursor + 1 || *end != ']') return NULL;
+
+            node = doc_image_node_at(image, node, index);
+            cursor = end + 1;
+        }
+        else{                                                                       // by name
+            size_t len = strcspn(cursor, ".[");
+
+            node = find_member(image, node, cursor, len);
+            cursor += len;
+        }
+    }
+
+    return node;
+}
+
+// get a member by index
+doc_image_node *doc_image_node_at(doc_image *image, doc_image_node *node, uint64_t index){
+    if(image == NULL || node == NULL) return NULL;
+    if(node->type != dt_obj && node->type != dt_array) return NULL;
+    if(index >= node->childs) return NULL;
+
+    return member_at(image, node, index);
+}
+
+// get the name of a node
+const char *doc_image_node_name(doc_image *image, doc_image_node *node){
+    if(image == NULL || node == NULL) return NULL;
+
+    return (const char*)(image->base + node->name);
+}
+
+// get data of strings and bindata
+const void *doc_image_node_data(doc_image *image, doc_image_node *node){
+    if(image == NULL || node == NULL) return NULL;
+
+    switch(node->type){
+        case dt_string:
+        case dt_const_string:
+        case dt_bindata:
+        case dt_const_bindata:
+            return image->base + node->data;
+
+        default:
+            return NULL;
+    }
+}
+
+// size of a node
+uint64_t doc_image_get_size(doc_image *image, char *name){
+    doc_image_node *node = doc_image_get_ptr(image, name);
+    if(node == NULL) return 0;
+
+    switch(node->type){
+        case dt_obj:
+        case dt_array:
+            return node->childs;
+
+        case dt_string:
+        case dt_const_string:
+        case dt_bindata:
+        case dt_const_bindata:
+            return node->len;
+
+        case dt_null:
+            return 0;
+
+        default:
+            return doc_struct_size(node->type) - sizeof(doc);
+    }
+}
+
+// materialize a node into a doc structure
+doc *doc_image_to_doc(doc_image *image, char *name){
+    doc_image_node *node = doc_image_get_ptr(image, name);
+    if(node == NULL) return NULL;
+
+    return node_to_doc(image, node);
+}
@@ -0,0 +1,164 @@
+#ifndef _DOC_IMAGE_HEADER_
+#define _DOC_IMAGE_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "doc.h"
+
+/**
+ * A doc image is a read only, offset based, binary representation of a doc data structure,
+ * made to be memory mapped and queried in place. Opening a image does not parse anything,
+ * the file is just mapped, so opening is O(1) no matter the size of the file, and processes
+ * opening the same image share the same pages from the os page cache.
+ *
+ * Objects carry a table of members sorted by name, so lookups by name are binary searches,
+ * and arrays carry a table of offsets, so lookups by index are O(1).
+ *
+ * Images are written with the host byte order, a image written on a machine with a
+ * different endianness will fail to open.
+ */
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_IMAGE_MAGIC             "DOCIMG"                                        // magic number at the start of the file
+#define DOC_IMAGE_VERSION           (1)                                             // version of the layout
+
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief opaque type for a opened doc image
+ */
+typedef struct doc_image doc_image;
+
+/**
+ * @brief a node inside a mapped doc image, pointers to nodes are valid until doc_image_close() is called
+ */
+typedef struct{
+    uint32_t type;                                                                  /**< type of the node, as in doc_type_t */
+    uint32_t name_len;                                                              /**< length of the name, without the null terminator */
+    uint64_t name;                                                                  /**< offset of the null terminated name */
+    union{
+        uint64_t childs;                                                            /**< quantity of members on objects and arrays */
+        uint64_t len;                                                               /**< length of strings and binary data */
+        uint64_t bits;                                                              /**< raw bits of numeric and bool values */
+    };
+    uint64_t data;                                                                  /**< offset of string data, binary data or the table of members */
+}doc_image_node;
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+/**
+ * @brief internal function, visible only for macro porpouses, returns a dummy node in case node is NULL
+ * so the macros don't segfault on not found members
+ */
+doc_image_node *__doc_image_check_node(doc_image_node *node);
+
+/**
+ * @brief writes a doc data structure as a doc image file
+ * @param variable: doc data structure to write, may be of any type
+ * @param filename: path to the file
+ * @return true on success, false otherwise
+ */
+bool doc_image_write(doc *variable, char *filename);
+
+/**
+ * @brief maps a doc image file into memory
+ * @param filename: path to the file
+ * @return a opened image or NULL if the file could not be mapped or is not a valid image
+ * @note only the header and the root node are checked here, every other node is checked against the bounds
+ * of the mapping when reached, a corrupted node is reported as not found
+ */
+doc_image *doc_image_open(char *filename);
+
+/**
+ * @brief unmaps and frees a doc image, every node and pointer acquired trought the image becomes invalid
+ * @param image: opened doc image
+ */
+void doc_image_close(doc_image *image);
+
+/**
+ * @brief gets a node inside the image, by the same syntax used on doc_get_ptr(), ex: "member.array[2].value"
+ * @param image: opened doc image
+ * @param name: path to the member, "." for the root
+ * @return pointer to the node inside the mapping, NULL if not found
+ */
+doc_image_node *doc_image_get_ptr(doc_image *image, char *name);
+
+/**
+ * @brief gets a node relative to another node, same syntax as doc_image_get_ptr()
+ * @param image: opened doc image
+ * @param node: node to start the search from
+ * @param name: path to the member, "." for the node itself
+ * @return pointer to the node inside the mapping, NULL if not found
+ */
+doc_image_node *doc_image_node_get_ptr(doc_image *image, doc_image_node *node, char *name);
+
+/**
+ * @brief gets a member of a object or array by its index, O(1)
+ * @param image: opened doc image
+ * @param node: object or array node
+ * @param index: index of the member
+ * @return pointer to the member node, NULL if out of bounds or node is not a object or array
+ */
+doc_image_node *doc_image_node_at(doc_image *image, doc_image_node *node, uint64_t index);
+
+/**
+ * @brief gets the name of a node
+ * @param image: opened doc image
+ * @param node: node inside the image
+ * @return null terminated name, pointing inside the mapping
+ */
+const char *doc_image_node_name(doc_image *image, doc_image_node *node);
+
+/**
+ * @brief gets a pointer to the data of a string or binary data node
+ * @param image: opened doc image
+ * @param node: string or bindata node
+ * @return pointer inside the mapping, strings are null terminated, NULL if node is not a string or bindata
+ */
+const void *doc_image_node_data(doc_image *image, doc_image_node *node);
+
+/**
+ * @brief returns the size of a node, with the same semantic of doc_get_size()
+ * @param image: opened doc image
+ * @param name: path to the member
+ * @return quantity of members, length of the data or size of the type, 0 if not found
+ */
+uint64_t doc_image_get_size(doc_image *image, char *name);
+
+/**
+ * @brief materializes a node of the image into a regular doc data structure, so it can be
+ * modified or stringified. Strings and binary data will be of the const types, pointing inside
+ * the mapping, so the image must not be closed while the returned doc is in use
+ * @param image: opened doc image
+ * @param name: path to the member
+ * @return newly allocated doc data structure, NULL if not found
+ */
+doc *doc_image_to_doc(doc_image *image, char *name);
+
+/* ----------------------------------------- Macros ----------------------------------------- */
+
+/**
+ * @brief gets the actual value from a numeric or bool node, as a C type
+ * @param image: opened doc image
+ * @param name: path to the member
+ * @param type: type of the data, C keyword types
+ * @return the actual value
+ */
+#define doc_image_get(image, name, type) (*(type*)(&(__doc_image_check_node(doc_image_get_ptr(image, name))->bits)))
+
+/**
+ * @brief gets the string from a string node, pointing inside the mapping
+ * @param image: opened doc image
+ * @param name: path to the member
+ */
+#define doc_image_get_string(image, name) ((const char*)doc_image_node_data(image, doc_image_get_ptr(image, name)))
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -2,192 +2,226 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "doc_ini.h"
 #include "parse_utils.h"
 #include "base64.h"
 
-/* ----------------------------------------- Private Functions ------------------------------ */
+/* ----------------------------------------- Parser ----------------------------------------- */
 
-// parse a section tag
-static doc *parse_section(char **stream){
-    if(*stream == NULL) return NULL;
-
-    (*stream)++;
-    char *name = *stream;
+// checks for a whitespace char other than the line break, like run_space()
+static bool is_space(char chr){
+    return (chr >= '\b' && chr <= '\r' && chr != '\n') || chr == ' ';
+}
 
-    *stream = strpbrk(*stream, "]");
-    **stream = '\0';
-    (*stream)++;
+// allocate a node with a copy of the first len chars of name
+static doc *new_node(doc_type_t type, size_t size, const char *name, size_t len){
+    doc *variable = calloc(1, size);
 
-    doc *section = doc_new(name, dt_obj, ";");
+    variable->type = type;
+    variable->name = malloc(len + 1);
+    memcpy(variable->name, name, len);
+    variable->name[len] = '\0';
 
-    return section;
+    return variable;
 }
 
-// parse a variable
-static doc *parse_variable(char **stream){
-    if(*stream == NULL) return NULL;
-    
-    doc *variable;
-    char *lstring;
+// link a member at the end of a obj, tail is the last member
+static void link_member(doc *parent, doc **tail, doc *member){
+    member->parent = parent;
 
-    run_whitespace(stream);
-    char *name = *stream;
+    if(*tail == NULL){
+        parent->child = member;
+    }
+    else{
+        (*tail)->next = member;
+        member->prev = *tail;
+    }
 
-    if(**stream == '{'){                                                            // anonymous variable
-        (*stream)++;
+    *tail = member;
+    parent->childs++;
+}
 
-        lstring = *stream;
+// string value with a copy of len chars, len of the node counts the null terminator like create_doc_from_string()
+static doc *new_string(const char *name, size_t name_len, const char *string, size_t len){
+    doc *variable = new_node(dt_string, sizeof(doc_string), name, name_len);
 
-        *stream = strpbrk(*stream, "}");
-        
-        char hold = **stream;
-        **stream = '\0';
+    ((doc_string*)variable)->string = malloc(len + 1);
+    memcpy(((doc_string*)variable)->string, string, len);
+    ((doc_string*)variable)->string[len] = '\0';
+    ((doc_string*)variable)->len = len + 1;
 
-        variable = create_doc_from_string("", lstring);
+    return variable;
+}
 
-        **stream = hold;
-        *stream = strpbrk(*stream, "}");
-        (*stream)++;
-    }
-    else{                                                                           // normal variable
-        *stream = strpbrk(*stream, "=\n");
+// value typed like create_doc_from_string(), value is null terminated after len chars
+static doc *new_value(const char *name, size_t name_len, const char *value, size_t len){
+    doc *variable;
 
-        if(**stream == '='){                                                        // defined value
-            size_t len;
+    switch(check_value_type_len(value, len)){
+        case decimal_dt_type_parse_utils:
+            variable = new_node(decimal_dt_type_parse_utils, sizeof(decimal_doc_type_parse_utils), name, name_len);
+            ((decimal_doc_type_parse_utils*)variable)->value = strto_rational_parse_utils(value, NULL);
+        break;
 
-            char *name_end = *stream;
-            name_end--;
-            run_whitespace_back(&name_end);
-            name_end++;
-            *name_end = '\0';
+        case integer_dt_type_parse_utils:
+            variable = new_node(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils), name, name_len);
+            ((integer_doc_type_parse_utils*)variable)->value = strto_integer_parse_utils(value, NULL);
+        break;
 
-            (*stream)++;
-            run_space(stream);
+        case dt_bool:
+            variable = new_node(dt_bool, sizeof(doc_bool), name, name_len);
+            ((doc_bool*)variable)->value = (*value == 't');
+        break;
 
-            if(**stream == '\"'){                                                   // string literal
-                (*stream)++;
-                lstring = *stream;
+        default:
+            variable = new_string(name, name_len, value, len);
+        break;
+    }
 
-                // run trought the stream verifing the '\"' token and the ending '"' token 
-                for(*stream = strpbrk(*stream, "\""); *(*stream - 1) == '\\'; *stream = strpbrk(*stream, "\"")); 
+    return variable;
+}
 
-                **stream = '\0';
-                len = *stream - lstring + 1;
-                (*stream)++;
-                *stream = strpbrk(*stream, "\n");
-                (*stream)++;
+// position after the line break of the line at cursor, or the end of the stream
+static char *next_line(char *cursor){
+    char *line_break = strchr(cursor, '\n');
+    return (line_break != NULL) ? line_break + 1 : cursor + strlen(cursor);
+}
 
-                variable = doc_new(name, dt_string, lstring, len);
-            }
-            else if(**stream == '\n'){                                              // empty value after '='
-                variable = doc_new(name, dt_null);
-                (*stream)++;
-            }
-            else{                                                                   // normal value
-                lstring = *stream;
+// checks if a '\' is a line break sequence, only followed by whitespace up to the line break
+static char *line_continuation(char *cursor){
+    for(cursor++; is_space(*cursor); cursor++);
 
-                for(*stream = strpbrk(*stream, "\\\n;#"); *stream != NULL && **stream != '\n'; *stream = strpbrk(*stream, "\\\n;#")){
+    return (*cursor == '\n') ? cursor + 1 : NULL;
+}
 
-                    if(**stream == ';' || **stream == '#'){                         // jump over inline comments
-                        run_whitespace_back(stream);
+// parse a value after the '=' up to the line break or a inline comment. Line break sequences are joined in place,
+// moving the chars back over them as the value is read, and the value is null terminated
+static char *parse_value(char **stream, size_t *len){
+    char *value = *stream;
+    char *out = value;
+    char *cursor = value;
 
-                        **stream = '\0';
-                        (*stream)++;
-                        *stream = strpbrk(*stream, "\n");
-                        break;
-                    }
+    while(*cursor != '\0' && *cursor != '\n' && *cursor != '#' && *cursor != ';'){
+        char *continuation;
 
-                    *stream = strpbrk(*stream, "\n");
-                    
-                    (*stream)++;
-                }
+        if(*cursor == '\\' && (continuation = line_continuation(cursor)) != NULL){
+            cursor = continuation;
+            continue;
+        }
 
-                run_whitespace_back(stream);
-                (*stream)++;
-                **stream = '\0';
+        *out++ = *cursor++;
+    }
 
-                len = *stream - lstring + 1;
-                (*stream)++;    
+    while(out > value && is_space(out[-1]))                                         // trailing whitespace
+        out--;
 
-                char *buffer_value = strbreak_clear(lstring);
+    *stream = (*cursor == '\0') ? cursor : next_line(cursor);                       // past the line and its comment
+    *out = '\0';
+    *len = out - value;
 
-                variable = create_doc_from_string(name, buffer_value);
+    return value;
+}
 
-                free(buffer_value);
-            }
+// parse a variable, stream is at its first char and is left at the next line
+static doc *parse_variable(char **stream){
+    char *name = *stream;
+    char *name_end = name + strcspn(name, "=\n");
+    char *cursor = name_end;
+    size_t len;
 
-        }
-        else{                                                                           // empty value
-            run_whitespace_back(stream);
-            (*stream)++;
-            **stream = '\0';
-            (*stream)++;
-            run_whitespace(stream);
-            variable = doc_new(name, dt_null);
-        }
+    while(name_end > name && is_space(name_end[-1]))
+        name_end--;
+
+    size_t name_len = name_end - name;
+
+    if(*cursor != '='){                                                             // empty variable without '='
+        *stream = cursor;
+        return new_node(dt_null, sizeof(doc), name, name_len);
     }
 
-    return variable;
-}
+    for(cursor++; is_space(*cursor); cursor++);
 
-// try and parse a section, variable or anonymous var, and ignore comments
-static doc *parse_token(char **stream){
-    if(*stream == NULL) return NULL;
+    if(*cursor == '\"'){                                                            // string literal, '\"' is kept inside it
+        char *literal = ++cursor;
 
-    run_whitespace(stream);
+        while(*cursor != '\0' && (*cursor != '\"' || cursor[-1] == '\\'))
+            cursor++;
 
-    while(**stream == '#' || **stream == ';'){
-        *stream = strpbrk(*stream, "\n");
-        (*stream)++;
-        run_whitespace(stream);
-    }
+        len = cursor - literal;
+        *stream = (*cursor == '\0') ? cursor : next_line(cursor);
 
-    // if( **stream == '#' || **stream == ';'){                                        // comments
-    //     *stream = strpbrk(*stream, "\n");
-    //     (*stream)++;
-    //     run_whitespace(stream);
-    // }
+        return new_string(name, name_len, literal, len);
+    }
 
-    if( (*stream)[0] == '\0' || (*stream)[1] == '\0') return NULL;
+    *stream = cursor;
+    char *value = parse_value(stream, &len);
 
-    switch(**stream){
-        case '[':                                                                   // section
-            return parse_section(stream);
-        break;        
+    if(len == 0)                                                                    // empty value after '='
+        return new_node(dt_null, sizeof(doc), name, name_len);
 
-        case '{':                                                                   // anonymous variables
-        default:                                                                    // variables
-            return parse_variable(stream);
-        break;
-    }
+    return new_value(name, name_len, value, len);
 }
 
-// parse a ini file
-static doc *parse_ini(char **stream){
-    if(*stream == NULL) return NULL;
-
+// parse a ini stream in place, in one pass where every token is read once. The stream is modified
+static doc *parse_ini(char *stream){
     doc *ini = doc_new("ini", dt_obj, ";");
-    doc *current_section = NULL;
-
-    for(doc *token = parse_token(stream); token != NULL; token = parse_token(stream)){
-        if(token->type == dt_obj){                                                  // a section
-            doc_append(ini, ".", token);
-            current_section = token;
+    doc *section = ini;
+    doc *ini_tail = NULL;
+    doc *section_tail = NULL;
+    doc **tail = &ini_tail;
+    char *cursor = stream;
+
+    while(1){
+        run_whitespace(&cursor);
+
+        char *end;
+        char hold;
+        doc *variable;
+
+        switch(*cursor){
+            case '\0':
+                return ini;
+
+            case '#':                                                               // comments
+            case ';':
+                cursor = next_line(cursor);
+            continue;
+
+            case '[':                                                               // section
+                cursor++;
+                end = cursor + strcspn(cursor, "]\n");
+
+                section = new_node(dt_obj, sizeof(doc), cursor, end - cursor);
+                link_member(ini, &ini_tail, section);
+                section_tail = NULL;
+                tail = &section_tail;
+
+                cursor = (*end == ']') ? end + 1 : end;
+            continue;
+
+            case '{':                                                               // anonymous variables
+                cursor++;
+                end = cursor + strcspn(cursor, "}");
+
+                hold = *end;
+                *end = '\0';
+                variable = new_value("", 0, cursor, end - cursor);
+
+                cursor = (hold == '}') ? end + 1 : end;
+            break;
+
+            default:                                                                // variables
+                variable = parse_variable(&cursor);
+            break;
         }
-        else{
-            if(current_section == NULL){                                            // no specified section yet
-                doc_append(ini, ".", token);
-            }
-            else{                                                                   // inside a section
-                doc_append(current_section, ".", token);
-            }
-        }
-    }
 
-    return ini;
+        link_member(section, tail, variable);
+    }
 }
 
+/* ----------------------------------------- Stringifier ------------------------------------ */
+
 // print to output stream, reallocating it accordingly
 static void printf_stringify(char **string_start_address, size_t *length, size_t buffer_size, char *format, ...){
     va_list args;
@@ -350,15 +384,16 @@ static char *stringify(doc *variable, char **stream, size_t *length){
 
 /* ----------------------------------------- Functions -------------------------------------- */
 
-// opens and parse a ini file to a doc structure
+// opens and parse a ini file to a doc structure, the file stream is parsed in place
 doc *doc_ini_open(char *filename){
     if(filename == NULL){
         return NULL;
     }
 
     char *stream = fstream(filename);
+    if(stream == NULL) return NULL;
 
-    doc *ini = doc_ini_parse(stream);
+    doc *ini = parse_ini(stream);
 
     free(stream);
 
@@ -371,9 +406,7 @@ void doc_ini_save(doc *ini_doc, char *filename){
 
     if(ini == NULL) return;
 
-    FILE *out = fopen(filename, "w+");
-    fprintf(out, ini);
-    fclose(out);
+    fsave(filename, ini, strlen(ini));
     free(ini);
 }
 
@@ -382,15 +415,12 @@ doc *doc_ini_parse(char *ini_file_stream){
     if(ini_file_stream == NULL) return NULL;
 
     size_t stream_size = strlen(ini_file_stream);
-    char *stream = (char*)calloc(stream_size + 2, sizeof(char));                    // make a copy before passing to parsers(destructive)
-    char *base_stream = stream;
-    memcpy(stream, ini_file_stream, stream_size);
-    stream[stream_size] = '\n';
-    stream[stream_size + 1] = '\0';
+    char *stream = malloc(stream_size + 1);                                         // values are joined and terminated in place, so a copy is parsed
+    memcpy(stream, ini_file_stream, stream_size + 1);
 
-    doc *doc_ini = parse_ini(&stream);
+    doc *doc_ini = parse_ini(stream);
 
-    free(base_stream);
+    free(stream);
     return doc_ini;
 }
 
@@ -29,8 +29,9 @@ void doc_ini_save(doc *ini_doc, char *filename);
  * simple variables, empty variables like: 'var=' and 'var ' without the '=' sign, anonymous variables, 
  * ex: '{anonymous_variable}', have to be surrounded by curly brackets and will have a "" empty name string,
  * 'doc_get()' and 'doc_get_ptr()' with a syntax like: 'anonymous_variables[1]' must be used, getting the value by index.
- * Comments use the '#' or ';' characters.     
- * Variables must terminate with a line break
+ * Comments use the '#' or ';' characters, at the start of a line or after a value. A '\' followed only by
+ * whitespace joins the value with the next line, other '\' are kept as they are.
+ * Variables must terminate with a line break. The file is read in one pass over a copy of the stream.
  * @param ini_file_stream: a string of ASCII chars in memory
  * @return the doc data structure representing the file 
  */
@@ -500,6 +500,7 @@ doc *doc_json_open(char *filename){
     }
 
     char *stream = fstream(filename);
+    if(stream == NULL) return NULL;
 
     doc *json = doc_json_parse(stream);
 
@@ -514,9 +515,7 @@ void doc_json_save(doc *json_doc, char *filename){
 
     if(json == NULL) return;
 
-    FILE *out = fopen(filename, "w+");
-    fprintf(out, json);
-    fclose(out);
+    fsave(filename, json, strlen(json));
     free(json);
 }
 
@@ -0,0 +1,401 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "doc_lz.h"
+#include "parse_utils.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define LZ_MIN_MATCH                (4)                                             // matches shorter than this are literals
+#define LZ_LAST_LITERALS            (5)                                             // the last bytes of a block are always literals
+#define LZ_MATCH_LIMIT              (12)                                            // no match starts this close to the end
+#define LZ_MAX_OFFSET               (65535)                                         // window size
+#define LZ_HASH_LOG                 (13)                                            // hash table of 8K positions
+#define LZ_SKIP_TRIGGER             (6)                                             // speeds up the search over incompressible data
+
+#define LZ_FRAME_HEADER_SIZE        (8)                                             // magic and block size
+#define LZ_BLOCK_HEADER_SIZE        (8)                                             // compressed length and raw length
+#define LZ_BLOCK_STORED             (0x80000000u)                                   // flag on the compressed length of stored blocks
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// streaming frame writer
+struct doc_lz_writer{
+    doc_lz_write_function_t write_function;
+    void *context;
+    uint8_t *block;                                                                 // uncompressed data of the current block
+    size_t len;
+    size_t size;
+    uint8_t *out;                                                                   // block header and compressed data
+};
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+static inline uint32_t read32(const uint8_t *data){
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash32(uint32_t sequence){
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+static inline void write_le32(uint8_t *data, uint32_t value){
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+}
+
+static inline uint32_t read_le32(const uint8_t *data){
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// write the extension of a length that did not fit on the token
+static uint8_t *write_length(uint8_t *op, size_t len){
+    while(len >= 255){
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// read the extension of a length
+static bool read_length(const uint8_t **ip, const uint8_t *iend, size_t *len){
+    uint8_t byte;
+
+    do{
+        if(*ip >= iend || *len > SIZE_MAX / 2) return false;
+
+        byte = *(*ip)++;
+        *len += byte;
+    }while(byte == 255);
+
+    return true;
+}
+
+// write a sequence of literals followed by a match, match_len 0 for the last sequence. Returns NULL if it does not fit
+static uint8_t *write_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literals, size_t lit_len, size_t offset, size_t match_len){
+    size_t needed = 1 + lit_len + lit_len / 255 + 1;
+    if(match_len != 0) needed += 2 + match_len / 255 + 1;
+
+    if((size_t)(oend - op) < needed) return NULL;
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+
+    if(lit_len >= 15) op = write_length(op, lit_len - 15);
+
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if(match_len == 0) return op;
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+
+    match_len -= LZ_MIN_MATCH;
+    *token |= (uint8_t)(match_len >= 15 ? 15 : match_len);
+
+    if(match_len >= 15) op = write_length(op, match_len - 15);
+
+    return op;
+}
+
+// compress the current block of a writer and send it, incompressible blocks are stored
+static void write_block(doc_lz_writer *writer){
+    if(writer->len == 0) return;
+
+    size_t len = doc_lz_compress(writer->block, writer->len, writer->out + LZ_BLOCK_HEADER_SIZE, writer->len - 1);
+
+    write_le32(writer->out + 4, (uint32_t)writer->len);
+
+    if(len == 0){
+        write_le32(writer->out, (uint32_t)writer->len | LZ_BLOCK_STORED);
+        writer->write_function(writer->context, writer->out, LZ_BLOCK_HEADER_SIZE);
+        writer->write_function(writer->context, writer->block, writer->len);
+    }
+    else{
+        write_le32(writer->out, (uint32_t)len);
+        writer->write_function(writer->context, writer->out, LZ_BLOCK_HEADER_SIZE + len);
+    }
+
+    writer->len = 0;
+}
+
+// write function for writers whose context is a wbuffer_t
+static void write_wbuffer(void *context, const void *data, size_t len){
+    wbuffer_write((wbuffer_t*)context, data, len);
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// worst case size of a compressed block
+size_t doc_lz_compress_bound(size_t len){
+    return len + len / 255 + 16;
+}
+
+// compresses a single block
+size_t doc_lz_compress(const void *src, size_t len, void *dst, size_t capacity){
+    const uint8_t *in = (const uint8_t*)src;
+    const uint8_t *ip = in;
+    const uint8_t *anchor = in;
+    const uint8_t *iend = in + len;
+    uint8_t *op = (uint8_t*)dst;
+    uint8_t *oend = op + capacity;
+
+    if(len > LZ_MATCH_LIMIT){
+        const uint8_t *mflimit = iend - LZ_MATCH_LIMIT;
+        const uint8_t *matchlimit = iend - LZ_LAST_LITERALS;
+        uint32_t table[1 << LZ_HASH_LOG];
+
+        memset(table, 0, sizeof(table));                                            // empty slots point to the start, checked like any other
+
+        for(ip++; ip < mflimit;){
+            uint32_t sequence = read32(ip);
+            uint32_t hash = hash32(sequence);
+            const uint8_t *ref = in + table[hash];
+
+            table[hash] = (uint32_t)(ip - in);
+
+            if(ip - ref > LZ_MAX_OFFSET || read32(ref) != sequence){
+                ip += 1 + ((ip - anchor) >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+
+            while(ip > anchor && ref > in && ip[-1] == ref[-1]){                    // extend backwards
+                ip--;
+                ref--;
+            }
+
+            const uint8_t *match_end = ip + LZ_MIN_MATCH;
+            const uint8_t *ref_end = ref + LZ_MIN_MATCH;
+
+            while(match_end < matchlimit && *match_end == *ref_end){
+                match_end++;
+                ref_end++;
+            }
+
+            op = write_sequence(op, oend, anchor, ip - anchor, ip - ref, match_end - ip);
+            if(op == NULL) return 0;
+
+            ip = match_end;
+            anchor = ip;
+
+            if(ip < mflimit)
+                table[hash32(read32(ip - 2))] = (uint32_t)(ip - 2 - in);
+        }
+    }
+
+    op = write_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    if(op == NULL) return 0;
+
+    return op - (uint8_t*)dst;
+}
+
+// decompresses a single block
+bool doc_lz_decompress(const void *src, size_t len, void *dst, size_t raw_len){
+    const uint8_t *ip = (const uint8_t*)src;
+    const uint8_t *iend = ip + len;
+    uint8_t *ostart = (uint8_t*)dst;
+    uint8_t *op = ostart;
+    uint8_t *oend = op + raw_len;
+
+    while(ip < iend){
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if(lit_len == 15 && !read_length(&ip, iend, &lit_len)) return false;
+
+        if((size_t)(iend - ip) < lit_len || (size_t)(oend - op) < lit_len) return false;
+
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        if(ip == iend) break;                                                       // the last sequence has no match
+
+        if(iend - ip < 2) return false;
+
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        if(offset == 0 || offset > (size_t)(op - ostart)) return false;
+
+        size_t match_len = token & 0x0F;
+        if(match_len == 15 && !read_length(&ip, iend, &match_len)) return false;
+        match_len += LZ_MIN_MATCH;
+
+        if((size_t)(oend - op) < match_len) return false;
+
+        const uint8_t *match = op - offset;
+
+        if(offset >= match_len){
+            memcpy(op, match, match_len);
+        }
+        else{                                                                       // overlapping copy repeats the pattern
+            for(size_t i = 0; i < match_len; i++)
+                op[i] = match[i];
+        }
+
+        op += match_len;
+    }
+
+    return op == oend;
+}
+
+// checks if the data starts with a frame header
+bool doc_lz_is_frame(const void *data, size_t len){
+    return data != NULL && len >= LZ_FRAME_HEADER_SIZE && memcmp(data, DOC_LZ_MAGIC, 4) == 0;
+}
+
+// compresses data into a whole frame
+uint8_t *doc_lz_frame_compress(const void *data, size_t len, size_t *frame_len){
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, doc_lz_compress_bound(len) + 64, NULL, NULL);
+
+    doc_lz_writer *writer = doc_lz_writer_new(write_wbuffer, &buffer, 0);
+    doc_lz_write(writer, data, len);
+    doc_lz_writer_close(writer);
+
+    return (uint8_t*)wbuffer_release(&buffer, frame_len);
+}
+
+// decompresses a whole frame
+uint8_t *doc_lz_frame_decompress(const void *frame, size_t len, size_t *raw_len){
+    if(!doc_lz_is_frame(frame, len)) return NULL;
+
+    const uint8_t *end = (const uint8_t*)frame + len;
+    const uint8_t *cursor = (const uint8_t*)frame;
+    doc_lz_block block;
+    size_t total = 0;
+
+    while(doc_lz_frame_next(&cursor, end, &block)){                                 // sizes first, the blocks are independent
+        if(total > SIZE_MAX - block.raw_len - 1) return NULL;
+        total += block.raw_len;
+    }
+
+    if(end - cursor < 4 || read_le32(cursor) != 0) return NULL;                     // stopped before the end mark
+
+    uint8_t *data = malloc(total + 1);
+    uint8_t *out = data;
+
+    cursor = (const uint8_t*)frame;
+    while(doc_lz_frame_next(&cursor, end, &block)){
+        if(!doc_lz_block_decompress(&block, out)){
+            free(data);
+            return NULL;
+        }
+
+        out += block.raw_len;
+    }
+
+    data[total] = '\0';
+    if(raw_len != NULL) *raw_len = total;
+
+    return data;
+}
+
+// walks the blocks of a frame
+bool doc_lz_frame_next(const uint8_t **cursor, const uint8_t *end, doc_lz_block *block){
+    const uint8_t *ip = *cursor;
+
+    if(doc_lz_is_frame(ip, end - ip)) ip += LZ_FRAME_HEADER_SIZE;
+
+    if(end - ip < 4) return false;
+
+    uint32_t header = read_le32(ip);
+    if(header == 0){                                                                // end mark
+        *cursor = ip;
+        return false;
+    }
+
+    if(end - ip < LZ_BLOCK_HEADER_SIZE) return false;
+
+    uint32_t len = header & ~LZ_BLOCK_STORED;
+    uint32_t raw_len = read_le32(ip + 4);
+    bool stored = (header & LZ_BLOCK_STORED) != 0;
+
+    if( raw_len > DOC_LZ_MAX_BLOCK_SIZE || len > (size_t)(end - ip - LZ_BLOCK_HEADER_SIZE) ||
+        (stored && len != raw_len)
+    ) return false;
+
+    block->data = ip + LZ_BLOCK_HEADER_SIZE;
+    block->len = len;
+    block->raw_len = raw_len;
+    block->stored = stored;
+
+    *cursor = block->data + len;
+
+    return true;
+}
+
+// decompresses a block found by doc_lz_frame_next()
+bool doc_lz_block_decompress(const doc_lz_block *block, void *dst){
+    if(block->stored){
+        memcpy(dst, block->data, block->raw_len);
+        return true;
+    }
+
+    return doc_lz_decompress(block->data, block->len, dst, block->raw_len);
+}
+
+// new streaming frame writer
+doc_lz_writer *doc_lz_writer_new(doc_lz_write_function_t write_function, void *context, size_t block_size){
+    if(write_function == NULL) return NULL;
+
+    if(block_size == 0) block_size = DOC_LZ_BLOCK_SIZE;
+    if(block_size > DOC_LZ_MAX_BLOCK_SIZE) block_size = DOC_LZ_MAX_BLOCK_SIZE;
+
+    doc_lz_writer *writer = malloc(sizeof(*writer));
+    writer->write_function = write_function;
+    writer->context = context;
+    writer->block = malloc(block_size);
+    writer->len = 0;
+    writer->size = block_size;
+    writer->out = malloc(LZ_BLOCK_HEADER_SIZE + block_size);                        // compressed blocks are always smaller than raw ones
+
+    uint8_t header[LZ_FRAME_HEADER_SIZE];
+    memcpy(header, DOC_LZ_MAGIC, 4);
+    write_le32(header + 4, (uint32_t)block_size);
+    write_function(context, header, sizeof(header));
+
+    return writer;
+}
+
+// writes data to a frame
+void doc_lz_write(void *writer, const void *data, size_t len){
+    doc_lz_writer *lz = (doc_lz_writer*)writer;
+    const uint8_t *input = (const uint8_t*)data;
+
+    while(len > 0){
+        size_t chunk = lz->size - lz->len;
+        if(chunk > len) chunk = len;
+
+        memcpy(lz->block + lz->len, input, chunk);
+        lz->len += chunk;
+        input += chunk;
+        len -= chunk;
+
+        if(lz->len == lz->size) write_block(lz);
+    }
+}
+
+// ends the frame and frees the writer
+void doc_lz_writer_close(doc_lz_writer *writer){
+    if(writer == NULL) return;
+
+    write_block(writer);
+
+    uint8_t end_mark[4] = {0};
+    writer->write_function(writer->context, end_mark, sizeof(end_mark));
+
+    free(writer->block);
+    free(writer->out);
+    free(writer);
+}
@@ -0,0 +1,139 @@
+#ifndef _DOC_LZ_HEADER_
+#define _DOC_LZ_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_LZ_EXTENSION            ".dlz"                                          // files saved with this extension are compressed
+#define DOC_LZ_MAGIC                "DLZ1"                                          // first bytes of a frame
+#define DOC_LZ_BLOCK_SIZE           (64 * 1024)                                     // default uncompressed size of the blocks of a frame
+#define DOC_LZ_MAX_BLOCK_SIZE       (4 * 1024 * 1024)                               // maximum uncompressed size of a block
+
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief a block of a frame, as found by doc_lz_frame_next(). Blocks are independent,
+ * so they can be decompressed in any order or in parallel
+ */
+typedef struct{
+    const uint8_t *data;                                                            /**< block payload, inside the frame */
+    uint32_t len;                                                                   /**< length of the payload */
+    uint32_t raw_len;                                                               /**< length of the block once decompressed */
+    bool stored;                                                                    /**< the payload is stored uncompressed */
+}doc_lz_block;
+
+/**
+ * @brief opaque type for a streaming frame writer
+ */
+typedef struct doc_lz_writer doc_lz_writer;
+
+/**
+ * @brief type for a function that receives the output of a frame writer
+ */
+typedef void (*doc_lz_write_function_t)(void *context, const void *data, size_t len);
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+/**
+ * @brief worst case size of a compressed block
+ * @param len: uncompressed length
+ * @return the capacity needed by doc_lz_compress() to never fail
+ */
+size_t doc_lz_compress_bound(size_t len);
+
+/**
+ * @brief compresses a single block, LZ4 style: sequences of literals and matches with a 64KiB window
+ * @param src: data to compress
+ * @param len: length of the data
+ * @param dst: output
+ * @param capacity: size of the output
+ * @return the compressed length, 0 if it does not fit in capacity
+ */
+size_t doc_lz_compress(const void *src, size_t len, void *dst, size_t capacity);
+
+/**
+ * @brief decompresses a single block
+ * @param src: compressed block
+ * @param len: length of the compressed block
+ * @param dst: output, with room for raw_len bytes
+ * @param raw_len: exact uncompressed length of the block
+ * @return false if the block is malformed or does not decompress to raw_len bytes
+ */
+bool doc_lz_decompress(const void *src, size_t len, void *dst, size_t raw_len);
+
+/**
+ * @brief checks if the data starts with a frame header
+ */
+bool doc_lz_is_frame(const void *data, size_t len);
+
+/**
+ * @brief compresses data into a whole frame
+ * @param data: data to compress
+ * @param len: length of the data
+ * @param frame_len: pointer where the length of the frame will be written
+ * @return the frame, must be freed by the caller
+ */
+uint8_t *doc_lz_frame_compress(const void *data, size_t len, size_t *frame_len);
+
+/**
+ * @brief decompresses a whole frame
+ * @param frame: the frame
+ * @param len: length of the frame
+ * @param raw_len: pointer where the decompressed length will be written, can be NULL
+ * @return the decompressed data, null terminated, must be freed by the caller. NULL if the frame is malformed
+ */
+uint8_t *doc_lz_frame_decompress(const void *frame, size_t len, size_t *raw_len);
+
+/**
+ * @brief walks the blocks of a frame without decompressing them
+ * @note start with *cursor pointing to the frame, the header is skipped on the first call
+ * @param cursor: position inside the frame, advanced past the block
+ * @param end: end of the frame
+ * @param block: where the block will be written
+ * @return false at the end of the frame or if it is malformed
+ */
+bool doc_lz_frame_next(const uint8_t **cursor, const uint8_t *end, doc_lz_block *block);
+
+/**
+ * @brief decompresses a block found by doc_lz_frame_next()
+ * @param block: the block
+ * @param dst: output, with room for block->raw_len bytes
+ * @return false if the block is malformed
+ */
+bool doc_lz_block_decompress(const doc_lz_block *block, void *dst);
+
+/**
+ * @brief creates a streaming frame writer, the frame header is written right away
+ * @param write_function: function that receives the frame
+ * @param context: opaque pointer passed to write_function
+ * @param block_size: uncompressed size of each block, 0 for DOC_LZ_BLOCK_SIZE
+ * @return a new writer, close it with doc_lz_writer_close()
+ */
+doc_lz_writer *doc_lz_writer_new(doc_lz_write_function_t write_function, void *context, size_t block_size);
+
+/**
+ * @brief writes data to a frame, blocks are compressed and sent as they fill up
+ * @note the signature matches doc_lz_write_function_t, so a writer can be the sink of another writer
+ * @param writer: a doc_lz_writer
+ * @param data: data to write
+ * @param len: length of the data
+ */
+void doc_lz_write(void *writer, const void *data, size_t len);
+
+/**
+ * @brief compresses the last block, ends the frame and frees the writer
+ * @param writer: the writer
+ */
+void doc_lz_writer_close(doc_lz_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
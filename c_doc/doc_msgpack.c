@@ -0,0 +1,538 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "doc_msgpack.h"
+#include "parse_utils.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define MSGPACK_WRITER_BUFFER_SIZE  (64 * 1024)                                     // chunk size passed to the write functions
+#define MSGPACK_MAX_DEPTH           (1024)                                          // maximum nesting accepted by the parser
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// streaming writer
+struct doc_msgpack_writer{
+    wbuffer_t buffer;
+    fsink_t *sink;                                                                  // only set when opened by doc_msgpack_writer_open()
+};
+
+// parser cursor
+typedef struct{
+    uint8_t *cursor;
+    uint8_t *end;
+}msgpack_reader_t;
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+// write a prefix byte followed by a big endian value of 'bytes' length
+static void write_prefixed(doc_msgpack_writer *writer, uint8_t prefix, uint64_t value, size_t bytes){
+    uint8_t data[9];
+
+    data[0] = prefix;
+    for(size_t i = 0; i < bytes; i++)
+        data[bytes - i] = (uint8_t)(value >> (8 * i));
+
+    wbuffer_write(&writer->buffer, data, bytes + 1);
+}
+
+// write a header of the str, bin, array and map families, picking the smallest one
+static void write_header(doc_msgpack_writer *writer, uint8_t fix_prefix, uint64_t fix_max, uint8_t prefix8, uint8_t prefix16, uint8_t prefix32, uint64_t size){
+    if(size <= fix_max)
+        wbuffer_putc(&writer->buffer, (char)(fix_prefix | size));
+    else if(prefix8 != 0 && size <= UINT8_MAX)
+        write_prefixed(writer, prefix8, size, 1);
+    else if(size <= UINT16_MAX)
+        write_prefixed(writer, prefix16, size, 2);
+    else
+        write_prefixed(writer, prefix32, size, 4);
+}
+
+// check if there are at least len bytes left
+static bool reader_has(msgpack_reader_t *reader, size_t len){
+    return (size_t)(reader->end - reader->cursor) >= len;
+}
+
+// read a big endian unsigned value of 'bytes' length
+static uint64_t read_be(msgpack_reader_t *reader, size_t bytes){
+    uint64_t value = 0;
+
+    for(size_t i = 0; i < bytes; i++)
+        value = (value << 8) | reader->cursor[i];
+
+    reader->cursor += bytes;
+    return value;
+}
+
+// allocate a value doc
+static doc *new_value(doc_type_t type, size_t size){
+    doc *variable = calloc(1, size);
+    variable->type = type;
+    return variable;
+}
+
+// create a integer doc, uint64 only when the value doesn't fit a int64
+static doc *new_integer(uint64_t bits, bool is_signed){
+    if(!is_signed && bits > INT64_MAX){
+        doc *variable = new_value(dt_uint64, sizeof(doc_uint64_t));
+        ((doc_uint64_t*)variable)->value = bits;
+        return variable;
+    }
+
+    doc *variable = new_value(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils));
+    ((integer_doc_type_parse_utils*)variable)->value = (integer_type_parse_utils)(int64_t)bits;
+    return variable;
+}
+
+// read the length of a str, bin, array or map, returns false if the type byte is not of the family
+static bool read_length(msgpack_reader_t *reader, uint8_t type, uint8_t prefix8, uint8_t prefix16, uint8_t prefix32, uint64_t *len){
+    size_t bytes;
+
+    if(prefix8 != 0 && type == prefix8)    bytes = 1;
+    else if(type == prefix16)              bytes = 2;
+    else if(type == prefix32)              bytes = 4;
+    else                                   return false;
+
+    if(!reader_has(reader, bytes)) return false;
+
+    *len = read_be(reader, bytes);
+    return true;
+}
+
+static doc *parse_value(msgpack_reader_t *reader, size_t depth);
+
+// read a map key as a allocated name
+static char *parse_key(msgpack_reader_t *reader){
+    if(!reader_has(reader, 1)) return NULL;
+
+    uint8_t type = *reader->cursor;
+
+    if((type & 0xE0) == 0xA0 || type == 0xD9 || type == 0xDA || type == 0xDB){      // str keys, copied directly
+        uint64_t len;
+        reader->cursor++;
+
+        if((type & 0xE0) == 0xA0)
+            len = type & 0x1F;
+        else if(!read_length(reader, type, 0xD9, 0xDA, 0xDB, &len))
+            return NULL;
+
+        if(!reader_has(reader, len)) return NULL;
+
+        char *name = malloc(len + 1);
+        memcpy(name, reader->cursor, len);
+        name[len] = '\0';
+        reader->cursor += len;
+
+        return name;
+    }
+
+    doc *key = parse_value(reader, MSGPACK_MAX_DEPTH);                              // integer, float, bool and nil keys, turned into text
+    if(key == NULL) return NULL;
+
+    char *name = NULL;
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS + 2, NULL, NULL);
+
+    switch(key->type){
+        case dt_uint64:     wbuffer_write_uint(&buffer, ((doc_uint64_t*)key)->value);                   break;
+        case integer_dt_type_parse_utils:
+                            wbuffer_write_int(&buffer, ((integer_doc_type_parse_utils*)key)->value);    break;
+        case dt_double:     wbuffer_write_double(&buffer, ((doc_double*)key)->value);                   break;
+        case dt_float:      wbuffer_write_double(&buffer, ((doc_float*)key)->value);                    break;
+        case dt_bool:       wbuffer_puts(&buffer, ((doc_bool*)key)->value ? "true" : "false");          break;
+        case dt_null:       wbuffer_puts(&buffer, "null");                                              break;
+
+        default:                                                                    // bin, ext, arrays and maps are not supported as keys
+            wbuffer_free(&buffer);
+            doc_delete(key, ".");
+            return NULL;
+    }
+
+    name = wbuffer_release(&buffer, NULL);
+    doc_delete(key, ".");
+    return name;
+}
+
+// parse a array or map with 'size' members
+static doc *parse_container(msgpack_reader_t *reader, doc_type_t type, uint64_t size, size_t depth){
+    doc *variable = new_value(type, sizeof(doc));
+    doc *last_member = NULL;
+
+    for(uint64_t i = 0; i < size; i++){
+        char *name = NULL;
+
+        if(type == dt_obj){
+            name = parse_key(reader);
+
+            if(name == NULL){
+                doc_delete(variable, ".");
+                return NULL;
+            }
+        }
+
+        doc *member = parse_value(reader, depth + 1);
+
+        if(member == NULL){
+            free(name);
+            doc_delete(variable, ".");
+            return NULL;
+        }
+
+        if(name == NULL){
+            name = malloc(1);
+            *name = '\0';
+        }
+
+        member->name = name;
+        member->parent = variable;
+
+        if(last_member == NULL){
+            variable->child = member;
+        }
+        else{
+            last_member->next = member;
+            member->prev = last_member;
+        }
+
+        last_member = member;
+        variable->childs++;
+    }
+
+    return variable;
+}
+
+// parse a str or bin payload of len bytes
+static doc *parse_data(msgpack_reader_t *reader, doc_type_t type, uint64_t len){
+    if(!reader_has(reader, len)) return NULL;
+
+    uint8_t *data = malloc(len + 1);
+    memcpy(data, reader->cursor, len);
+    data[len] = '\0';
+    reader->cursor += len;
+
+    doc *variable = new_value(type, sizeof(doc_bindata));
+    ((doc_bindata*)variable)->data = data;
+    ((doc_bindata*)variable)->len = len;
+
+    return variable;
+}
+
+// parse any msgpack value, recursive
+static doc *parse_value(msgpack_reader_t *reader, size_t depth){
+    if(depth > MSGPACK_MAX_DEPTH || !reader_has(reader, 1)) return NULL;
+
+    uint8_t type = *(reader->cursor++);
+    uint64_t len;
+    doc *variable;
+
+    if(type <= 0x7F)                                                                // positive fixint
+        return new_integer(type, false);
+    if(type >= 0xE0)                                                                // negative fixint
+        return new_integer((uint64_t)(int64_t)(int8_t)type, true);
+    if((type & 0xF0) == 0x80)                                                       // fixmap
+        return parse_container(reader, dt_obj, type & 0x0F, depth);
+    if((type & 0xF0) == 0x90)                                                       // fixarray
+        return parse_container(reader, dt_array, type & 0x0F, depth);
+    if((type & 0xE0) == 0xA0)                                                       // fixstr
+        return parse_data(reader, dt_string, type & 0x1F);
+
+    switch(type){
+        case 0xC0:                                                                  // nil
+            return new_value(dt_null, sizeof(doc));
+
+        case 0xC2:                                                                  // false
+        case 0xC3:                                                                  // true
+            variable = new_value(dt_bool, sizeof(doc_bool));
+            ((doc_bool*)variable)->value = (type == 0xC3);
+            return variable;
+
+        case 0xC4: case 0xC5: case 0xC6:                                            // bin 8, 16, 32
+            if(!read_length(reader, type, 0xC4, 0xC5, 0xC6, &len)) return NULL;
+            return parse_data(reader, dt_bindata, len);
+
+        case 0xD9: case 0xDA: case 0xDB:                                            // str 8, 16, 32
+            if(!read_length(reader, type, 0xD9, 0xDA, 0xDB, &len)) return NULL;
+            return parse_data(reader, dt_string, len);
+
+        case 0xDC: case 0xDD:                                                       // array 16, 32
+            if(!read_length(reader, type, 0, 0xDC, 0xDD, &len)) return NULL;
+            return parse_container(reader, dt_array, len, depth);
+
+        case 0xDE: case 0xDF:                                                       // map 16, 32
+            if(!read_length(reader, type, 0, 0xDE, 0xDF, &len)) return NULL;
+            return parse_container(reader, dt_obj, len, depth);
+
+        case 0xCA:                                                                  // float 32
+            if(!reader_has(reader, 4)) return NULL;
+            {
+                uint32_t bits = (uint32_t)read_be(reader, 4);
+                variable = new_value(dt_float, sizeof(doc_float));
+                memcpy(&((doc_float*)variable)->value, &bits, sizeof(bits));
+            }
+            return variable;
+
+        case 0xCB:                                                                  // float 64
+            if(!reader_has(reader, 8)) return NULL;
+            {
+                uint64_t bits = read_be(reader, 8);
+                variable = new_value(dt_double, sizeof(doc_double));
+                memcpy(&((doc_double*)variable)->value, &bits, sizeof(bits));
+            }
+            return variable;
+
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF:                                 // uint 8, 16, 32, 64
+            len = (size_t)1 << (type - 0xCC);
+            if(!reader_has(reader, len)) return NULL;
+            return new_integer(read_be(reader, len), false);
+
+        case 0xD0: case 0xD1: case 0xD2: case 0xD3:                                 // int 8, 16, 32, 64
+            len = (size_t)1 << (type - 0xD0);
+            if(!reader_has(reader, len)) return NULL;
+            {
+                uint64_t bits = read_be(reader, len);
+                size_t shift = 64 - 8 * len;
+                return new_integer((uint64_t)(((int64_t)(bits << shift)) >> shift), true);  // sign extend
+            }
+
+        case 0xD4: case 0xD5: case 0xD6: case 0xD7: case 0xD8:                      // fixext 1, 2, 4, 8, 16, the ext type is dropped
+            len = (size_t)1 << (type - 0xD4);
+            if(!reader_has(reader, 1)) return NULL;
+            reader->cursor++;
+            return parse_data(reader, dt_bindata, len);
+
+        case 0xC7: case 0xC8: case 0xC9:                                            // ext 8, 16, 32
+            if(!read_length(reader, type, 0xC7, 0xC8, 0xC9, &len)) return NULL;
+            if(!reader_has(reader, 1)) return NULL;
+            reader->cursor++;
+            return parse_data(reader, dt_bindata, len);
+
+        default:                                                                    // 0xC1 is never used
+            return NULL;
+    }
+}
+
+/* ----------------------------------------- Writer ----------------------------------------- */
+
+// new streaming writer
+doc_msgpack_writer *doc_msgpack_writer_new(doc_msgpack_write_function_t write_function, void *context){
+    doc_msgpack_writer *writer = malloc(sizeof(*writer));
+
+    wbuffer_init(&writer->buffer, MSGPACK_WRITER_BUFFER_SIZE, write_function, context);
+    writer->sink = NULL;
+
+    return writer;
+}
+
+// new streaming writer to a file
+doc_msgpack_writer *doc_msgpack_writer_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    fsink_t *sink = fsink_open(filename);
+    if(sink == NULL) return NULL;
+
+    doc_msgpack_writer *writer = doc_msgpack_writer_new(fsink_write, sink);
+    writer->sink = sink;
+
+    return writer;
+}
+
+// flush and free a writer
+void doc_msgpack_writer_close(doc_msgpack_writer *writer){
+    if(writer == NULL) return;
+
+    wbuffer_flush(&writer->buffer);
+    wbuffer_free(&writer->buffer);
+
+    if(writer->sink != NULL)
+        fsink_close(writer->sink);
+
+    free(writer);
+}
+
+// map header
+void doc_msgpack_write_map(doc_msgpack_writer *writer, uint32_t size){
+    write_header(writer, 0x80, 0x0F, 0, 0xDE, 0xDF, size);
+}
+
+// array header
+void doc_msgpack_write_array(doc_msgpack_writer *writer, uint32_t size){
+    write_header(writer, 0x90, 0x0F, 0, 0xDC, 0xDD, size);
+}
+
+// string
+void doc_msgpack_write_str(doc_msgpack_writer *writer, const char *string, size_t len){
+    write_header(writer, 0xA0, 0x1F, 0xD9, 0xDA, 0xDB, len);
+    wbuffer_write(&writer->buffer, string, len);
+}
+
+// binary data
+void doc_msgpack_write_bin(doc_msgpack_writer *writer, const void *data, size_t len){
+    if(len <= UINT8_MAX)
+        write_prefixed(writer, 0xC4, len, 1);
+    else if(len <= UINT16_MAX)
+        write_prefixed(writer, 0xC5, len, 2);
+    else
+        write_prefixed(writer, 0xC6, len, 4);
+
+    wbuffer_write(&writer->buffer, data, len);
+}
+
+// unsigned integer
+void doc_msgpack_write_uint(doc_msgpack_writer *writer, uint64_t value){
+    if(value <= 0x7F)
+        wbuffer_putc(&writer->buffer, (char)value);
+    else if(value <= UINT8_MAX)
+        write_prefixed(writer, 0xCC, value, 1);
+    else if(value <= UINT16_MAX)
+        write_prefixed(writer, 0xCD, value, 2);
+    else if(value <= UINT32_MAX)
+        write_prefixed(writer, 0xCE, value, 4);
+    else
+        write_prefixed(writer, 0xCF, value, 8);
+}
+
+// signed integer, positive values use the unsigned family as they are tighter
+void doc_msgpack_write_int(doc_msgpack_writer *writer, int64_t value){
+    if(value >= 0)
+        doc_msgpack_write_uint(writer, (uint64_t)value);
+    else if(value >= -32)
+        wbuffer_putc(&writer->buffer, (char)(int8_t)value);
+    else if(value >= INT8_MIN)
+        write_prefixed(writer, 0xD0, (uint64_t)value, 1);
+    else if(value >= INT16_MIN)
+        write_prefixed(writer, 0xD1, (uint64_t)value, 2);
+    else if(value >= INT32_MIN)
+        write_prefixed(writer, 0xD2, (uint64_t)value, 4);
+    else
+        write_prefixed(writer, 0xD3, (uint64_t)value, 8);
+}
+
+// float 32
+void doc_msgpack_write_float(doc_msgpack_writer *writer, float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_prefixed(writer, 0xCA, bits, 4);
+}
+
+// float 64
+void doc_msgpack_write_double(doc_msgpack_writer *writer, double value){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_prefixed(writer, 0xCB, bits, 8);
+}
+
+// bool
+void doc_msgpack_write_bool(doc_msgpack_writer *writer, bool value){
+    wbuffer_putc(&writer->buffer, value ? (char)0xC3 : (char)0xC2);
+}
+
+// nil
+void doc_msgpack_write_nil(doc_msgpack_writer *writer){
+    wbuffer_putc(&writer->buffer, (char)0xC0);
+}
+
+// whole doc structure, recursive
+void doc_msgpack_write_doc(doc_msgpack_writer *writer, doc *variable){
+    if(writer == NULL || variable == NULL) return;
+
+    switch(variable->type){
+        case dt_obj:
+            doc_msgpack_write_map(writer, variable->childs);
+
+            for(doc_loop(member, variable)){
+                doc_msgpack_write_str(writer, member->name, strlen(member->name));
+                doc_msgpack_write_doc(writer, member);
+            }
+        break;
+
+        case dt_array:
+            doc_msgpack_write_array(writer, variable->childs);
+
+            for(doc_loop(member, variable))
+                doc_msgpack_write_doc(writer, member);
+        break;
+
+        case dt_null:       doc_msgpack_write_nil(writer);                                          break;
+        case dt_bool:       doc_msgpack_write_bool(writer, ((doc_bool*)variable)->value);           break;
+        case dt_double:     doc_msgpack_write_double(writer, ((doc_double*)variable)->value);       break;
+        case dt_float:      doc_msgpack_write_float(writer, ((doc_float*)variable)->value);         break;
+        case dt_uint:       doc_msgpack_write_uint(writer, ((doc_uint_t*)variable)->value);         break;
+        case dt_uint64:     doc_msgpack_write_uint(writer, ((doc_uint64_t*)variable)->value);       break;
+        case dt_uint32:     doc_msgpack_write_uint(writer, ((doc_uint32_t*)variable)->value);       break;
+        case dt_uint16:     doc_msgpack_write_uint(writer, ((doc_uint16_t*)variable)->value);       break;
+        case dt_uint8:      doc_msgpack_write_uint(writer, ((doc_uint8_t*)variable)->value);        break;
+        case dt_int:        doc_msgpack_write_int(writer, ((doc_int*)variable)->value);             break;
+        case dt_int64:      doc_msgpack_write_int(writer, ((doc_int64_t*)variable)->value);         break;
+        case dt_int32:      doc_msgpack_write_int(writer, ((doc_int32_t*)variable)->value);         break;
+        case dt_int16:      doc_msgpack_write_int(writer, ((doc_int16_t*)variable)->value);         break;
+        case dt_int8:       doc_msgpack_write_int(writer, ((doc_int8_t*)variable)->value);          break;
+
+        case dt_string:
+        case dt_const_string:                                                       // some strings count the null terminator on len
+            doc_msgpack_write_str(writer, ((doc_string*)variable)->string, strnlen(((doc_string*)variable)->string, ((doc_string*)variable)->len));
+        break;
+
+        case dt_bindata:
+        case dt_const_bindata:
+            doc_msgpack_write_bin(writer, ((doc_bindata*)variable)->data, ((doc_bindata*)variable)->len);
+        break;
+    }
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// opens and parse a msgpack file to a doc structure
+doc *doc_msgpack_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    size_t size;
+    uint8_t *stream = fload(filename, &size);
+    if(stream == NULL) return NULL;
+
+    doc *msgpack = doc_msgpack_parse(stream, size);
+
+    free(stream);
+
+    return msgpack;
+}
+
+// save doc as a msgpack file
+void doc_msgpack_save(doc *msgpack_doc, char *filename){
+    if(msgpack_doc == NULL) return;
+
+    doc_msgpack_writer *writer = doc_msgpack_writer_open(filename);
+    if(writer == NULL) return;
+
+    doc_msgpack_write_doc(writer, msgpack_doc);
+    doc_msgpack_writer_close(writer);
+}
+
+// parse msgpack
+doc *doc_msgpack_parse(uint8_t *stream, size_t len){
+    if(stream == NULL) return NULL;
+
+    msgpack_reader_t reader = { .cursor = stream, .end = stream + len };
+
+    doc *msgpack = parse_value(&reader, 0);
+    if(msgpack == NULL) return NULL;
+
+    const char *name = "msgpack";
+    msgpack->name = malloc(strlen(name) + 1);
+    strcpy(msgpack->name, name);
+
+    return msgpack;
+}
+
+// serialize a doc to msgpack
+uint8_t *doc_msgpack_serialize(doc *msgpack_doc, size_t *len){
+    if(msgpack_doc == NULL) return NULL;
+
+    doc_msgpack_writer writer = { .sink = NULL };
+    wbuffer_init(&writer.buffer, MSGPACK_WRITER_BUFFER_SIZE, NULL, NULL);
+
+    doc_msgpack_write_doc(&writer, msgpack_doc);
+
+    return (uint8_t*)wbuffer_release(&writer.buffer, len);
+}
@@ -0,0 +1,145 @@
+#ifndef _DOC_MSGPACK_HEADER_
+#define _DOC_MSGPACK_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "doc.h"
+
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief opaque type for a streaming msgpack writer
+ */
+typedef struct doc_msgpack_writer doc_msgpack_writer;
+
+/**
+ * @brief type for a function that receives the output of a msgpack writer
+ */
+typedef void (*doc_msgpack_write_function_t)(void *context, const void *data, size_t len);
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+/**
+ * @brief opens and parses a msgpack file to a doc structure
+ * @param filename: the path to file
+ * @return a doc data struture
+ */
+doc *doc_msgpack_open(char *filename);
+
+/**
+ * @brief serializes a doc structure and save it to a msgpack file
+ * @note see doc_msgpack_serialize call.
+ * @param msgpack_doc: doc data structure
+ * @param filename: path to the file
+ */
+void doc_msgpack_save(doc *msgpack_doc, char *filename);
+
+/**
+ * @brief parse a msgpack stream to a 'doc' structure
+ * @note maps become dt_obj and arrays dt_array, integers become int64, or uint64 when they don't fit,
+ * float 32 becomes dt_float, float 64 dt_double, str becomes dt_string and bin and ext become dt_bindata.
+ * Map keys that are not strings are converted to names: integers and floats to their decimal text, bools to
+ * "true" or "false" and nil to "null". Keys that are bin, ext, arrays or maps are not supported and make the parse fail.
+ * The root value will be named "msgpack".
+ * @param stream: msgpack encoded data
+ * @param len: length of the data
+ * @return pointer to 'doc' structure, NULL if the stream is malformed or truncated
+ */
+doc *doc_msgpack_parse(uint8_t *stream, size_t len);
+
+/**
+ * @brief serializes a 'doc' structure to msgpack, every type is written with its tightest encoding,
+ * dt_bindata and dt_const_bindata are written as the bin family. The name of the root is not written
+ * and members of arrays are written without their names
+ * @param msgpack_doc: pointer to 'doc' structure, of any type
+ * @param len: pointer where the length of the output will be written
+ * @return msgpack data, must be freed by the caller. NULL if msgpack_doc is NULL
+ */
+uint8_t *doc_msgpack_serialize(doc *msgpack_doc, size_t *len);
+
+/**
+ * @brief creates a streaming writer, output is buffered and passed to write_function in chunks,
+ * so documents of any size can be written with constant memory
+ * @param write_function: function that receives the output
+ * @param context: opaque pointer passed to write_function
+ * @return a new writer, close it with doc_msgpack_writer_close()
+ */
+doc_msgpack_writer *doc_msgpack_writer_new(doc_msgpack_write_function_t write_function, void *context);
+
+/**
+ * @brief creates a streaming writer that writes to a file
+ * @param filename: path to the file
+ * @return a new writer, NULL if the file could not be opened
+ */
+doc_msgpack_writer *doc_msgpack_writer_open(char *filename);
+
+/**
+ * @brief flushes and frees a writer, closing the file if opened by doc_msgpack_writer_open()
+ * @param writer: the writer
+ */
+void doc_msgpack_writer_close(doc_msgpack_writer *writer);
+
+/**
+ * @brief writes a map header, must be followed by 'size' pairs of key and value
+ */
+void doc_msgpack_write_map(doc_msgpack_writer *writer, uint32_t size);
+
+/**
+ * @brief writes a array header, must be followed by 'size' values
+ */
+void doc_msgpack_write_array(doc_msgpack_writer *writer, uint32_t size);
+
+/**
+ * @brief writes a string, may be used as a map key
+ */
+void doc_msgpack_write_str(doc_msgpack_writer *writer, const char *string, size_t len);
+
+/**
+ * @brief writes binary data
+ */
+void doc_msgpack_write_bin(doc_msgpack_writer *writer, const void *data, size_t len);
+
+/**
+ * @brief writes a signed integer with its tightest encoding
+ */
+void doc_msgpack_write_int(doc_msgpack_writer *writer, int64_t value);
+
+/**
+ * @brief writes a unsigned integer with its tightest encoding
+ */
+void doc_msgpack_write_uint(doc_msgpack_writer *writer, uint64_t value);
+
+/**
+ * @brief writes a float 32
+ */
+void doc_msgpack_write_float(doc_msgpack_writer *writer, float value);
+
+/**
+ * @brief writes a float 64
+ */
+void doc_msgpack_write_double(doc_msgpack_writer *writer, double value);
+
+/**
+ * @brief writes a bool
+ */
+void doc_msgpack_write_bool(doc_msgpack_writer *writer, bool value);
+
+/**
+ * @brief writes a nil
+ */
+void doc_msgpack_write_nil(doc_msgpack_writer *writer);
+
+/**
+ * @brief writes a whole doc structure, same encoding as doc_msgpack_serialize()
+ */
+void doc_msgpack_write_doc(doc_msgpack_writer *writer, doc *variable);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
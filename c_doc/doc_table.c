@@ -0,0 +1,1260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "doc_table.h"
+#include "parse_utils.h"
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_TABLE_ENDIANNESS        (0x01020304)                                    // written in host order, to detect byte order mismatch
+#define DOC_TABLE_ALIGNMENT         (8)                                             // every page and table is aligned to this
+#define DOC_TABLE_BUFFER_SIZE       (1 << 16)                                       // output flushed to the file in chunks of this size
+#define DOC_TABLE_DICTIONARY_RATIO  (4)                                             // string pages with up to rows / this distinct values use a dictionary
+
+/* ----------------------------------------- Private Struct's --------------------------------- */
+
+// header at the start of every table file
+typedef struct{
+    char magic[6];
+    uint16_t version;
+    uint32_t endianness;
+    uint32_t columns;
+    uint32_t page_rows;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t pages;                                                                 // pages of every column
+    uint64_t directory;                                                             // offset of the table_column_t of the columns
+    uint64_t size;                                                                  // size of the whole file
+}table_header_t;
+
+// entry of a column in the directory
+typedef struct{
+    uint64_t name;                                                                  // offset of the null terminated name
+    uint32_t name_len;
+    uint32_t type;                                                                  // doc_csv_column_type_t
+    uint64_t pages;                                                                 // offset of the table_page_t of the column
+}table_column_t;
+
+// entry of a page of a column
+typedef struct{
+    uint64_t offset;
+    uint64_t len;
+    uint32_t rows;
+    uint32_t encoding;                                                              // table_encoding_t
+    uint64_t nulls;
+    uint64_t min;                                                                   // bits of a int64 or a double
+    uint64_t max;
+}table_page_t;
+
+// header of a block of bit packed integers, followed by (count * width + 63) / 64 words
+typedef struct{
+    int64_t base;                                                                   // added to every value
+    uint32_t width;                                                                 // bits per value, 0 to 64
+    uint32_t count;
+}table_packed_t;
+
+// encoding of the values of a page
+typedef enum{
+    table_plain,                                                                    // doubles and bool bits as they are, strings as packed lengths and bytes
+    table_frame_of_reference,                                                       // int64 packed as the difference to the smallest one
+    table_delta,                                                                    // int64 packed as the difference to the previous one
+    table_dictionary                                                                // strings stored once, with a packed code per row
+}table_encoding_t;
+
+// opened table
+struct doc_table{
+    uint8_t *base;
+    size_t size;
+    const table_header_t *header;
+    const table_column_t *columns;
+};
+
+// state of the table writer
+typedef struct{
+    FILE *file;
+    wbuffer_t buffer;
+    uint64_t offset;
+    bool error;
+}table_writer_t;
+
+// a column of the doc being written
+typedef struct{
+    const char *name;
+    doc_csv_column_type_t type;
+    size_t rows;
+    const uint8_t *validity;
+    size_t validity_len;
+    const void *values;
+    const char *strings;
+}table_source_t;
+
+// memory of the page encoders and decoders, sized for a page
+typedef struct{
+    int64_t *values;
+    int64_t *lengths;
+    uint64_t *offsets;
+    uint8_t *bitmap;
+    uint32_t *slots;                                                                // hash table of a dictionary, entry indexes
+    size_t slot_count;
+    const char **entries;
+    size_t *entry_lens;
+}table_scratch_t;
+
+// bounds checked reader over the bytes of a page
+typedef struct{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+}table_cursor_t;
+
+// typed buffers of a column being read
+typedef struct{
+    doc_csv_column_type_t type;
+    uint8_t *validity;
+    void *values;
+    char *strings;
+    size_t strings_len;
+    size_t strings_size;
+}table_buffers_t;
+
+/* ----------------------------------------- Private Globals -------------------------------- */
+
+// names of the column types, as stored in the "type" member of a columnar doc
+static const char *column_type_names[] = { "int64", "double", "bool", "string" };
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+// allocate a node with a copy of name
+static doc *new_node(doc_type_t type, size_t size, const char *name){
+    doc *variable = calloc(1, size);
+    size_t len = strlen(name);
+
+    variable->type = type;
+    variable->name = malloc(len + 1);
+    memcpy(variable->name, name, len + 1);
+
+    return variable;
+}
+
+// link a member at the end of a obj, tail is the last member
+static void link_member(doc *parent, doc **tail, doc *member){
+    member->parent = parent;
+
+    if(*tail == NULL){
+        parent->child = member;
+    }
+    else{
+        (*tail)->next = member;
+        member->prev = *tail;
+    }
+
+    *tail = member;
+    parent->childs++;
+}
+
+// named binary data member, owns data
+static doc *new_bindata_member(const char *name, void *data, size_t len){
+    doc *member = new_node(dt_bindata, sizeof(doc_bindata), name);
+    ((doc_bindata*)member)->data = data;
+    ((doc_bindata*)member)->len = len;
+    return member;
+}
+
+// column obj out of its buffers, same layout as the columns of csv_parse_columnar
+static doc *new_column(const char *name, table_buffers_t *buffers, size_t rows){
+    doc *column = new_node(dt_obj, sizeof(doc), name);
+    doc *tail = NULL;
+
+    doc *type = new_node(dt_string, sizeof(doc_string), "type");
+    size_t type_len = strlen(column_type_names[buffers->type]);
+    ((doc_string*)type)->string = malloc(type_len + 1);
+    memcpy(((doc_string*)type)->string, column_type_names[buffers->type], type_len + 1);
+    ((doc_string*)type)->len = type_len + 1;
+    link_member(column, &tail, type);
+
+    doc *count = new_node(dt_uint64, sizeof(doc_uint64_t), "rows");
+    ((doc_uint64_t*)count)->value = rows;
+    link_member(column, &tail, count);
+
+    link_member(column, &tail, new_bindata_member("validity", buffers->validity, (rows + 7) / 8));
+
+    switch(buffers->type){
+        case csv_column_int64:
+        case csv_column_double:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, rows * sizeof(int64_t)));
+        break;
+
+        case csv_column_bool:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, rows));
+        break;
+
+        case csv_column_string:
+            link_member(column, &tail, new_bindata_member("values", buffers->values, (rows + 1) * sizeof(uint64_t)));
+            link_member(column, &tail, new_bindata_member("strings", buffers->strings, buffers->strings_len));
+        break;
+    }
+
+    return column;
+}
+
+// allocates the buffers of a column of rows, strings_size bytes of strings
+static void buffers_init(table_buffers_t *buffers, doc_csv_column_type_t type, size_t rows, size_t strings_size){
+    buffers->type = type;
+    buffers->validity = calloc((rows + 7) / 8 + 1, 1);
+    buffers->values = calloc(rows + 1, type == csv_column_bool ? 1 : sizeof(int64_t));
+    buffers->strings = type == csv_column_string ? malloc(strings_size + 1) : NULL;
+    buffers->strings_len = 0;
+    buffers->strings_size = strings_size;
+}
+
+// frees the buffers of a column that was not turned into a doc
+static void buffers_free(table_buffers_t *buffers){
+    free(buffers->validity);
+    free(buffers->values);
+    free(buffers->strings);
+}
+
+// number of bits needed to hold value
+static unsigned bit_width(uint64_t value){
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+// checks a bit of a bitmap
+static bool bitmap_get(const uint8_t *bitmap, size_t bit){
+    return (bitmap[bit / 8] >> (bit % 8)) & 1;
+}
+
+// FNV-1a hash of a string
+static uint64_t string_hash(const char *string, size_t len){
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for(size_t i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)string[i]) * 0x100000001B3ull;
+
+    return hash;
+}
+
+/* ----------------------------------------- Rows To Columns -------------------------------- */
+
+// column type of a cell, -1 for cells that are null in a table
+static int cell_type(doc *cell){
+    switch(cell->type){
+        case dt_bool:
+            return csv_column_bool;
+
+        case dt_int: case dt_int64: case dt_int32: case dt_int16: case dt_int8:
+        case dt_uint: case dt_uint32: case dt_uint16: case dt_uint8:
+            return csv_column_int64;
+
+        case dt_uint64:                                                             // values past INT64_MAX don't fit
+            return ((doc_uint64_t*)cell)->value > INT64_MAX ? csv_column_double : csv_column_int64;
+
+        case dt_double:
+        case dt_float:
+            return csv_column_double;
+
+        case dt_string:
+        case dt_const_string:
+            return csv_column_string;
+
+        default:
+            return -1;
+    }
+}
+
+// type of a column holding cells of the types column and cell
+static int merge_type(int column, int cell){
+    if(cell < 0 || column == cell) return column < 0 ? cell : column;
+    if(column < 0) return cell;
+
+    if( (column == csv_column_int64 && cell == csv_column_double) ||
+        (column == csv_column_double && cell == csv_column_int64))
+        return csv_column_double;
+
+    return csv_column_string;
+}
+
+// integer value of a integer or bool cell
+static int64_t cell_int64(doc *cell){
+    switch(cell->type){
+        case dt_int:    return ((doc_int*)cell)->value;
+        case dt_int64:  return ((doc_int64_t*)cell)->value;
+        case dt_int32:  return ((doc_int32_t*)cell)->value;
+        case dt_int16:  return ((doc_int16_t*)cell)->value;
+        case dt_int8:   return ((doc_int8_t*)cell)->value;
+        case dt_uint:   return ((doc_uint_t*)cell)->value;
+        case dt_uint64: return (int64_t)((doc_uint64_t*)cell)->value;
+        case dt_uint32: return ((doc_uint32_t*)cell)->value;
+        case dt_uint16: return ((doc_uint16_t*)cell)->value;
+        case dt_uint8:  return ((doc_uint8_t*)cell)->value;
+        case dt_bool:   return ((doc_bool*)cell)->value;
+        default:        return 0;
+    }
+}
+
+// decimal value of a number cell
+static double cell_double(doc *cell){
+    switch(cell->type){
+        case dt_double: return ((doc_double*)cell)->value;
+        case dt_float:  return ((doc_float*)cell)->value;
+        case dt_uint64: return (double)((doc_uint64_t*)cell)->value;
+        default:        return (double)cell_int64(cell);
+    }
+}
+
+// appends the text of a cell to the strings of a column
+static void write_cell_text(wbuffer_t *strings, doc *cell, int type){
+    switch(type){
+        case csv_column_bool:
+            wbuffer_puts(strings, ((doc_bool*)cell)->value ? "true" : "false");
+        break;
+
+        case csv_column_int64:
+            if(cell->type == dt_uint64) wbuffer_write_uint(strings, ((doc_uint64_t*)cell)->value);
+            else wbuffer_write_int(strings, cell_int64(cell));
+        break;
+
+        case csv_column_double:
+            wbuffer_write_double(strings, cell_double(cell));
+        break;
+
+        case csv_column_string:
+            wbuffer_puts(strings, ((doc_string*)cell)->string != NULL ? ((doc_string*)cell)->string : "");
+        break;
+    }
+
+    wbuffer_putc(strings, '\0');
+}
+
+// writes a cell in row of a column
+static void fill_cell(table_buffers_t *column, wbuffer_t *strings, size_t row, doc *cell){
+    int type = cell_type(cell);
+    if(type < 0) return;
+
+    switch(column->type){
+        case csv_column_int64:
+            ((int64_t*)column->values)[row] = cell_int64(cell);
+        break;
+
+        case csv_column_double:
+            ((double*)column->values)[row] = cell_double(cell);
+        break;
+
+        case csv_column_bool:
+            ((uint8_t*)column->values)[row] = ((doc_bool*)cell)->value;
+        break;
+
+        case csv_column_string:
+            write_cell_text(strings, cell, type);
+        break;
+    }
+
+    column->validity[row / 8] |= (uint8_t)(1 << (row % 8));
+}
+
+// columnar doc out of a object of rows. A first pass finds the number of columns, their names and types, a second
+// one fills the column buffers
+static doc *columns_of_rows(doc *table_doc){
+    size_t column_count = 0, rows = 0;
+
+    for(doc_loop(row, table_doc)){
+        if((row->type == dt_obj || row->type == dt_array) && row->childs > column_count) column_count = row->childs;
+        rows++;
+    }
+
+    int *types = malloc((column_count + 1) * sizeof(*types));
+    const char **names = calloc(column_count + 1, sizeof(*names));
+    for(size_t i = 0; i < column_count; i++) types[i] = -1;
+
+    for(doc_loop(row, table_doc)){
+        if(row->type != dt_obj && row->type != dt_array) continue;
+
+        size_t column = 0;
+        for(doc_loop(cell, row)){
+            types[column] = merge_type(types[column], cell_type(cell));
+            if(names[column] == NULL && cell->name != NULL && *cell->name != '\0') names[column] = cell->name;
+            column++;
+        }
+    }
+
+    table_buffers_t *buffers = calloc(column_count + 1, sizeof(*buffers));
+    wbuffer_t *strings = calloc(column_count + 1, sizeof(*strings));
+
+    for(size_t i = 0; i < column_count; i++){
+        buffers_init(&buffers[i], types[i] < 0 ? csv_column_string : (doc_csv_column_type_t)types[i], rows, 0);
+        if(buffers[i].type == csv_column_string) wbuffer_init(&strings[i], 256, NULL, NULL);
+    }
+
+    size_t row_index = 0;
+
+    for(doc_loop(row, table_doc)){
+        if(row->type == dt_obj || row->type == dt_array){
+            size_t column = 0;
+            for(doc_loop(cell, row))
+                fill_cell(&buffers[column], &strings[column], row_index, cell), column++;
+        }
+
+        for(size_t i = 0; i < column_count; i++){                                   // null and missing cells take no bytes
+            if(buffers[i].type == csv_column_string) ((uint64_t*)buffers[i].values)[row_index + 1] = strings[i].len;
+        }
+
+        row_index++;
+    }
+
+    doc *columns = doc_new("", dt_obj, ";");
+    doc *last_column = NULL;
+
+    for(size_t i = 0; i < column_count; i++){
+        if(buffers[i].type == csv_column_string){
+            free(buffers[i].strings);
+            buffers[i].strings = wbuffer_release(&strings[i], &buffers[i].strings_len);
+        }
+
+        link_member(columns, &last_column, new_column(names[i] != NULL ? names[i] : "", &buffers[i], rows));
+    }
+
+    free(names);
+    free(strings);
+    free(buffers);
+    free(types);
+
+    return columns;
+}
+
+/* ----------------------------------------- Writer ----------------------------------------- */
+
+// flush function of the writer buffer
+static void writer_flush(void *context, const void *data, size_t len){
+    table_writer_t *writer = (table_writer_t*)context;
+
+    if(len > 0 && fwrite(data, 1, len, writer->file) != len)
+        writer->error = true;
+}
+
+// write bytes to the table
+static void write_bytes(table_writer_t *writer, const void *data, size_t len){
+    wbuffer_write(&writer->buffer, data, len);
+    writer->offset += len;
+}
+
+// pad the table to the alignment
+static void write_align(table_writer_t *writer){
+    static const uint8_t zeros[DOC_TABLE_ALIGNMENT] = {0};
+    size_t pad = (DOC_TABLE_ALIGNMENT - (writer->offset % DOC_TABLE_ALIGNMENT)) % DOC_TABLE_ALIGNMENT;
+
+    write_bytes(writer, zeros, pad);
+}
+
+// writes count values bit packed as their difference to the smallest one
+static void write_packed(table_writer_t *writer, const int64_t *values, size_t count){
+    int64_t min = count > 0 ? values[0] : 0;
+    int64_t max = min;
+
+    for(size_t i = 1; i < count; i++){
+        if(values[i] < min) min = values[i];
+        if(values[i] > max) max = values[i];
+    }
+
+    table_packed_t packed = { .base = min, .width = bit_width((uint64_t)max - (uint64_t)min), .count = (uint32_t)count };
+    write_bytes(writer, &packed, sizeof(packed));
+
+    if(packed.width == 0) return;
+
+    uint64_t word = 0;
+    unsigned used = 0;
+
+    for(size_t i = 0; i < count; i++){
+        uint64_t value = (uint64_t)values[i] - (uint64_t)min;
+
+        word |= value << used;
+        used += packed.width;
+
+        if(used >= 64){                                                             // the high bits of value start the next word
+            write_bytes(writer, &word, sizeof(word));
+            used -= 64;
+            word = used > 0 ? value >> (packed.width - used) : 0;
+        }
+    }
+
+    if(used > 0) write_bytes(writer, &word, sizeof(word));
+}
+
+// checks the validity bit of a cell of a source
+static bool source_valid(const table_source_t *source, size_t row){
+    return row < source->rows && row / 8 < source->validity_len && bitmap_get(source->validity, row);
+}
+
+// writes the validity bitmap of a page if it has nulls, the bitmap is kept in scratch. Returns the number of nulls
+static size_t write_validity(table_writer_t *writer, const table_source_t *source, size_t first, size_t rows, table_scratch_t *scratch){
+    size_t bytes = (rows + 7) / 8;
+    size_t valid = 0;
+
+    memset(scratch->bitmap, 0, bytes);
+
+    for(size_t i = 0; i < rows; i++){
+        if(source_valid(source, first + i)){
+            scratch->bitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+            valid++;
+        }
+    }
+
+    if(valid < rows){
+        write_bytes(writer, scratch->bitmap, bytes);
+        write_align(writer);
+    }
+
+    return rows - valid;
+}
+
+// writes a int64 page as frame of reference or delta, whichever packs in less bits
+static void write_int64_page(table_writer_t *writer, const table_source_t *source, size_t first, table_page_t *page, table_scratch_t *scratch){
+    const int64_t *values = (const int64_t*)source->values + first;
+    int64_t *filled = scratch->values;
+    int64_t *deltas = scratch->lengths;
+    int64_t min = INT64_MAX, max = INT64_MIN, previous = 0;
+    size_t rows = page->rows;
+
+    for(size_t i = 0; i < rows; i++){                                               // nulls before the first value take it
+        if(bitmap_get(scratch->bitmap, i)){ previous = values[i]; break; }
+    }
+
+    for(size_t i = 0; i < rows; i++){                                               // nulls repeat the previous value, so they don't widen the packing
+        if(bitmap_get(scratch->bitmap, i)){
+            previous = values[i];
+            if(previous < min) min = previous;
+            if(previous > max) max = previous;
+        }
+
+        filled[i] = previous;
+    }
+
+    int64_t delta_min = 0, delta_max = 0;
+    deltas[0] = 0;
+
+    for(size_t i = 1; i < rows; i++){
+        deltas[i] = (int64_t)((uint64_t)filled[i] - (uint64_t)filled[i - 1]);
+        if(deltas[i] < delta_min) delta_min = deltas[i];
+        if(deltas[i] > delta_max) delta_max = deltas[i];
+    }
+
+    unsigned reference_width = min <= max ? bit_width((uint64_t)max - (uint64_t)min) : 0;
+    unsigned delta_width = bit_width((uint64_t)delta_max - (uint64_t)delta_min);
+
+    page->min = (uint64_t)min;
+    page->max = (uint64_t)max;
+
+    if(delta_width < reference_width && (uint64_t)rows * (reference_width - delta_width) > 64){
+        page->encoding = table_delta;
+        write_bytes(writer, &filled[0], sizeof(filled[0]));
+        write_packed(writer, deltas, rows);
+    }
+    else{
+        page->encoding = table_frame_of_reference;
+        write_packed(writer, filled, rows);
+    }
+}
+
+// writes a double page as it is, nulls as 0
+static void write_double_page(table_writer_t *writer, const table_source_t *source, size_t first, table_page_t *page, table_scratch_t *scratch){
+    const double *values = (const double*)source->values + first;
+    double *plain = (double*)scratch->values;
+    double min = INFINITY, max = -INFINITY;
+
+    for(size_t i = 0; i < page->rows; i++){
+        plain[i] = bitmap_get(scratch->bitmap, i) ? values[i] : 0.0;
+
+        if(bitmap_get(scratch->bitmap, i) && !isnan(plain[i])){
+            if(plain[i] < min) min = plain[i];
+            if(plain[i] > max) max = plain[i];
+        }
+    }
+
+    page->encoding = table_plain;
+    memcpy(&page->min, &min, sizeof(min));
+    memcpy(&page->max, &max, sizeof(max));
+
+    write_bytes(writer, plain, page->rows * sizeof(double));
+}
+
+// writes a bool page as one bit per row
+static void write_bool_page(table_writer_t *writer, const table_source_t *source, size_t first, table_page_t *page, table_scratch_t *scratch){
+    const uint8_t *values = (const uint8_t*)source->values + first;
+    uint8_t *bits = (uint8_t*)scratch->values;
+    int64_t min = INT64_MAX, max = INT64_MIN;
+    size_t bytes = (page->rows + 7) / 8;
+
+    memset(bits, 0, bytes);
+
+    for(size_t i = 0; i < page->rows; i++){
+        if(!bitmap_get(scratch->bitmap, i)) continue;
+
+        int64_t value = values[i] != 0;
+        bits[i / 8] |= (uint8_t)(value << (i % 8));
+
+        if(value < min) min = value;
+        if(value > max) max = value;
+    }
+
+    page->encoding = table_plain;
+    page->min = (uint64_t)min;
+    page->max = (uint64_t)max;
+
+    write_bytes(writer, bits, bytes);
+    write_align(writer);
+}
+
+// finds a string in the dictionary of a page, adding it if there is room. Returns its code, -1 if the dictionary is full
+static int64_t dictionary_code(table_scratch_t *scratch, size_t *entry_count, size_t limit, const char *string, size_t len){
+    size_t mask = scratch->slot_count - 1;
+    size_t slot = string_hash(string, len) & mask;
+
+    for(; scratch->slots[slot] != UINT32_MAX; slot = (slot + 1) & mask){
+        uint32_t entry = scratch->slots[slot];
+
+        if(scratch->entry_lens[entry] == len && !memcmp(scratch->entries[entry], string, len))
+            return entry;
+    }
+
+    if(*entry_count >= limit) return -1;
+
+    scratch->entries[*entry_count] = string;
+    scratch->entry_lens[*entry_count] = len;
+    scratch->slots[slot] = (uint32_t)*entry_count;
+
+    return (int64_t)(*entry_count)++;
+}
+
+// writes a string page with a dictionary when it has few distinct strings, as lengths and bytes otherwise
+static void write_string_page(table_writer_t *writer, const table_source_t *source, size_t first, table_page_t *page, table_scratch_t *scratch){
+    const uint64_t *offsets = (const uint64_t*)source->values + first;
+    int64_t *codes = scratch->values;
+    int64_t *lengths = scratch->lengths;
+    size_t rows = page->rows;
+    size_t limit = rows / DOC_TABLE_DICTIONARY_RATIO;
+    size_t entry_count = 0;
+    uint64_t string_bytes = 0;
+    bool dictionary = limit > 0;
+
+    if(dictionary) memset(scratch->slots, 0xFF, scratch->slot_count * sizeof(*scratch->slots));
+
+    for(size_t i = 0; i < rows; i++){
+        codes[i] = 0;
+        lengths[i] = 0;
+
+        if(!bitmap_get(scratch->bitmap, i)) continue;
+
+        const char *string = source->strings + offsets[i];
+        size_t len = offsets[i + 1] > offsets[i] ? offsets[i + 1] - offsets[i] - 1 : 0;
+
+        lengths[i] = (int64_t)len;
+        string_bytes += len + 1;
+
+        if(dictionary){
+            codes[i] = dictionary_code(scratch, &entry_count, limit, string, len);
+            dictionary = codes[i] >= 0;
+        }
+    }
+
+    write_bytes(writer, &string_bytes, sizeof(string_bytes));                       // size of the decoded strings, terminators included
+
+    if(dictionary){
+        page->encoding = table_dictionary;
+
+        for(size_t i = 0; i < entry_count; i++)
+            lengths[i] = (int64_t)scratch->entry_lens[i];
+
+        write_packed(writer, lengths, entry_count);
+
+        for(size_t i = 0; i < entry_count; i++)
+            write_bytes(writer, scratch->entries[i], scratch->entry_lens[i]);
+
+        write_align(writer);
+        write_packed(writer, codes, rows);
+    }
+    else{
+        page->encoding = table_plain;
+        write_packed(writer, lengths, rows);
+
+        for(size_t i = 0; i < rows; i++){
+            if(lengths[i] > 0) write_bytes(writer, source->strings + offsets[i], (size_t)lengths[i]);
+        }
+
+        write_align(writer);
+    }
+}
+
+// writes the pages of a column, filling its page table
+static void write_column(table_writer_t *writer, const table_source_t *source, size_t rows, table_page_t *pages, table_scratch_t *scratch){
+    for(size_t first = 0, index = 0; first < rows; first += DOC_TABLE_PAGE_ROWS, index++){
+        table_page_t *page = &pages[index];
+
+        *page = (table_page_t){ .offset = writer->offset, .rows = (uint32_t)(rows - first < DOC_TABLE_PAGE_ROWS ? rows - first : DOC_TABLE_PAGE_ROWS) };
+        page->nulls = write_validity(writer, source, first, page->rows, scratch);
+
+        switch(source->type){
+            case csv_column_int64:  write_int64_page(writer, source, first, page, scratch);  break;
+            case csv_column_double: write_double_page(writer, source, first, page, scratch); break;
+            case csv_column_bool:   write_bool_page(writer, source, first, page, scratch);   break;
+            case csv_column_string: write_string_page(writer, source, first, page, scratch); break;
+        }
+
+        page->len = writer->offset - page->offset;
+    }
+}
+
+// member of a column by name
+static doc *column_member(doc *column, const char *name){
+    for(doc_loop(member, column)){
+        if(!strcmp(member->name, name)) return member;
+    }
+
+    return NULL;
+}
+
+// bindata of a member of a column, NULL if it is missing or shorter than len
+static const void *column_data(doc *column, const char *name, size_t len, size_t *member_len){
+    doc *member = column_member(column, name);
+    if(member == NULL || member->type != dt_bindata || ((doc_bindata*)member)->len < len) return NULL;
+
+    if(member_len != NULL) *member_len = ((doc_bindata*)member)->len;
+    return ((doc_bindata*)member)->data;
+}
+
+// source of a column of a columnar doc, false if its buffers are too short for its rows
+static bool source_of_column(table_source_t *source, doc *column){
+    size_t value_size[] = { sizeof(int64_t), sizeof(double), 1, sizeof(uint64_t) };
+    size_t strings_len = 0;
+
+    source->name = column->name != NULL ? column->name : "";
+    source->type = doc_csv_column_type(column);
+    source->rows = doc_csv_column_rows(column);
+    source->validity = column_data(column, "validity", 0, &source->validity_len);
+    source->values = column_data(column, "values", (source->rows + (source->type == csv_column_string)) * value_size[source->type], NULL);
+    source->strings = NULL;
+
+    if(source->validity == NULL || source->values == NULL) return false;
+    if(source->type != csv_column_string) return true;
+
+    source->strings = column_data(column, "strings", 0, &strings_len);
+
+    return source->strings != NULL && ((const uint64_t*)source->values)[source->rows] <= strings_len;
+}
+
+/* ----------------------------------------- Reader ----------------------------------------- */
+
+// takes len bytes of a page, NULL if the page is shorter
+static const void *cursor_take(table_cursor_t *cursor, size_t len){
+    if(len > cursor->len - cursor->pos) return NULL;
+
+    const void *data = cursor->data + cursor->pos;
+    cursor->pos += len;
+
+    return data;
+}
+
+// skips the padding after a block
+static void cursor_align(table_cursor_t *cursor){
+    size_t pad = (DOC_TABLE_ALIGNMENT - (cursor->pos % DOC_TABLE_ALIGNMENT)) % DOC_TABLE_ALIGNMENT;
+    cursor->pos = pad > cursor->len - cursor->pos ? cursor->len : cursor->pos + pad;
+}
+
+// reads a block of bit packed integers holding up to capacity values, *count receives the number of values
+static bool read_packed(table_cursor_t *cursor, int64_t *values, size_t capacity, size_t *count){
+    const table_packed_t *packed = cursor_take(cursor, sizeof(*packed));
+    if(packed == NULL || packed->count > capacity || packed->width > 64) return false;
+
+    size_t words = ((uint64_t)packed->count * packed->width + 63) / 64;
+    const uint64_t *data = cursor_take(cursor, words * sizeof(uint64_t));
+    if(data == NULL) return false;
+
+    uint64_t base = (uint64_t)packed->base;
+    unsigned width = packed->width;
+    *count = packed->count;
+
+    if(width == 0){
+        for(size_t i = 0; i < packed->count; i++) values[i] = (int64_t)base;
+        return true;
+    }
+
+    uint64_t mask = width == 64 ? UINT64_MAX : ((uint64_t)1 << width) - 1;
+    size_t bit = 0;
+
+    for(size_t i = 0; i < packed->count; i++, bit += width){
+        size_t word = bit / 64;
+        unsigned shift = bit % 64;
+        uint64_t value = data[word] >> shift;
+
+        if(shift + width > 64) value |= data[word + 1] << (64 - shift);             // straddles two words
+
+        values[i] = (int64_t)(base + (value & mask));
+    }
+
+    return true;
+}
+
+// appends a string of a row to a string column, false if it doesn't fit the size given by the page
+static bool append_string(table_buffers_t *buffers, const char *string, size_t len){
+    if(len + 1 > buffers->strings_size - buffers->strings_len) return false;
+
+    memcpy(buffers->strings + buffers->strings_len, string, len);
+    buffers->strings[buffers->strings_len + len] = '\0';
+    buffers->strings_len += len + 1;
+
+    return true;
+}
+
+// decodes the strings of a page, offsets holds the rows + 1 offsets of the page
+static bool read_string_page(table_cursor_t *cursor, const table_page_t *page, const uint8_t *validity, table_buffers_t *buffers, uint64_t *offsets, table_scratch_t *scratch){
+    size_t rows = page->rows, count = 0, total = 0;
+    int64_t *lengths = scratch->lengths;
+    int64_t *codes = scratch->values;
+
+    if(cursor_take(cursor, sizeof(uint64_t)) == NULL) return false;                 // the string bytes were already summed
+
+    if(!read_packed(cursor, lengths, DOC_TABLE_PAGE_ROWS, &count)) return false;
+    if(page->encoding == table_plain && count != rows) return false;
+    if(page->encoding != table_plain && page->encoding != table_dictionary) return false;
+
+    for(size_t i = 0; i < count; i++){
+        if(lengths[i] < 0 || (uint64_t)lengths[i] > cursor->len) return false;
+        scratch->offsets[i] = total;
+        total += (size_t)lengths[i];
+    }
+
+    const char *bytes = cursor_take(cursor, total);
+    if(bytes == NULL) return false;
+
+    cursor_align(cursor);
+
+    if(page->encoding == table_plain){
+        for(size_t i = 0; i < rows; i++){
+            if(bitmap_get(validity, i) && !append_string(buffers, bytes + scratch->offsets[i], (size_t)lengths[i])) return false;
+            offsets[i + 1] = buffers->strings_len;
+        }
+
+        return true;
+    }
+
+    size_t code_count = 0;
+    if(!read_packed(cursor, codes, DOC_TABLE_PAGE_ROWS, &code_count) || code_count != rows) return false;
+
+    for(size_t i = 0; i < rows; i++){
+        if(bitmap_get(validity, i)){
+            if(codes[i] < 0 || (uint64_t)codes[i] >= count) return false;
+            if(!append_string(buffers, bytes + scratch->offsets[codes[i]], (size_t)lengths[codes[i]])) return false;
+        }
+
+        offsets[i + 1] = buffers->strings_len;
+    }
+
+    return true;
+}
+
+// decodes a page into the buffers of a column, starting at row
+static bool read_page(const doc_table *table, const table_page_t *page, table_buffers_t *buffers, size_t row, table_scratch_t *scratch){
+    table_cursor_t cursor = { .data = table->base + page->offset, .len = page->len, .pos = 0 };
+    uint8_t *validity = buffers->validity + row / 8;                                // rows of a page start at a multiple of 64
+    size_t rows = page->rows;
+    size_t bytes = (rows + 7) / 8;
+
+    if(page->nulls > 0){
+        const uint8_t *bitmap = cursor_take(&cursor, bytes);
+        if(bitmap == NULL) return false;
+
+        memcpy(validity, bitmap, bytes);
+        cursor_align(&cursor);
+    }
+    else{
+        memset(validity, 0xFF, bytes);
+    }
+
+    if(rows % 8) validity[rows / 8] &= (uint8_t)((1 << (rows % 8)) - 1);             // bits past the last row stay clear
+
+    int64_t *integers = (int64_t*)buffers->values + row;
+    size_t count = 0;
+
+    switch(buffers->type){
+        case csv_column_int64:
+            if(page->encoding == table_delta){
+                const int64_t *start = cursor_take(&cursor, sizeof(int64_t));
+                if(start == NULL || !read_packed(&cursor, integers, rows, &count) || count != rows) return false;
+
+                uint64_t value = (uint64_t)*start;
+                for(size_t i = 0; i < rows; i++){
+                    value += (uint64_t)integers[i];
+                    integers[i] = (int64_t)value;
+                }
+            }
+            else if(page->encoding != table_frame_of_reference || !read_packed(&cursor, integers, rows, &count) || count != rows){
+                return false;
+            }
+        break;
+
+        case csv_column_double:{
+            const void *values = cursor_take(&cursor, rows * sizeof(double));
+            if(values == NULL) return false;
+
+            memcpy((double*)buffers->values + row, values, rows * sizeof(double));
+        }
+        break;
+
+        case csv_column_bool:{
+            const uint8_t *bits = cursor_take(&cursor, bytes);
+            uint8_t *values = (uint8_t*)buffers->values + row;
+            if(bits == NULL) return false;
+
+            for(size_t i = 0; i < rows; i++)
+                values[i] = bitmap_get(bits, i);
+        }
+        break;
+
+        case csv_column_string:
+            return read_string_page(&cursor, page, validity, buffers, (uint64_t*)buffers->values + row, scratch);
+    }
+
+    if(page->nulls > 0){                                                            // null cells are 0, like in csv_parse_columnar
+        for(size_t i = 0; i < rows; i++){
+            if(bitmap_get(validity, i)) continue;
+
+            if(buffers->type == csv_column_bool) ((uint8_t*)buffers->values)[row + i] = 0;
+            else integers[i] = 0;
+        }
+    }
+
+    return true;
+}
+
+// page table of a column
+static const table_page_t *column_pages(const doc_table *table, size_t column){
+    return (const table_page_t*)(table->base + table->columns[column].pages);
+}
+
+// size of the decoded strings of a page, as written before its values
+static bool page_string_bytes(const doc_table *table, const table_page_t *page, uint64_t *string_bytes){
+    size_t start = page->nulls > 0 ? ((page->rows + 7) / 8 + DOC_TABLE_ALIGNMENT - 1) / DOC_TABLE_ALIGNMENT * DOC_TABLE_ALIGNMENT : 0;
+
+    if(page->len < start + sizeof(uint64_t)) return false;
+
+    memcpy(string_bytes, table->base + page->offset + start, sizeof(uint64_t));
+    return *string_bytes <= (uint64_t)page->rows * (page->len + 1);
+}
+
+// checks if a column was asked for
+static bool column_requested(const doc_table *table, size_t column, size_t count, const char **names){
+    if(count == 0) return true;
+
+    for(size_t i = 0; i < count; i++){
+        if(names[i] != NULL && !strcmp(names[i], doc_table_column_name((doc_table*)table, column))) return true;
+    }
+
+    return false;
+}
+
+// decodes the pages of a column into a column obj, NULL if a page is corrupted
+static doc *read_column(const doc_table *table, size_t column, size_t first_page, size_t page_count, size_t rows, table_scratch_t *scratch){
+    const table_page_t *pages = column_pages(table, column) + first_page;
+    doc_csv_column_type_t type = (doc_csv_column_type_t)table->columns[column].type;
+    uint64_t strings_size = 0;
+
+    for(size_t i = 0; i < page_count && type == csv_column_string; i++){
+        uint64_t string_bytes;
+        if(!page_string_bytes(table, &pages[i], &string_bytes)) return NULL;
+
+        strings_size += string_bytes;
+    }
+
+    table_buffers_t buffers;
+    buffers_init(&buffers, type, rows, strings_size);
+
+    for(size_t i = 0, row = 0; i < page_count; row += pages[i].rows, i++){
+        if(!read_page(table, &pages[i], &buffers, row, scratch)){
+            buffers_free(&buffers);
+            return NULL;
+        }
+    }
+
+    return new_column(doc_table_column_name((doc_table*)table, column), &buffers, rows);
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// write a table doc as a table file
+bool doc_table_write(doc *table_doc, char *filename){
+    if(table_doc == NULL || filename == NULL) return false;
+    if(table_doc->type != dt_obj && table_doc->type != dt_array) return false;
+
+    doc *columnar = doc_csv_is_columnar(table_doc) ? table_doc : columns_of_rows(table_doc);
+    size_t column_count = columnar->childs, rows = 0, column = 0;
+    table_source_t *sources = calloc(column_count + 1, sizeof(*sources));
+    bool valid = true;
+
+    for(doc_loop(member, columnar)){
+        valid = valid && source_of_column(&sources[column], member);
+        if(sources[column].rows > rows) rows = sources[column].rows;
+        column++;
+    }
+
+    FILE *file = valid ? fopen(filename, "wb") : NULL;
+
+    if(file == NULL){
+        if(columnar != table_doc) doc_delete(columnar, ".");
+        free(sources);
+        return false;
+    }
+
+    size_t page_count = (rows + DOC_TABLE_PAGE_ROWS - 1) / DOC_TABLE_PAGE_ROWS;
+    table_page_t *pages = calloc(column_count * page_count + 1, sizeof(*pages));
+    table_column_t *columns = calloc(column_count + 1, sizeof(*columns));
+    table_writer_t writer = { .file = file, .offset = 0, .error = false };
+    table_header_t header = {0};
+
+    table_scratch_t scratch = {
+        .values = malloc(DOC_TABLE_PAGE_ROWS * sizeof(int64_t)),
+        .lengths = malloc(DOC_TABLE_PAGE_ROWS * sizeof(int64_t)),
+        .bitmap = malloc(DOC_TABLE_PAGE_ROWS / 8),
+        .slot_count = 2 * DOC_TABLE_PAGE_ROWS / DOC_TABLE_DICTIONARY_RATIO,
+        .entries = malloc(DOC_TABLE_PAGE_ROWS / DOC_TABLE_DICTIONARY_RATIO * sizeof(char*)),
+        .entry_lens = malloc(DOC_TABLE_PAGE_ROWS / DOC_TABLE_DICTIONARY_RATIO * sizeof(size_t))
+    };
+    scratch.slots = malloc(scratch.slot_count * sizeof(*scratch.slots));
+
+    wbuffer_init(&writer.buffer, DOC_TABLE_BUFFER_SIZE, writer_flush, &writer);
+    write_bytes(&writer, &header, sizeof(header));                                  // placeholder, written again at the end
+
+    for(size_t i = 0; i < column_count; i++)
+        write_column(&writer, &sources[i], rows, pages + i * page_count, &scratch);
+
+    for(size_t i = 0; i < column_count; i++){
+        columns[i].name_len = (uint32_t)strlen(sources[i].name);
+        columns[i].name = writer.offset;
+        columns[i].type = sources[i].type;
+        write_bytes(&writer, sources[i].name, columns[i].name_len + 1);
+    }
+
+    write_align(&writer);
+    header.directory = writer.offset;
+
+    for(size_t i = 0; i < column_count; i++)
+        columns[i].pages = header.directory + column_count * sizeof(*columns) + i * page_count * sizeof(*pages);
+
+    write_bytes(&writer, columns, column_count * sizeof(*columns));
+    write_bytes(&writer, pages, column_count * page_count * sizeof(*pages));
+    wbuffer_flush(&writer.buffer);
+
+    memcpy(header.magic, DOC_TABLE_MAGIC, sizeof(header.magic));
+    header.version = DOC_TABLE_VERSION;
+    header.endianness = DOC_TABLE_ENDIANNESS;
+    header.columns = (uint32_t)column_count;
+    header.page_rows = DOC_TABLE_PAGE_ROWS;
+    header.rows = rows;
+    header.pages = page_count;
+    header.size = writer.offset;
+
+    if(fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)
+        writer.error = true;
+
+    if(fclose(file) != 0)
+        writer.error = true;
+
+    if(writer.error)
+        remove(filename);
+
+    wbuffer_free(&writer.buffer);
+    free(scratch.values);
+    free(scratch.lengths);
+    free(scratch.bitmap);
+    free(scratch.slots);
+    free(scratch.entries);
+    free(scratch.entry_lens);
+    free(columns);
+    free(pages);
+    free(sources);
+
+    if(columnar != table_doc) doc_delete(columnar, ".");
+
+    return !writer.error;
+}
+
+// map a table
+doc_table *doc_table_open(char *filename){
+    size_t size;
+    uint8_t *base = fmap(filename, &size);
+    if(base == NULL) return NULL;
+
+    const table_header_t *header = (const table_header_t*)base;
+
+    if( size < sizeof(*header)                                                      ||
+        memcmp(header->magic, DOC_TABLE_MAGIC, sizeof(header->magic))              ||
+        header->version != DOC_TABLE_VERSION                                        ||
+        header->endianness != DOC_TABLE_ENDIANNESS                                  ||
+        header->size != size                                                        ||
+        header->page_rows != DOC_TABLE_PAGE_ROWS                                    ||
+        header->pages != (header->rows + DOC_TABLE_PAGE_ROWS - 1) / DOC_TABLE_PAGE_ROWS ||
+        header->directory > size || header->directory % DOC_TABLE_ALIGNMENT         ||
+        header->columns > (size - header->directory) / sizeof(table_column_t)
+    ){
+        funmap(base, size);
+        return NULL;
+    }
+
+    doc_table *table = malloc(sizeof(*table));
+    table->base = base;
+    table->size = size;
+    table->header = header;
+    table->columns = (const table_column_t*)(base + header->directory);
+
+    for(size_t i = 0; i < header->columns; i++){                                    // every offset is checked once, so reads trust them
+        const table_column_t *column = &table->columns[i];
+
+        bool valid =    column->name < size && column->name_len < size - column->name && base[column->name + column->name_len] == '\0' &&
+                        column->type <= csv_column_string && column->pages <= size && column->pages % DOC_TABLE_ALIGNMENT == 0 &&
+                        header->pages <= (size - column->pages) / sizeof(table_page_t);
+
+        for(size_t p = 0; valid && p < header->pages; p++){
+            const table_page_t *page = column_pages(table, i) + p;
+            uint64_t rows = p + 1 < header->pages ? DOC_TABLE_PAGE_ROWS : header->rows - p * DOC_TABLE_PAGE_ROWS;
+
+            valid = page->offset <= size && page->len <= size - page->offset && page->offset % DOC_TABLE_ALIGNMENT == 0 &&
+                    page->rows == rows && page->nulls <= rows;
+        }
+
+        if(!valid){
+            doc_table_close(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+// unmap a table
+void doc_table_close(doc_table *table){
+    if(table == NULL) return;
+
+    funmap(table->base, table->size);
+    free(table);
+}
+
+// rows of a table
+size_t doc_table_rows(doc_table *table){
+    return table != NULL ? table->header->rows : 0;
+}
+
+// columns of a table
+size_t doc_table_columns(doc_table *table){
+    return table != NULL ? table->header->columns : 0;
+}
+
+// pages of every column
+size_t doc_table_pages(doc_table *table){
+    return table != NULL ? table->header->pages : 0;
+}
+
+// name of a column
+const char *doc_table_column_name(doc_table *table, size_t column){
+    if(table == NULL || column >= table->header->columns) return NULL;
+
+    return (const char*)(table->base + table->columns[column].name);
+}
+
+// index of a column by name
+int doc_table_column_index(doc_table *table, const char *name){
+    if(table == NULL || name == NULL) return -1;
+
+    for(size_t i = 0; i < table->header->columns; i++){
+        if(!strcmp(doc_table_column_name(table, i), name)) return (int)i;
+    }
+
+    return -1;
+}
+
+// type of a column
+doc_csv_column_type_t doc_table_column_type(doc_table *table, size_t column){
+    if(table == NULL || column >= table->header->columns) return csv_column_string;
+
+    return (doc_csv_column_type_t)table->columns[column].type;
+}
+
+// statistics of a page or column
+bool doc_table_stats(doc_table *table, size_t column, size_t page, doc_table_stats_t *stats){
+    if(table == NULL || stats == NULL || column >= table->header->columns) return false;
+    if(page != DOC_TABLE_ALL_PAGES && page >= table->header->pages) return false;
+
+    const table_page_t *pages = column_pages(table, column);
+    doc_csv_column_type_t type = (doc_csv_column_type_t)table->columns[column].type;
+    size_t first = page == DOC_TABLE_ALL_PAGES ? 0 : page;
+    size_t last = page == DOC_TABLE_ALL_PAGES ? table->header->pages : page + 1;
+
+    *stats = (doc_table_stats_t){ .min_int64 = INT64_MAX, .max_int64 = INT64_MIN, .min_double = INFINITY, .max_double = -INFINITY };
+
+    for(size_t i = first; i < last; i++){
+        stats->rows += pages[i].rows;
+        stats->nulls += pages[i].nulls;
+
+        if(type == csv_column_int64 || type == csv_column_bool){
+            if((int64_t)pages[i].min < stats->min_int64) stats->min_int64 = (int64_t)pages[i].min;
+            if((int64_t)pages[i].max > stats->max_int64) stats->max_int64 = (int64_t)pages[i].max;
+        }
+        else if(type == csv_column_double){
+            double min, max;
+            memcpy(&min, &pages[i].min, sizeof(min));
+            memcpy(&max, &pages[i].max, sizeof(max));
+
+            if(min < stats->min_double) stats->min_double = min;
+            if(max > stats->max_double) stats->max_double = max;
+        }
+    }
+
+    return true;
+}
+
+// read columns of every page
+doc *doc_table_read(doc_table *table, size_t count, const char **names){
+    return doc_table_read_pages(table, 0, DOC_TABLE_ALL_PAGES, count, names);
+}
+
+// read columns of a range of pages
+doc *doc_table_read_pages(doc_table *table, size_t first_page, size_t page_count, size_t count, const char **names){
+    if(table == NULL || (count > 0 && names == NULL)) return NULL;
+
+    size_t pages = table->header->pages;
+
+    if(first_page > pages || (first_page == pages && pages > 0)) return NULL;       // a empty table reads as no rows
+    if(page_count > pages - first_page) page_count = pages - first_page;
+
+    size_t first_row = first_page * DOC_TABLE_PAGE_ROWS;
+    size_t end_row = (first_page + page_count) * DOC_TABLE_PAGE_ROWS;
+    size_t rows = (end_row < table->header->rows ? end_row : table->header->rows) - first_row;
+
+    table_scratch_t scratch = {
+        .values = malloc(DOC_TABLE_PAGE_ROWS * sizeof(int64_t)),
+        .lengths = malloc(DOC_TABLE_PAGE_ROWS * sizeof(int64_t)),
+        .offsets = malloc(DOC_TABLE_PAGE_ROWS * sizeof(uint64_t))
+    };
+
+    doc *columns = doc_new("", dt_obj, ";");
+    doc *last_column = NULL;
+
+    for(size_t i = 0; i < table->header->columns; i++){
+        if(!column_requested(table, i, count, names)) continue;
+
+        doc *column = read_column(table, i, first_page, page_count, rows, &scratch);
+
+        if(column == NULL){
+            doc_delete(columns, ".");
+            columns = NULL;
+            break;
+        }
+
+        link_member(columns, &last_column, column);
+    }
+
+    free(scratch.values);
+    free(scratch.lengths);
+    free(scratch.offsets);
+
+    return columns;
+}
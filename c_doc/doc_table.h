@@ -0,0 +1,167 @@
+#ifndef _DOC_TABLE_HEADER_
+#define _DOC_TABLE_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "doc.h"
+#include "doc_csv.h"
+
+/**
+ * A doc table is a columnar binary file for tabular data, a object of rows with the same cells like the ones
+ * given by doc_csv_parse(), or a columnar doc given by csv_parse_columnar. Every column is cut in pages of
+ * DOC_TABLE_PAGE_ROWS rows and each page is encoded on its own after the type of the column:
+ *
+ *  - int64 values are bit packed as the difference to the smallest value of the page (frame of reference), or
+ *    as the difference to the previous value (delta) when that takes less bits, so ids and timestamps take a
+ *    few bits per row.
+ *  - strings of pages with few distinct values are stored once, with a bit packed code per row (dictionary),
+ *    the other pages keep bit packed lengths and the string bytes.
+ *  - doubles are stored as they are and bools as one bit per row.
+ *
+ * Null cells take one bit of a validity bitmap, left out of pages without nulls. Every page keeps its number
+ * of nulls and the min and max of its values, so pages can be skipped with doc_table_stats() before reading.
+ *
+ * Reading gives the same doc structure as csv_parse_columnar, read with the doc_csv_column_* calls, and only
+ * the requested columns are decoded. The file is memory mapped, so opening it parses nothing.
+ *
+ * Tables are written with the host byte order, a table written on a machine with a different endianness
+ * will fail to open.
+ */
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define DOC_TABLE_MAGIC             "DOCTBL"                                        // magic number at the start of the file
+#define DOC_TABLE_VERSION           (1)                                             // version of the layout
+#define DOC_TABLE_PAGE_ROWS         (1 << 16)                                       // rows of every page but the last one
+#define DOC_TABLE_ALL_PAGES         ((size_t)-1)                                    // page argument of doc_table_stats() for the whole column
+
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief opaque type for a opened doc table
+ */
+typedef struct doc_table doc_table;
+
+/**
+ * @brief statistics of a page or a column of a doc table. When there are no values, all null, min is greater than max
+ */
+typedef struct{
+    uint64_t rows;                                                                  /**< rows covered */
+    uint64_t nulls;                                                                 /**< null cells among them */
+    int64_t min_int64;                                                              /**< smallest value of int64 and bool columns */
+    int64_t max_int64;                                                              /**< biggest value of int64 and bool columns */
+    double min_double;                                                              /**< smallest value of double columns, NaN is left out */
+    double max_double;                                                              /**< biggest value of double columns, NaN is left out */
+}doc_table_stats_t;
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+/**
+ * @brief writes a table as a doc table file
+ * @note with rows, the number of columns is the one of the widest row and a column is named after the first named
+ * cell found in its position. The type of a column is the smallest one that fits all its cells: bool, int64, double or
+ * string, where columns mixing strings with other values hold their text. Null, object, array and binary cells are
+ * null, and so are the missing cells of short rows. Row names are not kept.
+ * @param table_doc: object of rows, or a columnar doc
+ * @param filename: path to the file
+ * @return true on success, false otherwise
+ */
+bool doc_table_write(doc *table_doc, char *filename);
+
+/**
+ * @brief maps a doc table file into memory
+ * @param filename: path to the file
+ * @return a opened table or NULL if the file could not be mapped or is not a valid table
+ */
+doc_table *doc_table_open(char *filename);
+
+/**
+ * @brief unmaps and frees a doc table, docs read from it stay valid
+ * @param table: opened doc table
+ */
+void doc_table_close(doc_table *table);
+
+/**
+ * @brief number of rows of a table
+ * @param table: opened doc table
+ * @return the number of rows
+ */
+size_t doc_table_rows(doc_table *table);
+
+/**
+ * @brief number of columns of a table
+ * @param table: opened doc table
+ * @return the number of columns
+ */
+size_t doc_table_columns(doc_table *table);
+
+/**
+ * @brief number of pages of every column of a table, page p holds the rows from p * DOC_TABLE_PAGE_ROWS
+ * @param table: opened doc table
+ * @return the number of pages
+ */
+size_t doc_table_pages(doc_table *table);
+
+/**
+ * @brief name of a column
+ * @param table: opened doc table
+ * @param column: index of the column
+ * @return null terminated name, pointing inside the mapping, NULL if out of bounds
+ */
+const char *doc_table_column_name(doc_table *table, size_t column);
+
+/**
+ * @brief finds a column by name
+ * @param table: opened doc table
+ * @param name: name of the column
+ * @return index of the first column with that name, -1 if not found
+ */
+int doc_table_column_index(doc_table *table, const char *name);
+
+/**
+ * @brief type of a column
+ * @param table: opened doc table
+ * @param column: index of the column
+ * @return the type, csv_column_string if out of bounds
+ */
+doc_csv_column_type_t doc_table_column_type(doc_table *table, size_t column);
+
+/**
+ * @brief statistics of a page of a column, or of the whole column, without decoding it
+ * @note min and max are only kept for int64, double and bool columns, string columns only give rows and nulls
+ * @param table: opened doc table
+ * @param column: index of the column
+ * @param page: index of the page, DOC_TABLE_ALL_PAGES for the whole column
+ * @param stats: receives the statistics
+ * @return false if column or page is out of bounds
+ */
+bool doc_table_stats(doc_table *table, size_t column, size_t page, doc_table_stats_t *stats);
+
+/**
+ * @brief decodes columns of a table into a columnar doc, see doc_csv_is_columnar()
+ * @param table: opened doc table
+ * @param count: number of names, 0 for every column
+ * @param names: names of the columns to read, read in the order of the file, unknown names are ignored
+ * @return newly allocated doc data structure, NULL on error or if the file is corrupted
+ */
+doc *doc_table_read(doc_table *table, size_t count, const char **names);
+
+/**
+ * @brief same as doc_table_read(), decoding only a range of pages
+ * @param table: opened doc table
+ * @param first_page: first page to read
+ * @param page_count: number of pages, less are read at the end of the table
+ * @param count: number of names, 0 for every column
+ * @param names: names of the columns to read
+ * @return newly allocated doc data structure with the rows of the pages, NULL on error or if first_page is out of bounds
+ */
+doc *doc_table_read_pages(doc_table *table, size_t first_page, size_t page_count, size_t count, const char **names);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
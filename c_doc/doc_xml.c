@@ -1,177 +1,446 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <stdarg.h>
 #include <string.h>
 #include "doc_xml.h"
 #include "parse_utils.h"
 #include "base64.h"
 
-/* ----------------------------------------- Private functions ------------------------------ */
+/* ----------------------------------------- Definitions ------------------------------------ */
 
-static void vprintf_stringify(char **string_start_address, size_t *length, size_t buffer_size, char *format, va_list args){
-    size_t token_size = buffer_size + strlen(format);
-    char *token = calloc(token_size, sizeof(*token));
-    vsnprintf(token, token_size, format, args);
+#define XML_READER_BUFFER_SIZE  (1 << 16)                                           // initial read buffer of a event reader
+#define XML_WRITER_BUFFER_SIZE  (1 << 16)                                           // output flushed to the write function in chunks of this size
+#define XPATH_MAX_PREDICATES    (8)                                                 // predicates of a xpath step
 
-    *length += strlen(token);
-    *string_start_address = realloc(*string_start_address, *length);
-    strcat(*string_start_address, token);
+/* ----------------------------------------- Parser ----------------------------------------- */
+
+// parser state over a stream that is modified in place, values are null terminated where they end
+typedef struct{
+    char *cursor;
+    bool in_situ;                                                                   // string values point into the stream
+    bool at_markup;                                                                 // cursor is past a '<' that was overwritten
+}xml_parser_t;
 
-    free(token);
+// checks for a whitespace char
+static bool is_whitespace(char chr){
+    return chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r' || chr == '\v' || chr == '\f';
 }
 
-static void printf_stringify(char **string_start_address, size_t *length, size_t buffer_size, char *format, ...){
-    va_list args;
-    va_start(args, format);
-    vprintf_stringify(string_start_address, length, buffer_size, format, args);
-    va_end(args);
+// allocate a node with a copy of the first len chars of name
+static doc *new_node(doc_type_t type, size_t size, const char *name, size_t len){
+    doc *variable = calloc(1, size);
+
+    variable->type = type;
+    variable->name = malloc(len + 1);
+    memcpy(variable->name, name, len);
+    variable->name[len] = '\0';
+
+    return variable;
 }
 
-/* ----------------------------------------- Parser ----------------------------------------- */
+// link a member at the end of a obj, tail is the last member
+static void link_member(doc *parent, doc **tail, doc *member){
+    member->parent = parent;
 
-// parse a single value string
-static doc *parse_value(char **stream){
-    run_whitespace(stream);
-    char *value = *stream;
+    if(*tail == NULL){
+        parent->child = member;
+    }
+    else{
+        (*tail)->next = member;
+        member->prev = *tail;
+    }
 
-    *stream = strpbrk(*stream, "<");                                                // find the closing tag or nother tag
-    (*stream)--;
-    run_whitespace_back(stream);
-    (*stream)++;
-    char hold = (**stream);
-    (**stream) = '\0';
+    *tail = member;
+    parent->childs++;
+}
 
-    doc *variable = create_doc_from_string("", value);
+// string value, pointing into the stream when parsing in situ. len counts the null terminator like create_doc_from_string()
+static doc *new_string(const char *name, size_t name_len, char *string, size_t len, bool in_situ){
+    doc *variable = new_node(in_situ ? dt_const_string : dt_string, sizeof(doc_string), name, name_len);
 
-    (**stream) = hold;
+    if(in_situ){
+        ((doc_string*)variable)->string = string;
+    }
+    else{
+        ((doc_string*)variable)->string = malloc(len + 1);
+        memcpy(((doc_string*)variable)->string, string, len + 1);
+    }
+
+    ((doc_string*)variable)->len = len + 1;
 
     return variable;
 }
 
-// parse a atribute inside the tag
-static doc *parse_atribute(char **stream){
-    char *name = *stream;
-    char *marker = strpbrk(*stream, "=");
-    *marker = '\0';
-    marker++;
+// value of a text or atribute, typed like create_doc_from_string(), value is null terminated after len chars
+static doc *new_value(const char *name, size_t name_len, char *value, size_t len, bool in_situ){
+    doc *variable;
 
-    char *value = strpbrk(marker, "\"");
-    value++;
-    marker = strpbrk(value, "\"");
-    *marker = '\0';
+    switch(check_value_type_len(value, len)){
+        case decimal_dt_type_parse_utils:
+            variable = new_node(decimal_dt_type_parse_utils, sizeof(decimal_doc_type_parse_utils), name, name_len);
+            ((decimal_doc_type_parse_utils*)variable)->value = strto_rational_parse_utils(value, NULL);
+        break;
 
-    doc *atribute = create_doc_from_string(name, value);
+        case integer_dt_type_parse_utils:
+            variable = new_node(integer_dt_type_parse_utils, sizeof(integer_doc_type_parse_utils), name, name_len);
+            ((integer_doc_type_parse_utils*)variable)->value = strto_integer_parse_utils(value, NULL);
+        break;
+
+        case dt_bool:
+            variable = new_node(dt_bool, sizeof(doc_bool), name, name_len);
+            ((doc_bool*)variable)->value = (*value == 't');
+        break;
 
-    marker++;
-    *stream = marker;
+        default:
+            variable = new_string(name, name_len, value, len, in_situ);
+        break;
+    }
 
-    return atribute;
+    return variable;
 }
 
-// parse a tag from stream
-static doc *parse_tag(char **stream){
-    char *name = *stream;
+// decodes one entity or character reference into out, up to 4 bytes of UTF-8. Returns the chars it takes, 0 if it
+// is not a known one and is kept as it is
+static size_t decode_entity(const char *entity, const char *end, char *out, size_t *written){
+    static const struct{ const char *name; size_t len; char chr; } named[] = {
+        { "&amp;", 5, '&' }, { "&lt;", 4, '<' }, { "&gt;", 4, '>' }, { "&quot;", 6, '"' }, { "&apos;", 6, '\'' },
+    };
+
+    const char *semicolon = memchr(entity, ';', end - entity < 12 ? (size_t)(end - entity) : 12);
+    if(semicolon == NULL) return 0;
+
+    size_t len = semicolon - entity + 1;
+
+    if(entity[1] != '#'){
+        for(size_t i = 0; i < sizeof(named) / sizeof(*named); i++){
+            if(len == named[i].len && !memcmp(entity, named[i].name, len)){
+                *out = named[i].chr;
+                *written = 1;
+                return len;
+            }
+        }
+
+        return 0;
+    }
+
+    bool hex = (entity[2] == 'x' || entity[2] == 'X');
+    uint32_t code = 0;
+    const char *digit = entity + (hex ? 3 : 2);
+
+    if(digit == semicolon) return 0;
+
+    for(; digit < semicolon; digit++){
+        uint32_t value;
+
+        if(*digit >= '0' && *digit <= '9')                  value = *digit - '0';
+        else if(hex && *digit >= 'a' && *digit <= 'f')      value = *digit - 'a' + 10;
+        else if(hex && *digit >= 'A' && *digit <= 'F')      value = *digit - 'A' + 10;
+        else                                                return 0;
+
+        code = code * (hex ? 16 : 10) + value;
+        if(code > 0x10FFFF) return 0;
+    }
+
+    if(code == 0 || (code >= 0xD800 && code <= 0xDFFF)) return 0;                   // not a char
+
+    if(code < 0x80){
+        out[0] = (char)code;
+        *written = 1;
+    }
+    else if(code < 0x800){
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        *written = 2;
+    }
+    else if(code < 0x10000){
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        *written = 3;
+    }
+    else{
+        out[0] = (char)(0xF0 | (code >> 18));
+        out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (code & 0x3F));
+        *written = 4;
+    }
+
+    return len;
+}
+
+// decodes the entities and character references of a value in place, a value only shrinks so the runs between
+// them are moved at once. Returns the new length, the value is null terminated again when it changes
+static size_t decode_entities(char *value, size_t len){
+    char *end = value + len;
+    char *entity = memchr(value, '&', len);
+
+    if(entity == NULL) return len;                                                  // most values have none
+
+    char *out = entity;
+    char *cursor = entity;
+
+    while(entity != NULL){
+        char decoded[4];
+        size_t written = 0;
+
+        memmove(out, cursor, entity - cursor);
+        out += entity - cursor;
+
+        size_t used = decode_entity(entity, end, decoded, &written);
+
+        if(used == 0){
+            *out++ = '&';
+            cursor = entity + 1;
+        }
+        else{
+            memcpy(out, decoded, written);
+            out += written;
+            cursor = entity + used;
+        }
+
+        entity = memchr(cursor, '&', end - cursor);
+    }
+
+    memmove(out, cursor, end - cursor);
+    out += end - cursor;
+    *out = '\0';
 
-    name = strpbrk(name, "<");
-    if(name == NULL) return NULL;
-    name++;
+    return out - value;
+}
 
-    doc *tag;
-    char *marker;
-    bool self_terminated = false;
-    bool last_atribute = false;
+// moves past the next occurrence of token, or to the end of the stream
+static char *skip_past(char *stream, const char *token){
+    char *found = strstr(stream, token);
+    return found != NULL ? found + strlen(token) : stream + strlen(stream);
+}
 
-    *stream = strpbrk(name, WHITESPACE_PARSE_UTILS ">/");                                        // get name and create doc
-    char hold_char = **stream;
-    (**stream) = '\0';
-    tag = doc_new(name, dt_obj, ";");                               
+// skips a comment, processing instruction or declaration, markup is the char after '<'. Returns false for other markup
+static bool skip_markup(xml_parser_t *parser, char *markup){
+    if(*markup == '?'){                                                             // xml info and processing instructions
+        parser->cursor = skip_past(markup, "?>");
+    }
+    else if(!strncmp(markup, "!--", 3)){
+        parser->cursor = skip_past(markup + 3, "-->");
+    }
+    else if(*markup == '!' && strncmp(markup, "![CDATA[", 8)){                      // doctype, its internal subset may hold '>'
+        char *cursor = markup + strcspn(markup, "[>");
+        if(*cursor == '[') cursor = skip_past(cursor, "]");
 
-    if(hold_char == '/'){
-        (*stream)++;
-        *stream = strpbrk(*stream, ">");
-        (*stream)++;
-        self_terminated = true;
+        parser->cursor = skip_past(cursor, ">");
     }
-    else if(hold_char != '>'){
-        (*stream)++;
-        doc_add(tag, ".", "atributes", dt_obj, ";");
-        while(1){                                                                   // run through atributes
-            run_whitespace(stream);
-            if(**stream == '>'){                                                    // no atributes, just the tag name
-                (*stream)++;
-                break;
+    else{
+        return false;
+    }
+
+    return true;
+}
+
+static doc *parse_element(xml_parser_t *parser, bool *bare_self_closing);
+
+// parse the content of a element up to its closing tag. A self closing tag without atributes takes the
+// member that follows it, text or tag. Top level text and closing tags are skipped
+static void parse_content(xml_parser_t *parser, doc *element, doc **tail, bool top_level, bool single_member){
+    while(1){
+        char *markup;
+
+        if(parser->at_markup){                                                      // the '<' was overwritten by a terminator
+            markup = parser->cursor;
+            parser->at_markup = false;
+        }
+        else{
+            char *text = parser->cursor;
+            markup = strchr(text, '<');
+            if(markup == NULL) markup = text + strlen(text);
+
+            char next = *markup;                                                    // the terminator of the text may overwrite the '<'
+            char *end = markup;
+
+            while(text < end && is_whitespace(*text)) text++;
+            while(end > text && is_whitespace(end[-1])) end--;
+
+            bool has_text = end > text && !top_level;
+
+            if(has_text){
+                *end = '\0';
+                link_member(element, tail, new_value("", 0, text, decode_entities(text, end - text), parser->in_situ));
             }
-            else if(**stream == '/'){                                               // closing tag without a opening tag
-                self_terminated = true;
-                doc_delete(tag, "atributes");
-                *stream = strpbrk(*stream, ">");
-                (*stream)++;
-                return tag;
+
+            if(next == '\0'){
+                parser->cursor = markup;
+                return;
             }
-            else{                                                                   // with atributes
-                doc *atribute = parse_atribute(stream);
-                doc_append(tag, "atributes", atribute);
+
+            markup++;
+
+            if(has_text && single_member){
+                parser->cursor = markup;
+                parser->at_markup = true;
+                return;
+            }
+        }
+
+        if(*markup == '/'){                                                         // closing tag
+            if(single_member){                                                      // left for the parent
+                parser->cursor = markup;
+                parser->at_markup = true;
+                return;
             }
-        }   
+
+            parser->cursor = skip_past(markup, ">");
+            if(top_level) continue;
+            return;
+        }
+
+        if(skip_markup(parser, markup)) continue;
+
+        if(!strncmp(markup, "![CDATA[", 8)){                                        // raw text, as a string
+            char *data = markup + 8;
+            char *data_end = strstr(data, "]]>");
+
+            parser->cursor = data_end != NULL ? data_end + 3 : data + strlen(data);
+            if(data_end == NULL) data_end = parser->cursor;
+
+            *data_end = '\0';
+            if(!top_level) link_member(element, tail, new_string("", 0, data, data_end - data, parser->in_situ));
+        }
+        else{
+            bool bare_self_closing = false;
+            parser->cursor = markup;
+
+            doc *child = parse_element(parser, &bare_self_closing);
+
+            if(child != NULL){
+                doc *child_tail = child->child;
+
+                if(bare_self_closing)
+                    parse_content(parser, child, &child_tail, false, true);
+
+                link_member(element, tail, child);
+            }
+        }
+
+        if(single_member) return;
     }
-    else{
-        (*stream)++;
+}
+
+// parse a tag and its atributes, cursor is at the name and is left after the tag. bare_self_closing tells if it was
+// closed right after the name
+static doc *parse_tag(xml_parser_t *parser, bool *self_closing, bool *bare_self_closing){
+    char *name = parser->cursor;
+    size_t name_len = strcspn(name, WHITESPACE_PARSE_UTILS "/>");
+
+    if(name_len == 0){                                                              // not a tag
+        parser->cursor = skip_past(name, ">");
+        return NULL;
     }
 
-    doc *member;
+    doc *element = new_node(dt_obj, sizeof(doc), name, name_len);
+    doc *tail = NULL;
+    doc *atributes = NULL;
+    doc *atributes_tail = NULL;
+    char *cursor = name + name_len;
+
+    *bare_self_closing = *cursor == '/';
+    *self_closing = false;
+
+    while(1){                                                                       // run through atributes
+        cursor += strspn(cursor, WHITESPACE_PARSE_UTILS);
 
-    while(1){                                                                       // run and parse values and other tags inside the tag 
-        run_whitespace(stream);
+        if(*cursor == '>'){
+            cursor++;
+            break;
+        }
+        else if(*cursor == '/' || *cursor == '\0'){                                // self closing tag
+            parser->cursor = skip_past(cursor, ">");
+            *self_closing = true;
+            return element;
+        }
+
+        char *atribute = cursor;
+        size_t atribute_len = strcspn(cursor, WHITESPACE_PARSE_UTILS "=/>");
+        char *value = "";
+        size_t value_len = 0;
+
+        cursor += atribute_len;
+        cursor += strspn(cursor, WHITESPACE_PARSE_UTILS);
+
+        if(*cursor == '='){
+            cursor++;
+            cursor += strspn(cursor, WHITESPACE_PARSE_UTILS);
+
+            if(*cursor == '"' || *cursor == '\''){
+                char *value_end = strchr(cursor + 1, *cursor);
+
+                value = cursor + 1;
+                value_len = value_end != NULL ? (size_t)(value_end - value) : strlen(value);
+                cursor = value + value_len + (value_end != NULL);
 
-        if((**stream) == '<'){                                                      // tag value
-            if(!self_terminated && (*stream)[1] == '/'){                            // found the closing tag
-                *stream = strpbrk(*stream, ">");
-                (*stream)++;
-                return tag;
-            }                             
-            
-            member = parse_tag(stream);
+                if(value_end != NULL) *value_end = '\0';
+                value_len = decode_entities(value, value_len);
+            }
         }
-        else{                                                                       // value
-            member = parse_value(stream);
+
+        if(atribute_len == 0){                                                      // stray char
+            if(*cursor != '\0' && *cursor != '/' && *cursor != '>') cursor++;
+            continue;
         }
 
-        doc_append(tag, ".", member);
+        if(atributes == NULL){
+            atributes = new_node(dt_obj, sizeof(doc), "atributes", 9);
+            link_member(element, &tail, atributes);
+        }
 
-        if(self_terminated) return tag;
-    }                             
+        link_member(atributes, &atributes_tail, new_value(atribute, atribute_len, value, value_len, parser->in_situ && value_len > 0));
+    }
+
+    parser->cursor = cursor;
+    return element;
 }
 
-// parse a xml file
-static doc *parse_xml(char **stream){
-    if((*stream)[0] == '<' && (*stream)[1] == '?'){                                 // find next tag after xml info
-        (*stream)++;
-        *stream = strpbrk(*stream, "<"); 
+// parse a tag, its atributes and its content
+static doc *parse_element(xml_parser_t *parser, bool *bare_self_closing){
+    bool self_closing = false;
+    doc *element = parse_tag(parser, &self_closing, bare_self_closing);
+
+    if(element != NULL && !self_closing){
+        doc *tail = element->child;                                                 // the atributes, if any
+        parse_content(parser, element, &tail, false, false);
     }
 
+    return element;
+}
+
+// parse a xml stream in place
+static doc *parse_xml(char *stream, bool in_situ){
+    xml_parser_t parser = { .cursor = stream, .in_situ = in_situ, .at_markup = false };
     doc *xml = doc_new("xml", dt_obj, ";");
-    doc *tag;
+    doc *tail = NULL;
 
-    for(tag = parse_tag(stream); tag != NULL; tag = parse_tag(stream)){             // parse through the tags
-        doc_append(xml, ".", tag);
-    }
+    parse_content(&parser, xml, &tail, true, false);
 
     return xml;
 }
 
 // parse all elements inside a xml file
 doc *doc_xml_parse(char *xml_stream){
+    if(xml_stream == NULL) return NULL;
+
     size_t stream_size = strlen(xml_stream);
-    char *stream = (char*)calloc(stream_size + 1, sizeof(char));                    // make a copy before passing to parsers(destructive)
-    char *base_stream = stream;
-    memcpy(stream, xml_stream, stream_size);
-    stream[stream_size] = '\0';
+    char *stream = malloc(stream_size + 1);                                         // values are terminated in place, so a copy is parsed
+    memcpy(stream, xml_stream, stream_size + 1);
+
+    doc *xml = parse_xml(stream, false);
+
+    free(stream);
+    return xml;
+}
 
-    doc *doc_xml = parse_xml(&stream);
+// parse a xml stream in place, strings point into it
+doc *doc_xml_parse_in_situ(char *xml_stream){
+    if(xml_stream == NULL) return NULL;
 
-    free(base_stream);
-    return doc_xml;
+    return parse_xml(xml_stream, true);
 }
 
 // opens and parse a xml file to a doc structure
@@ -181,224 +450,966 @@ doc *doc_xml_open(char *filename){
     }
 
     char *stream = fstream(filename);
+    if(stream == NULL) return NULL;
 
-    doc *xml = doc_xml_parse(stream);
+    doc *xml = parse_xml(stream, false);                                            // the stream is ours, no need for a copy
 
     free(stream);
 
     return xml;
 }
 
-/* ----------------------------------------- Stringifier ------------------------------------ */
+/* ----------------------------------------- Reader ----------------------------------------- */
+
+// event reader, markup is parsed in place in the read buffer
+struct doc_xml_reader{
+    freader_t *file;
+    char *buffer;                                                                   // one spare byte for the terminator after the data
+    size_t size;
+    size_t len;
+    char *cursor;
+    bool at_markup;                                                                 // cursor is past a '<' that was overwritten
+    bool eof;
+    bool error;
+    size_t depth;
+    bool pending_end;                                                               // the element of the last start event was self closing
+    doc *element;                                                                   // element of the last start event
+    doc_xml_event_t event;
+};
+
+// frees the element of a start event, it has no parent and only holds its atributes
+static void free_element(doc *element){
+    for(doc *member = element->child, *next; member != NULL; member = next){
+        next = member->next;
+        free_element(member);
+    }
+
+    if(element->type == dt_string) free(((doc_string*)element)->string);
+
+    free(element->name);
+    free(element);
+}
+
+// end of the markup starting after a '<', NULL if it doesn't end inside the buffer
+static char *markup_end(char *markup, char *end, bool eof){
+    const char *token = NULL;
+
+    if(!eof && end - markup < 9) return NULL;                                       // too short to tell a comment or CDATA
+
+    if(*markup == '?'){
+        token = "?>";
+    }
+    else if(!strncmp(markup, "!--", 3)){
+        markup += 3;
+        token = "-->";
+    }
+    else if(!strncmp(markup, "![CDATA[", 8)){
+        markup += 8;
+        token = "]]>";
+    }
+    else if(*markup == '!'){                                                        // doctype, its internal subset may hold '>'
+        markup += strcspn(markup, "[>");
+        if(*markup == '[' && (markup = strchr(markup, ']')) == NULL) return NULL;
+
+        token = ">";
+    }
+
+    if(token != NULL){
+        char *found = strstr(markup, token);
+        return found != NULL ? found + strlen(token) : NULL;
+    }
+
+    while(1){                                                                       // tags, atribute values may hold '>'
+        markup += strcspn(markup, "\"'>");
+        if(markup >= end) return NULL;
+
+        if(*markup == '>') return markup + 1;
+
+        char *quote = memchr(markup + 1, *markup, end - markup - 1);
+        if(quote == NULL) return NULL;
+
+        markup = quote + 1;
+    }
+}
+
+// keeps the unread data at the start of the buffer and reads after it, the buffer only grows when it is full
+static bool reader_fill(doc_xml_reader *reader){
+    size_t keep = reader->buffer + reader->len - reader->cursor;
+
+    memmove(reader->buffer, reader->cursor, keep);
+    reader->cursor = reader->buffer;
+    reader->len = keep;
+
+    if(reader->len == reader->size){
+        reader->size *= 2;
+        reader->buffer = realloc(reader->buffer, reader->size + 1);
+        reader->cursor = reader->buffer;
+    }
+
+    size_t read = freader_read(reader->file, reader->buffer + reader->len, reader->size - reader->len);
+    if(freader_error(reader->file)){
+        reader->error = true;
+        return false;
+    }
+
+    reader->len += read;
+    reader->eof = (read == 0);
+    reader->buffer[reader->len] = '\0';
+
+    return true;
+}
+
+// checks if the content of the current element ends inside the buffer
+static bool reader_has_element(doc_xml_reader *reader){
+    char *end = reader->buffer + reader->len;
+    char *cursor = reader->cursor;
+    size_t depth = 1;
+
+    while(1){
+        char *markup = memchr(cursor, '<', end - cursor);
+        if(markup == NULL) return false;
+
+        char *after = markup_end(markup + 1, end, reader->eof);
+        if(after == NULL) return false;
+
+        if(markup[1] == '/'){
+            if(--depth == 0) return true;
+        }
+        else if(markup[1] != '?' && markup[1] != '!' && after[-2] != '/'){
+            depth++;
+        }
+
+        cursor = after;
+    }
+}
+
+// sets the event of the reader
+static const doc_xml_event_t *reader_event(doc_xml_reader *reader, doc_xml_event_type_t type, const char *name, const char *text, size_t len){
+    reader->event.type = type;
+    reader->event.name = name;
+    reader->event.text = text;
+    reader->event.len = len;
+    reader->event.atributes = (type == xml_event_start) ? reader->element->child : NULL;  // the only member of a tag is its atributes
+    reader->event.depth = reader->depth;
+
+    return &reader->event;
+}
+
+// creates a reader over a chunked file
+static doc_xml_reader *reader_new(freader_t *file){
+    if(file == NULL) return NULL;
+
+    doc_xml_reader *reader = calloc(1, sizeof(*reader));
+    reader->file = file;
+    reader->size = XML_READER_BUFFER_SIZE;
+    reader->buffer = malloc(reader->size + 1);
+    reader->buffer[0] = '\0';
+    reader->cursor = reader->buffer;
+
+    return reader;
+}
+
+// open a event reader
+doc_xml_reader *doc_xml_reader_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    return reader_new(freader_open(filename));
+}
+
+// event reader over a opened file
+doc_xml_reader *doc_xml_reader_file(FILE *file){
+    if(file == NULL) return NULL;
+
+    return reader_new(freader_file(file));
+}
+
+// next event of a reader
+const doc_xml_event_t *doc_xml_reader_next(doc_xml_reader *reader){
+    if(reader == NULL || reader->error) return NULL;
+
+    if(reader->pending_end){                                                        // the end of a self closing element
+        reader->pending_end = false;
+        reader_event(reader, xml_event_end, reader->element->name, NULL, 0);
+        reader->depth--;
+
+        return &reader->event;
+    }
+
+    if(reader->element != NULL){
+        free_element(reader->element);
+        reader->element = NULL;
+    }
+
+    while(1){
+        char *end = reader->buffer + reader->len;
+
+        if(!reader->at_markup){                                                     // text up to the next markup
+            char *markup = memchr(reader->cursor, '<', end - reader->cursor);
+
+            if(markup == NULL && !reader->eof){
+                if(!reader_fill(reader)) return NULL;
+                continue;
+            }
+
+            char *text = reader->cursor;
+            char *text_end = markup != NULL ? markup : end;
+
+            while(text < text_end && is_whitespace(*text)) text++;
+            while(text_end > text && is_whitespace(text_end[-1])) text_end--;
+
+            reader->cursor = markup != NULL ? markup + 1 : end;
+            reader->at_markup = (markup != NULL);
+
+            if(text < text_end && reader->depth > 0){                               // the terminator may overwrite the '<'
+                *text_end = '\0';
+                return reader_event(reader, xml_event_text, NULL, text, decode_entities(text, text_end - text));
+            }
+
+            if(markup == NULL) return NULL;
+        }
+
+        char *markup = reader->cursor;
+        char *after = markup_end(markup, end, reader->eof);
+
+        if(after == NULL){
+            if(reader->eof){                                                        // truncated markup
+                reader->cursor = end;
+                reader->at_markup = false;
+                return NULL;
+            }
+
+            if(!reader_fill(reader)) return NULL;
+            continue;
+        }
+
+        reader->cursor = after;
+        reader->at_markup = false;
+
+        if(*markup == '/'){                                                         // closing tag
+            if(reader->depth == 0) continue;
+
+            markup++;
+            markup[strcspn(markup, WHITESPACE_PARSE_UTILS ">")] = '\0';
+
+            reader_event(reader, xml_event_end, markup, NULL, 0);
+            reader->depth--;
+
+            return &reader->event;
+        }
+
+        if(!strncmp(markup, "![CDATA[", 8)){                                        // raw text
+            if(reader->depth == 0) continue;
+
+            after[-3] = '\0';
+            return reader_event(reader, xml_event_text, NULL, markup + 8, after - 3 - (markup + 8));
+        }
+
+        if(*markup == '?' || *markup == '!') continue;                              // comments, processing instructions and doctypes
+
+        xml_parser_t parser = { .cursor = markup, .in_situ = false, .at_markup = false };
+        bool self_closing = false, bare_self_closing = false;
+
+        reader->element = parse_tag(&parser, &self_closing, &bare_self_closing);
+        if(reader->element == NULL) continue;
+
+        reader->depth++;
+        reader->pending_end = self_closing;
+
+        return reader_event(reader, xml_event_start, reader->element->name, NULL, 0);
+    }
+}
+
+// reads the element of the last start event
+doc *doc_xml_reader_element(doc_xml_reader *reader){
+    if(reader == NULL || reader->error || reader->element == NULL || reader->event.type != xml_event_start) return NULL;
+
+    doc *element = reader->element;
+    reader->element = NULL;
+    reader->depth--;                                                                // its end is consumed
+
+    if(reader->pending_end){
+        reader->pending_end = false;
+        return element;
+    }
+
+    while(!reader->eof && !reader_has_element(reader)){
+        if(!reader_fill(reader)){
+            free_element(element);
+            return NULL;
+        }
+    }
+
+    xml_parser_t parser = { .cursor = reader->cursor, .in_situ = false, .at_markup = false };
+    doc *tail = element->child;                                                     // the atributes, if any
+
+    parse_content(&parser, element, &tail, false, false);
+    reader->cursor = parser.cursor;
+
+    return element;
+}
+
+// checks if a reader failed
+bool doc_xml_reader_error(doc_xml_reader *reader){
+    return reader == NULL || reader->error;
+}
+
+// close a reader
+void doc_xml_reader_close(doc_xml_reader *reader){
+    if(reader == NULL) return;
+
+    if(reader->element != NULL) free_element(reader->element);
+
+    free(reader->buffer);
+    freader_close(reader->file);
+    free(reader);
+}
 
-// reallocate a output stream and concatenate strings to it 
-static void printf_stringify_value(char **base_address, size_t *length, doc *variable, bool use_tags){
-    char *buffer = NULL;
+/* ----------------------------------------- Writer ----------------------------------------- */
+
+// writer state, output goes through a buffer that is flushed in chunks, or grows when there is no flush function
+typedef struct{
+    wbuffer_t buffer;
+    size_t indent;                                                                  // spaces per level, 0 writes a single line
+}xml_writer_t;
+
+// writes a string replacing the chars that can't be written as they are by entities, quotes only inside
+// atributes. The runs between them are copied at once
+static void write_escaped(xml_writer_t *writer, const char *string, bool atribute){
+    const char *specials = atribute ? "&<>\"" : "&<>";
+
+    while(*string != '\0'){
+        size_t run = strcspn(string, specials);
+
+        if(run > 0){
+            wbuffer_write(&writer->buffer, string, run);
+            string += run;
+        }
+
+        switch(*string){
+            case '&':   wbuffer_write(&writer->buffer, "&amp;", 5);                 break;
+            case '<':   wbuffer_write(&writer->buffer, "&lt;", 4);                  break;
+            case '>':   wbuffer_write(&writer->buffer, "&gt;", 4);                  break;
+            case '"':   wbuffer_write(&writer->buffer, "&quot;", 6);                break;
+            default:    continue;                                                   // end of the string
+        }
+
+        string++;
+    }
+}
+
+// writes the text of a value, objects and arrays have no text
+static void write_value(xml_writer_t *writer, doc *variable, bool atribute){
+    wbuffer_t *buffer = &writer->buffer;
+    char *encoded;
 
     switch(variable->type){
-        case dt_double:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name), "<%s>%.*G</%s>", variable->name, FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_double *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name), "%.*G", FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_double *)(variable))->value);
-        break;
-            
-        case dt_float:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name), "<%s>%.*G</%s>", variable->name, FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_float *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name), "%.*G", FLOAT_DECIMAL_PLACES_PARSE_UTILS, ((doc_float *)(variable))->value);
-        break;
+        case dt_double:     wbuffer_write_double(buffer, ((doc_double*)variable)->value);       break;
+        case dt_float:      wbuffer_write_double(buffer, ((doc_float*)variable)->value);        break;
 
-        case dt_int:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%i</%s>", variable->name, ((doc_int *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int *)(variable))->value);
-        break;
- 
-        case dt_int8:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%i</%s>", variable->name, ((doc_int8_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int8_t *)(variable))->value);
-        break;
- 
-        case dt_int16:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%i</%s>", variable->name, ((doc_int16_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int16_t *)(variable))->value);
-        break;
- 
-        case dt_int32:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%i</%s>", variable->name, ((doc_int32_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int32_t *)(variable))->value);
-        break;
- 
-        case dt_int64:        
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%i</%s>", variable->name, ((doc_int64_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%i", ((doc_int64_t *)(variable))->value);
-        break;
- 
-        case dt_uint:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%u</%s>" , variable->name, ((doc_uint_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint_t *)(variable))->value);
-        break;
- 
-        case dt_uint8:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%u</%s>" , variable->name, ((doc_uint8_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint8_t *)(variable))->value);
-        break;
- 
-        case dt_uint16:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%u</%s>" , variable->name, ((doc_uint16_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint16_t *)(variable))->value);
-        break;
- 
-        case dt_uint32:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%u</%s>" , variable->name, ((doc_uint32_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint32_t *)(variable))->value);
-        break;
- 
-        case dt_uint64:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "<%s>%u</%s>" , variable->name, ((doc_uint64_t *)(variable))->value, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS, "%u", ((doc_uint64_t *)(variable))->value);
-        break;
+        case dt_uint:       wbuffer_write_uint(buffer, ((doc_uint_t*)variable)->value);         break;
+        case dt_uint64:     wbuffer_write_uint(buffer, ((doc_uint64_t*)variable)->value);       break;
+        case dt_uint32:     wbuffer_write_uint(buffer, ((doc_uint32_t*)variable)->value);       break;
+        case dt_uint16:     wbuffer_write_uint(buffer, ((doc_uint16_t*)variable)->value);       break;
+        case dt_uint8:      wbuffer_write_uint(buffer, ((doc_uint8_t*)variable)->value);        break;
 
-        case dt_bool:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + 5, "<%s>%s</%s>", variable->name, (((doc_bool *)(variable))->value) ? "true" : "false", variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + 5, "%s", (((doc_bool *)(variable))->value) ? "true" : "false");
-        break;
+        case dt_int:        wbuffer_write_int(buffer, ((doc_int*)variable)->value);             break;
+        case dt_int64:      wbuffer_write_int(buffer, ((doc_int64_t*)variable)->value);         break;
+        case dt_int32:      wbuffer_write_int(buffer, ((doc_int32_t*)variable)->value);         break;
+        case dt_int16:      wbuffer_write_int(buffer, ((doc_int16_t*)variable)->value);         break;
+        case dt_int8:       wbuffer_write_int(buffer, ((doc_int8_t*)variable)->value);          break;
 
-        case dt_null:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + 4, "<%s>%s</%s>", variable->name, "null", variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + 4, "%s", "null");
-        break;
+        case dt_bool:       wbuffer_puts(buffer, ((doc_bool*)variable)->value ? "true" : "false");  break;
+        case dt_null:       wbuffer_puts(buffer, "null");                                       break;
 
         case dt_string:
         case dt_const_string:
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + ((doc_string *)variable)->len, "<%s>%s</%s>", variable->name, ((doc_string *)variable)->string, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + ((doc_string *)variable)->len, "%s", ((doc_string *)variable)->string);
+            write_escaped(writer, ((doc_string*)variable)->string, atribute);
         break;
 
         case dt_bindata:
-        case dt_const_bindata:
-            buffer = base64_encode(((doc_bindata *)variable)->data, ((doc_bindata *)variable)->len);            
-
-            if(use_tags)
-                printf_stringify(base_address, length, 2*strlen(variable->name) + strlen(buffer), "<%s>%s</%s>", variable->name, buffer, variable->name);
-            else
-                printf_stringify(base_address, length, 2*strlen(variable->name) + strlen(buffer), "%s", buffer);
+        case dt_const_bindata:                                                      // base64 has no special chars
+            encoded = base64_encode(((doc_bindata*)variable)->data, ((doc_bindata*)variable)->len);
+            wbuffer_puts(buffer, encoded);
+            free(encoded);
+        break;
 
-            free(buffer);
+        default:
         break;
     }
 }
 
-// recursive call for generating text based on doc structure
-static void stringify(doc *variable, char **base_address, size_t *length){
+// starts a line at the indentation of a depth
+static void write_line(xml_writer_t *writer, size_t depth){
+    size_t spaces = depth * writer->indent;
+
+    wbuffer_reserve(&writer->buffer, spaces + 1);
+    writer->buffer.data[writer->buffer.len++] = '\n';
+    memset(writer->buffer.data + writer->buffer.len, ' ', spaces);
+    writer->buffer.len += spaces;
+}
 
-    char *value = NULL;
-    doc *member = NULL;
-    size_t value_len;
-    bool first_call = false;
-    bool atributes_tag_jump = false;
+// atributes obj of a element, the parsers put it as the first member so that is checked before
+// looking through the other members, built docs may have it anywhere
+static doc *element_atributes(doc *element){
+    if(element->child != NULL && element->child->type == dt_obj && !strcmp(element->child->name, "atributes"))
+        return element->child;
 
-    if(*base_address == NULL){
-        *base_address = calloc(1, sizeof(**base_address));
-        *length = 1;
-        first_call = true;
+    for(doc_loop(member, element)){
+        if(member->type == dt_obj && !strcmp(member->name, "atributes"))
+            return member;
     }
-    
-    switch(variable->type){
 
-        case dt_obj:
-        case dt_array:
+    return NULL;
+}
+
+// checks if a element has other elements inside, those are put in their own lines when indenting,
+// elements with only text are kept in one line so their text is not changed
+static bool has_elements(doc *element, doc *atributes){
+    for(doc_loop(member, element)){
+        if(member != atributes && member->name[0] != '\0')
+            return true;
+    }
 
-            // put the tag and atributes
-            printf_stringify(base_address, length, strlen(variable->name), "<%s", variable->name);
+    return false;
+}
 
-            doc *atributes = doc_get_ptr(variable, "atributes");
-            if(doc_error_code != errno_doc_value_not_found && atributes != NULL){   
-                for(doc_loop(atribute, atributes)){
-                    printf_stringify(base_address, length, strlen(atribute->name), " %s=\"", atribute->name);
-                    printf_stringify_value(base_address, length, atribute, false);
-                    printf_stringify(base_address, length, 1, "\"");
-                }
-            }
+// recursive call that writes a element, its atributes and its content
+static void write_element(xml_writer_t *writer, doc *variable, size_t depth){
+    wbuffer_putc(&writer->buffer, '<');
+    wbuffer_puts(&writer->buffer, variable->name);
 
-            printf_stringify(base_address, length, 1, ">");
-
-            // generate values and other tags inside the tag
-            for(doc_loop(member, variable)){
-                if(!atributes_tag_jump && !strcmp(member->name, "atributes")){      // if the child isn't the atributes object
-                    atributes_tag_jump = true;
-                    continue;
-                }
-                    
-                if(!strcmp(member->name, "")){
-                    printf_stringify_value(base_address, length, member, false);
-                }
-                else{
-                    stringify(member, base_address, length);
-                }
+    if(variable->type != dt_obj && variable->type != dt_array){
+        wbuffer_putc(&writer->buffer, '>');
+        write_value(writer, variable, false);
+    }
+    else{
+        doc *atributes = element_atributes(variable);
+
+        if(atributes != NULL){
+            for(doc_loop(atribute, atributes)){
+                wbuffer_putc(&writer->buffer, ' ');
+                wbuffer_puts(&writer->buffer, atribute->name);
+                wbuffer_write(&writer->buffer, "=\"", 2);
+                write_value(writer, atribute, true);
+                wbuffer_putc(&writer->buffer, '"');
             }
+        }
 
-            // close tag
-            printf_stringify(base_address, length, strlen(variable->name), "</%s>", variable->name);
+        wbuffer_putc(&writer->buffer, '>');
 
-        break;
+        bool lines = writer->indent > 0 && has_elements(variable, atributes);
 
-        default:
-            printf_stringify_value(base_address, length, variable, true);
-        break;
+        for(doc_loop(member, variable)){
+            if(member == atributes)                                                 // already written in the tag
+                continue;
+
+            if(lines)
+                write_line(writer, depth + 1);
+
+            if(member->name[0] == '\0')
+                write_value(writer, member, false);
+            else
+                write_element(writer, member, depth + 1);
+        }
+
+        if(lines)
+            write_line(writer, depth);
     }
+
+    wbuffer_write(&writer->buffer, "</", 2);
+    wbuffer_puts(&writer->buffer, variable->name);
+    wbuffer_putc(&writer->buffer, '>');
+}
+
+// writes every member of the root as a top level element, each one in its own line when indenting
+static void write_xml(xml_writer_t *writer, doc *xml_doc){
+    for(doc_loop(member, xml_doc)){
+        write_element(writer, member, 0);
+
+        if(writer->indent > 0)
+            wbuffer_putc(&writer->buffer, '\n');
+    }
+}
+
+// write a xml structure to a function as it is made
+bool doc_xml_write(doc *xml_doc, size_t indent, doc_xml_write_function_t write_function, void *context){
+    if(xml_doc == NULL || xml_doc->type != dt_obj || write_function == NULL)
+        return false;
+
+    xml_writer_t writer = {.indent = indent};
+    wbuffer_init(&writer.buffer, XML_WRITER_BUFFER_SIZE, write_function, context);
+
+    write_xml(&writer, xml_doc);
+
+    wbuffer_flush(&writer.buffer);
+    wbuffer_free(&writer.buffer);
+
+    return true;
 }
 
 // main call for xml stringify 
 char *doc_xml_stringify(doc *xml_doc){
-    char *xml_stream = NULL;
-    size_t xml_stream_len = 0;
+    if(xml_doc == NULL || xml_doc->type != dt_obj)
+        return NULL;
+
+    xml_writer_t writer = {.indent = 0};
+    wbuffer_init(&writer.buffer, XML_WRITER_BUFFER_SIZE, NULL, NULL);
+
+    write_xml(&writer, xml_doc);
+
+    return wbuffer_release(&writer.buffer, NULL);
+}
+
+// save doc xml to file, written in chunks as it is made
+void doc_xml_save(doc *xml_doc, char *filename){
+    if(xml_doc == NULL || xml_doc->type != dt_obj)
+        return;
+
+    fsink_t *sink = fsink_open(filename);
+    if(sink == NULL) return;
+
+    doc_xml_write(xml_doc, 0, fsink_write, sink);
+    fsink_close(sink);
+}
+
+/* ----------------------------------------- XPath ------------------------------------------ */
+
+// kind of a predicate of a xpath step
+typedef enum{
+    xpath_predicate_position,                                                       // [n]
+    xpath_predicate_has_atribute,                                                   // [@name]
+    xpath_predicate_atribute_equal,                                                 // [@name='value']
+    xpath_predicate_atribute_not_equal,                                             // [@name!='value']
+}xpath_predicate_type_t;
+
+// predicate of a step, tested in order against the nodes that passed the ones before it
+typedef struct{
+    xpath_predicate_type_t type;
+    size_t position;                                                                // 1 for the first node
+    char *name;                                                                     // atribute name, NULL for '@*'
+    char *value;                                                                    // value compared with the atribute
+}xpath_predicate_t;
+
+// location step of a path
+typedef struct{
+    char *name;                                                                     // name test, NULL for '*'
+    bool descendant;                                                                // after '//', the whole subtree is searched
+    bool atribute;                                                                  // '@' step, selects atributes instead of elements
+    size_t predicate_count;
+    xpath_predicate_t predicates[XPATH_MAX_PREDICATES];
+}xpath_step_t;
+
+struct doc_xpath{
+    bool absolute;                                                                  // starts at the root of the doc
+    size_t step_count;
+    xpath_step_t *steps;
+};
+
+// list of selected nodes
+typedef struct{
+    doc **nodes;
+    size_t len;
+    size_t size;
+}xpath_set_t;
+
+// state of a select
+typedef struct{
+    xpath_set_t *result;
+    xml_writer_t text;                                                              // atributes that are not strings are written here to be compared
+}xpath_select_t;
+
+// checks for a char that can be part of a name
+static bool is_name_char(char chr){
+    return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || (chr >= '0' && chr <= '9') ||
+        chr == '_' || chr == '-' || chr == '.' || chr == ':' || (unsigned char)chr >= 0x80;
+}
+
+// chars that can start a xml name, digits, '-' and '.' can't, so "." and ".." are rejected
+static bool is_name_start_char(char chr){
+    return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || chr == '_' || chr == ':' || (unsigned char)chr >= 0x80;
+}
+
+// skips whitespace of a path
+static void skip_spaces(const char **cursor){
+    while(is_whitespace(**cursor)) (*cursor)++;
+}
+
+// null terminated copy of len chars
+static char *copy_text(const char *text, size_t len){
+    char *copy = malloc(len + 1);
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+
+    return copy;
+}
+
+// reads a name test, '*' gives a NULL name. Returns false if there is no name
+static bool compile_name(const char **cursor, char **name){
+    if(**cursor == '*'){
+        (*cursor)++;
+        *name = NULL;
+        return true;
+    }
+
+    if(!is_name_start_char(**cursor)) return false;
+
+    const char *start = *cursor;
+    while(is_name_char(**cursor)) (*cursor)++;
+
+    *name = copy_text(start, *cursor - start);
+    return true;
+}
+
+// reads a predicate, cursor is past the '[' and is left past the ']'
+static bool compile_predicate(const char **cursor, xpath_predicate_t *predicate){
+    skip_spaces(cursor);
+
+    if(**cursor >= '0' && **cursor <= '9'){
+        char *end;
+        predicate->type = xpath_predicate_position;
+        predicate->position = strtoull(*cursor, &end, 10);
+        *cursor = end;
+
+        if(predicate->position == 0) return false;                                  // positions start at 1
+    }
+    else if(**cursor == '@'){
+        (*cursor)++;
+        if(!compile_name(cursor, &predicate->name)) return false;
+
+        skip_spaces(cursor);
+        predicate->type = xpath_predicate_has_atribute;
+
+        if(**cursor == '=' || (**cursor == '!' && (*cursor)[1] == '=')){
+            predicate->type = (**cursor == '=') ? xpath_predicate_atribute_equal : xpath_predicate_atribute_not_equal;
+            *cursor += (**cursor == '=') ? 1 : 2;
+            skip_spaces(cursor);
+
+            char quote = **cursor;
+            if(quote != '\'' && quote != '"') return false;
+
+            const char *end = strchr(*cursor + 1, quote);
+            if(end == NULL) return false;
+
+            predicate->value = copy_text(*cursor + 1, end - *cursor - 1);
+            *cursor = end + 1;
+        }
+    }
+    else{
+        return false;
+    }
 
-    if(xml_doc->type != dt_obj)
+    skip_spaces(cursor);
+    if(**cursor != ']') return false;
+
+    (*cursor)++;
+    return true;
+}
+
+// reads a location step, cursor is past its '/' or '//'
+static bool compile_step(const char **cursor, xpath_step_t *step){
+    if(**cursor == '@'){
+        (*cursor)++;
+        step->atribute = true;
+        return compile_name(cursor, &step->name);                                   // atributes have no predicates
+    }
+
+    if(!compile_name(cursor, &step->name)) return false;
+
+    while(**cursor == '['){
+        if(step->predicate_count == XPATH_MAX_PREDICATES) return false;
+
+        (*cursor)++;
+        if(!compile_predicate(cursor, &step->predicates[step->predicate_count++])) return false;
+    }
+
+    return true;
+}
+
+// compile a xpath
+doc_xpath *doc_xpath_compile(const char *path){
+    if(path == NULL) return NULL;
+
+    doc_xpath *xpath = calloc(1, sizeof(*xpath));
+    size_t size = 0;
+    bool valid = true;
+
+    skip_spaces(&path);
+
+    if(*path == '/'){
+        xpath->absolute = true;
+
+        if(path[1] == '\0')                                                         // the root itself
+            return xpath;
+    }
+
+    while(1){
+        bool descendant = false;
+
+        if(*path == '/'){
+            path++;
+            descendant = (*path == '/');
+            if(descendant) path++;
+        }
+        else if(xpath->step_count > 0){                                             // the first step of a relative path has no '/'
+            break;
+        }
+
+        if(xpath->step_count > 0 && xpath->steps[xpath->step_count - 1].atribute)   // atributes have nothing inside
+            break;
+
+        if(xpath->step_count == size){
+            size = (size == 0) ? 4 : size * 2;
+            xpath->steps = realloc(xpath->steps, size * sizeof(*xpath->steps));
+        }
+
+        xpath_step_t *step = &xpath->steps[xpath->step_count++];
+        memset(step, 0, sizeof(*step));
+        step->descendant = descendant;
+
+        if(!compile_step(&path, step)){
+            valid = false;
+            break;
+        }
+    }
+
+    skip_spaces(&path);
+
+    if(!valid || *path != '\0'){
+        doc_xpath_free(xpath);
         return NULL;
+    }
 
-    for(doc_loop(member, xml_doc)){
-        stringify(member, &xml_stream, &xml_stream_len);
+    return xpath;
+}
+
+// free a compiled xpath
+void doc_xpath_free(doc_xpath *xpath){
+    if(xpath == NULL) return;
+
+    for(size_t i = 0; i < xpath->step_count; i++){
+        free(xpath->steps[i].name);
+
+        for(size_t j = 0; j < xpath->steps[i].predicate_count; j++){
+            free(xpath->steps[i].predicates[j].name);
+            free(xpath->steps[i].predicates[j].value);
+        }
     }
 
-    return xml_stream;
+    free(xpath->steps);
+    free(xpath);
 }
 
-// save doc xml to file
-void doc_xml_save(doc *xml_doc, char *filename){
-    char *xml = doc_xml_stringify(xml_doc);
+// appends a node to a set
+static void set_push(xpath_set_t *set, doc *node){
+    if(set->len + 1 >= set->size){                                                  // room for the NULL at the end
+        set->size = (set->size == 0) ? 16 : set->size * 2;
+        set->nodes = realloc(set->nodes, set->size * sizeof(*set->nodes));
+    }
+
+    set->nodes[set->len++] = node;
+}
+
+// checks if a node is inside the subtree of other
+static bool is_inside(doc *node, doc *subtree){
+    for(node = node->parent; node != NULL; node = node->parent)
+        if(node == subtree) return true;
+
+    return false;
+}
 
-    if(xml == NULL) return;
+// number of parents of a node
+static size_t node_depth(doc *node){
+    size_t depth = 0;
+
+    for(node = node->parent; node != NULL; node = node->parent)
+        depth++;
+
+    return depth;
+}
+
+// qsort compare of nodes by the order they are in the document, parents before their members
+static int document_order(const void *a, const void *b){
+    doc *x = *(doc **)a;
+    doc *y = *(doc **)b;
+    size_t x_depth = node_depth(x);
+    size_t y_depth = node_depth(y);
+
+    if(x == y) return 0;
+
+    for(; x_depth > y_depth; x_depth--){
+        x = x->parent;
+        if(x == y) return 1;
+    }
+
+    for(; y_depth > x_depth; y_depth--){
+        y = y->parent;
+        if(y == x) return -1;
+    }
+
+    while(x->parent != y->parent){
+        x = x->parent;
+        y = y->parent;
+    }
+
+    for(doc *sibling = x->next; sibling != NULL; sibling = sibling->next)
+        if(sibling == y) return -1;
+
+    return 1;
+}
+
+// compares a atribute with a value, atributes that are not strings are compared as doc_xml_stringify writes them
+static bool atribute_equals(xpath_select_t *select, doc *atribute, const char *value){
+    if(atribute->type == dt_string || atribute->type == dt_const_string)
+        return !strcmp(((doc_string *)atribute)->string, value);
+
+    select->text.buffer.len = 0;
+    write_value(&select->text, atribute, true);
+
+    return select->text.buffer.len == strlen(value) && !memcmp(select->text.buffer.data, value, select->text.buffer.len);
+}
+
+// finds a atribute of a element by name, any one for a NULL name
+static doc *find_atribute(doc *element, const char *name){
+    if(element->type != dt_obj && element->type != dt_array) return NULL;
+
+    doc *atributes = element_atributes(element);
+    if(atributes == NULL) return NULL;
+
+    for(doc *atribute = atributes->child; atribute != NULL; atribute = atribute->next)
+        if(name == NULL || !strcmp(atribute->name, name)) return atribute;
+
+    return NULL;
+}
+
+// tests the predicates of a step on a element, positions counts the elements that reached each predicate
+static bool predicates_match(xpath_select_t *select, const xpath_step_t *step, doc *element, size_t *positions){
+    for(size_t i = 0; i < step->predicate_count; i++){
+        const xpath_predicate_t *predicate = &step->predicates[i];
+        doc *atribute;
+
+        positions[i]++;
+
+        switch(predicate->type){
+            case xpath_predicate_position:
+                if(positions[i] != predicate->position) return false;
+            break;
+
+            case xpath_predicate_has_atribute:
+                if(find_atribute(element, predicate->name) == NULL) return false;
+            break;
+
+            case xpath_predicate_atribute_equal:
+            case xpath_predicate_atribute_not_equal:
+                atribute = find_atribute(element, predicate->name);
+
+                if(atribute == NULL) return false;                                  // a missing atribute is neither equal nor different
+                if(atribute_equals(select, atribute, predicate->value) != (predicate->type == xpath_predicate_atribute_equal)) return false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+// selects the elements of a parent that match a step, and of every element inside it for '//'. The elements are
+// visited in document order and only objects and arrays are entered, values have no elements inside
+static void select_elements(xpath_select_t *select, const xpath_step_t *step, doc *parent){
+    if(parent->type != dt_obj && parent->type != dt_array) return;
+
+    size_t positions[XPATH_MAX_PREDICATES] = {0};
+    doc *atributes = element_atributes(parent);
+
+    for(doc *member = parent->child; member != NULL; member = member->next){
+        if(member == atributes || member->name[0] == '\0')                          // atributes and text are not elements
+            continue;
+
+        if((step->name == NULL || !strcmp(member->name, step->name)) && predicates_match(select, step, member, positions))
+            set_push(select->result, member);
+
+        if(step->descendant)
+            select_elements(select, step, member);
+    }
+}
+
+// selects the atributes of a element that match a step, and of every element inside it for '//'
+static void select_atributes(xpath_select_t *select, const xpath_step_t *step, doc *element){
+    if(element->type != dt_obj && element->type != dt_array) return;
+
+    doc *atributes = element_atributes(element);
+
+    if(atributes != NULL){
+        for(doc *atribute = atributes->child; atribute != NULL; atribute = atribute->next)
+            if(step->name == NULL || !strcmp(atribute->name, step->name))
+                set_push(select->result, atribute);
+    }
+
+    if(!step->descendant) return;
+
+    for(doc *member = element->child; member != NULL; member = member->next)
+        if(member != atributes && member->name[0] != '\0')
+            select_atributes(select, step, member);
+}
+
+// select the nodes of a doc matched by a compiled xpath, one step at a time over the nodes of the step before
+size_t doc_xpath_select(doc *xml_doc, const doc_xpath *xpath, doc ***out){
+    if(out != NULL) *out = NULL;
+    if(xml_doc == NULL || xpath == NULL) return 0;
+
+    if(xpath->absolute)
+        while(xml_doc->parent != NULL) xml_doc = xml_doc->parent;
+
+    xpath_set_t sets[2] = {0};
+    xpath_set_t *context = &sets[0];
+    xpath_select_t select = { .result = &sets[1], .text = { .indent = 0 } };
+
+    wbuffer_init(&select.text.buffer, 64, NULL, NULL);
+    set_push(context, xml_doc);
+
+    for(size_t i = 0; i < xpath->step_count && context->len > 0; i++){
+        const xpath_step_t *step = &xpath->steps[i];
+        doc *subtree = NULL;
+        bool unordered = false;
+
+        select.result->len = 0;
+
+        for(size_t j = 0; j < context->len; j++){
+            doc *node = context->nodes[j];
+
+            if(subtree != NULL && is_inside(node, subtree)){                        // a node found inside a node before it
+                if(step->descendant) continue;                                      // already searched
+
+                unordered = true;                                                   // its elements go among the ones of the node before
+            }
+            else{
+                subtree = node;
+            }
+
+            if(step->atribute)
+                select_atributes(&select, step, node);
+            else
+                select_elements(&select, step, node);
+        }
+
+        if(unordered)
+            qsort(select.result->nodes, select.result->len, sizeof(*select.result->nodes), document_order);
+
+        xpath_set_t *swap = context;
+        context = select.result;
+        select.result = swap;
+    }
+
+    wbuffer_free(&select.text.buffer);
+    free(select.result->nodes);
+
+    size_t len = context->len;
+
+    if(out != NULL && len > 0){
+        context->nodes[len] = NULL;
+        *out = context->nodes;
+    }
+    else{
+        free(context->nodes);
+    }
 
-    FILE *out = fopen(filename, "w+");
-    fprintf(out, xml);
-    fclose(out);
-    free(xml);
+    return len;
 }
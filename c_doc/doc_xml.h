@@ -4,8 +4,47 @@
 extern "C" {
 #endif
 
+#include <stdio.h>
 #include "doc.h"
 
+/* ----------------------------------------- Structs ---------------------------------------- */
+
+/**
+ * @brief reads a xml file one event at a time, see doc_xml_reader_open
+ */
+typedef struct doc_xml_reader doc_xml_reader;
+
+/**
+ * @brief compiled xpath, see doc_xpath_compile
+ */
+typedef struct doc_xpath doc_xpath;
+
+/**
+ * @brief kind of a reader event
+ */
+typedef enum{
+    xml_event_start,                                                                /**< start of a element, self closing ones are followed by their end */
+    xml_event_text,                                                                 /**< text or CDATA inside a element */
+    xml_event_end,                                                                  /**< end of a element */
+}doc_xml_event_type_t;
+
+/**
+ * @brief event given by doc_xml_reader_next, it belongs to the reader and is valid until the next call
+ */
+typedef struct{
+    doc_xml_event_type_t type;                                                      /**< kind of event */
+    const char *name;                                                               /**< name of the element of start and end events, NULL for text */
+    const char *text;                                                               /**< trimmed text of text events with entities decoded, CDATA as it is, NULL otherwise */
+    size_t len;                                                                     /**< length of the text */
+    doc *atributes;                                                                 /**< atributes of start events, like the 'atributes' obj of doc_xml_parse, NULL without atributes */
+    size_t depth;                                                                   /**< depth of the element, 1 for the root, text has the depth of its element */
+}doc_xml_event_t;
+
+/**
+ * @brief type for a function that receives the output of doc_xml_write
+ */
+typedef void (*doc_xml_write_function_t)(void *context, const void *data, size_t len);
+
 /* ----------------------------------------- Functions -------------------------------------- */
 
 /**
@@ -17,7 +56,7 @@ doc *doc_xml_open(char *filename);
 
 /**
  * @brief stringify a xml structure and save it to a file 
- * @note see doc_xml_stringify call.
+ * @note see doc_xml_stringify call. The text is written to the file in chunks of 64KiB as it is made.
  * @param xml_doc: xml doc data structure
  * @param filename: path to the file
  */
@@ -35,17 +74,116 @@ void doc_xml_save(doc *xml_doc, char *filename);
  */
 doc *doc_xml_parse(char *xml_stream);
 
+/**
+ * @brief parse a xml stream in place, same structure as doc_xml_parse without copying the stream
+ * @note the stream is modified, values are null terminated where they end. Text values and atributes
+ * that are not numbers or bools are dt_const_string pointing into the stream, so the stream must be
+ * kept until the doc is deleted and freed by the caller after it, tag names are still copied.
+ * @param xml_stream: mutable stream of the file in memory, like the one given by fstream
+ * @return a doc data structure
+ */
+doc *doc_xml_parse_in_situ(char *xml_stream);
+
+/**
+ * @brief opens a xml file to be read one event at a time, gzip and doc_lz files are decoded on the fly
+ * @note the file is read through a buffer of 64KiB that only grows for a event, or a element read with
+ * doc_xml_reader_element, longer than it, so record oriented files of any size are read in constant memory.
+ * Comments, processing instructions, doctypes and text outside the root are skipped.
+ * @param filename: path to the file
+ * @return the reader, NULL on error
+ */
+doc_xml_reader *doc_xml_reader_open(char *filename);
+
+/**
+ * @brief same as doc_xml_reader_open over a opened file, use fdopen() for a file descriptor
+ * @param file: opened file, it is not closed by doc_xml_reader_close
+ * @return the reader, NULL on error
+ */
+doc_xml_reader *doc_xml_reader_file(FILE *file);
+
+/**
+ * @brief next event of a reader
+ * @param reader: xml reader
+ * @return the event, NULL at the end of the file or on errors
+ */
+const doc_xml_event_t *doc_xml_reader_next(doc_xml_reader *reader);
+
+/**
+ * @brief reads the whole element of the last start event into a doc, with the same structure as a
+ * element of doc_xml_parse, its end event is consumed and the next event is the one after it
+ * @note only the element is held in memory, self closing elements only hold their atributes.
+ * @param reader: xml reader, the last event must be a start event
+ * @return newly allocated element, to be deleted by the caller, NULL if the last event was not a start event
+ */
+doc *doc_xml_reader_element(doc_xml_reader *reader);
+
+/**
+ * @brief checks if the file of a reader could not be read or decoded
+ * @param reader: xml reader
+ * @return true on errors
+ */
+bool doc_xml_reader_error(doc_xml_reader *reader);
+
+/**
+ * @brief closes a reader and frees its memory, including the last event
+ * @param reader: xml reader
+ */
+void doc_xml_reader_close(doc_xml_reader *reader);
 
 /**
  * @brief generate a xml text stream of the data structure
  * @note each value that will become a xml tag must be a object with two members,
  * with one being a object with name 'atributes' that holds the atributes of the tag,
  * and other object with name 'value', that holds the actual value of the tag.
+ * 'atributes' is looked for as the first member first, where the parsers put it.
  * @param xml_doc: pointer to a doc structure
- * @return char string with the xml file
+ * @return char string with the xml file, NULL if xml_doc is not a object
  */
 char *doc_xml_stringify(doc *xml_doc);
 
+/**
+ * @brief writes a xml structure like doc_xml_stringify, passing the text to a function in chunks of 64KiB as it is made
+ * @note with indent, elements that hold other elements have each member in its own line, indented by indent spaces
+ * per level, and elements with only text are kept in one line, so the text reads back the same.
+ * @param xml_doc: pointer to a doc structure
+ * @param indent: spaces per level, 0 writes the whole document in one line like doc_xml_stringify
+ * @param write_function: function that receives the output, a FILE* or file descriptor can be written to from it
+ * @param context: opaque pointer passed to write_function
+ * @return false if xml_doc is not a object or write_function is NULL
+ */
+bool doc_xml_write(doc *xml_doc, size_t indent, doc_xml_write_function_t write_function, void *context);
+
+/**
+ * @brief compiles a xpath to be used with doc_xpath_select, so it is parsed once for any number of selects
+ * @note the supported subset is made of steps separated by '/' for elements of the node before, and '//' for
+ * elements at any depth inside it. Steps are a name or '*', followed by up to 8 predicates: a position, like
+ * [2], counted from 1 among the elements that passed the predicates before it, [@name] for elements with the
+ * atribute, and [@name='value'] or [@name!='value'] to compare it. The last step can be '@name' or '@*' to select
+ * atributes. Paths that start with '/' begin at the root of the doc, the others at the node given to select.
+ * Ex: "/feed/entry[@type='a']/title", "//entry[1]/@id"
+ * @param path: the xpath
+ * @return the compiled xpath, NULL if the path is not valid or not supported
+ */
+doc_xpath *doc_xpath_compile(const char *path);
+
+/**
+ * @brief selects the elements or atributes of a doc structure, with the layout of doc_xml_parse, matched by a xpath
+ * @note elements are the named members of a tag, values included, the 'atributes' object and text are not.
+ * Atributes that are not strings are compared as doc_xml_stringify writes them.
+ * @param xml_doc: doc structure, or a node inside it for relative paths
+ * @param xpath: compiled xpath
+ * @param out: receives a NULL terminated array, in document order, with the nodes found. The nodes belong to the
+ * doc and the array must be freed by the caller. NULL when nothing is found, and can be NULL to just count them
+ * @return the number of nodes found
+ */
+size_t doc_xpath_select(doc *xml_doc, const doc_xpath *xpath, doc ***out);
+
+/**
+ * @brief frees a compiled xpath
+ * @param xpath: compiled xpath
+ */
+void doc_xpath_free(doc_xpath *xpath);
+
 #ifdef __cplusplus 
 }
 #endif
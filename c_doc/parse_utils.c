@@ -1,4 +1,22 @@
 #include "parse_utils.h"
+#include <math.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define FREADER_BUFFER_SIZE         (64 * 1024)                                     // chunk read from the file
+#define INFLATE_WINDOW_SIZE         (32 * 1024)                                     // deflate distances reach this far back
+#define INFLATE_BUFFER_SIZE         (3 * INFLATE_WINDOW_SIZE)                       // history plus up to two windows of new output
+#define INFLATE_MAX_MATCH           (258)
+#define INFLATE_FAST_BITS           (10)                                            // codes up to this length are decoded by a table lookup
 
 /* ----------------------------------------- Globals ---------------------------------------- */
 
@@ -109,6 +127,42 @@ doc_type_t check_value_type(char *value){
     }
 }
 
+// type of len chars of a value in one pass over them, the same as check_value_type(): numbers take digits, signs,
+// points, commas and exponents, each of the last ones only once
+doc_type_t check_value_type_len(const char *value, size_t len){
+    bool integer = true;
+    bool digits = false;
+    unsigned seen = 0;
+
+    if((len == 4 && !memcmp(value, "true", 4)) || (len == 5 && !memcmp(value, "false", 5))) return dt_bool;
+
+    for(size_t i = 0; i < len; i++){
+        unsigned mark;
+
+        if(value[i] >= '0' && value[i] <= '9'){
+            digits = true;
+            continue;
+        }
+
+        switch(value[i]){
+            case '-': mark = 1 << 0;                    break;
+            case '+': mark = 1 << 1;                    break;
+            case '.': mark = 1 << 2; integer = false;   break;
+            case ',': mark = 1 << 3; integer = false;   break;
+            case 'e': mark = 1 << 4; integer = false;   break;
+            case 'E': mark = 1 << 5; integer = false;   break;
+            default: return dt_string;
+        }
+
+        if(seen & mark) return dt_string;
+        seen |= mark;
+    }
+
+    if(!digits) return dt_string;
+
+    return integer ? integer_dt_type_parse_utils : decimal_dt_type_parse_utils;
+}
+
 // create a doc from a string with an appropriate value type
 doc *create_doc_from_string(char *name, char *value_string){
     doc_type_t type = check_value_type(value_string);
@@ -148,21 +202,20 @@ void strcrop(char *string, char *start, char *end){
     strcat(string, end);
 }
 
-// clean a string with line breaking sequence
+// clean a string with line breaking sequence, in one pass copying the chars that are kept
 char *strbreak_clear(char *string){
     char *string_copy = (char*)calloc(strlen(string) + 1, sizeof(char));
-    memcpy(string_copy, string, strlen(string) + 1);
-    
-    for(char *cursor = strpbrk(string_copy, "\\"); cursor != NULL; cursor = strpbrk(string_copy, "\\")){
-        char *start = cursor;
+    char *out = string_copy;
 
-        cursor++;
-        cursor = strpbrk(cursor, "\n");
-        cursor++;
+    for(char *cursor = string; *cursor != '\0'; cursor++){
+        if(*cursor == '\\'){                                                       // dropped up to the line break, included
+            cursor = strchr(cursor, '\n');
+            if(cursor == NULL) break;
 
-        char *end = cursor;
+            continue;
+        }
 
-        strcrop(string_copy, start, end);
+        *out++ = *cursor;
     }
 
     return string_copy;
@@ -170,15 +223,1080 @@ char *strbreak_clear(char *string){
 
 // creates a ASCII stream from a file
 char *fstream(char *filename){
-    FILE *file_p = fopen(filename, "r+b");
+    return (char*)fload(filename, NULL);
+}
+
+// reads a whole file into memory
+void *fload(char *filename, size_t *size){
+    if(filename == NULL) return NULL;
+
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    freader_t *reader = freader_file(file);
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, file_size > 0 ? (size_t)file_size + 2 : FREADER_BUFFER_SIZE, NULL, NULL);
+
+    while(1){                                                                       // compressed files are decoded chunk by chunk
+        if(buffer.size - buffer.len < FREADER_BUFFER_SIZE / 4) wbuffer_reserve(&buffer, FREADER_BUFFER_SIZE);
+
+        size_t wanted = buffer.size - buffer.len - 1;
+        size_t read = freader_read(reader, buffer.data + buffer.len, wanted);
+        buffer.len += read;
+
+        if(read < wanted) break;                                                    // short reads only happen at the end
+    }
+
+    bool error = freader_error(reader);
+    freader_close(reader);
+    fclose(file);
+
+    if(error){
+        wbuffer_free(&buffer);
+        return NULL;
+    }
+
+    return wbuffer_release(&buffer, size);
+}
+
+// check for the extension of compressed files
+static bool has_lz_extension(char *filename){
+    size_t len = strlen(filename);
+    size_t extension_len = strlen(DOC_LZ_EXTENSION);
+
+    return len > extension_len && strcmp(filename + len - extension_len, DOC_LZ_EXTENSION) == 0;
+}
+
+// raw write to the file of a sink
+static void fsink_write_file(void *context, const void *data, size_t len){
+    fsink_t *sink = (fsink_t*)context;
+
+    if(fwrite(data, 1, len, sink->file) != len)
+        sink->error = true;
+}
+
+// opens a file for writing
+fsink_t *fsink_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    FILE *file = fopen(filename, "wb");
+    if(file == NULL) return NULL;
+
+    fsink_t *sink = malloc(sizeof(*sink));
+    sink->file = file;
+    sink->lz = NULL;
+    sink->error = false;
+
+    if(has_lz_extension(filename))
+        sink->lz = doc_lz_writer_new(fsink_write_file, sink, 0);
+
+    return sink;
+}
+
+// writes to a sink
+void fsink_write(void *context, const void *data, size_t len){
+    fsink_t *sink = (fsink_t*)context;
+
+    if(sink->lz != NULL)
+        doc_lz_write(sink->lz, data, len);
+    else
+        fsink_write_file(sink, data, len);
+}
+
+// ends the output and closes the file of a sink
+bool fsink_close(fsink_t *sink){
+    if(sink == NULL) return false;
+
+    if(sink->lz != NULL)
+        doc_lz_writer_close(sink->lz);
+
+    if(fclose(sink->file) != 0)
+        sink->error = true;
+
+    bool ok = !sink->error;
+    free(sink);
+
+    return ok;
+}
+
+// writes a whole file
+bool fsave(char *filename, const void *data, size_t len){
+    fsink_t *sink = fsink_open(filename);
+    if(sink == NULL) return false;
+
+    fsink_write(sink, data, len);
+
+    return fsink_close(sink);
+}
+
+// initializes a write buffer
+void wbuffer_init(wbuffer_t *buffer, size_t size, wbuffer_flush_function_t flush, void *context){
+    if(size < 16) size = 16;
+
+    buffer->data = malloc(size);
+    buffer->len = 0;
+    buffer->size = size;
+    buffer->flush = flush;
+    buffer->context = context;
+}
+
+// makes room for len more bytes, one byte is always kept free for the null terminator
+void wbuffer_reserve(wbuffer_t *buffer, size_t len){
+    if(buffer->len + len < buffer->size) return;
+
+    if(buffer->flush != NULL){
+        wbuffer_flush(buffer);
+
+        if(len < buffer->size) return;
+    }
+
+    size_t size = buffer->size;
+    while(buffer->len + len >= size)
+        size *= 2;
+
+    buffer->data = realloc(buffer->data, size);
+    buffer->size = size;
+}
+
+// appends len bytes to the buffer
+void wbuffer_write(wbuffer_t *buffer, const void *data, size_t len){
+    if(buffer->flush != NULL && len >= buffer->size){                               // big writes go straight to the sink
+        wbuffer_flush(buffer);
+        buffer->flush(buffer->context, data, len);
+        return;
+    }
+
+    if(buffer->len + len >= buffer->size) wbuffer_reserve(buffer, len);
+
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+// appends a null terminated string to the buffer
+void wbuffer_puts(wbuffer_t *buffer, const char *string){
+    wbuffer_write(buffer, string, strlen(string));
+}
+
+// appends a unsigned integer as decimal text
+void wbuffer_write_uint(wbuffer_t *buffer, uint64_t value){
+    char digits[UINT64_MAX_DECIMAL_CHARS_PARSE_UTILS];
+    size_t pos = sizeof(digits);
+
+    do{                                                                             // digits are generated backwards
+        digits[--pos] = '0' + (value % 10);
+        value /= 10;
+    }while(value != 0);
+
+    wbuffer_write(buffer, digits + pos, sizeof(digits) - pos);
+}
+
+// appends a integer as decimal text
+void wbuffer_write_int(wbuffer_t *buffer, int64_t value){
+    if(value < 0){
+        wbuffer_putc(buffer, '-');
+        wbuffer_write_uint(buffer, (uint64_t)0 - (uint64_t)value);                  // well defined for INT64_MIN
+    }
+    else{
+        wbuffer_write_uint(buffer, (uint64_t)value);
+    }
+}
+
+// appends a double as decimal text. A value that is n / 10^k with n below 2^53 is written from n, the division of
+// two exact doubles is correctly rounded like strtod() so the text reads back to the same value
+void wbuffer_write_double(wbuffer_t *buffer, double value){
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+    static const uint64_t integer_powers[] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull };
+    const double exact_limit = 9007199254740992.0;                                  // 2^53
+
+    bool negative = signbit(value);
+    double magnitude = negative ? -value : value;
+
+    for(size_t k = 0; magnitude < exact_limit && k < sizeof(powers) / sizeof(*powers); k++){   // false for inf and nan
+        double scaled = magnitude * powers[k];
+        if(scaled >= exact_limit) break;
+
+        uint64_t n = (uint64_t)(scaled + 0.5);
+        if((double)n / powers[k] != magnitude) continue;
+
+        if(negative) wbuffer_putc(buffer, '-');
+        wbuffer_write_uint(buffer, n / integer_powers[k]);
+        wbuffer_putc(buffer, '.');
+
+        if(k == 0){
+            wbuffer_putc(buffer, '0');
+            return;
+        }
+
+        uint64_t fraction = n % integer_powers[k];
+        char digits[16];
+
+        for(size_t i = k; i > 0; i--){                                              // leading zeros included
+            digits[i - 1] = '0' + (fraction % 10);
+            fraction /= 10;
+        }
+
+        wbuffer_write(buffer, digits, k);
+        return;
+    }
+
+    char number[32];                                                                // 17 digits always read back the same
+    wbuffer_write(buffer, number, snprintf(number, sizeof(number), "%#.17G", value));
+}
+
+// sends the buffered data to the flush function
+void wbuffer_flush(wbuffer_t *buffer){
+    if(buffer->flush == NULL || buffer->len == 0) return;
+
+    buffer->flush(buffer->context, buffer->data, buffer->len);
+    buffer->len = 0;
+}
+
+// returns the buffered data as a null terminated stream
+char *wbuffer_release(wbuffer_t *buffer, size_t *len){
+    buffer->data[buffer->len] = '\0';
+
+    char *data = (char*)buffer->data;
+    if(len != NULL) *len = buffer->len;
+
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->size = 0;
+
+    return data;
+}
+
+// frees the buffer memory
+void wbuffer_free(wbuffer_t *buffer){
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->size = 0;
+}
+
+// flush function for write buffers whose context is a FILE*
+void wbuffer_flush_file(void *context, const void *data, size_t len){
+    fwrite(data, 1, len, (FILE*)context);
+}
+
+// maps a whole file read only into memory
+void *fmap(char *filename, size_t *size){
+    if(filename == NULL || size == NULL) return NULL;
+
+    void *data = NULL;
+    *size = 0;
+
+    #ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file == INVALID_HANDLE_VALUE) return NULL;
+
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0){
+            CloseHandle(file);
+            return NULL;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if(mapping == NULL) return NULL;
+
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);                      // the view keeps the mapping alive
+        CloseHandle(mapping);
+        if(data == NULL) return NULL;
+
+        *size = (size_t)file_size.QuadPart;
+    #else
+        int fd = open(filename, O_RDONLY);
+        if(fd < 0) return NULL;
+
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) < 0 || file_stat.st_size == 0){
+            close(fd);
+            return NULL;
+        }
+
+        data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);  // shared, so processes share the page cache
+        close(fd);
+        if(data == MAP_FAILED) return NULL;
+
+        *size = (size_t)file_stat.st_size;
+    #endif
+
+    return data;
+}
+
+// unmaps a file mapped with fmap()
+void funmap(void *data, size_t size){
+    if(data == NULL) return;
+
+    #ifdef _WIN32
+        UnmapViewOfFile(data);
+    #else
+        munmap(data, size);
+    #endif
+}
+
+// maps a plain file, compressed files are decoded into memory instead
+void *fview(char *filename, size_t *size, bool *mapped){
+    if(filename == NULL || size == NULL || mapped == NULL) return NULL;
+
+    uint8_t *data = fmap(filename, size);
+    *mapped = true;
+
+    if(data != NULL){
+        bool gzip = *size >= 2 && data[0] == 0x1F && data[1] == 0x8B;
+        if(!gzip && !doc_lz_is_frame(data, *size)) return data;
+
+        funmap(data, *size);
+    }
+
+    *mapped = false;
+    return fload(filename, size);                                                   // compressed or empty files
+}
+
+// releases a view returned by fview()
+void fview_release(void *data, size_t size, bool mapped){
+    if(mapped)
+        funmap(data, size);
+    else
+        free(data);
+}
+
+// number of online cpus, at least one
+unsigned cpu_count(void){
+    #ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwNumberOfProcessors > 0 ? (unsigned)info.dwNumberOfProcessors : 1;
+    #else
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        return count > 0 ? (unsigned)count : 1;
+    #endif
+}
+
+/* ----------------------------------------- File Reader ------------------------------------ */
+
+// formats understood by the file reader
+typedef enum{
+    freader_plain,
+    freader_gzip,
+    freader_lz
+}freader_format_t;
+
+// states of the inflate decoder between chunks
+typedef enum{
+    inflate_member,                                                                 // expecting a gzip header
+    inflate_block,                                                                  // expecting a deflate block header
+    inflate_stored,
+    inflate_huffman,
+    inflate_trailer,
+    inflate_done
+}inflate_state_t;
+
+// canonical huffman code
+typedef struct{
+    uint16_t fast[1 << INFLATE_FAST_BITS];                                          // (length << 9) | symbol, by the reversed code
+    uint16_t counts[16];                                                            // codes of each length
+    uint16_t symbols[288];                                                          // symbols ordered by code
+}inflate_table_t;
+
+// chunked reader
+struct freader{
+    FILE *file;
+    bool owns_file;
+    freader_format_t format;
+    bool error;
+
+    uint8_t *input;                                                                 // raw bytes from the file
+    size_t input_pos;
+    size_t input_len;
+
+    const uint8_t *output;                                                          // decoded bytes not read yet
+    size_t output_len;
+
+    // gzip
+    uint64_t bits;                                                                  // bit buffer, lsb first
+    unsigned bit_count;
+    inflate_state_t state;
+    bool last_block;
+    bool first_member;
+    size_t stored_left;
+    uint8_t *window;
+    size_t pos;                                                                     // write position in the window
+    uint32_t crc;
+    uint32_t total;                                                                 // output length modulo 2^32, for the trailer
+    inflate_table_t *literals;
+    inflate_table_t *distances;
+
+    // doc_lz
+    uint8_t *block;                                                                 // block header and payload
+    uint8_t *raw;                                                                   // decompressed block
+    size_t block_size;
+    bool end_mark;                                                                  // the frame ended
+};
+
+static const uint32_t crc32_table[256] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+    0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+    0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+    0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+    0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+    0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+    0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+    0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+    0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+    0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+    0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+    0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+    0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+    0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+    0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+    0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+    0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+    0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+    0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+    0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+    0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+    0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t code_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// update a crc32 with more data
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len){
+    crc = ~crc;
+
+    for(size_t i = 0; i < len; i++)
+        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+// read more of the file when the input is empty, false at the end of the file
+static bool input_fill(freader_t *reader){
+    if(reader->input_pos < reader->input_len) return true;
+
+    reader->input_pos = 0;
+    reader->input_len = fread(reader->input, 1, FREADER_BUFFER_SIZE, reader->file);
+
+    return reader->input_len > 0;
+}
+
+// read exactly len bytes of the file
+static bool input_read(freader_t *reader, void *data, size_t len){
+    uint8_t *out = (uint8_t*)data;
+
+    while(len > 0){
+        if(!input_fill(reader)) return false;
+
+        size_t chunk = reader->input_len - reader->input_pos;
+        if(chunk > len) chunk = len;
+
+        memcpy(out, reader->input + reader->input_pos, chunk);
+        reader->input_pos += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+
+    return true;
+}
+
+// load bits while there is input, without failing at the end
+static inline void bits_refill(freader_t *reader){
+    while(reader->bit_count <= 56){
+        if(reader->input_pos == reader->input_len && !input_fill(reader)) return;
+
+        reader->bits |= (uint64_t)reader->input[reader->input_pos++] << reader->bit_count;
+        reader->bit_count += 8;
+    }
+}
+
+// take n bits, up to 32. Running out of input is an error
+static inline uint32_t bits_get(freader_t *reader, unsigned n){
+    if(reader->bit_count < n){
+        bits_refill(reader);
+
+        if(reader->bit_count < n){
+            reader->error = true;
+            return 0;
+        }
+    }
+
+    uint32_t value = (uint32_t)(reader->bits & ((1ull << n) - 1));
+    reader->bits >>= n;
+    reader->bit_count -= n;
+
+    return value;
+}
+
+// skip to the next byte boundary
+static inline void bits_align(freader_t *reader){
+    reader->bits >>= reader->bit_count % 8;
+    reader->bit_count -= reader->bit_count % 8;
+}
+
+// build a canonical huffman table from the code lengths, false if over subscribed
+static bool inflate_build(inflate_table_t *table, const uint8_t *lengths, size_t symbols){
+    uint16_t offsets[16];
+    int left = 1;
+
+    memset(table->counts, 0, sizeof(table->counts));
+    for(size_t i = 0; i < symbols; i++)
+        table->counts[lengths[i]]++;
+    table->counts[0] = 0;
+
+    for(int len = 1; len < 16; len++){
+        left <<= 1;
+        left -= table->counts[len];
+        if(left < 0) return false;
+    }
+
+    offsets[1] = 0;
+    for(int len = 1; len < 15; len++)
+        offsets[len + 1] = offsets[len] + table->counts[len];
+
+    for(size_t i = 0; i < symbols; i++)
+        if(lengths[i] != 0)
+            table->symbols[offsets[lengths[i]]++] = (uint16_t)i;
+
+    memset(table->fast, 0, sizeof(table->fast));
+
+    uint32_t code = 0;
+    size_t index = 0;
+
+    for(int len = 1; len <= INFLATE_FAST_BITS; len++){                               // codes are assigned in order, stored bit reversed
+        for(uint16_t i = 0; i < table->counts[len]; i++, index++, code++){
+            uint32_t reversed = 0;
+            for(int bit = 0; bit < len; bit++)
+                reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+
+            for(uint32_t fill = reversed; fill < (1u << INFLATE_FAST_BITS); fill += 1u << len)
+                table->fast[fill] = (uint16_t)((len << 9) | table->symbols[index]);
+        }
+
+        code <<= 1;
+    }
+
+    return true;
+}
+
+// decode a symbol, -1 on error
+static int inflate_decode(freader_t *reader, const inflate_table_t *table){
+    if(reader->bit_count < 15) bits_refill(reader);
+
+    uint16_t entry = table->fast[reader->bits & ((1u << INFLATE_FAST_BITS) - 1)];
+
+    if(entry != 0 && (unsigned)(entry >> 9) <= reader->bit_count){
+        reader->bits >>= entry >> 9;
+        reader->bit_count -= entry >> 9;
+        return entry & 0x1FF;
+    }
+
+    int code = 0, first = 0, index = 0;                                             // long codes, one bit at a time
+
+    for(int len = 1; len < 16; len++){
+        code |= (int)bits_get(reader, 1);
+        if(reader->error) return -1;
+
+        int count = table->counts[len];
+        if(code - count < first) return table->symbols[index + (code - first)];
+
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    return -1;
+}
+
+// read the header of a gzip member, false at the end of the file
+static bool inflate_read_member(freader_t *reader){
+    bits_align(reader);
+    bits_refill(reader);
+
+    if(reader->bit_count == 0){                                                     // no more members
+        if(reader->first_member) reader->error = true;
+        return false;
+    }
+
+    uint32_t magic = bits_get(reader, 16);
+    if(magic != 0x8B1F){
+        if(reader->first_member) reader->error = true;                              // garbage after the last member is ignored
+        return false;
+    }
+
+    uint32_t method = bits_get(reader, 8);
+    uint32_t flags = bits_get(reader, 8);
+    bits_get(reader, 32);                                                           // mtime
+    bits_get(reader, 16);                                                           // extra flags and os
+
+    if(method != 8){
+        reader->error = true;
+        return false;
+    }
+
+    if(flags & 0x04){                                                               // extra field
+        uint32_t len = bits_get(reader, 16);
+        while(len-- > 0 && !reader->error) bits_get(reader, 8);
+    }
+
+    if(flags & 0x08)                                                                // file name
+        while(bits_get(reader, 8) != 0 && !reader->error);
+
+    if(flags & 0x10)                                                                // comment
+        while(bits_get(reader, 8) != 0 && !reader->error);
+
+    if(flags & 0x02)                                                                // header crc
+        bits_get(reader, 16);
+
+    reader->first_member = false;
+    reader->last_block = false;
+    reader->crc = 0;
+    reader->total = 0;
+
+    return !reader->error;
+}
+
+// read the header of a deflate block and its tables
+static void inflate_read_block(freader_t *reader){
+    reader->last_block = bits_get(reader, 1);
+    uint32_t type = bits_get(reader, 2);
+
+    if(type == 0){                                                                  // stored
+        bits_align(reader);
+        uint32_t len = bits_get(reader, 16);
+        uint32_t nlen = bits_get(reader, 16);
+
+        if(len != (~nlen & 0xFFFF)){
+            reader->error = true;
+            return;
+        }
+
+        reader->stored_left = len;
+        reader->state = inflate_stored;
+        return;
+    }
+
+    uint8_t lengths[288 + 32];
+
+    if(type == 1){                                                                  // fixed codes
+        size_t i = 0;
+        for(; i < 144; i++) lengths[i] = 8;
+        for(; i < 256; i++) lengths[i] = 9;
+        for(; i < 280; i++) lengths[i] = 7;
+        for(; i < 288; i++) lengths[i] = 8;
+        for(i = 0; i < 30; i++) lengths[288 + i] = 5;
+
+        inflate_build(reader->literals, lengths, 288);
+        inflate_build(reader->distances, lengths + 288, 30);
+
+        reader->state = inflate_huffman;
+        return;
+    }
+
+    if(type != 2){
+        reader->error = true;
+        return;
+    }
+
+    size_t literal_count = bits_get(reader, 5) + 257;                               // dynamic codes
+    size_t distance_count = bits_get(reader, 5) + 1;
+    size_t code_count = bits_get(reader, 4) + 4;
+    uint8_t code_lengths[19] = {0};
+
+    if(literal_count > 286 || distance_count > 30){
+        reader->error = true;
+        return;
+    }
+
+    for(size_t i = 0; i < code_count; i++)
+        code_lengths[code_length_order[i]] = (uint8_t)bits_get(reader, 3);
+
+    if(reader->error || !inflate_build(reader->distances, code_lengths, 19)){       // distances table borrowed for the code lengths
+        reader->error = true;
+        return;
+    }
+
+    for(size_t i = 0; i < literal_count + distance_count;){
+        int symbol = inflate_decode(reader, reader->distances);
+        size_t repeat;
+        uint8_t value = 0;
+
+        if(symbol < 0){
+            reader->error = true;
+            return;
+        }
+
+        if(symbol < 16){
+            lengths[i++] = (uint8_t)symbol;
+            continue;
+        }
+
+        if(symbol == 16){
+            if(i == 0){
+                reader->error = true;
+                return;
+            }
+
+            value = lengths[i - 1];
+            repeat = 3 + bits_get(reader, 2);
+        }
+        else if(symbol == 17){
+            repeat = 3 + bits_get(reader, 3);
+        }
+        else{
+            repeat = 11 + bits_get(reader, 7);
+        }
+
+        if(i + repeat > literal_count + distance_count){
+            reader->error = true;
+            return;
+        }
+
+        while(repeat-- > 0) lengths[i++] = value;
+    }
+
+    if( lengths[256] == 0 ||
+        !inflate_build(reader->literals, lengths, literal_count) ||
+        !inflate_build(reader->distances, lengths + literal_count, distance_count)
+    ){
+        reader->error = true;
+        return;
+    }
+
+    reader->state = inflate_huffman;
+}
+
+// decode compressed data of a block until the window is full or the block ends
+static void inflate_huffman_data(freader_t *reader){
+    size_t limit = INFLATE_BUFFER_SIZE - INFLATE_MAX_MATCH;
+    uint8_t *window = reader->window;
+
+    while(reader->pos < limit){
+        int symbol = inflate_decode(reader, reader->literals);
+
+        if(symbol < 256){
+            if(symbol < 0){
+                reader->error = true;
+                return;
+            }
+
+            window[reader->pos++] = (uint8_t)symbol;
+            continue;
+        }
+
+        if(symbol == 256){
+            reader->state = reader->last_block ? inflate_trailer : inflate_block;
+            return;
+        }
+
+        symbol -= 257;
+        if(symbol >= 29){
+            reader->error = true;
+            return;
+        }
+
+        size_t len = length_base[symbol] + bits_get(reader, length_extra[symbol]);
+
+        int distance_symbol = inflate_decode(reader, reader->distances);
+        if(distance_symbol < 0 || distance_symbol >= 30){
+            reader->error = true;
+            return;
+        }
+
+        size_t distance = distance_base[distance_symbol] + bits_get(reader, distance_extra[distance_symbol]);
+
+        if(distance > reader->pos || reader->error){
+            reader->error = true;
+            return;
+        }
+
+        uint8_t *out = window + reader->pos;
+        const uint8_t *match = out - distance;
+
+        if(distance >= len){
+            memcpy(out, match, len);
+        }
+        else{
+            for(size_t i = 0; i < len; i++)
+                out[i] = match[i];
+        }
+
+        reader->pos += len;
+    }
+}
+
+// decode the next chunk of a gzip file
+static bool fill_gzip(freader_t *reader){
+    if(reader->pos >= 2 * INFLATE_WINDOW_SIZE){                                     // keep only the history the distances can reach
+        memmove(reader->window, reader->window + reader->pos - INFLATE_WINDOW_SIZE, INFLATE_WINDOW_SIZE);
+        reader->pos = INFLATE_WINDOW_SIZE;
+    }
+
+    size_t start = reader->pos;
+
+    while(!reader->error && reader->pos == start){
+        switch(reader->state){
+            case inflate_member:
+                if(!inflate_read_member(reader)){
+                    reader->state = inflate_done;
+                    break;
+                }
+
+                reader->state = inflate_block;
+            break;
+
+            case inflate_block:
+                inflate_read_block(reader);
+            break;
+
+            case inflate_stored:
+                {
+                    size_t chunk = INFLATE_BUFFER_SIZE - reader->pos;
+                    if(chunk > reader->stored_left) chunk = reader->stored_left;
+
+                    while(chunk > 0 && reader->bit_count >= 8){                     // bytes already in the bit buffer
+                        reader->window[reader->pos++] = (uint8_t)bits_get(reader, 8);
+                        reader->stored_left--;
+                        chunk--;
+                    }
+
+                    if(!input_read(reader, reader->window + reader->pos, chunk)){
+                        reader->error = true;
+                        break;
+                    }
+
+                    reader->pos += chunk;
+                    reader->stored_left -= chunk;
+
+                    if(reader->stored_left == 0)
+                        reader->state = reader->last_block ? inflate_trailer : inflate_block;
+                }
+            break;
+
+            case inflate_huffman:
+                inflate_huffman_data(reader);
+            break;
+
+            case inflate_trailer:
+                bits_align(reader);
+
+                if(bits_get(reader, 32) != reader->crc || bits_get(reader, 32) != reader->total){
+                    reader->error = true;
+                    break;
+                }
+
+                reader->state = inflate_member;                                     // gzip files may have several members
+            break;
+
+            case inflate_done:
+                return false;
+        }
+    }
+
+    if(reader->error) return false;
+
+    reader->output = reader->window + start;
+    reader->output_len = reader->pos - start;
+    reader->crc = crc32_update(reader->crc, reader->output, reader->output_len);
+    reader->total += (uint32_t)reader->output_len;
+
+    return true;
+}
+
+// decompress the next block of a doc_lz frame
+static bool fill_lz(freader_t *reader){
+    if(reader->end_mark) return false;
+
+    if(reader->block == NULL){
+        uint8_t header[8];
+
+        if(!input_read(reader, header, sizeof(header)) || !doc_lz_is_frame(header, sizeof(header))){
+            reader->error = true;
+            return false;
+        }
+
+        reader->block_size = (size_t)header[4] | ((size_t)header[5] << 8) | ((size_t)header[6] << 16) | ((size_t)header[7] << 24);
+
+        if(reader->block_size == 0 || reader->block_size > DOC_LZ_MAX_BLOCK_SIZE){
+            reader->error = true;
+            return false;
+        }
+
+        reader->block = malloc(reader->block_size + 8);
+        reader->raw = malloc(reader->block_size);
+    }
+
+    uint8_t *header = reader->block;
+
+    if(!input_read(reader, header, 4)){
+        reader->error = true;
+        return false;
+    }
+
+    uint32_t len = (uint32_t)header[0] | ((uint32_t)header[1] << 8) | ((uint32_t)header[2] << 16) | ((uint32_t)header[3] << 24);
+    if(len == 0){                                                                   // end mark
+        reader->end_mark = true;
+        return false;
+    }
+
+    len &= 0x7FFFFFFF;                                                              // without the stored flag
+
+    if(len > reader->block_size || !input_read(reader, header + 4, len + 4)){
+        reader->error = true;
+        return false;
+    }
+
+    const uint8_t *cursor = reader->block;
+    doc_lz_block block;
+
+    if( !doc_lz_frame_next(&cursor, reader->block + 8 + len, &block) || block.raw_len > reader->block_size ||
+        !doc_lz_block_decompress(&block, reader->raw)
+    ){
+        reader->error = true;
+        return false;
+    }
+
+    reader->output = reader->raw;
+    reader->output_len = block.raw_len;
+
+    return true;
+}
+
+// reader over a open file
+freader_t *freader_file(FILE *file){
+    if(file == NULL) return NULL;
+
+    freader_t *reader = calloc(1, sizeof(*reader));
+    reader->file = file;
+    reader->input = malloc(FREADER_BUFFER_SIZE);
+    reader->format = freader_plain;
+
+    if(input_fill(reader)){                                                         // sniff the format
+        uint8_t *magic = reader->input;
+        size_t len = reader->input_len;
+
+        if(len >= 2 && magic[0] == 0x1F && magic[1] == 0x8B){
+            reader->format = freader_gzip;
+            reader->state = inflate_member;
+            reader->first_member = true;
+            reader->window = malloc(INFLATE_BUFFER_SIZE);
+            reader->literals = malloc(sizeof(inflate_table_t));
+            reader->distances = malloc(sizeof(inflate_table_t));
+        }
+        else if(doc_lz_is_frame(magic, len)){
+            reader->format = freader_lz;
+        }
+    }
+
+    return reader;
+}
+
+// opens a file for reading
+freader_t *freader_open(char *filename){
+    if(filename == NULL) return NULL;
+
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) return NULL;
+
+    freader_t *reader = freader_file(file);
+    reader->owns_file = true;
+
+    return reader;
+}
+
+// reads the next decoded bytes
+size_t freader_read(freader_t *reader, void *data, size_t len){
+    if(reader == NULL) return 0;
+
+    uint8_t *out = (uint8_t*)data;
+    size_t total = 0;
+
+    while(total < len && !reader->error){
+        if(reader->output_len == 0){
+            if(reader->format == freader_plain){                                    // plain files skip the chunk buffer
+                if(reader->input_pos < reader->input_len){
+                    reader->output = reader->input + reader->input_pos;
+                    reader->output_len = reader->input_len - reader->input_pos;
+                    reader->input_pos = reader->input_len;
+                    continue;
+                }
+
+                size_t read = fread(out + total, 1, len - total, reader->file);
+                total += read;
+
+                if(read == 0) break;
+                continue;
+            }
+
+            bool more = reader->format == freader_gzip ? fill_gzip(reader) : fill_lz(reader);
+            if(!more) break;
+            continue;
+        }
+
+        size_t chunk = reader->output_len;
+        if(chunk > len - total) chunk = len - total;
+
+        memcpy(out + total, reader->output, chunk);
+        reader->output += chunk;
+        reader->output_len -= chunk;
+        total += chunk;
+    }
+
+    return total;
+}
+
+// checks if the input was malformed or truncated
+bool freader_error(freader_t *reader){
+    return reader == NULL || reader->error || ferror(reader->file);
+}
 
-    fseek(file_p, 0, SEEK_END);
-    long file_p_size = ftell(file_p) + 1;
-    fseek(file_p, 0, SEEK_SET);
+// frees the reader
+void freader_close(freader_t *reader){
+    if(reader == NULL) return;
 
-    char *file_stream = (char*)calloc(file_p_size, sizeof(char));
-    fread(file_stream, sizeof(char), file_p_size, file_p);
-    fclose(file_p);
+    if(reader->owns_file)
+        fclose(reader->file);
 
-    return file_stream;
+    free(reader->input);
+    free(reader->window);
+    free(reader->literals);
+    free(reader->distances);
+    free(reader->block);
+    free(reader->raw);
+    free(reader);
 }
@@ -9,6 +9,7 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 #include "doc.h"
+#include "doc_lz.h"
 
 /* ----------------------------------------- Definitions ------------------------------------ */
 
@@ -17,6 +18,31 @@ extern "C" {
 
 #define WHITESPACE_PARSE_UTILS  " \t\n\r\v\f"                                       // white space chars
 
+/* ----------------------------------------- Typedef's ---------------------------------------- */
+
+// function called when a write buffer is full or flushed, context is the one passed to wbuffer_init()
+typedef void (*wbuffer_flush_function_t)(void *context, const void *data, size_t len);
+
+// growable output buffer, appends are amortized O(1). With a flush function the buffer has a fixed size
+// and is emptied to the flush function when full, without one it grows and holds the whole output
+typedef struct{
+    uint8_t *data;
+    size_t len;
+    size_t size;
+    wbuffer_flush_function_t flush;
+    void *context;
+}wbuffer_t;
+
+// chunked file reader, decodes gzip and doc_lz files transparently
+typedef struct freader freader_t;
+
+// output file, written as a doc_lz frame when the filename ends with DOC_LZ_EXTENSION
+typedef struct{
+    FILE *file;
+    doc_lz_writer *lz;
+    bool error;
+}fsink_t;
+
 /* ----------------------------------------- Globals ---------------------------------------- */
 
 extern const char *NUMBER_INTEGER_ALPHABET;
@@ -67,6 +93,9 @@ bool str_is_number(char *string);
 // check the value of a string representation of the value
 doc_type_t check_value_type(char *value);
 
+// check the value type of the first len chars of a string, in one pass, same types as check_value_type()
+doc_type_t check_value_type_len(const char *value, size_t len);
+
 // create a doc from a string with an appropriate value type
 doc *create_doc_from_string(char *name, char *value_string);
 
@@ -76,9 +105,97 @@ void strcrop(char *string, char *start, char *end);
 // clean a string with line breaking sequence
 char *strbreak_clear(char *string);
 
-// creates a ASCII stream from a file
+// creates a ASCII stream from a file, compressed files are decompressed. Returns NULL if the file can't be read
 char *fstream(char *filename);
 
+// reads a whole file into memory, null terminated, compressed files are decompressed. The length is written to *size if not NULL
+void *fload(char *filename, size_t *size);
+
+// opens a file for chunked reading, the format is detected from the first bytes: gzip, doc_lz frame or plain
+freader_t *freader_open(char *filename);
+
+// chunked reader over a open file, the file is not closed by freader_close()
+freader_t *freader_file(FILE *file);
+
+// reads up to len decoded bytes, returns less only at the end of the data or on error
+size_t freader_read(freader_t *reader, void *data, size_t len);
+
+// checks if the file was malformed, truncated or could not be read
+bool freader_error(freader_t *reader);
+
+// closes the reader
+void freader_close(freader_t *reader);
+
+// opens a file for writing, compressing the output when the filename ends with DOC_LZ_EXTENSION
+fsink_t *fsink_open(char *filename);
+
+// writes to a sink, matches wbuffer_flush_function_t so a sink can be the context of a write buffer
+void fsink_write(void *context, const void *data, size_t len);
+
+// ends the output and closes the file, returns false if any write failed
+bool fsink_close(fsink_t *sink);
+
+// writes a whole file through a sink, returns false on error
+bool fsave(char *filename, const void *data, size_t len);
+
+// initializes a write buffer, flush can be NULL to accumulate the whole output in memory
+void wbuffer_init(wbuffer_t *buffer, size_t size, wbuffer_flush_function_t flush, void *context);
+
+// makes room for at least len more bytes, flushing or growing the buffer
+void wbuffer_reserve(wbuffer_t *buffer, size_t len);
+
+// appends len bytes to the buffer
+void wbuffer_write(wbuffer_t *buffer, const void *data, size_t len);
+
+// appends a null terminated string to the buffer
+void wbuffer_puts(wbuffer_t *buffer, const char *string);
+
+// appends a integer as decimal text, without printf
+void wbuffer_write_int(wbuffer_t *buffer, int64_t value);
+
+// appends a unsigned integer as decimal text, without printf
+void wbuffer_write_uint(wbuffer_t *buffer, uint64_t value);
+
+// appends a double as the shortest decimal text that reads back to the same value, always with a dot or exponent.
+// Values with up to 15 fraction digits and below 2^53 are written without printf
+void wbuffer_write_double(wbuffer_t *buffer, double value);
+
+// sends the buffered data to the flush function, if any
+void wbuffer_flush(wbuffer_t *buffer);
+
+// returns the buffered data as a null terminated stream, the buffer is left empty and the caller owns the data
+char *wbuffer_release(wbuffer_t *buffer, size_t *len);
+
+// frees the buffer memory
+void wbuffer_free(wbuffer_t *buffer);
+
+// flush function for write buffers whose context is a FILE*
+void wbuffer_flush_file(void *context, const void *data, size_t len);
+
+// maps a whole file read only into memory, the file size is written to *size. Returns NULL on error or empty files
+void *fmap(char *filename, size_t *size);
+
+// unmaps a file mapped with fmap()
+void funmap(void *data, size_t size);
+
+// maps a plain file like fmap(), gzip and doc_lz files are decoded into memory like fload(). *mapped tells how
+// the data must be released. Returns NULL on error, empty files give a empty stream
+void *fview(char *filename, size_t *size, bool *mapped);
+
+// releases a view returned by fview()
+void fview_release(void *data, size_t size, bool mapped);
+
+// number of online cpus, at least one
+unsigned cpu_count(void);
+
+/* ----------------------------------------- Inline Functions ------------------------------- */
+
+// appends a single byte to a write buffer
+static inline void wbuffer_putc(wbuffer_t *buffer, char chr){
+    if(buffer->len + 1 >= buffer->size) wbuffer_reserve(buffer, 1);
+    buffer->data[buffer->len++] = (uint8_t)chr;
+}
+
 #ifdef __cplusplus 
 }
 #endif
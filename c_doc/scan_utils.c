@@ -0,0 +1,174 @@
+#include <string.h>
+#include "scan_utils.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(SCAN_UTILS_NO_SIMD)
+    #define SCAN_X86
+    #include <immintrin.h>
+#endif
+
+/* ----------------------------------------- Private Typedef's -------------------------------- */
+
+typedef void (*scan_masks_function_t)(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks);
+
+/* ----------------------------------------- Private Functions ------------------------------ */
+
+// portable scanner, one table lookup per byte and set
+static void scan_masks_scalar(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks){
+    for(size_t n = 0; n < set_count; n++){
+        const bool *table = sets[n].table;
+        uint64_t mask = 0;
+
+        for(unsigned i = 0; i < SCAN_BLOCK_SIZE; i++)
+            mask |= (uint64_t)table[block[i]] << i;
+
+        masks[n] = mask;
+    }
+}
+
+#ifdef SCAN_X86
+
+// four 16 byte compares per char
+__attribute__((target("sse2")))
+static void scan_masks_sse2(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks){
+    __m128i data0 = _mm_loadu_si128((const __m128i*)(block));
+    __m128i data1 = _mm_loadu_si128((const __m128i*)(block + 16));
+    __m128i data2 = _mm_loadu_si128((const __m128i*)(block + 32));
+    __m128i data3 = _mm_loadu_si128((const __m128i*)(block + 48));
+
+    for(size_t n = 0; n < set_count; n++){
+        __m128i found0 = _mm_setzero_si128();
+        __m128i found1 = _mm_setzero_si128();
+        __m128i found2 = _mm_setzero_si128();
+        __m128i found3 = _mm_setzero_si128();
+
+        for(size_t i = 0; i < sets[n].count; i++){
+            __m128i chr = _mm_set1_epi8((char)sets[n].chars[i]);
+            found0 = _mm_or_si128(found0, _mm_cmpeq_epi8(data0, chr));
+            found1 = _mm_or_si128(found1, _mm_cmpeq_epi8(data1, chr));
+            found2 = _mm_or_si128(found2, _mm_cmpeq_epi8(data2, chr));
+            found3 = _mm_or_si128(found3, _mm_cmpeq_epi8(data3, chr));
+        }
+
+        masks[n] =  (uint64_t)(uint16_t)_mm_movemask_epi8(found0)         |
+                    (uint64_t)(uint16_t)_mm_movemask_epi8(found1) << 16   |
+                    (uint64_t)(uint16_t)_mm_movemask_epi8(found2) << 32   |
+                    (uint64_t)(uint16_t)_mm_movemask_epi8(found3) << 48;
+    }
+}
+
+// two 32 byte compares per char
+__attribute__((target("avx2")))
+static void scan_masks_avx2(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks){
+    __m256i data0 = _mm256_loadu_si256((const __m256i*)(block));
+    __m256i data1 = _mm256_loadu_si256((const __m256i*)(block + 32));
+
+    for(size_t n = 0; n < set_count; n++){
+        __m256i found0 = _mm256_setzero_si256();
+        __m256i found1 = _mm256_setzero_si256();
+
+        for(size_t i = 0; i < sets[n].count; i++){
+            __m256i chr = _mm256_set1_epi8((char)sets[n].chars[i]);
+            found0 = _mm256_or_si256(found0, _mm256_cmpeq_epi8(data0, chr));
+            found1 = _mm256_or_si256(found1, _mm256_cmpeq_epi8(data1, chr));
+        }
+
+        masks[n] =  (uint64_t)(uint32_t)_mm256_movemask_epi8(found0) |
+                    (uint64_t)(uint32_t)_mm256_movemask_epi8(found1) << 32;
+    }
+}
+
+#endif
+
+// picks the best scanner for this cpu
+static scan_masks_function_t scan_select(void){
+    #ifdef SCAN_X86
+        __builtin_cpu_init();
+
+        if(__builtin_cpu_supports("avx2")) return scan_masks_avx2;
+        if(__builtin_cpu_supports("sse2")) return scan_masks_sse2;
+    #endif
+
+    return scan_masks_scalar;
+}
+
+// scanner in use, resolved on the first call
+static scan_masks_function_t scan_function(void){
+    static scan_masks_function_t function = NULL;
+
+    scan_masks_function_t selected = __atomic_load_n(&function, __ATOMIC_RELAXED);
+
+    if(selected == NULL){                                                           // every thread selects the same one
+        selected = scan_select();
+        __atomic_store_n(&function, selected, __ATOMIC_RELAXED);
+    }
+
+    return selected;
+}
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// initializes a set
+void scan_set_init(scan_set_t *set, const char *chars){
+    memset(set, 0, sizeof(*set));
+
+    for(; chars != NULL && *chars != '\0'; chars++)
+        scan_set_add(set, *chars);
+}
+
+// adds a char to a set
+void scan_set_add(scan_set_t *set, char chr){
+    if(set->count >= SCAN_SET_MAX_CHARS || set->table[(uint8_t)chr]) return;
+
+    set->chars[set->count++] = (uint8_t)chr;
+    set->table[(uint8_t)chr] = true;
+}
+
+// one mask per set for a block
+void scan_masks(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks){
+    scan_function()(sets, set_count, block, masks);
+}
+
+// masks for a partial block
+void scan_masks_tail(const scan_set_t *sets, size_t set_count, const uint8_t *data, size_t len, uint64_t *masks){
+    uint8_t block[SCAN_BLOCK_SIZE];
+
+    memcpy(block, data, len);
+    memset(block + len, 0, SCAN_BLOCK_SIZE - len);
+
+    scan_function()(sets, set_count, block, masks);
+
+    uint64_t valid = len == 0 ? 0 : (~0ull >> (SCAN_BLOCK_SIZE - len));            // the padding could match a '\0' in the set
+    for(size_t n = 0; n < set_count; n++)
+        masks[n] &= valid;
+}
+
+// first char of the set
+const char *scan_find(const scan_set_t *set, const char *cursor, const char *end){
+    scan_masks_function_t function = scan_function();
+    uint64_t mask;
+
+    for(; end - cursor >= SCAN_BLOCK_SIZE; cursor += SCAN_BLOCK_SIZE){
+        function(set, 1, (const uint8_t*)cursor, &mask);
+        if(mask != 0) return cursor + scan_first_bit(mask);
+    }
+
+    if(cursor < end){
+        scan_masks_tail(set, 1, (const uint8_t*)cursor, end - cursor, &mask);
+        if(mask != 0) return cursor + scan_first_bit(mask);
+    }
+
+    return end;
+}
+
+// instruction set used by the scanner
+const char *scan_instruction_set(void){
+    scan_masks_function_t function = scan_function();
+
+    #ifdef SCAN_X86
+        if(function == scan_masks_avx2) return "avx2";
+        if(function == scan_masks_sse2) return "sse2";
+    #endif
+
+    (void)function;
+    return "scalar";
+}
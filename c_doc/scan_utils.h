@@ -0,0 +1,66 @@
+#ifndef _SCAN_UTILS_HEADER_
+#define _SCAN_UTILS_HEADER_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------- Definitions ------------------------------------ */
+
+#define SCAN_BLOCK_SIZE         (64)                                                // bytes covered by one mask
+#define SCAN_SET_MAX_CHARS      (16)                                                // maximum chars in a set
+
+/* ----------------------------------------- Typedef's ---------------------------------------- */
+
+// a set of chars to look for
+typedef struct{
+    uint8_t chars[SCAN_SET_MAX_CHARS];
+    size_t count;
+    bool table[256];                                                                // for the scalar scanner
+}scan_set_t;
+
+/* ----------------------------------------- Functions -------------------------------------- */
+
+// initializes a set from a null terminated list of chars, extra chars are ignored
+void scan_set_init(scan_set_t *set, const char *chars);
+
+// adds a char to a set
+void scan_set_add(scan_set_t *set, char chr);
+
+// one mask per set for a block of SCAN_BLOCK_SIZE bytes, bit i of masks[n] is set when block[i] is in sets[n]. Uses AVX2 or SSE2 when available
+void scan_masks(const scan_set_t *sets, size_t set_count, const uint8_t *block, uint64_t *masks);
+
+// same as scan_masks() for the last len bytes of a stream, len smaller than SCAN_BLOCK_SIZE
+void scan_masks_tail(const scan_set_t *sets, size_t set_count, const uint8_t *data, size_t len, uint64_t *masks);
+
+// position of the first char of the set between cursor and end, end if not found
+const char *scan_find(const scan_set_t *set, const char *cursor, const char *end);
+
+// instruction set used by the scanner, "avx2", "sse2" or "scalar"
+const char *scan_instruction_set(void);
+
+/* ----------------------------------------- Inline Functions ------------------------------- */
+
+// bit i of the result is the xor of the bits 0 to i of mask, turns quote positions into a mask of the quoted regions
+static inline uint64_t scan_prefix_xor(uint64_t mask){
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+
+// index of the lowest set bit, mask must not be zero
+static inline unsigned scan_first_bit(uint64_t mask){
+    return (unsigned)__builtin_ctzll(mask);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
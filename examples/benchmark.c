@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "c_doc/doc.h"
+#include "c_doc/doc_json.h"
+#include "c_doc/doc_msgpack.h"
+#include "c_doc/doc_lz.h"
+#include "c_doc/doc_csv.h"
+#include "c_doc/doc_table.h"
+#include "c_doc/doc_xml.h"
+#include "c_doc/doc_ini.h"
+#include "c_doc/parse_utils.h"
+#include "c_doc/scan_utils.h"
+
+/**
+ * Benchmarks for the parsers and serializers, build with 'make bench' and run './bench.exe'.
+ * Each case runs a few times and reports the best time, with the throughput over the size of the
+ * text or binary stream involved.
+ */
+
+#define BENCH_RUNS      (5)
+#define CSV_COLUMNS     (200)
+
+// time in seconds
+static double now(void){
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// print a result line
+static void report(const char *name, double seconds, size_t bytes){
+    printf("%-32s %10.3f ms %10.1f MB/s\n", name, seconds * 1e3, ((double)bytes / (1024.0 * 1024.0)) / seconds);
+}
+
+// a object with 'records' records of mixed types
+static doc *make_records(size_t records){
+    static const uint8_t blob[64] = { 0xDE, 0xAD, 0xBE, 0xEF };
+    doc *root = doc_new("root", dt_obj, ";");
+    doc_add(root, ".", "records", dt_array, ";");
+    doc *array = doc_get_ptr(root, "records");
+
+    for(size_t i = 0; i < records; i++){
+        doc *record = doc_new("", dt_obj,
+            "id", dt_int64, (int64_t)i,
+            "score", dt_double, (double)i * 0.25,
+            "name", dt_const_string, "some record name", (size_t)16,
+            "active", dt_bool, (i % 2) == 0,
+            "payload", dt_const_bindata, (void*)blob, sizeof(blob),
+        ";");
+
+        doc_append(array, ".", record);
+    }
+
+    return root;
+}
+
+// a wide csv text, with integers, decimals, plain and quoted strings
+static char *make_csv(size_t rows, size_t *len){
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, 1024 * 1024, NULL, NULL);
+
+    for(size_t column = 0; column < CSV_COLUMNS; column++){
+        wbuffer_puts(&buffer, "column_");
+        wbuffer_write_uint(&buffer, column);
+        wbuffer_putc(&buffer, column + 1 < CSV_COLUMNS ? ',' : '\n');
+    }
+
+    for(size_t row = 0; row < rows; row++){
+        for(size_t column = 0; column < CSV_COLUMNS; column++){
+            switch(column % 4){
+                case 0: wbuffer_write_int(&buffer, (int64_t)(row * column) - 5000);                        break;
+                case 1: wbuffer_write_uint(&buffer, row); wbuffer_puts(&buffer, ".25");                    break;
+                case 2: wbuffer_puts(&buffer, "plain text");                                               break;
+                case 3: wbuffer_puts(&buffer, "\"quoted, with \"\"escapes\"\"\"");                        break;
+            }
+
+            wbuffer_putc(&buffer, column + 1 < CSV_COLUMNS ? ',' : '\n');
+        }
+    }
+
+    return wbuffer_release(&buffer, len);
+}
+
+// parses a csv text on its own, for the concurrent case
+static void *parse_csv_worker(void *csv){
+    doc *parsed = doc_csv_parse(csv, csv_parse_first_line_as_names | csv_parse_use_custom_separator, ',');
+    doc_delete(parsed, ".");
+    return NULL;
+}
+
+// independent parses running at once, one per thread. The calls share no state, so the throughput over all
+// the texts should grow with the threads up to the number of cpus
+static void bench_csv_concurrent(char *csv, size_t len){
+    unsigned cpus = cpu_count();
+    pthread_t *threads = malloc(cpus * sizeof(*threads));
+
+    for(unsigned count = 1; count <= cpus; count *= 2){
+        double best = 1e9;
+
+        for(int i = 0; i < BENCH_RUNS; i++){
+            double start = now();
+            for(unsigned t = 0; t < count; t++)
+                pthread_create(&threads[t], NULL, parse_csv_worker, csv);
+            for(unsigned t = 0; t < count; t++)
+                pthread_join(threads[t], NULL);
+            double time = now() - start;
+            if(time < best) best = time;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "doc_csv_parse (%u concurrent)", count);
+        report(name, best, len * count);
+    }
+
+    free(threads);
+}
+
+// csv parsing throughput on a wide file
+static void bench_csv(size_t rows){
+    size_t len;
+    char *csv = make_csv(rows, &len);
+    double best;
+
+    printf("\n-- csv, %zu rows of %d columns\n", rows, CSV_COLUMNS);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(csv, csv_parse_normal_mode);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_csv_parse", best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(csv, csv_parse_first_line_as_names);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_csv_parse (named columns)", best, len);
+
+    const char *picked[] = { "column_0", "column_101", "column_199" };
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(csv, csv_parse_first_line_as_names | csv_parse_select_named_columns, 3, picked);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_csv_parse (3 columns)", best, len);
+
+    unsigned threads = cpu_count();
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(csv, csv_parse_multithreaded, 0);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "doc_csv_parse (%u threads)", threads);
+    report(name, best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(csv, csv_parse_columnar);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_csv_parse (columnar)", best, len);
+
+    doc *columnar = doc_csv_parse(csv, csv_parse_columnar | csv_parse_first_line_as_names);   // throughput over the csv text it replaces
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_table_write(columnar, "bench.tbl");
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_table_write", best, len);
+    doc_delete(columnar, ".");
+
+    doc_table *tbl = doc_table_open("bench.tbl");
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *read = doc_table_read(tbl, 0, NULL);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(read, ".");
+    }
+    report("doc_table_read", best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *read = doc_table_read(tbl, 3, picked);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(read, ".");
+    }
+    report("doc_table_read (3 columns)", best, len);
+    doc_table_close(tbl);
+    remove("bench.tbl");
+
+    bench_csv_concurrent(csv, len);
+
+    fsave("bench.csv", csv, len);                                                   // rows streamed from a file, without a table
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_csv_reader *reader = doc_csv_reader_open("bench.csv", csv_parse_first_line_as_names);
+        while(doc_csv_reader_next(reader) != NULL);
+        doc_csv_reader_close(reader);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_csv_reader_next", best, len);
+
+    doc_csv_index *index = NULL;                                                    // random rows through a row index
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        remove("bench.csv" DOC_CSV_INDEX_EXTENSION);                                // built from scratch every run
+        doc_csv_index_close(index);
+        double start = now();
+        index = doc_csv_index_build("bench.csv", 0, csv_parse_first_line_as_names);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_csv_index_build", best, len);
+
+    size_t indexed_rows = doc_csv_index_rows(index);
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        for(size_t k = 0; k < 100; k++){
+            doc *row = doc_csv_read_rows("bench.csv", index, (k * 7919) % indexed_rows, 1);
+            doc_delete(row, ".");
+        }
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_csv_read_rows (100 rows)", best, len / indexed_rows * 100);
+
+    doc_csv_index_close(index);
+    remove("bench.csv" DOC_CSV_INDEX_EXTENSION);
+    remove("bench.csv");
+
+    doc *table = doc_csv_parse(csv, csv_parse_first_line_as_names);
+    size_t out_len = 0;
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        char *out = doc_csv_stringify(table, csv_stringify_put_columns_names_in_first_line);
+        double time = now() - start;
+        if(time < best) best = time;
+        out_len = strlen(out);
+        free(out);
+    }
+    report("doc_csv_stringify", best, out_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_csv_save(table, "bench.csv", csv_stringify_put_columns_names_in_first_line);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_csv_save", best, out_len);
+    remove("bench.csv");
+    doc_delete(table, ".");
+
+    char *body = strchr(csv, '\n') + 1;                                             // the names would make every column a string
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_csv_parse(body, csv_parse_infer_column_types);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_csv_parse (column types)", best, len - (body - csv));
+
+    scan_set_t sets[2];                                                             // the scan alone, as done by the parser
+    scan_set_init(&sets[0], "\"");
+    scan_set_init(&sets[1], ",;\r\n");
+    size_t delimiters = 0;
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        uint64_t in_quotes = 0, masks[2];
+        size_t block;
+        delimiters = 0;
+
+        double start = now();
+        for(block = 0; block + SCAN_BLOCK_SIZE <= len; block += SCAN_BLOCK_SIZE){
+            scan_masks(sets, 2, (const uint8_t*)csv + block, masks);
+            uint64_t quoted = scan_prefix_xor(masks[0]) ^ in_quotes;
+            in_quotes = (uint64_t)((int64_t)quoted >> 63);
+            delimiters += __builtin_popcountll(masks[1] & ~quoted);
+        }
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+
+    snprintf(name, sizeof(name), "csv scan (%s)", scan_instruction_set());
+    report(name, best, len);
+    printf("delimiters: %zu\n", delimiters);
+
+    free(csv);
+}
+
+// json against msgpack on the same document
+static void bench_json_msgpack(size_t records){
+    doc *variable = make_records(records);
+    double best;
+    char *json = NULL;
+    uint8_t *msgpack = NULL;
+    size_t json_len = 0, msgpack_len = 0;
+
+    printf("\n-- json vs msgpack, %zu records\n", records);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        free(json);
+        double start = now();
+        json = doc_json_stringify(variable);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    json_len = strlen(json);
+    report("doc_json_stringify", best, json_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        free(msgpack);
+        double start = now();
+        msgpack = doc_msgpack_serialize(variable, &msgpack_len);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_msgpack_serialize", best, msgpack_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_json_parse(json);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_json_parse", best, json_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_msgpack_parse(msgpack, msgpack_len);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_msgpack_parse", best, msgpack_len);
+
+    printf("sizes: json %zu bytes, msgpack %zu bytes\n", json_len, msgpack_len);
+
+    free(json);
+    free(msgpack);
+    doc_delete(variable, ".");
+}
+
+// block compression of the json text
+static void bench_lz(size_t records){
+    doc *variable = make_records(records);
+    char *json = doc_json_stringify(variable);
+    size_t json_len = strlen(json);
+    uint8_t *frame = NULL;
+    size_t frame_len = 0;
+    double best;
+
+    printf("\n-- lz frames, %zu records of json\n", records);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        free(frame);
+        double start = now();
+        frame = doc_lz_frame_compress(json, json_len, &frame_len);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_lz_frame_compress", best, json_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        uint8_t *raw = doc_lz_frame_decompress(frame, frame_len, NULL);
+        double time = now() - start;
+        if(time < best) best = time;
+        free(raw);
+    }
+    report("doc_lz_frame_decompress", best, json_len);
+
+    printf("sizes: json %zu bytes, frame %zu bytes\n", json_len, frame_len);
+
+    free(frame);
+    free(json);
+    doc_delete(variable, ".");
+}
+
+// a xml text of 'records' records with atributes and text values
+static char *make_xml(size_t records, size_t *len){
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, 1024 * 1024, NULL, NULL);
+
+    wbuffer_puts(&buffer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<records>\n");
+
+    for(size_t i = 0; i < records; i++){
+        wbuffer_puts(&buffer, "  <record id=\"");
+        wbuffer_write_uint(&buffer, i);
+        wbuffer_puts(&buffer, "\" kind=\"entry\">\n    <name>some record name</name>\n    <score>");
+        wbuffer_write_uint(&buffer, i);
+        wbuffer_puts(&buffer, ".25</score>\n    <active>");
+        wbuffer_puts(&buffer, (i % 2) == 0 ? "true" : "false");
+        wbuffer_puts(&buffer, "</active>\n    <comment>a longer text value that is kept as a string</comment>\n  </record>\n");
+    }
+
+    wbuffer_puts(&buffer, "</records>\n");
+
+    return wbuffer_release(&buffer, len);
+}
+
+// xml parsing, copying the stream against in place
+static void bench_xml(size_t records){
+    size_t len = 0;
+    char *xml = make_xml(records, &len);
+    char *stream = malloc(len + 1);
+    double best;
+
+    printf("\n-- xml, %zu records, %zu bytes\n", records, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_xml_parse(xml);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_xml_parse", best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        memcpy(stream, xml, len + 1);                                               // the stream is modified by the parser
+        double start = now();
+        doc *parsed = doc_xml_parse_in_situ(stream);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_xml_parse_in_situ", best, len);
+
+    fsave("bench.xml", xml, len);                                                   // events streamed from a file
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_xml_reader *reader = doc_xml_reader_open("bench.xml");
+        while(doc_xml_reader_next(reader) != NULL);
+        doc_xml_reader_close(reader);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_xml_reader_next", best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_xml_reader *reader = doc_xml_reader_open("bench.xml");
+        const doc_xml_event_t *event;
+
+        while((event = doc_xml_reader_next(reader)) != NULL){                      // every record as a doc, one at a time
+            if(event->type == xml_event_start && event->depth == 2)
+                doc_delete(doc_xml_reader_element(reader), ".");
+        }
+
+        doc_xml_reader_close(reader);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_xml_reader_element", best, len);
+    remove("bench.xml");
+
+    doc *tree = doc_xml_parse(xml);
+    doc_xpath *xpath = doc_xpath_compile("//record[@kind='entry']/name");
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc **found;
+        doc_xpath_select(tree, xpath, &found);
+        double time = now() - start;
+        if(time < best) best = time;
+        free(found);
+    }
+    report("doc_xpath_select", best, len);
+    doc_xpath_free(xpath);
+    doc_delete(tree, ".");
+
+    free(stream);
+    free(xml);
+
+    xml = make_xml(records * 25, &len);                                             // a large file
+    fsave("bench.xml", xml, len);
+    free(xml);
+
+    printf("\n-- xml file, %zu records, %zu bytes\n", records * 25, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_xml_open("bench.xml");
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_xml_open", best, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_xml_reader *reader = doc_xml_reader_open("bench.xml");
+        while(doc_xml_reader_next(reader) != NULL);
+        doc_xml_reader_close(reader);
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_xml_reader_next", best, len);
+
+    doc *parsed = doc_xml_open("bench.xml");
+    size_t out_len = 0;
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        char *out = doc_xml_stringify(parsed);
+        double time = now() - start;
+        if(time < best) best = time;
+        out_len = strlen(out);
+        free(out);
+    }
+    report("doc_xml_stringify", best, out_len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc_xml_save(parsed, "bench.xml");
+        double time = now() - start;
+        if(time < best) best = time;
+    }
+    report("doc_xml_save", best, out_len);
+    remove("bench.xml");
+    doc_delete(parsed, ".");
+}
+
+// a ini text with a section of 50 entries for every 50 records, some with comments and line breaks
+static char *make_ini(size_t records, size_t *len){
+    wbuffer_t buffer;
+    wbuffer_init(&buffer, 1024 * 1024, NULL, NULL);
+
+    wbuffer_puts(&buffer, "; generated file\nversion = 3\n");
+
+    for(size_t i = 0; i < records; i++){
+        if((i % 50) == 0){
+            wbuffer_puts(&buffer, "\n[section");
+            wbuffer_write_uint(&buffer, i / 50);
+            wbuffer_puts(&buffer, "]\n");
+        }
+
+        wbuffer_puts(&buffer, "key");
+        wbuffer_write_uint(&buffer, i);
+
+        switch(i % 4){
+            case 0: wbuffer_puts(&buffer, " = ");    wbuffer_write_uint(&buffer, i);     break;
+            case 1: wbuffer_puts(&buffer, " = some text value ; with a comment");       break;
+            case 2: wbuffer_puts(&buffer, " = \"quoted # text\"");                     break;
+            case 3: wbuffer_puts(&buffer, " = first part \\\n    second part");        break;
+        }
+
+        wbuffer_putc(&buffer, '\n');
+    }
+
+    return wbuffer_release(&buffer, len);
+}
+
+// ini parsing
+static void bench_ini(size_t records){
+    size_t len = 0;
+    char *ini = make_ini(records * 25, &len);
+    double best;
+
+    printf("\n-- ini, %zu entries, %zu bytes\n", records * 25, len);
+
+    best = 1e9;
+    for(int i = 0; i < BENCH_RUNS; i++){
+        double start = now();
+        doc *parsed = doc_ini_parse(ini);
+        double time = now() - start;
+        if(time < best) best = time;
+        doc_delete(parsed, ".");
+    }
+    report("doc_ini_parse", best, len);
+
+    free(ini);
+}
+
+int main(int argc, char **argv){
+    size_t records = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000;
+
+    bench_json_msgpack(records);
+    bench_lz(records);
+    bench_csv(records);
+    bench_xml(records);
+    bench_ini(records);
+
+    return 0;
+}
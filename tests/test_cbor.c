@@ -0,0 +1,155 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_cbor.h"
+
+#define CBOR_FILE       TEST_OUTPUT_DIR "test.cbor"
+
+// document with every type cbor keeps
+static doc *new_test_doc(void){
+    return doc_new(
+        "root", dt_obj,
+            "small", dt_int64, 7LL,
+            "negative", dt_int64, -33LL,
+            "large", dt_int64, -9223372036854775807LL - 1,
+            "unsigned", dt_uint64, 18446744073709551615ULL,
+            "real", dt_double, 0.1,
+            "huge", dt_double, 1e300,
+            "flag", dt_bool, false,
+            "nothing", dt_null,
+            "text", dt_const_string, "text", 4ULL,
+            "blob", dt_const_bindata, "\x00\x01\x02", 3ULL,
+            "list", dt_array,
+                "0", dt_int64, 1LL,
+                "1", dt_int64, 2LL,
+            ";",
+            "objects", dt_array,
+                "0", dt_obj,
+                    "deep", dt_bool, true,
+                ";",
+            ";",
+            "empty", dt_obj,
+            ";",
+        ";"
+    );
+}
+
+// serialize and parse back with every serialize option
+static void test_round_trip(void){
+    doc_cbor_serialize_opt_t options[] = { cbor_serialize_normal_mode, cbor_serialize_deterministic, cbor_serialize_indefinite_length };
+    doc *original = new_test_doc();
+
+    for(size_t i = 0; i < sizeof(options) / sizeof(*options); i++){
+        size_t len;
+        uint8_t *stream = doc_cbor_serialize(original, &len, options[i]);
+        doc *parsed = doc_cbor_parse(stream, len, cbor_parse_normal_mode);
+
+        check(parsed != NULL && !strcmp(parsed->name, "cbor"));
+        if(options[i] != cbor_serialize_deterministic)                              // deterministic mode sorts the members
+            check(test_doc_equal(original, parsed, false));
+        else
+            check(parsed != NULL && parsed->childs == original->childs && doc_get(parsed, "huge", double) == 1e300);
+
+        doc *zero_copy = doc_cbor_parse(stream, len, cbor_parse_zero_copy);
+        check(zero_copy != NULL && doc_get_ptr(zero_copy, "text")->type == dt_const_string);
+        doc_delete(zero_copy, ".");
+
+        doc_delete(parsed, ".");
+        free(stream);
+    }
+
+    doc_cbor_save(original, CBOR_FILE, cbor_serialize_normal_mode);
+    doc *opened = doc_cbor_open(CBOR_FILE);
+    check(test_doc_equal(original, opened, false));
+
+    doc_delete(opened, ".");
+    doc_delete(original, ".");
+}
+
+// encodings from RFC 8949 appendix A, on deterministic mode
+static void test_deterministic(void){
+    struct{
+        double value;
+        uint8_t encoding[9];
+        size_t len;
+    }floats[] = {
+        { 0.0,      { 0xF9, 0x00, 0x00 }, 3 },
+        { 1.5,      { 0xF9, 0x3E, 0x00 }, 3 },
+        { 65504.0,  { 0xF9, 0x7B, 0xFF }, 3 },
+        { 100000.0, { 0xFA, 0x47, 0xC3, 0x50, 0x00 }, 5 },
+        { 1.1,      { 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A }, 9 },
+        { 1e300,    { 0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C }, 9 },
+        { -4.1,     { 0xFB, 0xC0, 0x10, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66 }, 9 },
+    };
+
+    for(size_t i = 0; i < sizeof(floats) / sizeof(*floats); i++){
+        doc *value = doc_new("value", dt_double, floats[i].value);
+        size_t len;
+        uint8_t *stream = doc_cbor_serialize(value, &len, cbor_serialize_deterministic);
+
+        check(len == floats[i].len && !memcmp(stream, floats[i].encoding, len));
+
+        free(stream);
+        doc_delete(value, ".");
+    }
+
+    doc *map = doc_new("map", dt_obj, "bb", dt_int64, 2LL, "a", dt_int64, 1LL, "c", dt_int64, 3LL, ";");
+    uint8_t sorted[] = { 0xA3, 0x61, 'a', 0x01, 0x61, 'c', 0x03, 0x62, 'b', 'b', 0x02 };
+    size_t len;
+    uint8_t *stream = doc_cbor_serialize(map, &len, cbor_serialize_deterministic);
+
+    check(len == sizeof(sorted) && !memcmp(stream, sorted, len));
+
+    free(stream);
+    doc_delete(map, ".");
+}
+
+// truncated, invalid and hostile streams give NULL
+static void test_malformed(void){
+    doc *original = new_test_doc();
+    size_t len;
+    uint8_t *stream = doc_cbor_serialize(original, &len, cbor_serialize_normal_mode);
+
+    for(size_t cut = 0; cut < len; cut++)                                           // every truncation
+        check(doc_cbor_parse(stream, cut, cbor_parse_normal_mode) == NULL);
+
+    for(size_t i = 0; i < len; i++){                                                // every byte flipped, parsed or rejected without faults
+        uint8_t *corrupt = malloc(len);
+
+        memcpy(corrupt, stream, len);
+        corrupt[i] ^= 0xFF;
+        doc_delete(doc_cbor_parse(corrupt, len, cbor_parse_normal_mode), ".");
+        free(corrupt);
+    }
+
+    uint8_t reserved[] = { 0x1C };
+    uint8_t huge_string[] = { 0x7B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 'a' };
+    uint8_t huge_array[] = { 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    uint8_t lone_break[] = { 0xFF };
+    uint8_t unterminated[] = { 0x9F, 0x01, 0x02 };
+    check(doc_cbor_parse(reserved, sizeof(reserved), cbor_parse_normal_mode) == NULL);
+    check(doc_cbor_parse(huge_string, sizeof(huge_string), cbor_parse_normal_mode) == NULL);
+    check(doc_cbor_parse(huge_array, sizeof(huge_array), cbor_parse_normal_mode) == NULL);
+    check(doc_cbor_parse(lone_break, sizeof(lone_break), cbor_parse_normal_mode) == NULL);
+    check(doc_cbor_parse(unterminated, sizeof(unterminated), cbor_parse_normal_mode) == NULL);
+
+    uint8_t *nested = malloc(100000);                                               // deep nesting is refused, not recursed into
+    memset(nested, 0x81, 100000);
+    check(doc_cbor_parse(nested, 100000, cbor_parse_normal_mode) == NULL);
+
+    memset(nested, 0xC6, 100000);                                                   // tags are skipped the same way
+    check(doc_cbor_parse(nested, 100000, cbor_parse_normal_mode) == NULL);
+
+    check(doc_cbor_parse(NULL, 0, cbor_parse_normal_mode) == NULL);
+    check(doc_cbor_open(TEST_OUTPUT_DIR "missing.cbor") == NULL);
+
+    free(nested);
+    free(stream);
+    doc_delete(original, ".");
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_deterministic);
+    run_test(test_malformed);
+
+    return test_result();
+}
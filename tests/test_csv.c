@@ -0,0 +1,498 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_csv.h"
+
+#define CSV_FILE        TEST_OUTPUT_DIR "test.csv"
+#define INDEX_FILE      CSV_FILE DOC_CSV_INDEX_EXTENSION
+#define INDEX_ROWS      (50)
+#define INDEX_SEPARATORS_OFFSET     (16)                                            // after magic, version, endianness and options
+#define MODES_ROWS      (20000)                                                     // big enough to be split among 4 threads
+
+/* ----------------------------------------- Helpers ---------------------------------------- */
+
+// parses a string literal, the stream is copied since the parse calls take a mutable pointer
+static doc *parse(const char *text, doc_csv_parse_opt_t options){
+    char *stream = strdup(text);
+    doc *csv = doc_csv_parse(stream, options);
+
+    free(stream);
+    return csv;
+}
+
+// cell of a csv by its row and column, NULL if there is no such cell
+static doc *cell_at(doc *csv, size_t row, size_t column){
+    doc *line = csv != NULL ? csv->child : NULL;
+
+    for(; line != NULL && row > 0; row--) line = line->next;
+    doc *cell = line != NULL ? line->child : NULL;
+    for(; cell != NULL && column > 0; column--) cell = cell->next;
+
+    return cell;
+}
+
+// checks the type of a cell
+static bool cell_is(doc *csv, size_t row, size_t column, doc_type_t type){
+    doc *cell = cell_at(csv, row, column);
+    return cell != NULL && cell->type == type;
+}
+
+// checks a string cell
+static bool cell_string_is(doc *csv, size_t row, size_t column, const char *string){
+    doc *cell = cell_at(csv, row, column);
+    return cell != NULL && (cell->type == dt_string || cell->type == dt_const_string) && !strcmp(((doc_string*)cell)->string, string);
+}
+
+// checks a int64 cell
+static bool cell_int64_is(doc *csv, size_t row, size_t column, int64_t value){
+    doc *cell = cell_at(csv, row, column);
+    return cell != NULL && cell->type == dt_int64 && ((doc_int64_t*)cell)->value == value;
+}
+
+/* ----------------------------------------- Parser ----------------------------------------- */
+
+// unquoted cells are typed, quoted ones are strings
+static void test_parse_types(void){
+    doc *csv = parse("1,-2,2.5,1e3,true,abc,,\"7\",-,1e\n", csv_parse_normal_mode);
+
+    check(cell_int64_is(csv, 0, 0, 1));
+    check(cell_int64_is(csv, 0, 1, -2));
+    check(cell_is(csv, 0, 2, dt_double) && ((doc_double*)cell_at(csv, 0, 2))->value == 2.5);
+    check(cell_is(csv, 0, 3, dt_double) && ((doc_double*)cell_at(csv, 0, 3))->value == 1000.0);
+    check(cell_is(csv, 0, 4, dt_bool) && ((doc_bool*)cell_at(csv, 0, 4))->value);
+    check(cell_string_is(csv, 0, 5, "abc"));
+    check(cell_string_is(csv, 0, 6, ""));
+    check(cell_string_is(csv, 0, 7, "7"));
+    check(cell_string_is(csv, 0, 8, "-"));
+    check(cell_string_is(csv, 0, 9, "1e"));
+
+    doc_delete(csv, ".");
+}
+
+// integers are int64 up to its limits in every naming mode, only overflows become decimals
+static void test_parse_int64_limits(void){
+    const char *text = "id,v\n1234567890123456789,9223372036854775807\n-9223372036854775808,9223372036854775808\n";
+    doc_csv_parse_opt_t options[] = { csv_parse_normal_mode, csv_parse_first_line_as_names, csv_parse_first_column_as_names };
+
+    for(size_t i = 0; i < sizeof(options) / sizeof(*options); i++){
+        doc *csv = parse(text, options[i]);
+        size_t first_row = options[i] == csv_parse_first_line_as_names ? 0 : 1;
+        size_t first_column = options[i] == csv_parse_first_column_as_names ? 0 : 1;
+
+        if(options[i] != csv_parse_first_column_as_names)                          // the first field is the line name there
+            check(cell_int64_is(csv, first_row, 0, 1234567890123456789LL));
+
+        check(cell_int64_is(csv, first_row, first_column, 9223372036854775807LL));
+        check(cell_is(csv, first_row + 1, first_column, dt_double));
+
+        if(options[i] != csv_parse_first_column_as_names)
+            check(cell_int64_is(csv, first_row + 1, 0, -9223372036854775807LL - 1));
+
+        doc_delete(csv, ".");
+    }
+}
+
+// RFC 4180 quoting, line breaks and the last line without a line break
+static void test_parse_quotes(void){
+    doc *csv = parse("\"a,b\",\"x\"\"y\",\"l1\nl2\"\r\nlast,row", csv_parse_normal_mode);
+
+    check(csv != NULL && csv->childs == 2);
+    check(cell_string_is(csv, 0, 0, "a,b"));
+    check(cell_string_is(csv, 0, 1, "x\"y"));
+    check(cell_string_is(csv, 0, 2, "l1\nl2"));
+    check(cell_string_is(csv, 1, 0, "last"));
+    check(cell_string_is(csv, 1, 1, "row"));
+
+    doc_delete(csv, ".");
+
+    char *custom = strdup("a;\"b;c\"\n1;2\n");
+    csv = doc_csv_parse(custom, csv_parse_use_custom_separator, ';');
+    check(cell_string_is(csv, 0, 1, "b;c") && cell_int64_is(csv, 1, 1, 2));
+    doc_delete(csv, ".");
+    free(custom);
+}
+
+// parse, stringify and parse again gives the same doc
+static void test_round_trip(void){
+    const char *text =
+        "name,count,price,ok,note\n"
+        "\"Smith, J\",3,2.25,true,\"said \"\"hi\"\"\"\n"
+        "plain,-12,0.1,false,\"two\nlines\"\n"
+        "\"12\",,1e-7,true,\n";
+
+    doc *csv = parse(text, csv_parse_normal_mode);
+    char *stringified = doc_csv_stringify(csv, csv_stringify_normal_mode);
+    doc *again = parse(stringified, csv_parse_normal_mode);
+
+    check(csv != NULL && csv->childs == 4);
+    check(test_doc_equal(csv, again, true));
+
+    doc_delete(again, ".");
+    free(stringified);
+    doc_delete(csv, ".");
+}
+
+// broken input is parsed without reading past the stream
+static void test_parse_malformed(void){
+    doc *csv = parse("", csv_parse_normal_mode);
+    check(csv != NULL && csv->childs == 0);
+    doc_delete(csv, ".");
+
+    csv = parse("\"unterminated,1\n2,3\n", csv_parse_normal_mode);                // a open quote takes the rest
+    check(csv != NULL && csv->childs == 1);
+    doc_delete(csv, ".");
+
+    csv = parse("a,b\n1\n1,2,3\n", csv_parse_normal_mode);                        // ragged rows are kept as they are
+    check(csv != NULL && csv->childs == 3 && cell_int64_is(csv, 2, 2, 3));
+    doc_delete(csv, ".");
+
+    char *random = malloc(4097);
+    uint32_t seed = 7;
+    const char alphabet[] = "ab1,\"\n\r;.-e ";
+
+    for(int round = 0; round < 200; round++){                                       // random streams in every parse mode
+        for(size_t i = 0; i < 4096; i++){
+            seed = seed * 1103515245 + 12345;
+            random[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+        }
+        random[4096] = '\0';
+
+        doc_csv_parse_opt_t options = (doc_csv_parse_opt_t)((round % 4) | ((round & 4) ? csv_parse_infer_column_types : 0));
+        doc *fuzzed = doc_csv_parse(random, options);
+        check(fuzzed != NULL);
+
+        char *stringified = doc_csv_stringify(fuzzed, csv_stringify_normal_mode);
+        free(stringified);
+        doc_delete(fuzzed, ".");
+    }
+
+    free(random);
+}
+
+/* ----------------------------------------- Parse Modes ------------------------------------ */
+
+// csv with a column of each type, where some quoted names hold separators, quotes and line breaks
+static char *new_modes_csv(size_t rows){
+    size_t size = 64 + rows * 64, len = 0;
+    char *text = malloc(size);
+
+    len += snprintf(text + len, size - len, "id,name,price,ok\n");
+    for(size_t i = 0; i < rows; i++){
+        const char *name = i % 7 == 0 ? "\"line\nbreak, \"\"%zu\"\"\"" : "name%zu";
+        len += snprintf(text + len, size - len, "%zu,", i);
+        len += snprintf(text + len, size - len, name, i);
+        len += snprintf(text + len, size - len, ",%zu.25,%s\r\n", i, i % 2 ? "true" : "false");
+    }
+
+    return text;
+}
+
+// threaded parses give the same doc as a single threaded one
+static void test_parse_multithreaded(void){
+    char *text = new_modes_csv(MODES_ROWS);
+    doc *single = parse(text, csv_parse_first_line_as_names);
+    int threads[] = { 1, 2, 4, 0 };
+
+    check(single != NULL && single->childs == MODES_ROWS);
+
+    for(size_t i = 0; i < sizeof(threads) / sizeof(*threads); i++){
+        doc *threaded = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_multithreaded, threads[i]);
+        check(test_doc_equal(single, threaded, true));
+        doc_delete(threaded, ".");
+    }
+
+    doc_delete(single, ".");
+    free(text);
+}
+
+// columnar parses hold the values of the cells of the row parse, threaded or not
+static void test_parse_columnar(void){
+    char *text = new_modes_csv(MODES_ROWS);
+    doc *rows = parse(text, csv_parse_first_line_as_names);
+    doc_csv_parse_opt_t options[] = { csv_parse_normal_mode, csv_parse_multithreaded };
+
+    for(size_t i = 0; i < sizeof(options) / sizeof(*options); i++){
+        doc *columnar = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_columnar | options[i], 4);
+        doc *id = doc_get_ptr(columnar, "id"), *name = doc_get_ptr(columnar, "name");
+        doc *price = doc_get_ptr(columnar, "price"), *ok = doc_get_ptr(columnar, "ok");
+
+        check(doc_csv_is_columnar(columnar) && columnar->childs == 4);
+        check(doc_csv_column_type(id) == csv_column_int64 && doc_csv_column_type(name) == csv_column_string);
+        check(doc_csv_column_type(price) == csv_column_double && doc_csv_column_type(ok) == csv_column_bool);
+        check(doc_csv_column_rows(id) == MODES_ROWS && doc_csv_column_rows(name) == MODES_ROWS);
+
+        size_t mismatches = 0, row = 0;
+        for(doc *line = rows->child; line != NULL && row < doc_csv_column_rows(name); line = line->next, row++){
+            size_t len;
+            const char *string = doc_csv_column_string(name, row, &len);
+            doc_string *cell = (doc_string*)cell_at(rows, row, 1);
+
+            mismatches += !cell_int64_is(rows, row, 0, doc_csv_column_int64(id)[row]);
+            mismatches += strlen(cell->string) != len || memcmp(cell->string, string, len);
+            mismatches += ((doc_double*)cell_at(rows, row, 2))->value != doc_csv_column_double(price)[row];
+            mismatches += ((doc_bool*)cell_at(rows, row, 3))->value != doc_csv_column_bool(ok)[row];
+        }
+        check(row == MODES_ROWS && mismatches == 0);
+
+        doc_delete(columnar, ".");
+    }
+
+    doc *empty = parse("a,b\n1,\n,x\n", csv_parse_first_line_as_names | csv_parse_columnar);     // empty unquoted cells are null
+    check(!doc_csv_column_valid(doc_get_ptr(empty, "a"), 1) && doc_csv_column_valid(doc_get_ptr(empty, "a"), 0));
+    check(!doc_csv_column_valid(doc_get_ptr(empty, "b"), 0) && doc_csv_column_valid(doc_get_ptr(empty, "b"), 1));
+    doc_delete(empty, ".");
+
+    doc_delete(rows, ".");
+    free(text);
+}
+
+// rows of the reader are the lines of the parse, also for rows longer than its buffer and for truncated files
+static void test_reader(void){
+    char *text = new_modes_csv(MODES_ROWS);
+    size_t len = strlen(text);
+    doc *csv = parse(text, csv_parse_first_line_as_names);
+    check(test_write_file(CSV_FILE, text, len));
+
+    doc_csv_reader *reader = doc_csv_reader_open(CSV_FILE, csv_parse_first_line_as_names);
+    doc *line = csv->child, *row;
+    size_t rows = 0, mismatches = 0;
+
+    check(reader != NULL);
+    for(; reader != NULL && (row = doc_csv_reader_next(reader)) != NULL; rows++, line = line != NULL ? line->next : NULL)
+        mismatches += !test_doc_equal(row, line, false);
+
+    check(rows == MODES_ROWS && mismatches == 0);
+    check(reader != NULL && !doc_csv_reader_error(reader));
+    doc_csv_reader_close(reader);
+
+    int64_t value;
+    size_t long_len = 200000;                                                       // a single cell wider than the buffer
+    char *long_row = malloc(long_len + 10);
+    memcpy(long_row, "a,\"", 3);
+    memset(long_row + 3, 'x', long_len);
+    memcpy(long_row + 3 + long_len, "\"\nb,1\n", 7);
+    check(test_write_file(CSV_FILE, long_row, long_len + 9));
+
+    reader = doc_csv_reader_open(CSV_FILE, csv_parse_normal_mode);
+    row = doc_csv_reader_next(reader);
+    check(row != NULL && row->childs == 2 && ((doc_string*)row->child->next)->len >= long_len);
+    row = doc_csv_reader_next(reader);
+    check(row != NULL && row->childs == 2 && test_doc_integer(row->child->next, &value) && value == 1);
+    check(doc_csv_reader_next(reader) == NULL);
+    doc_csv_reader_close(reader);
+    free(long_row);
+
+    for(size_t cut = 0; cut < 2000; cut += 3){                                      // truncated inside quotes and rows
+        check(test_write_file(CSV_FILE, text, cut));
+        reader = doc_csv_reader_open(CSV_FILE, csv_parse_first_line_as_names);
+        for(rows = 0; doc_csv_reader_next(reader) != NULL; rows++);
+        check(rows <= cut / 10 + 1);
+        doc_csv_reader_close(reader);
+    }
+
+    check(doc_csv_reader_open(TEST_OUTPUT_DIR "missing.csv", csv_parse_normal_mode) == NULL);
+
+    doc_delete(csv, ".");
+    free(text);
+}
+
+// selected columns and row ranges hold the same cells as the whole parse
+static void test_parse_projection(void){
+    char *text = new_modes_csv(MODES_ROWS);
+    doc *csv = parse(text, csv_parse_first_line_as_names);
+    int columns[] = { 3, 1 };
+    char *names[] = { "ok", "missing", "name" };
+
+    doc *by_index = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_select_columns, 2, columns);
+    doc *by_name = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_select_named_columns, 3, names);
+    doc *threaded = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_multithreaded | csv_parse_select_columns, 4, 2, columns);
+
+    check(by_index != NULL && by_index->childs == MODES_ROWS);
+    check(test_doc_equal(by_index, by_name, true) && test_doc_equal(by_index, threaded, true));
+
+    size_t mismatches = 0, row = 0;                                                 // in the order of the file
+    for(doc *line = by_index != NULL ? by_index->child : NULL; line != NULL; line = line->next, row++)
+        mismatches += line->childs != 2 || !test_doc_equal(line->child, cell_at(csv, row, 1), true) ||
+                      !test_doc_equal(line->child->next, cell_at(csv, row, 3), true);
+    check(mismatches == 0);
+
+    doc *range = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_row_range, (size_t)100, (size_t)50);
+    check(range != NULL && range->childs == 50);
+    mismatches = 0;
+    row = 100;
+    for(doc *line = range != NULL ? range->child : NULL; line != NULL; line = line->next, row++)
+        mismatches += !test_doc_equal(line, cell_at(csv, row, 0)->parent, true);
+    check(mismatches == 0);
+
+    doc *past = doc_csv_parse(text, csv_parse_row_range, (size_t)MODES_ROWS + 1, (size_t)0);        // names line included
+    check(past != NULL && past->childs == 0);
+
+    doc *columnar = doc_csv_parse(text, csv_parse_first_line_as_names | csv_parse_columnar | csv_parse_select_columns | csv_parse_row_range, 2, columns, (size_t)10, (size_t)5);
+    check(columnar != NULL && columnar->childs == 2 && doc_csv_column_rows(doc_get_ptr(columnar, "ok")) == 5);
+    check(doc_csv_column_bool(doc_get_ptr(columnar, "ok"))[1] == 1);               // row 11
+
+    doc_delete(columnar, ".");
+    doc_delete(past, ".");
+    doc_delete(range, ".");
+    doc_delete(threaded, ".");
+    doc_delete(by_name, ".");
+    doc_delete(by_index, ".");
+    doc_delete(csv, ".");
+    free(text);
+}
+
+/* ----------------------------------------- Row Index -------------------------------------- */
+
+// writes the csv file indexed by the tests, with INDEX_ROWS rows after the names
+static void write_index_csv(void){
+    FILE *file = fopen(CSV_FILE, "wb");
+
+    fputs("id,name\n", file);
+    for(int i = 0; i < INDEX_ROWS; i++)
+        fprintf(file, "k%i,v%i\n", i, i);
+
+    fclose(file);
+}
+
+// rows found by key and read by range
+static void test_index(void){
+    size_t row = 0;
+
+    write_index_csv();
+    remove(INDEX_FILE);
+
+    doc_csv_index *index = doc_csv_index_build(CSV_FILE, 0, csv_parse_first_line_as_names);
+    check(index != NULL);
+    check(doc_csv_index_rows(index) == INDEX_ROWS);
+    check(doc_csv_index_find(index, "k42", &row) && row == 42);
+    check(!doc_csv_index_find(index, "k50", &row));
+
+    doc *rows = doc_csv_read_rows(CSV_FILE, index, 10, 2);
+    check(rows != NULL && rows->childs == 2);
+    check(!strcmp(doc_get(rows, "[1].name", char*), "v11"));
+
+    doc_delete(rows, ".");
+    doc_csv_index_close(index);
+
+    index = doc_csv_index_open(CSV_FILE);
+    check(index != NULL && doc_csv_index_rows(index) == INDEX_ROWS);
+    doc_csv_index_close(index);
+}
+
+// opens a sidecar after changing it, returns true if it was rejected
+static bool rejects(const uint8_t *data, size_t len, void (*change)(uint8_t *data, size_t len)){
+    uint8_t *corrupt = malloc(len);
+
+    memcpy(corrupt, data, len);
+    change(corrupt, len);
+    test_write_file(INDEX_FILE, corrupt, len);
+    free(corrupt);
+
+    doc_csv_index *index = doc_csv_index_open(CSV_FILE);
+    doc_csv_index_close(index);
+
+    return index == NULL;
+}
+
+// the sidecar ends with INDEX_ROWS + 1 offsets and then a key, of a hash and a row, per row
+static uint64_t *index_offsets(uint8_t *data, size_t len){
+    return (uint64_t*)(data + len - INDEX_ROWS * 16 - (INDEX_ROWS + 1) * 8);
+}
+
+static void unchanged(uint8_t *data, size_t len){
+    (void)data;
+    (void)len;
+}
+
+static void keys_out_of_range(uint8_t *data, size_t len){
+    for(size_t i = 0; i < INDEX_ROWS; i++){
+        uint64_t row = 1ULL << 40;
+        memcpy(data + len - INDEX_ROWS * 16 + i * 16 + 8, &row, sizeof(row));
+    }
+}
+
+static void offsets_backwards(uint8_t *data, size_t len){
+    uint64_t *offsets = index_offsets(data, len);
+    uint64_t swap = offsets[3];
+
+    offsets[3] = offsets[4];
+    offsets[4] = swap;
+}
+
+static void offsets_past_the_file(uint8_t *data, size_t len){
+    index_offsets(data, len)[INDEX_ROWS] += 1000;
+}
+
+static void offsets_before_the_names(uint8_t *data, size_t len){
+    index_offsets(data, len)[0] = 0;
+}
+
+static void separators_not_terminated(uint8_t *data, size_t len){
+    (void)len;
+    memset(data + INDEX_SEPARATORS_OFFSET, ',', 4);
+}
+
+// stale and corrupted sidecars are rejected at open and built again
+static void test_index_malformed(void){
+    size_t len, row = 0;
+
+    write_index_csv();
+    remove(INDEX_FILE);
+    doc_csv_index_close(doc_csv_index_build(CSV_FILE, 0, csv_parse_first_line_as_names));
+
+    uint8_t *data = test_read_file(INDEX_FILE, &len);
+    check(data != NULL && len > INDEX_ROWS * 24);
+
+    check(!rejects(data, len, unchanged));
+    check(rejects(data, len, keys_out_of_range));
+    check(rejects(data, len, offsets_backwards));
+    check(rejects(data, len, offsets_past_the_file));
+    check(rejects(data, len, offsets_before_the_names));
+    check(rejects(data, len, separators_not_terminated));
+
+    test_write_file(INDEX_FILE, data, len / 2);                                     // truncated
+    check(doc_csv_index_open(CSV_FILE) == NULL);
+
+    for(size_t i = 0; i < len; i++){                                                // every byte flipped, opened or rejected without faults
+        uint8_t *corrupt = malloc(len);
+
+        memcpy(corrupt, data, len);
+        corrupt[i] ^= (i & 1) ? 0xFF : 0x80;
+        test_write_file(INDEX_FILE, corrupt, len);
+        free(corrupt);
+
+        doc_csv_index *index = doc_csv_index_open(CSV_FILE);
+        if(index == NULL) continue;
+
+        doc_csv_index_find(index, "k7", NULL);
+        doc_delete(doc_csv_read_rows(CSV_FILE, index, 0, INDEX_ROWS), ".");
+        doc_csv_index_close(index);
+    }
+
+    test_write_file(INDEX_FILE, data, len);                                         // stale after the csv shrank
+    FILE *file = fopen(CSV_FILE, "wb");
+    fputs("id,name\nk0,v0\n", file);
+    fclose(file);
+    check(doc_csv_index_open(CSV_FILE) == NULL);
+
+    doc_csv_index *index = doc_csv_index_build(CSV_FILE, 0, csv_parse_first_line_as_names);
+    check(index != NULL && doc_csv_index_rows(index) == 1);
+    check(doc_csv_index_find(index, "k0", &row) && row == 0);
+    doc_csv_index_close(index);
+
+    free(data);
+}
+
+int main(void){
+    run_test(test_parse_types);
+    run_test(test_parse_int64_limits);
+    run_test(test_parse_quotes);
+    run_test(test_round_trip);
+    run_test(test_parse_malformed);
+    run_test(test_parse_multithreaded);
+    run_test(test_parse_columnar);
+    run_test(test_reader);
+    run_test(test_parse_projection);
+    run_test(test_index);
+    run_test(test_index_malformed);
+
+    return test_result();
+}
@@ -0,0 +1,232 @@
+#include "tests/test_utils.h"
+#include "c_doc/parse_utils.h"
+#include "c_doc/doc_csv.h"
+
+#define GZIP_FILE       TEST_OUTPUT_DIR "test.csv.gz"
+#define CORRUPT_FILE    TEST_OUTPUT_DIR "corrupt.gz"
+
+/**
+ * gzip members made by python's gzip.compress with mtime 0: gzip_dynamic is the text of dynamic_text() at
+ * level 9, with dynamic huffman blocks, gzip_fixed is "hello hello hello hello\n", a fixed huffman block,
+ * and gzip_stored is "stored block\n" at level 0, a stored block
+ */
+static const uint8_t gzip_dynamic[] = {
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4D, 0x98, 0x4B, 0x6E, 0x86, 0x35,
+    0x0C, 0x45, 0xE7, 0xAC, 0x82, 0x05, 0x30, 0x88, 0xED, 0x38, 0x8F, 0xE5, 0x30, 0x60, 0x86, 0x84,
+    0x84, 0x04, 0x6C, 0x9F, 0xB4, 0xBF, 0xEF, 0x71, 0x87, 0x5F, 0x9B, 0x26, 0xD7, 0xC9, 0xB5, 0x8F,
+    0xDD, 0xBF, 0xFF, 0xFA, 0xEF, 0xD7, 0xF1, 0xDB, 0xBF, 0xBF, 0xFF, 0xF9, 0xCF, 0x1F, 0xBF, 0x8E,
+    0x5F, 0xFE, 0x7E, 0x5F, 0x56, 0x5F, 0xF6, 0xFD, 0xE5, 0xF5, 0x35, 0xBF, 0xBF, 0xA2, 0xBE, 0xEE,
+    0xF7, 0xD7, 0xD4, 0xCA, 0xF5, 0xFD, 0x99, 0xF5, 0xE9, 0xF9, 0xFD, 0xB9, 0xEA, 0x33, 0x3E, 0xBF,
+    0xDD, 0xDA, 0xE8, 0xF3, 0xB7, 0xA7, 0x3E, 0xD7, 0x67, 0xE3, 0x5B, 0x9F, 0xE7, 0x73, 0xAA, 0x49,
+    0x92, 0x8D, 0x12, 0x85, 0x2A, 0xAF, 0x15, 0x12, 0x66, 0xF3, 0xB3, 0x83, 0x05, 0x6A, 0x3E, 0x27,
+    0x18, 0xF2, 0xEE, 0x47, 0x81, 0x21, 0xB0, 0x14, 0xDA, 0x42, 0x71, 0xAD, 0x90, 0x48, 0x3F, 0xB5,
+    0x87, 0x64, 0x86, 0xD7, 0x29, 0x97, 0xA8, 0xEA, 0x7E, 0xA4, 0x74, 0x96, 0x52, 0x97, 0xD2, 0x39,
+    0x6B, 0x05, 0x57, 0x78, 0x3E, 0x7B, 0xB8, 0x94, 0xA6, 0x7F, 0x4E, 0x71, 0x29, 0xCD, 0xFD, 0xD1,
+    0xE1, 0x52, 0xBA, 0x4A, 0xA9, 0x4B, 0xE9, 0xD2, 0x0A, 0x29, 0xDD, 0xDA, 0x43, 0x4A, 0xB7, 0x4E,
+    0xE1, 0x4A, 0x4B, 0x47, 0x48, 0xE9, 0x2D, 0xA5, 0x21, 0xA5, 0xB7, 0x62, 0x09, 0xEE, 0x74, 0x54,
+    0xB8, 0xC1, 0xA5, 0x8E, 0xBA, 0x91, 0xE0, 0x56, 0xAD, 0x2E, 0x2D, 0x92, 0xA7, 0x29, 0xB5, 0xB1,
+    0xF8, 0x49, 0x5D, 0x7D, 0x48, 0xAE, 0x45, 0xBD, 0x4E, 0x9C, 0x7E, 0xBF, 0x3A, 0x4B, 0x82, 0x2D,
+    0xEB, 0x8D, 0x27, 0x2E, 0x58, 0x25, 0x79, 0x62, 0x83, 0x55, 0x4E, 0x99, 0x68, 0xDE, 0x65, 0xA5,
+    0x89, 0xE6, 0x53, 0x5E, 0x9B, 0xED, 0x84, 0x32, 0xE3, 0xC4, 0x0A, 0xA3, 0x34, 0x4F, 0xBC, 0x60,
+    0x65, 0xE7, 0x89, 0x19, 0x7C, 0xD4, 0x3E, 0xD2, 0xEC, 0x31, 0xEA, 0x2C, 0x69, 0xF6, 0x39, 0x3E,
+    0x7A, 0x72, 0xE0, 0xA9, 0xD2, 0x9C, 0xD2, 0xEC, 0x4B, 0x6B, 0xA4, 0xD9, 0x77, 0xED, 0x93, 0x81,
+    0xF1, 0xEA, 0xAC, 0x94, 0x66, 0xBF, 0x4A, 0x2F, 0x69, 0x0E, 0x69, 0x4E, 0x52, 0xCC, 0x2A, 0xAE,
+    0xDC, 0xED, 0xD7, 0xDA, 0x07, 0x07, 0x47, 0xDD, 0x4F, 0x62, 0xE1, 0x59, 0x77, 0xB8, 0x06, 0xA6,
+    0x2E, 0xCD, 0x4B, 0x9A, 0x63, 0xD7, 0x5B, 0x2C, 0x69, 0x8E, 0x53, 0xEF, 0xB5, 0xA4, 0x39, 0x6E,
+    0xBD, 0xE9, 0x9A, 0xE4, 0x42, 0xBD, 0xFB, 0x92, 0xE6, 0x29, 0x6F, 0x2C, 0x69, 0x9E, 0x51, 0xFE,
+    0x59, 0x54, 0x86, 0x59, 0x1E, 0x5B, 0xD2, 0x3C, 0x57, 0xF9, 0x70, 0x49, 0xF3, 0xDC, 0xE5, 0xD5,
+    0x4D, 0xDE, 0xC9, 0xCE, 0x5B, 0x9A, 0x73, 0x94, 0xE3, 0xB7, 0x34, 0xA7, 0x55, 0x52, 0x6C, 0x52,
+    0x2F, 0x2A, 0x6F, 0x36, 0xB9, 0x37, 0x2B, 0xB5, 0xB6, 0x34, 0xA7, 0xB2, 0x6F, 0x2F, 0xF2, 0x53,
+    0x6B, 0xA4, 0x39, 0xAF, 0xF6, 0xA1, 0xA0, 0x0D, 0x9D, 0x75, 0x49, 0xE2, 0xD2, 0x73, 0x06, 0x45,
+    0xAF, 0x34, 0x1F, 0x69, 0x5E, 0x59, 0x71, 0x1D, 0x27, 0xD3, 0x2B, 0xF6, 0x23, 0xCD, 0xEB, 0xD4,
+    0xFD, 0x1C, 0x69, 0xDE, 0xA3, 0xEE, 0xF0, 0x24, 0xE5, 0xA0, 0x34, 0x1F, 0x69, 0xDE, 0x51, 0x6F,
+    0x71, 0x28, 0x19, 0x59, 0xEF, 0x75, 0xA8, 0x19, 0xBB, 0xDE, 0xF4, 0x48, 0xF3, 0xBE, 0xF5, 0xEE,
+    0x77, 0x50, 0x99, 0x4B, 0xF3, 0x95, 0xE6, 0xE3, 0xE5, 0x9F, 0xEB, 0x94, 0x1A, 0x95, 0x73, 0x69,
+    0x3E, 0xAB, 0x7C, 0x78, 0xA5, 0xF9, 0x9C, 0xF2, 0xEA, 0x4D, 0xEA, 0x51, 0x69, 0xBE, 0xD2, 0xFC,
+    0x0E, 0xAF, 0x35, 0xD2, 0x7C, 0x67, 0xE5, 0xC5, 0x3D, 0x14, 0xAD, 0xCA, 0x9D, 0x2B, 0xCD, 0xF7,
+    0x0C, 0xD1, 0xE3, 0x07, 0x3E, 0x04, 0x90, 0x61, 0x5D, 0xDC, 0x58, 0xD7, 0x05, 0x6F, 0xD6, 0x6E,
+    0x36, 0xBA, 0xE4, 0xAD, 0x3A, 0xF3, 0xFD, 0xB6, 0xCB, 0x60, 0x29, 0xB3, 0x41, 0xD9, 0x33, 0xE9,
+    0x7F, 0x7F, 0xC1, 0xCF, 0x3C, 0xB4, 0x8E, 0xD2, 0xF7, 0x2A, 0x9D, 0xF6, 0xA3, 0xF8, 0xD9, 0x5A,
+    0x3A, 0x97, 0xF2, 0x67, 0x47, 0x14, 0x6C, 0x0C, 0x7A, 0x83, 0xB0, 0x49, 0x18, 0x62, 0x61, 0xC3,
+    0xD0, 0x53, 0x38, 0x6C, 0x1E, 0xFA, 0x16, 0x11, 0x1B, 0x89, 0x7E, 0x05, 0x45, 0xA8, 0x68, 0x01,
+    0x17, 0x01, 0xA3, 0xC5, 0x14, 0x1A, 0xED, 0x47, 0x09, 0x17, 0x1D, 0xC1, 0xA3, 0xC5, 0x15, 0x20,
+    0x21, 0xA4, 0x4D, 0x5B, 0x62, 0xF5, 0xE8, 0x62, 0xAF, 0x38, 0xE0, 0xA4, 0x3D, 0xD3, 0x68, 0x5D,
+    0x43, 0xFD, 0x54, 0x16, 0x19, 0xB4, 0xB4, 0xB4, 0xCA, 0x35, 0x03, 0x98, 0x96, 0x51, 0x19, 0x69,
+    0x30, 0xD3, 0xC8, 0x5B, 0x03, 0x9B, 0x96, 0x87, 0x75, 0xC4, 0xB1, 0x7A, 0x3F, 0xE2, 0x58, 0xC1,
+    0xB9, 0xC4, 0xB1, 0xD0, 0x17, 0x0D, 0x24, 0x55, 0x1D, 0x83, 0xA2, 0xB6, 0x89, 0xB7, 0x41, 0xBA,
+    0xA7, 0xEE, 0xA5, 0x51, 0xBA, 0xB9, 0xBF, 0x86, 0xE9, 0xBE, 0xBA, 0xE7, 0xC6, 0xE9, 0xE1, 0x3D,
+    0x1A, 0xA8, 0x0F, 0x69, 0x5A, 0x47, 0x1C, 0x87, 0xF7, 0x6D, 0xA8, 0xDE, 0x41, 0x5B, 0x74, 0x1B,
+    0x7E, 0xF2, 0x4B, 0x83, 0xF5, 0xAA, 0xE2, 0x5B, 0xA3, 0xF5, 0xE2, 0x3F, 0xE0, 0xFA, 0x32, 0x46,
+    0x3E, 0x05, 0xAF, 0x3E, 0xF0, 0x33, 0x80, 0xF5, 0xB1, 0xE5, 0xFB, 0x46, 0x6C, 0xE7, 0xC7, 0x0F,
+    0xC8, 0x86, 0xF2, 0xA8, 0x31, 0x6B, 0xE4, 0x5B, 0x83, 0xF6, 0x2B, 0x90, 0xFA, 0x19, 0xA8, 0x75,
+    0xF2, 0xB7, 0x61, 0x0B, 0x6D, 0xAD, 0x71, 0xEB, 0xD4, 0x83, 0x06, 0x6E, 0x98, 0xF6, 0x6B, 0xE4,
+    0x86, 0x6A, 0x8B, 0x35, 0x74, 0x63, 0x4B, 0x1F, 0xD8, 0x7D, 0x88, 0x57, 0x1C, 0x80, 0xD7, 0x67,
+    0x28, 0x5E, 0xD0, 0xEB, 0x53, 0x35, 0xCF, 0x80, 0xEF, 0xA3, 0xB1, 0xEE, 0x0F, 0xFC, 0x7A, 0xAA,
+    0x7E, 0xDA, 0xEA, 0xA6, 0x81, 0xF7, 0x00, 0xC1, 0x9E, 0xAA, 0xC5, 0x06, 0x84, 0xFD, 0x31, 0xA5,
+    0xF6, 0x03, 0xC3, 0xBE, 0x54, 0xD7, 0x0D, 0x10, 0xFB, 0xB3, 0x5A, 0xE9, 0x03, 0xC5, 0xBE, 0xBB,
+    0xFF, 0x25, 0x8E, 0x9D, 0xF2, 0x1F, 0x38, 0xF6, 0x2D, 0xDE, 0x18, 0x40, 0xF6, 0xE7, 0x49, 0x9D,
+    0x4B, 0x1C, 0x47, 0xEC, 0x32, 0xA0, 0xFC, 0xFA, 0x67, 0xC5, 0x01, 0x96, 0xFD, 0x8A, 0x83, 0x06,
+    0x98, 0xFD, 0xA6, 0xF2, 0x0D, 0x34, 0xBF, 0xD2, 0xA4, 0xBC, 0x04, 0xCE, 0xAF, 0xE5, 0x51, 0xFE,
+    0xEE, 0x6E, 0x83, 0xC8, 0x73, 0x00, 0x1D, 0xE3, 0xB2, 0x6E, 0x77, 0x73, 0xC4, 0x7E, 0x34, 0x43,
+    0x2F, 0x24, 0x9D, 0x4B, 0x3B, 0xE4, 0xEA, 0x1B, 0x0C, 0x50, 0xBF, 0x36, 0x4A, 0x71, 0x80, 0xEA,
+    0x70, 0xF5, 0x20, 0x06, 0xAC, 0x23, 0x4C, 0xF7, 0x02, 0xAE, 0x23, 0x26, 0x53, 0x04, 0x71, 0xC4,
+    0xD1, 0x3D, 0x83, 0xEC, 0xA0, 0x37, 0x32, 0xA0, 0xFD, 0xCA, 0xAE, 0xDE, 0x0D, 0x6C, 0xC7, 0x54,
+    0x9F, 0x65, 0x80, 0x3B, 0x32, 0xE4, 0x03, 0xD0, 0x1D, 0xA9, 0x9E, 0xCD, 0x6E, 0x37, 0x76, 0xF0,
+    0x03, 0x7C, 0xBF, 0x7E, 0x50, 0xFE, 0x03, 0xE0, 0xAF, 0xB4, 0xCB, 0xA7, 0x20, 0xFC, 0xB5, 0x80,
+    0xF2, 0x33, 0x10, 0x7F, 0x55, 0x57, 0xBE, 0x07, 0xE3, 0x71, 0xC8, 0x0F, 0x40, 0xFE, 0xAA, 0xA9,
+    0xF2, 0x08, 0x94, 0xC7, 0x51, 0x8F, 0x6B, 0xC0, 0xFC, 0xE1, 0x43, 0x79, 0x09, 0xCE, 0x5F, 0xDF,
+    0x32, 0x34, 0x63, 0xFD, 0x18, 0xB2, 0x34, 0x66, 0xC1, 0xF3, 0x47, 0x6E, 0xD6, 0x31, 0x6A, 0x8D,
+    0x53, 0xFB, 0x39, 0x3C, 0x9F, 0xA6, 0x3E, 0xDE, 0xE1, 0xF9, 0x17, 0xA2, 0x6A, 0xA0, 0x1A, 0xDD,
+    0xAA, 0x2A, 0x0E, 0x87, 0xE7, 0xAF, 0x8A, 0x87, 0xD6, 0xD1, 0xAE, 0xBA, 0xE6, 0x0B, 0x87, 0xE7,
+    0x33, 0x7C, 0xE9, 0x5C, 0x5A, 0xD6, 0xD0, 0xAC, 0xE2, 0xF0, 0xFC, 0xCD, 0x86, 0x8C, 0x8B, 0x3D,
+    0x2F, 0x6A, 0xEE, 0x71, 0x78, 0xFE, 0x2A, 0x6C, 0xBD, 0xAF, 0xC3, 0xF3, 0x99, 0x9A, 0xA1, 0x1C,
+    0x9E, 0xCF, 0xDC, 0xE5, 0x17, 0x87, 0xE7, 0xAF, 0x79, 0x56, 0x1C, 0xF0, 0x7C, 0xAE, 0x95, 0x5A,
+    0x47, 0x1C, 0x5B, 0xB3, 0x9D, 0xC3, 0xF3, 0xB9, 0xD3, 0x75, 0x6E, 0xB7, 0xDE, 0x9A, 0x13, 0xBD,
+    0x87, 0xDE, 0xC3, 0xD8, 0xDB, 0x73, 0xEF, 0x39, 0x4C, 0xBE, 0xC4, 0x71, 0x5D, 0x63, 0x29, 0x3C,
+    0x9F, 0x97, 0xD9, 0xB5, 0x07, 0xE0, 0x61, 0x1A, 0x70, 0xE1, 0x79, 0x92, 0xE7, 0x0E, 0xCF, 0xF3,
+    0xB5, 0x55, 0x5A, 0x47, 0x2B, 0x6E, 0xCC, 0xD3, 0xF0, 0x3C, 0x9F, 0xC5, 0x74, 0xEE, 0x65, 0xEA,
+    0x66, 0x32, 0x87, 0xE7, 0xEF, 0x2F, 0x15, 0x07, 0x3C, 0xCF, 0x60, 0xC6, 0x87, 0xE7, 0x19, 0x47,
+    0xF7, 0x02, 0xCF, 0x73, 0xEA, 0xBF, 0x05, 0x1E, 0x3F, 0x86, 0x09, 0xDD, 0x33, 0x3C, 0xCF, 0xE4,
+    0x3D, 0xE0, 0xF9, 0xAB, 0xBA, 0x7A, 0x37, 0x78, 0xFE, 0xAA, 0xA9, 0xDE, 0x17, 0x9E, 0xE7, 0xEB,
+    0x41, 0x74, 0x2E, 0x71, 0x6C, 0xFD, 0x2F, 0xC4, 0xE1, 0x79, 0x6E, 0xF1, 0xC3, 0xE1, 0x79, 0x9E,
+    0x21, 0xFF, 0xC1, 0xF3, 0x7C, 0x65, 0xA8, 0xF6, 0x83, 0xE7, 0xF9, 0x50, 0xAB, 0xFF, 0x47, 0x10,
+    0xC7, 0x4D, 0xF9, 0x1E, 0x9E, 0xBF, 0x13, 0x14, 0x07, 0x3C, 0x5F, 0x23, 0x95, 0x47, 0xF0, 0xFC,
+    0xAB, 0xE4, 0x68, 0x3F, 0x86, 0xA3, 0x87, 0x6C, 0x9D, 0xDB, 0xE3, 0xD1, 0x50, 0xFE, 0xC2, 0xF3,
+    0x05, 0xCF, 0x1D, 0x9E, 0xAF, 0xE8, 0x75, 0x0C, 0x49, 0xC1, 0x7E, 0xF0, 0xFC, 0x6B, 0xB8, 0xAA,
+    0x73, 0xE1, 0xF9, 0x9A, 0xE8, 0x83, 0xE7, 0x2B, 0x89, 0x03, 0x9E, 0xAF, 0x24, 0x5E, 0x78, 0xBE,
+    0x16, 0xF7, 0x02, 0xCF, 0xBF, 0xD2, 0x48, 0xE7, 0x12, 0xC7, 0xE6, 0x9E, 0xE1, 0xF9, 0xEA, 0xF7,
+    0x80, 0xE7, 0xAF, 0x1A, 0xE8, 0xDD, 0xE0, 0xF9, 0x57, 0xD9, 0xAD, 0xFD, 0xE0, 0xF9, 0xBA, 0xF8,
+    0x00, 0x9E, 0x3F, 0xB7, 0xC8, 0x2F, 0xF0, 0x7C, 0x0F, 0x7C, 0x05, 0xCF, 0xF7, 0xC0, 0x7F, 0xF0,
+    0xFC, 0xD9, 0x45, 0x3E, 0x85, 0xE7, 0xDB, 0xF0, 0x33, 0x3C, 0xDF, 0x8E, 0xEF, 0xE1, 0xF9, 0xEE,
+    0xFC, 0x80, 0xE7, 0x3B, 0xC8, 0x23, 0x78, 0xFE, 0x86, 0x4D, 0xE5, 0x1B, 0x3C, 0xDF, 0x93, 0xBC,
+    0x84, 0xE7, 0x3B, 0xC9, 0x5F, 0x78, 0xBE, 0xE9, 0xDB, 0x1D, 0x9E, 0x3F, 0xD2, 0xB2, 0x8E, 0x38,
+    0x16, 0x75, 0x63, 0xF7, 0x00, 0x4B, 0x7D, 0x81, 0xE7, 0x7B, 0x53, 0x87, 0xE0, 0xF9, 0xEE, 0x7A,
+    0x05, 0xCF, 0xF7, 0xA1, 0xAE, 0xC1, 0xF3, 0xD7, 0x8E, 0xEB, 0x5E, 0xE0, 0xF9, 0x19, 0xD4, 0x49,
+    0x78, 0x7E, 0x06, 0xF5, 0x14, 0x9E, 0x1F, 0xFE, 0x0F, 0xE6, 0xF0, 0xFC, 0x18, 0xF5, 0x19, 0x9E,
+    0x1F, 0xA7, 0x8E, 0xC3, 0xF3, 0xE3, 0xD4, 0x7B, 0x78, 0x7E, 0x02, 0x2E, 0xF4, 0x30, 0xDE, 0xFC,
+    0xE8, 0x71, 0x7C, 0xC2, 0x99, 0x1E, 0xC8, 0x13, 0x1E, 0xF5, 0x48, 0x9E, 0x70, 0xAB, 0x87, 0xF2,
+    0x05, 0xDF, 0xE0, 0xF9, 0xD9, 0xE4, 0x07, 0x3C, 0x7F, 0xA3, 0x86, 0xF2, 0x08, 0x9E, 0x9F, 0x03,
+    0x57, 0xE1, 0xF9, 0x39, 0xF0, 0x17, 0x9E, 0x9F, 0xFB, 0xC5, 0xE9, 0xFF, 0x01, 0xF5, 0xF1, 0x36,
+    0x96, 0x70, 0x16, 0x00, 0x00,
+};
+
+static const uint8_t gzip_fixed[] = {
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xCB, 0x48, 0xCD, 0xC9, 0xC9, 0x57,
+    0xC8, 0x40, 0x27, 0xB9, 0x00, 0x00, 0x88, 0x59, 0x0B, 0x18, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t gzip_stored[] = {
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x01, 0x0D, 0x00, 0xF2, 0xFF, 0x73,
+    0x74, 0x6F, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x0A, 0x6D, 0x75, 0x88, 0xC5,
+    0x0D, 0x00, 0x00, 0x00,
+};
+
+// text of gzip_dynamic
+static char *dynamic_text(size_t *len){
+    char *text = malloc(8192);
+    size_t used = 0;
+
+    for(int n = 0; n < 300; n++)
+        used += (size_t)sprintf(text + used, "row %i,value %i\n", n, n * n);
+
+    *len = used;
+    return text;
+}
+
+// reads a whole file through a freader in small reads, false if the reader reports a error
+static bool read_all(const char *filename, wbuffer_t *output){
+    uint8_t chunk[100];
+    freader_t *reader = freader_open((char*)filename);
+    if(reader == NULL) return false;
+
+    size_t read;
+    while((read = freader_read(reader, chunk, sizeof(chunk))) > 0)
+        wbuffer_write(output, chunk, read);
+
+    bool error = freader_error(reader);
+    freader_close(reader);
+
+    return !error;
+}
+
+// every block type decodes, single and multi member files
+static void test_round_trip(void){
+    size_t len;
+    char *text = dynamic_text(&len);
+    wbuffer_t output;
+
+    check(test_write_file(GZIP_FILE, gzip_dynamic, sizeof(gzip_dynamic)));
+
+    wbuffer_init(&output, 64, NULL, NULL);
+    check(read_all(GZIP_FILE, &output));
+    check(output.len == len && !memcmp(output.data, text, len));
+    wbuffer_free(&output);
+
+    size_t loaded_len;
+    char *loaded = fload(GZIP_FILE, &loaded_len);
+    check(loaded != NULL && loaded_len == len && !memcmp(loaded, text, len));
+    free(loaded);
+
+    doc *csv = doc_csv_open(GZIP_FILE, csv_parse_normal_mode);                      // the open calls read it transparently
+    check(csv != NULL && csv->childs == 300);
+
+    doc *last = csv != NULL ? csv->child : NULL;
+    while(last != NULL && last->next != NULL) last = last->next;
+    check(last != NULL && !strcmp(doc_get(last, "[1]", char*), "value 89401"));
+    doc_delete(csv, ".");
+
+    FILE *file = fopen(GZIP_FILE, "wb");                                            // members are concatenated
+    fwrite(gzip_fixed, 1, sizeof(gzip_fixed), file);
+    fwrite(gzip_stored, 1, sizeof(gzip_stored), file);
+    fwrite(gzip_fixed, 1, sizeof(gzip_fixed), file);
+    fclose(file);
+
+    const char *expected = "hello hello hello hello\nstored block\nhello hello hello hello\n";
+    wbuffer_init(&output, 64, NULL, NULL);
+    check(read_all(GZIP_FILE, &output));
+    check(output.len == strlen(expected) && !memcmp(output.data, expected, output.len));
+    wbuffer_free(&output);
+
+    free(text);
+}
+
+// broken members are reported as errors, never read out of bounds
+static void test_malformed(void){
+    uint8_t *corrupt = malloc(sizeof(gzip_dynamic));
+    wbuffer_t output;
+
+    check(test_write_file(CORRUPT_FILE, gzip_dynamic, sizeof(gzip_dynamic) - 4));   // truncated length
+    wbuffer_init(&output, 64, NULL, NULL);
+    check(!read_all(CORRUPT_FILE, &output));
+    wbuffer_free(&output);
+    check(fload(CORRUPT_FILE, NULL) == NULL);
+
+    memcpy(corrupt, gzip_dynamic, sizeof(gzip_dynamic));                            // wrong crc
+    corrupt[sizeof(gzip_dynamic) - 8] ^= 0x01;
+    check(test_write_file(CORRUPT_FILE, corrupt, sizeof(gzip_dynamic)));
+    check(fload(CORRUPT_FILE, NULL) == NULL);
+
+    for(size_t i = 10; i < sizeof(gzip_dynamic); i++){                              // every byte of the deflate data flipped
+        memcpy(corrupt, gzip_dynamic, sizeof(gzip_dynamic));
+        corrupt[i] ^= 0xFF;                                                         // every bit, the last byte has padding bits
+        check(test_write_file(CORRUPT_FILE, corrupt, sizeof(gzip_dynamic)));
+
+        wbuffer_init(&output, 64, NULL, NULL);
+        check(!read_all(CORRUPT_FILE, &output));                                    // the crc catches what decodes
+        wbuffer_free(&output);
+    }
+
+    for(size_t cut = 3; cut < sizeof(gzip_dynamic); cut += 7){                       // truncations
+        check(test_write_file(CORRUPT_FILE, gzip_dynamic, cut));
+        check(fload(CORRUPT_FILE, NULL) == NULL);
+    }
+
+    free(corrupt);
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_malformed);
+
+    return test_result();
+}
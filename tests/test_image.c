@@ -0,0 +1,135 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_image.h"
+
+#define IMAGE_FILE      TEST_OUTPUT_DIR "test.img"
+#define CORRUPT_FILE    TEST_OUTPUT_DIR "corrupt.img"
+
+// document used by the tests
+static doc *new_test_doc(void){
+    return doc_new(
+        "root", dt_obj,
+            "integer", dt_int64, -42LL,
+            "real", dt_double, 2.5,
+            "flag", dt_bool, true,
+            "nothing", dt_null,
+            "text", dt_const_string, "hello", 5ULL,
+            "blob", dt_const_bindata, "\x01\x02\x03", 3ULL,
+            "sub", dt_obj,
+                "x", dt_double, 1.25,
+                "y", dt_const_string, "yy", 2ULL,
+            ";",
+            "list", dt_array,
+                "a", dt_int, 1,
+                "b", dt_int, 2,
+                "c", dt_int, 3,
+            ";",
+        ";"
+    );
+}
+
+// values read back from the mapping and as a doc
+static void test_round_trip(void){
+    doc *original = new_test_doc();
+    check(doc_image_write(original, IMAGE_FILE));
+
+    doc_image *image = doc_image_open(IMAGE_FILE);
+    check(image != NULL);
+
+    check(doc_image_get(image, "integer", int64_t) == -42);
+    check(doc_image_get(image, "real", double) == 2.5);
+    check(doc_image_get(image, "flag", bool) == true);
+    check(doc_image_get(image, "sub.x", double) == 1.25);
+    check(!strcmp(doc_image_get_string(image, "text"), "hello"));
+    check(!strcmp(doc_image_get_string(image, "sub.y"), "yy"));
+    check(doc_image_get_size(image, "blob") == 3);
+    check(!memcmp(doc_image_node_data(image, doc_image_get_ptr(image, "blob")), "\x01\x02\x03", 3));
+    check(doc_image_get(image, "list[2]", int) == 3);
+    check(doc_image_get_size(image, "list") == 3);
+    check(doc_image_get_ptr(image, "missing") == NULL);
+    check(doc_image_get_ptr(image, "list[3]") == NULL);
+
+    doc *copy = doc_image_to_doc(image, ".");
+    check(test_doc_equal(original, copy, true));
+
+    doc_delete(copy, ".");
+    doc_image_close(image);
+    doc_delete(original, ".");
+}
+
+// members without a name are written with a empty one
+static void test_unnamed_member(void){
+    doc *original = new_test_doc();
+    doc *member = doc_get_ptr(original, "sub");
+
+    free(member->name);
+    member->name = NULL;
+
+    check(doc_image_write(original, IMAGE_FILE));
+
+    doc_image *image = doc_image_open(IMAGE_FILE);
+    check(image != NULL);
+    check(doc_image_get(image, "integer", int64_t) == -42);
+
+    doc_image_close(image);
+    doc_delete(original, ".");
+}
+
+// images that are not valid are not opened, and corrupted nodes are not found instead of read out of bounds
+static void test_malformed(void){
+    doc *original = new_test_doc();
+    size_t len;
+
+    check(doc_image_write(original, IMAGE_FILE));
+    doc_delete(original, ".");
+
+    uint8_t *data = test_read_file(IMAGE_FILE, &len);
+    uint8_t *corrupt = malloc(len);
+
+    check(doc_image_open(TEST_OUTPUT_DIR "missing.img") == NULL);
+
+    check(test_write_file(CORRUPT_FILE, data, 16));                                 // truncated header
+    check(doc_image_open(CORRUPT_FILE) == NULL);
+
+    memcpy(corrupt, data, len);                                                     // bad magic
+    corrupt[0] ^= 0xFF;
+    check(test_write_file(CORRUPT_FILE, corrupt, len));
+    check(doc_image_open(CORRUPT_FILE) == NULL);
+
+    check(test_write_file(CORRUPT_FILE, data, len - 8));                            // size doesn't match the header
+    check(doc_image_open(CORRUPT_FILE) == NULL);
+
+    for(size_t i = 40; i < len; i++){                                               // every byte after the header, flipped
+        memcpy(corrupt, data, len);
+        corrupt[i] ^= (i & 1) ? 0xFF : 0x80;
+        check(test_write_file(CORRUPT_FILE, corrupt, len));
+
+        doc_image *image = doc_image_open(CORRUPT_FILE);
+        if(image == NULL) continue;
+
+        char *paths[] = { "integer", "text", "blob", "sub.x", "sub.y", "list[1]", "list", "." };
+
+        for(size_t p = 0; p < sizeof(paths) / sizeof(*paths); p++){
+            doc_image_node *node = doc_image_get_ptr(image, paths[p]);
+
+            if(node != NULL) check(strlen(doc_image_node_name(image, node)) == node->name_len);
+
+            doc_image_get_size(image, paths[p]);
+
+            doc *copy = doc_image_to_doc(image, paths[p]);
+            doc_delete(copy, ".");
+        }
+
+        doc_image_close(image);
+    }
+
+    free(corrupt);
+    free(data);
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_unnamed_member);
+    run_test(test_malformed);
+
+    return test_result();
+}
@@ -0,0 +1,134 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_ini.h"
+
+#define INI_FILE        TEST_OUTPUT_DIR "test.ini"
+
+static const char *test_ini =
+    "; global values\n"
+    "name = demo\n"
+    "count=42\n"
+    "ratio = 2.5\n"
+    "on = true\n"
+    "empty=\n"
+    "bare\n"
+    "quoted = \"a # b ; c\"\n"
+    "long = one \\\n"
+    " two\n"
+    "\n"
+    "[server]\n"
+    "host = example.org # trailing comment\n"
+    "port=8080\r\n"
+    "{anonymous}\n"
+    "\n"
+    "[paths]\n"
+    "root=/var/data\n";
+
+/* ----------------------------------------- Helpers ---------------------------------------- */
+
+// parses a string literal, the stream is copied since the parse calls take a mutable pointer
+static doc *parse(const char *text){
+    char *stream = strdup(text);
+    doc *ini = doc_ini_parse(stream);
+
+    free(stream);
+    return ini;
+}
+
+// checks a string value
+static bool string_is(doc *ini, char *path, const char *string){
+    doc *variable = doc_get_ptr(ini, path);
+    return variable != NULL && variable->type == dt_string && !strcmp(((doc_string*)variable)->string, string);
+}
+
+/* ----------------------------------------- Tests ------------------------------------------ */
+
+// values, sections and comments are parsed as documented
+static void test_parse(void){
+    doc *ini = parse(test_ini);
+    int64_t value;
+
+    check(ini != NULL && ini->childs == 10);
+    check(string_is(ini, "name", "demo"));
+    check(test_doc_integer(doc_get_ptr(ini, "count"), &value) && value == 42);
+    check(doc_get_ptr(ini, "ratio")->type == dt_double && doc_get(ini, "ratio", double) == 2.5);
+    check(doc_get_ptr(ini, "on")->type == dt_bool && doc_get(ini, "on", bool));
+    check(doc_get_ptr(ini, "empty")->type == dt_null && doc_get_ptr(ini, "bare")->type == dt_null);
+    check(string_is(ini, "quoted", "a # b ; c"));
+    check(string_is(ini, "long", "one  two"));
+    check(string_is(ini, "server.host", "example.org"));
+    check(test_doc_integer(doc_get_ptr(ini, "server.port"), &value) && value == 8080);
+    check(string_is(ini, "server[2]", "anonymous") && !strcmp(doc_get_ptr(ini, "server[2]")->name, ""));
+    check(string_is(ini, "paths.root", "/var/data"));
+
+    doc_delete(ini, ".");
+}
+
+// parse, stringify and parse again gives the same doc
+static void test_round_trip(void){
+    doc *ini = parse(test_ini);
+    char *stringified = doc_ini_stringify(ini);
+    doc *again = parse(stringified);
+    char *restringified = doc_ini_stringify(again);
+
+    check(test_doc_equal(ini, again, true));
+    check(stringified != NULL && restringified != NULL && !strcmp(stringified, restringified));
+
+    doc_ini_save(ini, INI_FILE);
+    doc *opened = doc_ini_open(INI_FILE);
+    check(test_doc_equal(ini, opened, true));
+    doc_delete(opened, ".");
+
+    free(restringified);
+    doc_delete(again, ".");
+    free(stringified);
+    doc_delete(ini, ".");
+}
+
+// broken input is parsed without reading past the stream
+static void test_malformed(void){
+    const char *broken[] = { "", "[", "[a", "[]\n=\n", "=", "a", "a=\"open", "{", "{a", "\\", "a=\\", "a=\\\n", "#", "\n\n\r" };
+
+    for(size_t i = 0; i < sizeof(broken) / sizeof(*broken); i++){
+        doc *ini = parse(broken[i]);
+        check(ini != NULL);
+        free(doc_ini_stringify(ini));
+        doc_delete(ini, ".");
+    }
+
+    size_t len = strlen(test_ini);
+    char *stream = malloc(len + 1);
+    for(size_t cut = 0; cut < len; cut++){                                          // every truncation
+        memcpy(stream, test_ini, cut);
+        stream[cut] = '\0';
+
+        doc *ini = doc_ini_parse(stream);
+        check(ini != NULL);
+        doc_delete(ini, ".");
+    }
+    free(stream);
+
+    char random[1025];
+    uint32_t seed = 11;
+    const char alphabet[] = "ab1=[]{}\"\\#;\n\r .";
+
+    for(int round = 0; round < 500; round++){                                       // random streams
+        for(size_t i = 0; i < sizeof(random) - 1; i++){
+            seed = seed * 1103515245 + 12345;
+            random[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+        }
+        random[sizeof(random) - 1] = '\0';
+
+        doc *ini = doc_ini_parse(random);
+        check(ini != NULL);
+        free(doc_ini_stringify(ini));
+        doc_delete(ini, ".");
+    }
+}
+
+int main(void){
+    run_test(test_parse);
+    run_test(test_round_trip);
+    run_test(test_malformed);
+
+    return test_result();
+}
@@ -0,0 +1,156 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_lz.h"
+#include "c_doc/doc_json.h"
+#include "c_doc/parse_utils.h"
+
+#define JSON_FILE       TEST_OUTPUT_DIR "test.json" DOC_LZ_EXTENSION
+
+// data that compresses a little: words from a small set with random numbers
+static uint8_t *new_test_data(size_t len){
+    static const char *words[] = { "alpha ", "beta ", "gamma ", "delta ", "\"key\": ", "12345, " };
+    uint8_t *data = malloc(len + 1);
+    uint32_t seed = 12345;
+
+    for(size_t i = 0; i < len;){
+        seed = seed * 1103515245 + 12345;
+
+        if(seed & 0x10000){
+            data[i++] = (uint8_t)(seed >> 24);
+            continue;
+        }
+
+        const char *word = words[(seed >> 20) % 6];
+        for(; *word != '\0' && i < len; word++)
+            data[i++] = (uint8_t)*word;
+    }
+
+    return data;
+}
+
+// collects the output of a writer
+static void write_to_buffer(void *context, const void *data, size_t len){
+    wbuffer_write((wbuffer_t*)context, data, len);
+}
+
+// blocks and frames decompress to the same data
+static void test_round_trip(void){
+    size_t sizes[] = { 0, 1, 15, 100, 65536, 65537, 300000 };
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++){
+        size_t len = sizes[i];
+        uint8_t *data = new_test_data(len);
+
+        size_t capacity = doc_lz_compress_bound(len);
+        uint8_t *block = malloc(capacity);
+        uint8_t *raw = malloc(len + 1);
+        size_t block_len = doc_lz_compress(data, len, block, capacity);
+
+        if(len <= DOC_LZ_MAX_BLOCK_SIZE && len > 0){
+            check(block_len > 0);
+            check(doc_lz_decompress(block, block_len, raw, len) && !memcmp(raw, data, len));
+        }
+
+        size_t frame_len, raw_len;
+        uint8_t *frame = doc_lz_frame_compress(data, len, &frame_len);
+        uint8_t *decompressed = doc_lz_frame_decompress(frame, frame_len, &raw_len);
+
+        check(doc_lz_is_frame(frame, frame_len));
+        check(decompressed != NULL && raw_len == len && !memcmp(decompressed, data, len));
+
+        wbuffer_t output;                                                           // streamed in small writes
+        wbuffer_init(&output, 64, NULL, NULL);
+
+        doc_lz_writer *writer = doc_lz_writer_new(write_to_buffer, &output, 4096);
+        for(size_t offset = 0; offset < len; offset += 1000)
+            doc_lz_write(writer, data + offset, len - offset < 1000 ? len - offset : 1000);
+        doc_lz_writer_close(writer);
+
+        size_t streamed_len;
+        uint8_t *streamed = (uint8_t*)wbuffer_release(&output, &streamed_len);
+        uint8_t *streamed_raw = doc_lz_frame_decompress(streamed, streamed_len, &raw_len);
+        check(streamed_raw != NULL && raw_len == len && !memcmp(streamed_raw, data, len));
+
+        free(streamed_raw);
+        free(streamed);
+        free(decompressed);
+        free(frame);
+        free(raw);
+        free(block);
+        free(data);
+    }
+}
+
+// files saved with the extension are compressed and opened back
+static void test_files(void){
+    doc *original = doc_new("root", dt_obj, "name", dt_const_string, "compressed", 10ULL, "value", dt_double, 2.5, ";");
+
+    doc_json_save(original, JSON_FILE);
+
+    size_t len;
+    uint8_t *file = test_read_file(JSON_FILE, &len);
+    check(file != NULL && doc_lz_is_frame(file, len));
+
+    doc *opened = doc_json_open(JSON_FILE);
+    check(test_doc_equal(original, opened, false));
+
+    doc_delete(opened, ".");
+    doc_delete(original, ".");
+    free(file);
+}
+
+// broken blocks and frames are rejected without writing past the output
+static void test_malformed(void){
+    size_t len = 100000;
+    uint8_t *data = new_test_data(len);
+    size_t frame_len;
+    uint8_t *frame = doc_lz_frame_compress(data, len, &frame_len);
+
+    for(size_t cut = 0; cut < frame_len; cut += (cut < 64 ? 1 : 97))               // truncations
+        free(doc_lz_frame_decompress(frame, cut, NULL));
+
+    check(doc_lz_frame_decompress(frame, frame_len / 2, NULL) == NULL);
+
+    for(size_t i = 0; i < frame_len; i += (i < 64 ? 1 : 31)){                       // flipped bytes, rejected or decoded without faults
+        uint8_t *corrupt = malloc(frame_len);
+
+        memcpy(corrupt, frame, frame_len);
+        corrupt[i] ^= 0xFF;
+        free(doc_lz_frame_decompress(corrupt, frame_len, NULL));
+        free(corrupt);
+    }
+
+    size_t capacity = doc_lz_compress_bound(4096);
+    uint8_t *block = malloc(capacity);
+    uint8_t *raw = malloc(4096);
+    size_t block_len = doc_lz_compress(data, 4096, block, capacity);
+
+    check(!doc_lz_decompress(block, block_len, raw, 4095));                          // raw_len must be exact
+    check(!doc_lz_decompress(block, block_len - 1, raw, 4096));
+
+    for(size_t i = 0; i < block_len; i++){
+        uint8_t *corrupt = malloc(block_len);
+
+        memcpy(corrupt, block, block_len);
+        corrupt[i] ^= 0xFF;
+        doc_lz_decompress(corrupt, block_len, raw, 4096);
+        free(corrupt);
+    }
+
+    uint8_t match_before_start[] = { 0x04, 0x01, 0x00, 0x00 };                      // a match going back past the output
+    check(!doc_lz_decompress(match_before_start, sizeof(match_before_start), raw, 64));
+
+    check(!doc_lz_is_frame("DLZ", 3));
+
+    free(raw);
+    free(block);
+    free(frame);
+    free(data);
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_files);
+    run_test(test_malformed);
+
+    return test_result();
+}
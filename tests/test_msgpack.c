@@ -0,0 +1,150 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_msgpack.h"
+#include "c_doc/parse_utils.h"
+
+#define MSGPACK_FILE    TEST_OUTPUT_DIR "test.msgpack"
+
+// document with every type msgpack keeps
+static doc *new_test_doc(void){
+    return doc_new(
+        "root", dt_obj,
+            "small", dt_int64, 7LL,
+            "negative", dt_int64, -33LL,
+            "large", dt_int64, -9223372036854775807LL - 1,
+            "unsigned", dt_uint64, 18446744073709551615ULL,
+            "real", dt_double, 0.1,
+            "single", dt_float, 1.5,
+            "flag", dt_bool, false,
+            "nothing", dt_null,
+            "text", dt_const_string, "h\\u00e9llo", 10ULL,
+            "blob", dt_const_bindata, "\x00\x01\x02", 3ULL,
+            "list", dt_array,
+                "0", dt_int64, 1LL,
+                "1", dt_int64, 2LL,
+            ";",
+            "objects", dt_array,
+                "0", dt_obj,
+                    "deep", dt_bool, true,
+                    "name", dt_const_string, "two", 3ULL,
+                ";",
+            ";",
+            "empty", dt_obj,
+            ";",
+        ";"
+    );
+}
+
+// collects the output of a writer
+static void write_to_buffer(void *context, const void *data, size_t len){
+    wbuffer_t *buffer = context;
+    wbuffer_write(buffer, data, len);
+}
+
+// serialize and parse back, with the buffer, the writer and a file
+static void test_round_trip(void){
+    doc *original = new_test_doc();
+    size_t len;
+
+    uint8_t *stream = doc_msgpack_serialize(original, &len);
+    doc *parsed = doc_msgpack_parse(stream, len);
+
+    check(original != NULL && parsed != NULL);
+    check(parsed != NULL && !strcmp(parsed->name, "msgpack"));
+    check(test_doc_equal(original, parsed, false));
+
+    size_t written_len;
+    wbuffer_t output;
+    wbuffer_init(&output, 64, NULL, NULL);
+
+    doc_msgpack_writer *writer = doc_msgpack_writer_new(write_to_buffer, &output);
+    doc_msgpack_write_doc(writer, original);
+    doc_msgpack_writer_close(writer);
+
+    uint8_t *written = (uint8_t*)wbuffer_release(&output, &written_len);
+    check(written_len == len && !memcmp(written, stream, len));
+
+    doc_msgpack_save(original, MSGPACK_FILE);
+    doc *opened = doc_msgpack_open(MSGPACK_FILE);
+    check(test_doc_equal(original, opened, false));
+
+    doc_delete(opened, ".");
+    doc_delete(parsed, ".");
+    doc_delete(original, ".");
+    free(written);
+    free(stream);
+}
+
+// keys that are not strings become names
+static void test_keys(void){
+    uint8_t stream[] = {
+        0x86,
+        0xC3, 0x01,                                                                 // true
+        0xC2, 0x02,                                                                 // false
+        0xC0, 0x03,                                                                 // nil
+        0xCB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,                 // 1.5
+        0xFD, 0x05,                                                                 // -3
+        0xCD, 0x01, 0x00, 0x06                                                      // 256
+    };
+    const char *names[] = { "true", "false", "null", "1.5", "-3", "256" };
+
+    doc *parsed = doc_msgpack_parse(stream, sizeof(stream));
+    check(parsed != NULL && parsed->childs == 6);
+
+    size_t i = 0;
+    for(doc *member = parsed != NULL ? parsed->child : NULL; member != NULL; member = member->next, i++)
+        check(!strcmp(member->name, names[i]));
+
+    doc_delete(parsed, ".");
+
+    uint8_t bin_key[] = { 0x81, 0xC4, 0x01, 0xAA, 0x01 };
+    uint8_t array_key[] = { 0x81, 0x90, 0x01 };
+    check(doc_msgpack_parse(bin_key, sizeof(bin_key)) == NULL);
+    check(doc_msgpack_parse(array_key, sizeof(array_key)) == NULL);
+}
+
+// truncated, invalid and hostile streams give NULL
+static void test_malformed(void){
+    doc *original = new_test_doc();
+    size_t len;
+    uint8_t *stream = doc_msgpack_serialize(original, &len);
+
+    for(size_t cut = 0; cut < len; cut++)                                           // every truncation
+        check(doc_msgpack_parse(stream, cut) == NULL);
+
+    for(size_t i = 0; i < len; i++){                                                // every byte flipped, parsed or rejected without faults
+        uint8_t *corrupt = malloc(len);
+
+        memcpy(corrupt, stream, len);
+        corrupt[i] ^= 0xFF;
+        doc_delete(doc_msgpack_parse(corrupt, len), ".");
+        free(corrupt);
+    }
+
+    uint8_t reserved[] = { 0xC1 };
+    uint8_t huge_string[] = { 0xDB, 0xFF, 0xFF, 0xFF, 0xFF, 'a' };
+    uint8_t huge_array[] = { 0xDD, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    uint8_t trailing[] = { 0x01, 0x02 };
+    check(doc_msgpack_parse(reserved, sizeof(reserved)) == NULL);
+    check(doc_msgpack_parse(huge_string, sizeof(huge_string)) == NULL);
+    check(doc_msgpack_parse(huge_array, sizeof(huge_array)) == NULL);
+    doc_delete(doc_msgpack_parse(trailing, sizeof(trailing)), ".");
+
+    uint8_t *nested = malloc(100000);                                               // deep nesting is refused, not recursed into
+    memset(nested, 0x91, 100000);
+    check(doc_msgpack_parse(nested, 100000) == NULL);
+
+    check(doc_msgpack_parse(NULL, 0) == NULL);
+    check(doc_msgpack_open(TEST_OUTPUT_DIR "missing.msgpack") == NULL);
+
+    free(nested);
+    free(stream);
+    doc_delete(original, ".");
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_keys);
+    run_test(test_malformed);
+
+    return test_result();
+}
@@ -0,0 +1,183 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_table.h"
+#include "c_doc/doc_csv.h"
+#include "c_doc/parse_utils.h"
+
+#define TABLE_FILE      TEST_OUTPUT_DIR "test.doctbl"
+#define BROKEN_FILE     TEST_OUTPUT_DIR "broken.doctbl"
+#define TABLE_ROWS      (DOC_TABLE_PAGE_ROWS + 4464)                                // two pages, the last one short
+
+/* ----------------------------------------- Helpers ---------------------------------------- */
+
+// csv with every column type and a dictionary friendly column, with empty cells for nulls
+static char *new_table_csv(size_t rows, bool nulls){
+    static const char *tags[] = { "red", "green", "blue", "\"with, comma\"" };
+    wbuffer_t csv;
+
+    wbuffer_init(&csv, 1 << 16, NULL, NULL);
+    wbuffer_write(&csv, "id,price,ok,tag,name\n", 21);
+
+    for(size_t i = 0; i < rows; i++){
+        char line[128];
+        int len = snprintf(line, sizeof(line), "%zu,", i * 3);
+        if(i % 13 || !nulls) len += snprintf(line + len, sizeof(line) - len, "%zu.5", i);
+        len += snprintf(line + len, sizeof(line) - len, ",%s,%s,n%zu\n", i % 3 ? "false" : "true", i % 17 || !nulls ? tags[i % 4] : "", i);
+        wbuffer_write(&csv, line, len);
+    }
+
+    wbuffer_write(&csv, "", 1);
+    return (char*)csv.data;
+}
+
+// compares a column read from a table with the one of a columnar csv
+static bool column_equal(doc *a, doc *b){
+    if(a == NULL || b == NULL) return false;
+
+    doc_csv_column_type_t type = doc_csv_column_type(a);
+    size_t rows = doc_csv_column_rows(a);
+    if(type != doc_csv_column_type(b) || rows != doc_csv_column_rows(b)) return false;
+
+    for(size_t row = 0; row < rows; row++){
+        bool valid = doc_csv_column_valid(a, row);
+        if(valid != doc_csv_column_valid(b, row)) return false;
+        if(!valid) continue;
+
+        switch(type){
+            case csv_column_int64:  if(doc_csv_column_int64(a)[row] != doc_csv_column_int64(b)[row]) return false;     break;
+            case csv_column_double: if(doc_csv_column_double(a)[row] != doc_csv_column_double(b)[row]) return false;   break;
+            case csv_column_bool:   if(doc_csv_column_bool(a)[row] != doc_csv_column_bool(b)[row]) return false;       break;
+            case csv_column_string:{
+                size_t len_a, len_b;
+                const char *string_a = doc_csv_column_string(a, row, &len_a);
+                const char *string_b = doc_csv_column_string(b, row, &len_b);
+                if(len_a != len_b || memcmp(string_a, string_b, len_a)) return false;
+            }break;
+        }
+    }
+
+    return true;
+}
+
+// compares every column of a table read with a columnar csv, by name
+static bool table_equal(doc *table, doc *csv){
+    if(table == NULL || csv == NULL || table->childs != csv->childs) return false;
+
+    for(doc *column = table->child; column != NULL; column = column->next)
+        if(!column_equal(column, doc_get_ptr(csv, column->name))) return false;
+
+    return true;
+}
+
+/* ----------------------------------------- Tests ------------------------------------------ */
+
+// columnar docs and objects of rows read back the same, objects of rows have no nulls since their empty cells are strings
+static void test_round_trip(void){
+    for(int nulls = 1; nulls >= 0; nulls--){
+        char *text = new_table_csv(TABLE_ROWS, nulls);
+        doc *columnar = doc_csv_parse(text, csv_parse_columnar | csv_parse_first_line_as_names);
+        doc *source = nulls ? columnar : doc_csv_parse(text, csv_parse_first_line_as_names);
+
+        check(doc_csv_is_columnar(columnar));
+        check(doc_csv_column_type(doc_get_ptr(columnar, "price")) == csv_column_double);
+        check(doc_csv_column_type(doc_get_ptr(columnar, "tag")) == csv_column_string);
+        check(doc_table_write(source, TABLE_FILE));
+
+        doc_table *table = doc_table_open(TABLE_FILE);
+        check(table != NULL);
+
+        if(table != NULL){
+            check(doc_table_rows(table) == TABLE_ROWS);
+            check(doc_table_columns(table) == 5);
+            check(doc_table_pages(table) == 2);
+            check(doc_table_column_index(table, "ok") == 2);
+            check(doc_table_column_type(table, 0) == csv_column_int64);
+            check(doc_table_column_type(table, 2) == csv_column_bool);
+
+            doc *read = doc_table_read(table, 0, NULL);
+            check(table_equal(read, columnar));
+            doc_delete(read, ".");
+
+            const char *names[] = { "name", "missing", "id" };                      // projection keeps the file order
+            read = doc_table_read(table, 3, names);
+            check(read != NULL && read->childs == 2 && !strcmp(read->child->name, "id"));
+            check(read != NULL && column_equal(doc_get_ptr(read, "name"), doc_get_ptr(columnar, "name")));
+            doc_delete(read, ".");
+
+            read = doc_table_read_pages(table, 1, 5, 0, NULL);                      // the short last page
+            check(read != NULL && doc_csv_column_rows(doc_get_ptr(read, "id")) == TABLE_ROWS - DOC_TABLE_PAGE_ROWS);
+            check(read != NULL && doc_csv_column_int64(doc_get_ptr(read, "id"))[0] == DOC_TABLE_PAGE_ROWS * 3);
+            doc_delete(read, ".");
+            check(doc_table_read_pages(table, 2, 1, 0, NULL) == NULL);
+
+            doc_table_stats_t stats;
+            check(doc_table_stats(table, 0, DOC_TABLE_ALL_PAGES, &stats));
+            check(stats.rows == TABLE_ROWS && stats.nulls == 0 && stats.min_int64 == 0 && stats.max_int64 == (TABLE_ROWS - 1) * 3);
+            check(doc_table_stats(table, 1, 0, &stats) && stats.nulls == (nulls ? (DOC_TABLE_PAGE_ROWS + 12) / 13 : 0));
+            check(!doc_table_stats(table, 5, 0, &stats) && !doc_table_stats(table, 0, 2, &stats));
+
+            doc_table_close(table);
+        }
+
+        if(source != columnar) doc_delete(source, ".");
+        doc_delete(columnar, ".");
+        free(text);
+    }
+}
+
+// opens and reads a broken table, it must fail or give a well formed doc
+static void open_broken(const uint8_t *data, size_t len){
+    check(test_write_file(BROKEN_FILE, data, len));
+
+    doc_table *table = doc_table_open(BROKEN_FILE);
+    if(table == NULL) return;
+
+    doc *read = doc_table_read(table, 0, NULL);
+    if(read != NULL)
+        for(doc *column = read->child; column != NULL; column = column->next)
+            for(size_t row = 0; row < doc_csv_column_rows(column); row++)           // touch every cell
+                if(doc_csv_column_type(column) == csv_column_string && doc_csv_column_valid(column, row)){
+                    size_t string_len;
+                    check(doc_csv_column_string(column, row, &string_len) != NULL);
+                }
+
+    doc_delete(read, ".");
+    doc_table_close(table);
+}
+
+// truncated and corrupted tables are rejected or read without going out of bounds
+static void test_malformed(void){
+    char *text = new_table_csv(300, true);
+    doc *columnar = doc_csv_parse(text, csv_parse_columnar | csv_parse_first_line_as_names);
+    check(doc_table_write(columnar, TABLE_FILE));
+
+    size_t len;
+    uint8_t *data = test_read_file(TABLE_FILE, &len);
+    check(data != NULL && len > 64);
+
+    check(test_write_file(BROKEN_FILE, "", 0) && doc_table_open(BROKEN_FILE) == NULL);
+    check(doc_table_open(TEST_OUTPUT_DIR "missing.doctbl") == NULL);
+
+    for(size_t cut = 0; cut < len; cut += 7){
+        check(test_write_file(BROKEN_FILE, data, cut));
+        check(doc_table_open(BROKEN_FILE) == NULL);                                  // the size in the header no longer matches
+    }
+
+    uint8_t *broken = malloc(len);
+    for(size_t i = 0; i < len; i++){
+        memcpy(broken, data, len);
+        broken[i] ^= 0xFF;
+        open_broken(broken, len);
+    }
+
+    free(broken);
+    free(data);
+    doc_delete(columnar, ".");
+    free(text);
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_malformed);
+
+    return test_result();
+}
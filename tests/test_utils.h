@@ -0,0 +1,140 @@
+#ifndef _TEST_UTILS_HEADER_
+#define _TEST_UTILS_HEADER_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "c_doc/doc.h"
+
+/**
+ * Minimal helpers shared by the tests in this folder, each test file is its own executable, built and run
+ * by 'make test'. A failed check is logged with its line and the test goes on, the exit code is 1 if any
+ * check failed.
+ */
+
+#define TEST_OUTPUT_DIR     "build/tests/"                                          // files written by the tests
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+// checks a condition, logging it if it fails
+#define check(condition)                                                                        \
+    do{                                                                                         \
+        test_checks++;                                                                          \
+        if(!(condition)){                                                                       \
+            printf("[%s:%i] [FAIL] %s\n", __FILE__, __LINE__, #condition);                     \
+            test_failures++;                                                                    \
+        }                                                                                       \
+    }while(0)
+
+// runs a test function
+#define run_test(function)                                                                      \
+    do{                                                                                         \
+        int failures = test_failures;                                                           \
+        function();                                                                             \
+        if(failures != test_failures) printf("[%s] [FAIL] %s\n", __FILE__, #function);          \
+    }while(0)
+
+// result of the tests of a file, to be returned from main
+#define test_result()                                                                           \
+    (printf("[%s] [%s] %i checks, %i failed\n", __FILE__, test_failures ? "FAIL" : "OK", test_checks, test_failures), \
+    test_failures != 0)
+
+// writes a buffer to a file
+static inline bool test_write_file(const char *filename, const void *data, size_t len){
+    FILE *file = fopen(filename, "wb");
+    if(file == NULL) return false;
+
+    bool ok = fwrite(data, 1, len, file) == len;
+    return fclose(file) == 0 && ok;
+}
+
+// reads a whole file, the length is written to *len
+static inline uint8_t *test_read_file(const char *filename, size_t *len){
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    *len = fread(data, 1, size > 0 ? (size_t)size : 0, file);
+    fclose(file);
+
+    return data;
+}
+
+// value of a integer node of any width, false if it is not a integer
+static inline bool test_doc_integer(doc *variable, int64_t *value){
+    switch(variable->type){
+        case dt_uint:   *value = ((doc_uint_t*)variable)->value;            return true;
+        case dt_uint64: *value = (int64_t)((doc_uint64_t*)variable)->value; return true;
+        case dt_uint32: *value = ((doc_uint32_t*)variable)->value;          return true;
+        case dt_uint16: *value = ((doc_uint16_t*)variable)->value;          return true;
+        case dt_uint8:  *value = ((doc_uint8_t*)variable)->value;           return true;
+        case dt_int:    *value = ((doc_int*)variable)->value;               return true;
+        case dt_int64:  *value = ((doc_int64_t*)variable)->value;           return true;
+        case dt_int32:  *value = ((doc_int32_t*)variable)->value;           return true;
+        case dt_int16:  *value = ((doc_int16_t*)variable)->value;           return true;
+        case dt_int8:   *value = ((doc_int8_t*)variable)->value;            return true;
+        default:        return false;
+    }
+}
+
+// compares two doc structures by names and values, recursive. Integers of any width are equal by value,
+// const strings and bindata equal their non const types and members of arrays are compared without their
+// names, since codecs don't keep those
+static inline bool test_doc_equal(doc *a, doc *b, bool compare_names){
+    if(a == NULL || b == NULL) return a == b;
+
+    if(compare_names){
+        const char *name_a = a->name != NULL ? a->name : "";
+        const char *name_b = b->name != NULL ? b->name : "";
+        if(strcmp(name_a, name_b)) return false;
+    }
+
+    int64_t integer_a, integer_b;
+    if(test_doc_integer(a, &integer_a)) return test_doc_integer(b, &integer_b) && integer_a == integer_b;
+
+    doc_type_t type_a = a->type == dt_const_string ? dt_string : a->type == dt_const_bindata ? dt_bindata : a->type;
+    doc_type_t type_b = b->type == dt_const_string ? dt_string : b->type == dt_const_bindata ? dt_bindata : b->type;
+    if(type_a != type_b) return false;
+
+    switch(type_a){
+        case dt_obj:
+        case dt_array:{
+            doc *member_b = b->child;
+
+            if(a->childs != b->childs) return false;
+
+            for(doc *member_a = a->child; member_a != NULL; member_a = member_a->next, member_b = member_b->next){
+                if(!test_doc_equal(member_a, member_b, type_a == dt_obj)) return false;
+            }
+
+            return true;
+        }
+
+        case dt_double:     return ((doc_double*)a)->value == ((doc_double*)b)->value;
+        case dt_float:      return ((doc_float*)a)->value == ((doc_float*)b)->value;
+        case dt_bool:       return ((doc_bool*)a)->value == ((doc_bool*)b)->value;
+
+        case dt_string:{                                                            // some parsers count the null terminator in len
+            size_t len_a = ((doc_string*)a)->len, len_b = ((doc_string*)b)->len;
+            if(len_a > 0 && ((doc_string*)a)->string[len_a - 1] == '\0') len_a--;
+            if(len_b > 0 && ((doc_string*)b)->string[len_b - 1] == '\0') len_b--;
+            return len_a == len_b && !memcmp(((doc_string*)a)->string, ((doc_string*)b)->string, len_a);
+        }
+
+        case dt_bindata:
+            return  ((doc_bindata*)a)->len == ((doc_bindata*)b)->len &&
+                    !memcmp(((doc_bindata*)a)->data, ((doc_bindata*)b)->data, ((doc_bindata*)a)->len);
+
+        default:
+            return true;
+    }
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "tests/test_utils.h"
+#include "c_doc/doc_xml.h"
+#include "c_doc/parse_utils.h"
+
+#define XML_FILE        TEST_OUTPUT_DIR "test.xml"
+
+static const char *test_xml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!-- entries of a feed -->\n"
+    "<feed lang=\"en\">\n"
+    "  <entry id=\"1\" type=\"a\">\n"
+    "    <title>Fish &amp; chips &#233; &#x41;</title>\n"
+    "    <count>42</count>\n"
+    "  </entry>\n"
+    "  <entry id=\"2\" type=\"b\">\n"
+    "    <title><![CDATA[<raw> & kept]]></title>\n"
+    "    <price>2.5</price>\n"
+    "    <empty/>\n"
+    "  </entry>\n"
+    "  <entry id=\"3\" type=\"a\" note='single &quot;quoted&quot;'>\n"
+    "    <title>last</title>\n"
+    "  </entry>\n"
+    "</feed>\n";
+
+/* ----------------------------------------- Helpers ---------------------------------------- */
+
+// parses a string literal, the stream is copied since the parse calls take a mutable pointer
+static doc *parse(const char *text){
+    char *stream = strdup(text);
+    doc *xml = doc_xml_parse(stream);
+
+    free(stream);
+    return xml;
+}
+
+// collects the output of doc_xml_write
+static void write_to_buffer(void *context, const void *data, size_t len){
+    wbuffer_write((wbuffer_t*)context, data, len);
+}
+
+// number of nodes a xpath selects
+static size_t select_count(doc *xml, const char *path){
+    doc_xpath *xpath = doc_xpath_compile(path);
+    size_t count = xpath != NULL ? doc_xpath_select(xml, xpath, NULL) : (size_t)-1;
+
+    doc_xpath_free(xpath);
+    return count;
+}
+
+// text value of the single element a xpath selects, NULL if it selects something else
+static const char *select_text(doc *xml, const char *path){
+    doc_xpath *xpath = doc_xpath_compile(path);
+    doc **nodes = NULL;
+    const char *text = NULL;
+
+    if(xpath != NULL && doc_xpath_select(xml, xpath, &nodes) == 1){
+        doc *node = nodes[0]->type == dt_obj ? nodes[0]->child : nodes[0];
+        if(node != NULL && (node->type == dt_string || node->type == dt_const_string)) text = ((doc_string*)node)->string;
+    }
+
+    free(nodes);
+    doc_xpath_free(xpath);
+    return text;
+}
+
+/* ----------------------------------------- Tests ------------------------------------------ */
+
+// parse, stringify and parse again gives the same doc, and so do the in situ parse and the indented writer
+static void test_round_trip(void){
+    doc *xml = parse(test_xml);
+    check(xml != NULL);
+    check(select_text(xml, "/feed/entry[1]/title") != NULL && !strcmp(select_text(xml, "/feed/entry[1]/title"), "Fish & chips \xC3\xA9 A"));
+    check(select_text(xml, "//entry[@id='2']/title") != NULL && !strcmp(select_text(xml, "//entry[@id='2']/title"), "<raw> & kept"));
+    check(select_text(xml, "/feed/entry[3]/@note") != NULL && !strcmp(select_text(xml, "/feed/entry[3]/@note"), "single \"quoted\""));
+
+    char *stringified = doc_xml_stringify(xml);
+    doc *again = parse(stringified);
+    char *restringified = doc_xml_stringify(again);
+
+    check(test_doc_equal(xml, again, true));
+    check(stringified != NULL && restringified != NULL && !strcmp(stringified, restringified));
+
+    char *stream = strdup(test_xml);
+    doc *in_situ = doc_xml_parse_in_situ(stream);
+    check(test_doc_equal(xml, in_situ, true));
+    doc_delete(in_situ, ".");
+    free(stream);
+
+    wbuffer_t output;
+    wbuffer_init(&output, 64, NULL, NULL);
+    check(doc_xml_write(xml, 2, write_to_buffer, &output));
+    wbuffer_write(&output, "", 1);
+
+    doc *indented = parse((char*)output.data);
+    check(strchr((char*)output.data, '\n') != NULL);
+    check(test_doc_equal(xml, indented, true));
+    doc_delete(indented, ".");
+    free(output.data);
+
+    doc_xml_save(xml, XML_FILE);
+    doc *opened = doc_xml_open(XML_FILE);
+    check(test_doc_equal(xml, opened, true));
+    doc_delete(opened, ".");
+
+    free(restringified);
+    doc_delete(again, ".");
+    free(stringified);
+    doc_delete(xml, ".");
+}
+
+// the events of the reader follow the document, and its elements match the ones of the parse
+static void test_reader(void){
+    check(test_write_file(XML_FILE, test_xml, strlen(test_xml)));
+    doc *xml = parse(test_xml);
+
+    doc_xml_reader *reader = doc_xml_reader_open(XML_FILE);
+    check(reader != NULL);
+    if(reader == NULL) return;
+
+    const doc_xml_event_t *event = doc_xml_reader_next(reader);
+    check(event != NULL && event->type == xml_event_start && !strcmp(event->name, "feed") && event->depth == 1);
+
+    size_t entries = 0;
+    doc *entry = doc_get_ptr(xml, "feed")->child->next;                             // after the atributes
+
+    while((event = doc_xml_reader_next(reader)) != NULL){
+        if(event->type == xml_event_start && !strcmp(event->name, "entry")){
+            doc *element = doc_xml_reader_element(reader);
+            check(element != NULL && entry != NULL && test_doc_equal(element, entry, true));
+            doc_delete(element, ".");
+
+            entries++;
+            if(entry != NULL) entry = entry->next;
+        }
+        else check(event->type == xml_event_end && !strcmp(event->name, "feed") && event->depth == 1);
+    }
+
+    check(entries == 3);
+    check(!doc_xml_reader_error(reader));
+    doc_xml_reader_close(reader);
+    doc_delete(xml, ".");
+}
+
+// xpath steps, predicates and atributes
+static void test_xpath(void){
+    doc *xml = parse(test_xml);
+
+    check(select_count(xml, "/feed/entry") == 3);
+    check(select_count(xml, "//title") == 3);
+    check(select_count(xml, "/feed/entry[@type='a']") == 2);
+    check(select_count(xml, "/feed/entry[@type!='a']/price") == 1);
+    check(select_count(xml, "/feed/entry[@note]") == 1);
+    check(select_count(xml, "/feed/entry[@type='a'][2]/title") == 1);
+    check(select_count(xml, "//entry/@*") == 7);
+    check(select_count(xml, "/feed/*") == 3);
+    check(select_count(xml, "/feed/entry[4]") == 0);
+    check(select_count(xml, "/missing") == 0);
+
+    doc *entry = doc_get_ptr(xml, "feed")->child->next;                             // relative paths start at the node given
+    check(select_count(entry, "title") == 1);
+    check(select_count(entry, "/feed/entry") == 3);
+
+    doc_delete(xml, ".");
+}
+
+// broken input is parsed without reading past the stream, broken xpaths don't compile
+static void test_malformed(void){
+    const char *broken[] = {
+        "", "<", "<a", "<a>", "</a>", "<a></b>", "<a><b></a>", "<a x=\"1></a>", "<a x=1></a>", "<a>&bogus;</a>",
+        "<a>&#xFFFFFFFFFF;</a>", "<a>&#;</a>", "<a><![CDATA[open</a>", "<!-- open", "<?xml", "<a/><b/>", "text",
+    };
+
+    for(size_t i = 0; i < sizeof(broken) / sizeof(*broken); i++){
+        doc *xml = parse(broken[i]);
+        check(xml != NULL);
+        free(doc_xml_stringify(xml));
+        doc_delete(xml, ".");
+
+        char *stream = strdup(broken[i]);
+        doc_delete(doc_xml_parse_in_situ(stream), ".");
+        free(stream);
+
+        check(test_write_file(XML_FILE, broken[i], strlen(broken[i])));              // the reader stops at the end of the file
+        doc_xml_reader *reader = doc_xml_reader_open(XML_FILE);
+        for(size_t events = 0; doc_xml_reader_next(reader) != NULL; events++) check(events < 64);
+        doc_xml_reader_close(reader);
+    }
+
+    size_t len = strlen(test_xml);
+    char *stream = malloc(len + 1);
+    for(size_t cut = 0; cut < len; cut++){                                          // every truncation in every parse
+        memcpy(stream, test_xml, cut);
+        stream[cut] = '\0';
+        doc_delete(parse(stream), ".");
+        doc_delete(doc_xml_parse_in_situ(stream), ".");
+
+        check(test_write_file(XML_FILE, test_xml, cut));
+        doc_xml_reader *reader = doc_xml_reader_open(XML_FILE);
+        const doc_xml_event_t *event;
+        while((event = doc_xml_reader_next(reader)) != NULL)
+            if(event->type == xml_event_start) doc_delete(doc_xml_reader_element(reader), ".");
+        doc_xml_reader_close(reader);
+    }
+    free(stream);
+
+    const char *paths[] = { "", "//", "/feed/", "feed[", "feed[0]", "feed[@]", "feed[@a='x]", "@id/feed", "feed/@", "a b" };
+    for(size_t i = 0; i < sizeof(paths) / sizeof(*paths); i++){
+        doc_xpath *xpath = doc_xpath_compile(paths[i]);
+        check(xpath == NULL);
+        doc_xpath_free(xpath);
+    }
+}
+
+int main(void){
+    run_test(test_round_trip);
+    run_test(test_reader);
+    run_test(test_xpath);
+    run_test(test_malformed);
+
+    return test_result();
+}